@@ -0,0 +1,90 @@
+/**
+ * Allocation tracker
+ *
+ * On debug builds (or if built with 'ALLOC_TRACK=yes'), malloc, calloc and
+ * realloc are interposed by the game, so every allocation is counted, even
+ * those made within GFraMe and SDL. Allocations made while the game state is
+ * updated or drawn (but not on the first frame of each) are also recorded per
+ * call site, and listed by alloc_report. Jobs carry the scope of the thread
+ * that pushed them, so whatever they allocate is attributed to that scope. As
+ * nothing should be allocated on a steady state, any site on that list is a
+ * bug.
+ *
+ * Interposing depends on glibc; Elsewhere, every function is a no-op.
+ *
+ * @file include/ld34/alloc.h
+ */
+#ifndef __ALLOC_H__
+#define __ALLOC_H__
+
+#include <stdio.h>
+
+#if (defined(DEBUG) || defined(ALLOC_TRACK)) && defined(__GLIBC__)
+#  define ALLOC_TRACKING
+#endif
+
+/** Most call sites recorded */
+#define ALLOC_MAX_SITES 256
+
+/** Where allocations are being watched */
+enum enAllocScope {
+    ALLOC_NONE = 0,
+    ALLOC_UPDATE,
+    ALLOC_DRAW,
+    ALLOC_NUM_SCOPES
+};
+typedef enum enAllocScope allocScope;
+
+#if defined(ALLOC_TRACKING)
+
+/**
+ * Start recording every allocation made by the calling thread; Each scope
+ * must only ever be entered by a single thread
+ *
+ * @param  [ in]scope The scope
+ */
+void alloc_enter(allocScope scope);
+
+/** Stop recording the calling thread's allocations and finish its frame */
+void alloc_leave();
+
+/**
+ * Retrieve the scope the calling thread is recording into
+ */
+allocScope alloc_getScope();
+
+/**
+ * Record the calling thread's allocations into another thread's scope (or stop
+ * recording, on ALLOC_NONE), without starting nor finishing any frame; Used
+ * by the job workers
+ *
+ * @param  [ in]scope The scope
+ */
+void alloc_adopt(allocScope scope);
+
+/**
+ * Retrieve how many allocations were made (by every thread) so far
+ */
+int alloc_getTotal();
+
+/**
+ * Print every call site that allocated within a scope and how often frames
+ * allocated anything
+ *
+ * @param  [ in]pFp Where the report is printed
+ */
+void alloc_report(FILE *pFp);
+
+#else
+
+#  define alloc_enter(scope) do {} while (0)
+#  define alloc_leave() do {} while (0)
+#  define alloc_getScope() ALLOC_NONE
+#  define alloc_adopt(scope) do { (void)(scope); } while (0)
+#  define alloc_getTotal() 0
+#  define alloc_report(pFp) do {} while (0)
+
+#endif /* ALLOC_TRACKING */
+
+#endif /* __ALLOC_H__ */
+
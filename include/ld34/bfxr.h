@@ -0,0 +1,86 @@
+/**
+ * Synthesizer for bfxr's sound definitions
+ *
+ * Renders the parameters saved by bfxr (as its comma separated '.bfxrsound'
+ * files) into 16 bits mono PCM. Square, sawtooth, sine, noise and triangle
+ * waves are supported, as are the envelope, frequency slides, vibrato, pitch
+ * jumps, duty sweep, repeat, flanger, filters, bit crush and compression.
+ *
+ * Noise is generated from a fixed seed, so the same definition is always
+ * rendered into the same samples.
+ *
+ * @file include/ld34/bfxr.h
+ */
+#ifndef __BFXR_STRUCT__
+#define __BFXR_STRUCT__
+
+typedef struct stBfxrParams bfxrParams;
+
+#endif /* __BFXR_STRUCT__ */
+
+#ifndef __BFXR_H__
+#define __BFXR_H__
+
+#include <GFraMe/gfmError.h>
+
+/** Sample rate of every rendered sound */
+#define BFXR_SAMPLE_RATE 44100
+/** Longest rendered sound, in samples */
+#define BFXR_MAX_SAMPLES (BFXR_SAMPLE_RATE * 10)
+
+/** Every parameter, in the order they are saved by bfxr */
+struct stBfxrParams {
+    float waveType;
+    float masterVolume;
+    float attackTime;
+    float sustainTime;
+    float sustainPunch;
+    float decayTime;
+    float compressionAmount;
+    float startFrequency;
+    float minFrequency;
+    float slide;
+    float deltaSlide;
+    float vibratoDepth;
+    float vibratoSpeed;
+    float overtones;
+    float overtoneFalloff;
+    float changeRepeat;
+    float changeAmount;
+    float changeSpeed;
+    float changeAmount2;
+    float changeSpeed2;
+    float squareDuty;
+    float dutySweep;
+    float repeatSpeed;
+    float flangerOffset;
+    float flangerSweep;
+    float lpFilterCutoff;
+    float lpFilterCutoffSweep;
+    float lpFilterResonance;
+    float hpFilterCutoff;
+    float hpFilterCutoffSweep;
+    float bitCrush;
+    float bitCrushSweep;
+};
+
+/**
+ * Parse a sound definition; Empty fields are set to bfxr's defaults
+ *
+ * @param  [out]pParams The parameters
+ * @param  [ in]pText   The definition (as saved by bfxr)
+ * @param  [ in]len     Length of the definition
+ */
+gfmRV bfxr_parse(bfxrParams *pParams, char *pText, int len);
+
+/**
+ * Render a sound
+ *
+ * @param  [out]ppSamples   The samples (must be freed by the caller)
+ * @param  [out]pNumSamples Number of samples
+ * @param  [ in]pParams     The parameters
+ */
+gfmRV bfxr_render(short **ppSamples, int *pNumSamples, bfxrParams *pParams);
+
+#endif /* __BFXR_H__ */
+
@@ -0,0 +1,177 @@
+/**
+ * Collision broadphase
+ *
+ * Every object collided on a tick is tested against the ones already added on
+ * that same tick, and then added itself. Overlaps are reported exactly like
+ * GFraMe's quadtree does (and with its return codes), so callers simply loop
+ * on broadphase_getOverlaping/broadphase_continue until GFMRV_QUADTREE_DONE.
+ *
+ * There are three backends: GFraMe's quadtree, a uniform spatial hash and a
+ * sort-and-sweep along the horizontal axis (which suits a wide but short
+ * level, as only objects horizontally close to each other are ever tested).
+ * The hash has a few settings (its cell size). Every setting of the requested
+ * backend (or of the hash and the sweep, if BROADPHASE_AUTO is requested) is
+ * tried for a few ticks, and the one that did the least work (objects tested,
+ * cells visited...) is kept, until the number of objects changes too much.
+ * Since that's deterministic, the same scene always ends up on the same
+ * setting. GFraMe's quadtree doesn't tell how many objects it tested, so it
+ * isn't tuned (nor tried automatically) and keeps the game's old setting.
+ *
+ * Fast objects may be collided over the whole path they moved on the tick, so
+ * they are reported even if they skipped over something thin. The quadtree
+ * can only test objects, so it's given a proxy (of type BROADPHASE_PROXY)
+ * covering that path, which is never reported itself.
+ *
+ * @file include/ld34/broadphase.h
+ */
+#ifndef __BROADPHASE_STRUCT__
+#define __BROADPHASE_STRUCT__
+
+typedef struct stBroadphase broadphase;
+
+#endif /* __BROADPHASE_STRUCT__ */
+
+#ifndef __BROADPHASE_H__
+#define __BROADPHASE_H__
+
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmObject.h>
+#include <GFraMe/gfmSprite.h>
+#include <GFraMe/gfmTypes.h>
+
+/** Ticks each setting is tried for (besides one, ignored, to warm it up) */
+#define BROADPHASE_TRIAL_TICKS 30
+/** Tuning restarts if the number of objects per tick gets this many times
+ * larger (or smaller) than it was */
+#define BROADPHASE_RETUNE_FACTOR 2
+/** Changes on the number of objects below this are ignored */
+#define BROADPHASE_RETUNE_MIN 64
+/** Type of the quadtree's proxies (so the game must not use it) */
+#define BROADPHASE_PROXY gfmType_reserved_14
+
+enum enBroadphaseType {
+    /** Try every backend (but the quadtree) */
+    BROADPHASE_AUTO = 0,
+    BROADPHASE_QUADTREE,
+    BROADPHASE_HASH,
+    BROADPHASE_SWEEP,
+    BROADPHASE_NUM_TYPES
+};
+typedef enum enBroadphaseType broadphaseType;
+
+/**
+ * Alloc the broadphase
+ *
+ * @param  [out]ppCtx The broadphase
+ * @param  [ in]type  Backend used (or BROADPHASE_AUTO)
+ */
+gfmRV broadphase_init(broadphase **ppCtx, broadphaseType type);
+
+/**
+ * Release the broadphase
+ *
+ * @param  [ in]ppCtx The broadphase
+ */
+void broadphase_clean(broadphase **ppCtx);
+
+/**
+ * Retrieve a backend's name
+ *
+ * @param  [ in]type The backend
+ * @return           The name (as accepted on the command line)
+ */
+const char* broadphase_getName(broadphaseType type);
+
+/**
+ * Remove every object and start a new tick; If the broadphase is being tuned,
+ * this is when the setting changes
+ *
+ * @param  [ in]pCtx   The broadphase
+ * @param  [ in]x      World's horizontal position
+ * @param  [ in]y      World's vertical position
+ * @param  [ in]width  World's width
+ * @param  [ in]height World's height
+ */
+gfmRV broadphase_reset(broadphase *pCtx, int x, int y, int width,
+        int height);
+
+/**
+ * Add an object without testing it (e.g., because it's static)
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pObj The object
+ */
+gfmRV broadphase_populateObject(broadphase *pCtx, gfmObject *pObj);
+
+/**
+ * Test an object against every other one and add it
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pObj The object
+ * @return           GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_collideObject(broadphase *pCtx, gfmObject *pObj);
+
+/**
+ * Test a sprite against every other object and add it
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pSpr The sprite
+ * @return           GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_collideSprite(broadphase *pCtx, gfmSprite *pSpr);
+
+/**
+ * Test an object, over the whole path it moved on this tick, against every
+ * other object and add it
+ *
+ * @param  [ in]pCtx  The broadphase
+ * @param  [ in]pObj  The object
+ * @param  [ in]lastX Horizontal position at the start of the tick
+ * @param  [ in]lastY Vertical position at the start of the tick
+ * @return            GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_collideSwept(broadphase *pCtx, gfmObject *pObj, int lastX,
+        int lastY);
+
+/**
+ * Retrieve the current overlap
+ *
+ * @param  [out]ppObj1 The object being collided
+ * @param  [out]ppObj2 The object it overlaps
+ * @param  [ in]pCtx   The broadphase
+ */
+gfmRV broadphase_getOverlaping(gfmObject **ppObj1, gfmObject **ppObj2,
+        broadphase *pCtx);
+
+/**
+ * Move to the next overlap
+ *
+ * @param  [ in]pCtx The broadphase
+ * @return           GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_continue(broadphase *pCtx);
+
+/**
+ * Draw the broadphase's structure (only the quadtree has any)
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pGfm GFraMe's context
+ */
+gfmRV broadphase_drawBounds(broadphase *pCtx, gfmCtx *pGfm);
+
+/**
+ * Retrieve the setting currently in use
+ *
+ * @param  [out]pType     The backend
+ * @param  [out]pParam    The quadtree's maximum depth or the hash's cell size
+ *                        (0, for the sweep)
+ * @param  [out]pIsTuning Whether settings are still being tried
+ * @param  [ in]pCtx      The broadphase
+ */
+void broadphase_getSetting(broadphaseType *pType, int *pParam, int *pIsTuning,
+        broadphase *pCtx);
+
+#endif /* __BROADPHASE_H__ */
+
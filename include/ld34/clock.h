@@ -0,0 +1,22 @@
+/**
+ * High resolution, monotonic clock (GFraMe only reports whole milliseconds)
+ *
+ * @file include/ld34/clock.h
+ */
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+/**
+ * Retrieve the time since an arbitrary point, in milliseconds
+ */
+double clock_getTime();
+
+/**
+ * Suspend the calling thread
+ *
+ * @param  [ in]ms For how long, in milliseconds
+ */
+void clock_sleep(int ms);
+
+#endif /* __CLOCK_H__ */
+
@@ -9,5 +9,31 @@
 /** Continue the currently executing collision */
 gfmRV collide_run();
 
+/**
+ * Store every overlap from the currently executing collision, so they may be
+ * resolved later by collide_resolve
+ */
+gfmRV collide_collect();
+
+/**
+ * Narrow-phase every collected pair (in parallel, if there are enough of
+ * those) and then respond to the overlapping ones on this thread, in the
+ * order they first touched (or in the order they were collected, if at the
+ * same time); Only pairs collected since the last resolve are ordered, so
+ * this ordering doesn't span the whole tick
+ */
+gfmRV collide_resolve();
+
+/**
+ * Retrieve how many pairs were collided since the game started
+ *
+ * @param  [out]pNumPairs    Pairs reported by the broadphase
+ * @param  [out]pNumOverlaps Pairs that actually overlapped
+ */
+void collide_getStats(int *pNumPairs, int *pNumOverlaps);
+
+/** Release the buffers used to store the collected pairs */
+void collide_clean();
+
 #endif /* __COLLIDE_H__ */
 
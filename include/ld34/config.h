@@ -0,0 +1,63 @@
+/**
+ * Game's configuration, loaded from a file and overridable from the command
+ * line
+ *
+ * The file is a list of 'key = value' lines ('#' starts a comment), with the
+ * same keys as the command line options (e.g., 'ups = 120')
+ *
+ * @file include/ld34/config.h
+ */
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include <GFraMe/gfmError.h>
+
+#include <ld34/game.h>
+
+/**
+ * Set every option to its default value
+ *
+ * @param  [ in]pConfig The configuration
+ */
+void config_setDefault(configCtx *pConfig);
+
+/**
+ * Load options from a file; Options missing from the file are left untouched
+ *
+ * @param  [ in]pConfig   The configuration
+ * @param  [ in]pFilename The file
+ * @return                GFMRV_OK, GFMRV_FALSE (the file doesn't exist),
+ *                        GFMRV_ARGUMENTS_BAD
+ */
+gfmRV config_loadFile(configCtx *pConfig, char *pFilename);
+
+/**
+ * Search the command line for an alternative configuration file
+ *
+ * @param  [ in]argc Number of arguments
+ * @param  [ in]argv List of arguments
+ * @return           The file passed through '--config', or CONFIG_FILE
+ */
+char* config_getFilename(int argc, char *argv[]);
+
+/**
+ * Override options from the command line
+ *
+ * @param  [ in]pConfig The configuration
+ * @param  [ in]argc    Number of arguments
+ * @param  [ in]argv    List of arguments
+ * @return              GFMRV_OK, GFMRV_FALSE (help was requested),
+ *                      GFMRV_ARGUMENTS_BAD
+ */
+gfmRV config_parseArgs(configCtx *pConfig, int argc, char *argv[]);
+
+/**
+ * Check that the options are sane, adjusting those that depend on others
+ * (e.g., the timer frequency is raised to fit the update and draw rates)
+ *
+ * @param  [ in]pConfig The configuration
+ */
+gfmRV config_validate(configCtx *pConfig);
+
+#endif /* __CONFIG_H__ */
+
@@ -13,7 +13,6 @@ typedef struct stEnemy enemy;
 
 #include <GFraMe/gfmError.h>
 #include <GFraMe/gfmObject.h>
-#include <GFraMe/gfmParser.h>
 
 /**
  * Alloc a new enemy
@@ -30,13 +29,45 @@ gfmRV enemy_getNew(enemy **ppEnemy);
 void enemy_clean(enemy **ppEnemy);
 
 /**
- * Initialize an enemy from the parser
+ * Initialize an enemy from its spawn position; Inactive enemies may be
+ * re-initialized
  *
- * @param  [ in]pEnemy  The enemy
- * @param  [ in]pParser The parser
- * @param  [ in]type    The enemie's type
+ * @param  [ in]pEnemy The enemy
+ * @param  [ in]type   The enemie's type
+ * @param  [ in]x      Spawn's horizontal position (as on the map)
+ * @param  [ in]y      Spawn's vertical position (as on the map, i.e., its
+ *                     bottom)
+ * @param  [ in]w      Spawn's width
+ * @param  [ in]h      Spawn's height
+ * @param  [ in]sector Sector that spawned the enemy (-1, if always loaded)
+ * @param  [ in]index  Index of the enemy within its sector (-1, if always
+ *                     loaded)
  */
-gfmRV enemy_init(enemy *pEnemy, gfmParser *pParser, int type);
+gfmRV enemy_init(enemy *pEnemy, int type, int x, int y, int w, int h,
+        int sector, int index);
+
+/**
+ * Check whether the enemy is still active (i.e., wasn't killed nor despawned)
+ *
+ * @param  [ in]pEnemy The enemy
+ * @return             GFMRV_TRUE, GFMRV_FALSE
+ */
+gfmRV enemy_isActive(enemy *pEnemy);
+
+/**
+ * Retrieve the sector that spawned the enemy
+ *
+ * @param  [ in]pEnemy The enemy
+ * @return             The sector (-1, if it's always loaded)
+ */
+int enemy_getSector(enemy *pEnemy);
+
+/**
+ * Deactivate the enemy (without killing it), so it may be reused
+ *
+ * @param  [ in]pEnemy The enemy
+ */
+void enemy_despawn(enemy *pEnemy);
 
 /**
  * Update the enemy
@@ -45,6 +76,15 @@ gfmRV enemy_init(enemy *pEnemy, gfmParser *pParser, int type);
  */
 gfmRV enemy_preUpdate(enemy *pEnemy);
 
+/**
+ * Spawn every shot queued (by every enemy) on this tick, with a single batch
+ * per pool
+ */
+gfmRV enemy_spawnShots();
+
+/** Release the shots' queues */
+void enemy_cleanShots();
+
 /**
  * Change state after all collisions
  *
@@ -53,7 +93,7 @@ gfmRV enemy_preUpdate(enemy *pEnemy);
 gfmRV enemy_postUpdate(enemy *pEnemy);
 
 /**
- * Render the enemy
+ * Push the enemy into the snapshot being recorded
  *
  * @param  [ in]pEnemy  The enemy
  */
@@ -7,14 +7,26 @@
 #define __GAME_H__
 
 #include <GFraMe/gframe.h>
-#include <GFraMe/gfmGroup.h>
 #include <GFraMe/gfmInput.h>
-#include <GFraMe/gfmQuadtree.h>
 #include <GFraMe/gfmSpriteset.h>
 #include <GFraMe/gfmTypes.h>
 
+#include <ld34/broadphase.h>
+#include <ld34/input.h>
+#include <ld34/jobs.h>
+#include <ld34/latency.h>
+#include <ld34/level.h>
+#include <ld34/mixer.h>
+#include <ld34/music.h>
+#include <ld34/particles.h>
+#include <ld34/sfx.h>
+#include <ld34/snapshot.h>
+#include <ld34/spritePool.h>
 #include <ld34/textManager.h>
 
+/** Longest accepted path to the assets directory */
+#define ASSETS_PATH_LEN 1024
+
 enum enState {
     state_none = 0,
     state_intro,
@@ -34,14 +46,36 @@ enum enParticles {
 struct stGameCtx {
     /** The game context */
     gfmCtx *pCtx;
+    /** Worker threads used to update independent systems in parallel */
+    jobs *pJobs;
     /** Particles used only for basic eye-candy */
-    gfmGroup *pParticles;
-    /** Particles used only for ~*awesome*~ eye-candy */
-    gfmGroup *pBullets;
-    /** Particles used only for ~*awesome*~ eye-candy */
-    gfmGroup *pProps;
-    /** The quadtree for collision */
-    gfmQuadtreeRoot *pQt;
+    particles *pParticles;
+    /** Enemies' bullets */
+    spritePool *pBullets;
+    /** Pellets and other props that may collide */
+    spritePool *pProps;
+    /** State handed from the update thread to the render thread */
+    snapshot *pSnapshot;
+    /** Latency instrumentation (NULL, if disabled) */
+    latency *pLatency;
+    /** Input events, sampled by the render thread */
+    input *pInput;
+    /** The streamed level; Opened while loading */
+    level *pLevel;
+    /** Every sound effect; Rendered (or read from the cache) while loading */
+    sfx *pSfx;
+    /** Plays the sound effects; Opened while loading */
+    mixer *pMixer;
+    /** The song, pre-rendered and mixed in; Started while loading */
+    music *pMusic;
+    /** Path to the assets directory (with a trailing '/'); Used by files
+     * that aren't read through GFraMe (e.g., streamed from another thread) */
+    char pAssetsPath[ASSETS_PATH_LEN];
+    /** Directory of the played level, relative to the assets directory (with
+     * a trailing '/') */
+    char *pLevelDir;
+    /** Broadphase for collision */
+    broadphase *pBroadphase;
     /** Current state */
     state curState;
     /**
@@ -53,6 +87,15 @@ struct stGameCtx {
 
     textManager *pTextManager;
 
+    /** Fixed time, in milliseconds, simulated by the current tick */
+    int elapsed;
+    /** Real time (from clock_getTime) of the end of the current tick */
+    double tickTime;
+    /** Time that couldn't be simulated because too many ticks were late */
+    double droppedTime;
+    /** Number of frames that had to drop time */
+    int numDroppedFrames;
+
     /** Whether in fullscreen or windowed mode */
     int isFullscreen;
     int width;
@@ -78,10 +121,7 @@ struct stGameAssets {
     /** 32x16 spriteset */
     gfmSpriteset *pSset32x16;
 
-    int audBass1;
-    int audBass2;
-    int audMelody;
-
+    /** Sound effects' ids, as passed to sfx_init */
     int sfxLeftStep;
     int sfxRightStep;
     int sfxEnemyCrushed;
@@ -96,10 +136,12 @@ typedef struct stGameAssets gameAssets;
 struct stButton {
     /** Internal button handle */
     int handle;
-    /** Number of times it was consecutively pressed */
-    int num;
     /** Current button state */
     gfmInputState state;
+    /** When it was last pressed (from clock_getTime) */
+    double pressTime;
+    /** When it was last released (from clock_getTime) */
+    double releaseTime;
 };
 typedef struct stButton button;
 
@@ -120,12 +162,32 @@ struct stGameButtons {
     button pause;
 };
 typedef struct stGameButtons gameButtons;
+/** Every button, as gameButtons is also accessed as an array of buttons */
+#define NUM_BUTTONS (int)(sizeof(gameButtons) / sizeof(button))
 
 struct stConfigCtx {
+    /** Draws per second */
     int dps;
+    /** Frequency of GFraMe's timer (must be at least as high as ups and dps) */
     int fps;
+    /** Whether vsync is enabled */
     int vsync;
+    /** Updates per second; Also defines the length of each fixed tick */
     int ups;
+    /** Maximum number of ticks run to catch up after a slow frame */
+    int maxSteps;
+    /** Window's dimensions */
+    int width;
+    /** Window's dimensions */
+    int height;
+    /** Initial number of particles/sprites on each pool */
+    int initParticles;
+    /** Maximum number of particles/sprites on each pool */
+    int maxParticles;
+    /** Whether latency should be measured (and logged on exit) */
+    int latency;
+    /** Collision broadphase (a broadphaseType) */
+    int broadphase;
 };
 typedef struct stConfigCtx configCtx;
 
@@ -148,11 +210,18 @@ extern void *pState;
 #define BGCOLOR 0x332825
 #define TEXATLAS "atlas.bmp"
 #define COLORKEY 0xff00ff
+/** The level, split by 'make level' */
+#define LEVEL_DIR "level/"
+/** Every track of the song */
+#define SONG "song.mml"
 
 #define SAVE_FILE "game.sav"
+#define CONFIG_FILE "ld34.cfg"
+#define LATENCY_FILE "latency.log"
 
 #define GRAV 100
 #define PARTICLE_TTL 10000
+#define INIT_PARTICLES 64
 #define NUM_PARTICLES 2048
 #define TEXT_DELAY 60
 
@@ -187,6 +256,9 @@ extern void *pState;
 #define TURRET       gfmType_reserved_11
 #define CHECKPOINT   gfmType_reserved_12
 #define EXIT         gfmType_reserved_13
+/* gfmType_reserved_14 is BROADPHASE_PROXY */
+/** Bounds of all the player's limbs, collided in their place */
+#define PL_BODY      gfmType_reserved_15
 
 #endif /* __GAME_H__ */
 
@@ -18,7 +18,16 @@ gfmRV gamestate_init();
 /** Update the current state as a gamestate */
 gfmRV gamestate_update();
 
-/** Render the current state as a gamestate */
+/**
+ * Record the visible tiles, every entity and the HUD of the current state
+ * into a new snapshot and publish it; Must be called from the update thread
+ */
+gfmRV gamestate_snapshot();
+
+/**
+ * Render the current state as a gamestate; Runs on the render thread (with the
+ * world locked) and only draws the latest snapshot
+ */
 gfmRV gamestate_draw();
 
 /**
@@ -0,0 +1,93 @@
+/**
+ * Event-driven input
+ *
+ * After events are handled (on the render thread), the press and release
+ * edges GFraMe reported for every bound button are queued as events, stamped
+ * with when the events were pumped. Edges are read separately (rather than
+ * diffing the held state), so a button pressed and released before the same
+ * pump still queues both.
+ * Once per tick, the update thread drains the queue into a packed bitset, from
+ * which edges are derived with bitwise operations. A press and a release that
+ * happen between two ticks are reported on consecutive ticks.
+ *
+ * @file include/ld34/input.h
+ */
+#ifndef __INPUT_STRUCT__
+#define __INPUT_STRUCT__
+
+typedef struct stInput input;
+
+#endif /* __INPUT_STRUCT__ */
+
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmError.h>
+
+/** Maximum number of buttons (i.e., bits on the bitset) */
+#define INPUT_MAX_BUTTONS 32
+
+/**
+ * Alloc the input
+ *
+ * @param  [out]ppCtx      The input
+ * @param  [ in]pHandles   GFraMe's virtual key of every button; The n-th
+ *                         button is reported on the n-th bit
+ * @param  [ in]numButtons Number of buttons
+ */
+gfmRV input_init(input **ppCtx, int *pHandles, int numButtons);
+
+/**
+ * Release the input
+ *
+ * @param  [ in]ppCtx The input
+ */
+void input_clean(input **ppCtx);
+
+/**
+ * Queue every press and release reported by the events that were just
+ * handled (on the render thread)
+ *
+ * @param  [ in]pCtx     The input
+ * @param  [ in]pGfm     GFraMe's context
+ * @param  [ in]pumpTime When the events were pumped (from clock_getTime)
+ */
+gfmRV input_poll(input *pCtx, gfmCtx *pGfm, double pumpTime);
+
+/**
+ * Drain every queued event into the current tick's state (on the update
+ * thread)
+ *
+ * @param  [ in]pCtx The input
+ */
+void input_update(input *pCtx);
+
+/**
+ * Retrieve the current tick's state, as bitsets (one bit per button)
+ *
+ * @param  [out]pPressed      Buttons currently held
+ * @param  [out]pJustPressed  Buttons pressed since the last tick
+ * @param  [out]pJustReleased Buttons released since the last tick
+ * @param  [ in]pCtx          The input
+ */
+void input_getState(unsigned int *pPressed, unsigned int *pJustPressed,
+        unsigned int *pJustReleased, input *pCtx);
+
+/**
+ * Retrieve when a button last changed; Times come from clock_getTime
+ *
+ * If a button was pressed and released between two ticks, its release time
+ * is already reported on the tick it's pressed (so the release time may be
+ * later than the press time, even though the button is still held)
+ *
+ * @param  [out]pPressTime   When it was last pressed (0, if never)
+ * @param  [out]pReleaseTime When it was last released (0, if never)
+ * @param  [ in]pCtx         The input
+ * @param  [ in]index        The button
+ */
+void input_getTimes(double *pPressTime, double *pReleaseTime, input *pCtx,
+        int index);
+
+#endif /* __INPUT_H__ */
+
@@ -0,0 +1,49 @@
+/**
+ * Loading screen, shown while the assets are loaded
+ *
+ * The texture must be uploaded by the render thread (which owns the window),
+ * so it's loaded by main right after the first frame is presented. Meanwhile,
+ * a worker decodes every sound effect and the song and opens the level; It
+ * never touches SDL nor GFraMe, so the audio device is also opened by the
+ * render thread, once the sounds are decoded. Once everything is loaded, the
+ * game state is started.
+ *
+ * @file include/ld34/introstate.h
+ */
+#ifndef __INTROSTATE_H__
+#define __INTROSTATE_H__
+
+#include <GFraMe/gfmError.h>
+
+/**
+ * Initialize the intro state and start loading the assets
+ *
+ * NOTE: pState will be overwritten!
+ */
+gfmRV introstate_init();
+
+/** Update the current state as an intro state; Starts the game once loaded */
+gfmRV introstate_update();
+
+/**
+ * Open the audio device, once the worker decoded the sound effects and the
+ * song; Must be called from the render thread (which owns SDL), with the
+ * world locked
+ */
+gfmRV introstate_openAudio();
+
+/**
+ * Render the loading progress; Runs on the render thread (with the world
+ * locked) and only draws anything after the texture was loaded
+ */
+gfmRV introstate_draw();
+
+/**
+ * Free all intro state related resources
+ *
+ * NOTE: pState will be overwritten!
+ */
+void introstate_clean();
+
+#endif /* __INTROSTATE_H__ */
+
@@ -0,0 +1,82 @@
+/**
+ * Small job system, used to spread independent work (e.g., integrating
+ * particles) across every core
+ *
+ * A fixed number of workers is spawned on init; Each one (and the thread that
+ * pushes the jobs) owns a queue and, once it's empty, steals jobs from the
+ * others. jobs_wait works as a barrier: it only returns after every job pushed
+ * so far finished running
+ *
+ * @file include/ld34/jobs.h
+ */
+#ifndef __JOBS_STRUCT__
+#define __JOBS_STRUCT__
+
+typedef struct stJobs jobs;
+
+#endif /* __JOBS_STRUCT__ */
+
+#ifndef __JOBS_H__
+#define __JOBS_H__
+
+#include <GFraMe/gfmError.h>
+
+/** Let jobs_init choose the number of workers (one less than the cores) */
+#define JOBS_AUTO -1
+
+/**
+ * Function run by a job; It must only access the range it was given (and never
+ * the shared gfmCtx, as GFraMe isn't reentrant)
+ *
+ * @param  [ in]pArg  Argument passed to jobs_push
+ * @param  [ in]first First element on the range
+ * @param  [ in]last  One past the last element on the range
+ */
+typedef gfmRV (*jobFunc)(void *pArg, int first, int last);
+
+/**
+ * Alloc the job system and spawn its workers
+ *
+ * @param  [out]ppCtx      The job system
+ * @param  [ in]numWorkers Number of worker threads (0 runs every job on the
+ *                         thread that calls jobs_wait), or JOBS_AUTO
+ */
+gfmRV jobs_init(jobs **ppCtx, int numWorkers);
+
+/**
+ * Stop every worker and release the job system
+ *
+ * @param  [ in]ppCtx The job system
+ */
+void jobs_clean(jobs **ppCtx);
+
+/**
+ * Split [0, num) into ranges of (at most) grain elements and queue one job
+ * for each of those
+ *
+ * @param  [ in]pCtx  The job system
+ * @param  [ in]func  Function run by every job
+ * @param  [ in]pArg  Argument passed to every job
+ * @param  [ in]num   Number of elements
+ * @param  [ in]grain Maximum number of elements per job
+ */
+gfmRV jobs_push(jobs *pCtx, jobFunc func, void *pArg, int num, int grain);
+
+/**
+ * Help running the queued jobs and wait until every one has finished
+ *
+ * @param  [ in]pCtx The job system
+ * @return           GFMRV_OK or the error returned by the first job that
+ *                   failed
+ */
+gfmRV jobs_wait(jobs *pCtx);
+
+/**
+ * Retrieve the number of threads that run jobs (i.e., workers + the caller)
+ *
+ * @param  [ in]pCtx The job system
+ */
+int jobs_getNumThreads(jobs *pCtx);
+
+#endif /* __JOBS_H__ */
+
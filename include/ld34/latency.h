@@ -0,0 +1,81 @@
+/**
+ * Frame pacing and input-to-present latency instrumentation
+ *
+ * Each stage of the path taken by an input is timestamped: when the render
+ * thread handles the events, when the update thread samples a changed button,
+ * when the tick that consumed it publishes its snapshot and when the frame
+ * showing that snapshot is presented. Percentiles of each leg (and of the
+ * frame time) are written on a log when the game exits
+ *
+ * Every function may be called with a NULL context, in which case it does
+ * nothing (i.e., instrumentation is disabled)
+ *
+ * @file include/ld34/latency.h
+ */
+#ifndef __LATENCY_STRUCT__
+#define __LATENCY_STRUCT__
+
+typedef struct stLatency latency;
+
+#endif /* __LATENCY_STRUCT__ */
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <GFraMe/gfmError.h>
+
+/**
+ * Alloc the instrumentation
+ *
+ * @param  [out]ppCtx The instrumentation
+ */
+gfmRV latency_init(latency **ppCtx);
+
+/**
+ * Release the instrumentation
+ *
+ * @param  [ in]ppCtx The instrumentation
+ */
+void latency_clean(latency **ppCtx);
+
+/**
+ * Mark that events were just handled (on the render thread)
+ *
+ * @param  [ in]pCtx The instrumentation
+ */
+void latency_markEvents(latency *pCtx);
+
+/**
+ * Mark that a changed input was just sampled (on the update thread); Only the
+ * first input is tracked until it's presented
+ *
+ * @param  [ in]pCtx The instrumentation
+ */
+void latency_markInput(latency *pCtx);
+
+/**
+ * Mark that the tick that consumed the tracked input published its snapshot
+ *
+ * @param  [ in]pCtx The instrumentation
+ * @param  [ in]seq  Sequence number of the published snapshot
+ */
+void latency_markUpdate(latency *pCtx, int seq);
+
+/**
+ * Mark that a frame was just presented (on the render thread)
+ *
+ * @param  [ in]pCtx The instrumentation
+ * @param  [ in]seq  Sequence number of the snapshot on the frame
+ */
+void latency_markPresent(latency *pCtx, int seq);
+
+/**
+ * Write the percentiles of every measured leg, and the frame time jitter
+ *
+ * @param  [ in]pCtx      The instrumentation
+ * @param  [ in]pFilename The log file
+ */
+gfmRV latency_report(latency *pCtx, char *pFilename);
+
+#endif /* __LATENCY_H__ */
+
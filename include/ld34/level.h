@@ -0,0 +1,167 @@
+/**
+ * Streamed level
+ *
+ * The map is split (by tools/splitlevel) into column sectors, each on its own
+ * file. A loader thread reads and parses the sectors (tiles and objects) close
+ * to the camera (and merges their typed tiles into collision areas), while the
+ * update thread only installs already parsed sectors (and spawns their
+ * objects), so it never blocks on the disk. Sectors that get too far from the
+ * camera are released, so only a few sectors are ever in memory.
+ *
+ * Sectors are kept on 'level/sector_NNN_tile.gfm' (and their objects, on
+ * 'level/sector_NNN_obj.gfm'), described by 'level/level.txt'. Other levels
+ * (e.g., the benchmark's scenes) use the same layout on their own directory.
+ *
+ * @file include/ld34/level.h
+ */
+#ifndef __LEVEL_STRUCT__
+#define __LEVEL_STRUCT__
+
+typedef struct stLevel level;
+
+#endif /* __LEVEL_STRUCT__ */
+
+#ifndef __LEVEL_H__
+#define __LEVEL_H__
+
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmSpriteset.h>
+
+#include <ld34/broadphase.h>
+#include <ld34/snapshot.h>
+
+/** Number of sectors loaded (ahead and behind) besides the visible ones */
+#define LEVEL_LOAD_MARGIN 1
+/** Number of sectors kept (ahead and behind) besides the visible ones */
+#define LEVEL_KEEP_MARGIN 2
+
+/** Longest name of an object spawned by a sector (with the '\0') */
+#define LEVEL_SPAWN_NAME_LEN 16
+
+/** An object that starts within a sector; Parsed by the loader thread */
+struct stLevelSpawn {
+    /** The object's type, as on the map (e.g., "turret") */
+    char pName[LEVEL_SPAWN_NAME_LEN];
+    /** Position and dimensions, as on the map */
+    int x;
+    int y;
+    int width;
+    int height;
+    /** Index of the object within its sector (see level_killSpawn) */
+    int index;
+};
+typedef struct stLevelSpawn levelSpawn;
+
+/**
+ * Called whenever a sector is installed or released (on the update thread),
+ * so its objects may be spawned/despawned
+ *
+ * @param  [ in]pArg      Argument passed to level_init
+ * @param  [ in]sector    The sector
+ * @param  [ in]pSpawns   Objects on the sector's file that weren't killed
+ *                        (NULL, if released)
+ * @param  [ in]numSpawns Number of objects on pSpawns
+ * @param  [ in]isLoaded  Whether the sector was installed (or released)
+ */
+typedef gfmRV (*levelCallback)(void *pArg, int sector, levelSpawn *pSpawns,
+        int numSpawns, int isLoaded);
+
+/**
+ * Read the level's index and start the loader thread
+ *
+ * @param  [out]ppCtx       The level
+ * @param  [ in]pAssetsPath Path to the assets directory (with a trailing '/')
+ * @param  [ in]pLevelDir   The level's directory, relative to the assets (with
+ *                          a trailing '/')
+ * @param  [ in]ppDictNames Name of every tile type
+ * @param  [ in]pDictTypes  Type of every tile type
+ * @param  [ in]dictLen     Number of tile types
+ */
+gfmRV level_init(level **ppCtx, char *pAssetsPath, char *pLevelDir,
+        char **ppDictNames, int *pDictTypes, int dictLen);
+
+/**
+ * Stop the loader thread and release every sector; Objects aren't despawned
+ *
+ * @param  [ in]ppCtx The level
+ */
+void level_clean(level **ppCtx);
+
+/**
+ * Set how sectors are installed; Until a spriteset is set, sectors are only
+ * read (but not installed)
+ *
+ * @param  [ in]pCtx     The level
+ * @param  [ in]pSset    Spriteset used by the tiles
+ * @param  [ in]callback Called when a sector is installed/released (may be
+ *                       NULL)
+ * @param  [ in]pArg     Passed to the callback
+ */
+void level_setCallback(level *pCtx, gfmSpriteset *pSset,
+        levelCallback callback, void *pArg);
+
+/**
+ * Mark an object spawned by a sector as killed, so it isn't spawned again
+ * whenever its sector gets reinstalled (until the level is reset)
+ *
+ * @param  [ in]pCtx   The level
+ * @param  [ in]sector The sector that spawned the object
+ * @param  [ in]index  The object's index (from its levelSpawn)
+ */
+void level_killSpawn(level *pCtx, int sector, int index);
+
+/**
+ * Release every installed sector, without calling the callback (e.g., because
+ * every object is being released as well), and forget which objects were
+ * killed; Sectors already read are kept
+ *
+ * @param  [ in]pCtx The level
+ */
+void level_reset(level *pCtx);
+
+/**
+ * Retrieve the level's dimensions
+ *
+ * @param  [out]pWidth  The width, in pixels
+ * @param  [out]pHeight The height, in pixels
+ * @param  [ in]pCtx    The level
+ */
+void level_getDimensions(int *pWidth, int *pHeight, level *pCtx);
+
+/**
+ * Request the sectors around the view, install the ones that were loaded and
+ * release the ones far from it; The world must be locked by the caller
+ *
+ * @param  [ in]pCtx   The level
+ * @param  [ in]x      View's horizontal position
+ * @param  [ in]width  View's width
+ * @param  [ in]doWait Whether to wait until the visible sectors are loaded
+ */
+gfmRV level_update(level *pCtx, int x, int width, int doWait);
+
+/**
+ * Add every installed sector's collision areas to the broadphase
+ *
+ * @param  [ in]pCtx The level
+ * @param  [ in]pBp  The broadphase
+ * @param  [ in]pGfm GFraMe's context
+ */
+gfmRV level_populateBroadphase(level *pCtx, broadphase *pBp, gfmCtx *pGfm);
+
+/**
+ * Push every installed tile inside the view into the snapshot being recorded
+ * (on the update thread)
+ *
+ * @param  [ in]pCtx      The level
+ * @param  [ in]pSnapshot The snapshots
+ * @param  [ in]x         View's horizontal position
+ * @param  [ in]y         View's vertical position
+ * @param  [ in]width     View's width
+ * @param  [ in]height    View's height
+ */
+gfmRV level_snapshot(level *pCtx, snapshot *pSnapshot, int x, int y,
+        int width, int height);
+
+#endif /* __LEVEL_H__ */
+
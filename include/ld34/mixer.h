@@ -0,0 +1,125 @@
+/**
+ * Plays the pre-rendered sound effects
+ *
+ * Sounds are mixed (on SDL's audio thread) directly from the sound effects'
+ * cache, into a device opened for the cache's format.
+ *
+ * Sounds requested during a tick are only started at its end, all at once, and
+ * a sound requested more than once on the same tick is played only once. The
+ * voices are a fixed pool: each sound may only use a few of those (stealing
+ * its own oldest voice past that) and, once every voice is busy, the one
+ * closest to finishing is stolen. Voices are mixed in fixed-size blocks and a
+ * limiter lowers the gain (instead of clipping) when many overlap.
+ *
+ * The music, if any, is mixed (already rendered) into every block.
+ *
+ * Sounds played from the world are attenuated by their distance to the
+ * listener (i.e., the camera's center) and sounds too far to be heard are
+ * discarded before taking any voice.
+ *
+ * @file include/ld34/mixer.h
+ */
+#ifndef __MIXER_STRUCT__
+#define __MIXER_STRUCT__
+
+typedef struct stMixer mixer;
+
+#endif /* __MIXER_STRUCT__ */
+
+#ifndef __MIXER_H__
+#define __MIXER_H__
+
+#include <GFraMe/gfmError.h>
+
+#include <ld34/music.h>
+#include <ld34/sfx.h>
+
+/** How many sounds may play at once */
+#define MIXER_MAX_VOICES 32
+/** How many times a single sound may play at once */
+#define MIXER_MAX_PER_SOUND 3
+/** Number of samples mixed at a time */
+#define MIXER_BLOCK_LEN 256
+/** Length of the device's buffer, in samples (~12ms) */
+#define MIXER_BUFFER_LEN 512
+/** Distance (from the listener) up to which sounds play at full volume */
+#define MIXER_NEAR_DIST 160
+/** Distance (from the listener) from which sounds can't be heard */
+#define MIXER_FAR_DIST 400
+
+/**
+ * Open the audio device and start mixing
+ *
+ * @param  [out]ppCtx The mixer
+ * @param  [ in]pSfx  The sound effects (must outlive the mixer)
+ */
+gfmRV mixer_init(mixer **ppCtx, sfx *pSfx);
+
+/**
+ * Close the audio device
+ *
+ * @param  [ in]ppCtx The mixer
+ */
+void mixer_clean(mixer **ppCtx);
+
+/**
+ * Set the music mixed with the sounds
+ *
+ * @param  [ in]pCtx   The mixer
+ * @param  [ in]pMusic The music (or NULL, to stop it)
+ */
+gfmRV mixer_setMusic(mixer *pCtx, music *pMusic);
+
+/**
+ * Request a sound to be played; Requests are only started by mixer_flush, and
+ * requesting a sound more than once on a tick plays it only once (as loud as
+ * the loudest request)
+ *
+ * @param  [ in]pCtx   The mixer
+ * @param  [ in]id     The sound (as passed to sfx_init)
+ * @param  [ in]volume The sound's volume, in the range [0.0, 1.0]
+ */
+gfmRV mixer_play(mixer *pCtx, int id, double volume);
+
+/**
+ * Request a sound, emitted from a position in the world, to be played; It's
+ * attenuated by its distance to the listener and ignored if inaudible
+ *
+ * @param  [ in]pCtx   The mixer
+ * @param  [ in]id     The sound (as passed to sfx_init)
+ * @param  [ in]volume The sound's volume, in the range [0.0, 1.0]
+ * @param  [ in]x      Horizontal position of the sound
+ * @param  [ in]y      Vertical position of the sound
+ */
+gfmRV mixer_playAt(mixer *pCtx, int id, double volume, int x, int y);
+
+/**
+ * Set the listener's position (i.e., the camera's center)
+ *
+ * @param  [ in]pCtx The mixer
+ * @param  [ in]x    Horizontal position of the listener
+ * @param  [ in]y    Vertical position of the listener
+ */
+gfmRV mixer_setListener(mixer *pCtx, int x, int y);
+
+/**
+ * Start every sound requested during the tick; Should be called once at the
+ * end of every tick
+ *
+ * @param  [ in]pCtx The mixer
+ */
+gfmRV mixer_flush(mixer *pCtx);
+
+/**
+ * Retrieve how many sounds were limited
+ *
+ * @param  [out]pNumStolen    Number of voices stolen
+ * @param  [out]pNumCoalesced Number of requests merged into another
+ * @param  [out]pNumCulled    Number of requests too far to be heard
+ * @param  [ in]pCtx          The mixer
+ */
+void mixer_getStats(int *pNumStolen, int *pNumCoalesced, int *pNumCulled,
+        mixer *pCtx);
+
+#endif /* __MIXER_H__ */
+
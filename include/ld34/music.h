@@ -0,0 +1,75 @@
+/**
+ * Pre-rendered music
+ *
+ * The song is compiled (from its MML) by c_synth when loaded, and a
+ * background thread renders every one of its tracks whole (c_synth can only
+ * render a track at once). Those are kept in memory for as long as the song
+ * plays, costing 2 bytes per sample per track (i.e., ~86KB for each second of
+ * each track, at 44100Hz). The thread then mixes the rendered tracks into a
+ * ring buffer a few hundred milliseconds ahead of playback, and the mixer only
+ * copies samples out of the ring, so the music costs nothing to the game's
+ * threads and doesn't depend on how long any tick takes.
+ *
+ * @file include/ld34/music.h
+ */
+#ifndef __MUSIC_STRUCT__
+#define __MUSIC_STRUCT__
+
+typedef struct stMusic music;
+
+#endif /* __MUSIC_STRUCT__ */
+
+#ifndef __MUSIC_H__
+#define __MUSIC_H__
+
+#include <GFraMe/gfmError.h>
+
+/** Length of the ring buffer, in samples (~370ms); Must be a power of 2 */
+#define MUSIC_RING_LEN 16384
+/** Number of samples synthesized at a time */
+#define MUSIC_CHUNK_LEN 1024
+/** How long the synthesizer waits, once the ring is full */
+#define MUSIC_SLEEP_MS 5
+/** Gain of each track, out of 128 */
+#define MUSIC_GAIN 64
+/** Most tracks on the song */
+#define MUSIC_MAX_TRACKS 8
+
+/**
+ * Compile a song and start synthesizing it
+ *
+ * @param  [out]ppCtx       The music
+ * @param  [ in]pAssetsPath Path to the assets directory (with a trailing '/')
+ * @param  [ in]pFilename   The song's MML, relative to the assets directory
+ * @param  [ in]sampleRate  Rate at which the song will be played
+ */
+gfmRV music_init(music **ppCtx, char *pAssetsPath, char *pFilename,
+        int sampleRate);
+
+/**
+ * Stop the synthesizer and release the song; The mixer must already be
+ * closed
+ *
+ * @param  [ in]ppCtx The music
+ */
+void music_clean(music **ppCtx);
+
+/**
+ * Add the next synthesized samples to a buffer; Called from the audio thread
+ *
+ * @param  [ in]pCtx The music
+ * @param  [ in]pAcc The buffer
+ * @param  [ in]num  Number of samples requested
+ */
+void music_mix(music *pCtx, int *pAcc, int num);
+
+/**
+ * Retrieve how many times the ring ran out of samples
+ *
+ * @param  [out]pNumUnderruns Number of underruns
+ * @param  [ in]pCtx          The music
+ */
+void music_getStats(int *pNumUnderruns, music *pCtx);
+
+#endif /* __MUSIC_H__ */
+
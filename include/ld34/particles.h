@@ -0,0 +1,147 @@
+/**
+ * Pool of purely decorative particles (e.g., explosions)
+ *
+ * Differently from a gfmGroup, every particle is stored as a set of parallel
+ * float arrays (one per attribute), so the whole pool may be integrated by a
+ * SIMD kernel
+ *
+ * @file include/ld34/particles.h
+ */
+#ifndef __PARTICLES_STRUCT__
+#define __PARTICLES_STRUCT__
+
+typedef struct stParticles particles;
+typedef struct stParticleDesc particleDesc;
+
+#endif /* __PARTICLES_STRUCT__ */
+
+#ifndef __PARTICLES_H__
+#define __PARTICLES_H__
+
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmSpriteset.h>
+
+/** Everything needed to spawn a single particle */
+struct stParticleDesc {
+    /** Initial position */
+    int x;
+    /** Initial position */
+    int y;
+    /** Initial velocity */
+    float vx;
+    /** Initial velocity */
+    float vy;
+    /** Acceleration */
+    float ax;
+    /** Acceleration */
+    float ay;
+    /** Animation played by the particle */
+    int anim;
+};
+
+/**
+ * Alloc and initialize a particle pool
+ *
+ * @param  [out]ppCtx        The particle pool
+ * @param  [ in]pSset        Spriteset used to render the particles
+ * @param  [ in]pAnimData    Animations, in the same format as a gfmGroup's
+ * @param  [ in]animDataLen  Number of elements in pAnimData
+ * @param  [ in]w            Particles' width (used only for culling)
+ * @param  [ in]h            Particles' height (used only for culling)
+ * @param  [ in]ox           Rendering offset
+ * @param  [ in]oy           Rendering offset
+ * @param  [ in]ttl          For how long, in milliseconds, particles live
+ * @param  [ in]deathOnLeave Whether particles die when leaving the camera
+ * @param  [ in]initLen      Number of particles alloc'ed at first
+ * @param  [ in]maxLen       Maximum number of particles
+ */
+gfmRV particles_init(particles **ppCtx, gfmSpriteset *pSset, int *pAnimData,
+        int animDataLen, int w, int h, int ox, int oy, int ttl,
+        int deathOnLeave, int initLen, int maxLen);
+
+/**
+ * Release the particle pool
+ *
+ * @param  [ in]ppCtx The particle pool
+ */
+void particles_clean(particles **ppCtx);
+
+/**
+ * Spawn a new particle, doubling the pool if it's full; If the pool already
+ * reached its maximum size, the particle is dropped
+ *
+ * @param  [ in]pCtx The particle pool
+ * @param  [ in]x    Initial position
+ * @param  [ in]y    Initial position
+ * @param  [ in]vx   Initial velocity
+ * @param  [ in]vy   Initial velocity
+ * @param  [ in]ax   Acceleration
+ * @param  [ in]ay   Acceleration
+ * @param  [ in]anim Animation played by the particle
+ */
+gfmRV particles_spawn(particles *pCtx, int x, int y, double vx, double vy,
+        double ax, double ay, int anim);
+
+/**
+ * Spawn every described particle in a single pass; Particles that don't fit
+ * on the pool (even after it grows) are dropped
+ *
+ * @param  [ in]pCtx   The particle pool
+ * @param  [ in]pDescs The particles
+ * @param  [ in]num    Number of elements in pDescs
+ */
+gfmRV particles_spawnBatch(particles *pCtx, particleDesc *pDescs, int num);
+
+/**
+ * Spawn num particles moving away from a common center, evenly spaced around
+ * it (the first one moves right); Particles that don't fit are dropped
+ *
+ * @param  [ in]pCtx  The particle pool
+ * @param  [ in]x     Burst's center
+ * @param  [ in]y     Burst's center
+ * @param  [ in]num   Number of particles
+ * @param  [ in]speed Particles' speed
+ * @param  [ in]anim  Animation played by every particle
+ */
+gfmRV particles_spawnBurst(particles *pCtx, int x, int y, int num,
+        double speed, int anim);
+
+/**
+ * Queue the integration of every particle on the job system; After a quiet
+ * period, the pool is also halved
+ *
+ * Nothing may be spawned until particles_postUpdate is called (after
+ * jobs_wait)
+ *
+ * @param  [ in]pCtx The particle pool
+ */
+gfmRV particles_update(particles *pCtx);
+
+/**
+ * Remove every particle that died while integrating
+ *
+ * @param  [ in]pCtx The particle pool
+ */
+gfmRV particles_postUpdate(particles *pCtx);
+
+/**
+ * Push every live particle into the snapshot being recorded
+ *
+ * @param  [ in]pCtx The particle pool
+ */
+gfmRV particles_draw(particles *pCtx);
+
+/**
+ * Retrieve the pool's usage
+ *
+ * @param  [out]pUsed      Number of live particles
+ * @param  [out]pHighWater Maximum number of live particles ever reached
+ * @param  [out]pLen       Number of particles currently alloc'ed
+ * @param  [out]pDropped   Number of particles dropped since the pool was full
+ * @param  [ in]pCtx       The particle pool
+ */
+void particles_getStats(int *pUsed, int *pHighWater, int *pLen, int *pDropped,
+        particles *pCtx);
+
+#endif /* __PARTICLES_H__ */
+
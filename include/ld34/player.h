@@ -14,6 +14,10 @@ typedef struct stPlayer player;
 #define __PLAYER_H__
 
 #include <GFraMe/gfmError.h>
+#include <GFraMe/gfmObject.h>
+
+/** How many limbs (i.e., shapes) the player is made of */
+#define PL_NUM_LIMBS 4
 
 /**
  * Alloc and initialize the player
@@ -34,7 +38,8 @@ void player_clean(player **ppPlayer);
 /**
  * Update the player's physics and handle inputs
  *
- * NOTE: This function already adds the player to the quadtree
+ * NOTE: This function already adds the player to the quadtree, as a single
+ * object (of type PL_BODY) covering every limb
  *
  * @param  [ in]pPlayer The player
  */
@@ -51,7 +56,7 @@ gfmRV player_preUpdate(player *pPlayer);
 gfmRV player_postUpdate(player *pPlayer);
 
 /**
- * Render the player
+ * Push every one of the player's parts into the snapshot being recorded
  *
  * @param  [ in]pPlayer The player
  */
@@ -66,5 +71,30 @@ gfmRV player_draw(player *pPlayer);
  */
 gfmRV player_collideLimbFloor(player *pPlayer, int type, gfmObject *pFloor);
 
+/**
+ * Retrieve where a leg was before it was last updated
+ *
+ * @param  [out]pX      Horizontal position
+ * @param  [out]pY      Vertical position
+ * @param  [ in]pPlayer The player
+ * @param  [ in]type    Which leg
+ */
+gfmRV player_getLastPosition(int *pX, int *pY, player *pPlayer, int type);
+
+/**
+ * Retrieve the limbs that may touch an object overlapping the player's body
+ * (the legs are tested over the whole path they moved on this tick)
+ *
+ * @param  [out]ppLimbs The limbs (at least PL_NUM_LIMBS of those)
+ * @param  [out]pNum    How many limbs were retrieved
+ * @param  [ in]pPlayer The player
+ * @param  [ in]x       Left of the overlapping object (over its movement)
+ * @param  [ in]y       Top of the overlapping object (over its movement)
+ * @param  [ in]width   Width of the overlapping object (over its movement)
+ * @param  [ in]height  Height of the overlapping object (over its movement)
+ */
+gfmRV player_getLimbs(gfmObject **ppLimbs, int *pNum, player *pPlayer, int x,
+        int y, int width, int height);
+
 #endif /* __PLAYER_H__ */
 
@@ -0,0 +1,63 @@
+/**
+ * Pre-rendered sound effects
+ *
+ * Every sound effect is defined by a '.bfxrsound' file on the assets directory
+ * and rendered (by the bfxr synthesizer) into PCM. The rendered samples are
+ * kept on a cache file, indexed by a hash of each definition, so a sound is
+ * only synthesized again after its definition is modified. The cache is
+ * mapped into memory as a whole and the samples are used directly from it.
+ *
+ * The cache (in native endianness) is laid out as:
+ *
+ *   "LDSF" | u32 version | u32 numSounds
+ *   numSounds * { u32 hash, u32 offset, u32 numSamples }
+ *   16 bits mono samples, at BFXR_SAMPLE_RATE
+ *
+ * @file include/ld34/sfx.h
+ */
+#ifndef __SFX_STRUCT__
+#define __SFX_STRUCT__
+
+typedef struct stSfx sfx;
+
+#endif /* __SFX_STRUCT__ */
+
+#ifndef __SFX_H__
+#define __SFX_H__
+
+#include <GFraMe/gfmError.h>
+
+/** Cache file, relative to the assets directory */
+#define SFX_CACHE_FILE "sfx.cache"
+
+/**
+ * Load every sound effect, rendering (and caching) any that changed
+ *
+ * @param  [out]ppCtx       The sound effects
+ * @param  [ in]pAssetsPath Path to the assets directory (with a trailing '/')
+ * @param  [ in]ppNames     Name of each sound's definition (without the
+ *                          '.bfxrsound' extension); Its index is the sound's
+ *                          id
+ * @param  [ in]numNames    Number of sounds
+ */
+gfmRV sfx_init(sfx **ppCtx, char *pAssetsPath, char **ppNames, int numNames);
+
+/**
+ * Release the sound effects
+ *
+ * @param  [ in]ppCtx The sound effects
+ */
+void sfx_clean(sfx **ppCtx);
+
+/**
+ * Retrieve a sound's samples
+ *
+ * @param  [out]ppSamples   The samples (owned by the context)
+ * @param  [out]pNumSamples Number of samples
+ * @param  [ in]pCtx        The sound effects
+ * @param  [ in]id          The sound
+ */
+gfmRV sfx_getSamples(short **ppSamples, int *pNumSamples, sfx *pCtx, int id);
+
+#endif /* __SFX_H__ */
+
@@ -0,0 +1,154 @@
+/**
+ * Render snapshots, used to hand the simulation's state to the render thread
+ *
+ * Every tick, the update thread pushes every visible tile (the tilemap's, the
+ * entities' and the HUD's, in drawing order) into a back buffer and publishes
+ * it. The render thread always takes the latest published snapshot and, when
+ * drawing faster than the game updates, interpolates each tile between the
+ * last two snapshots; It never reads the world itself
+ *
+ * @file include/ld34/snapshot.h
+ */
+#ifndef __SNAPSHOT_STRUCT__
+#define __SNAPSHOT_STRUCT__
+
+typedef struct stSnapshot snapshot;
+
+#endif /* __SNAPSHOT_STRUCT__ */
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmSprite.h>
+#include <GFraMe/gfmSpriteset.h>
+
+/**
+ * Alloc the snapshots
+ *
+ * @param  [out]ppCtx The snapshots
+ * @param  [ in]ups   Updates per second
+ * @param  [ in]dps   Draws per second (interpolation is only done if greater
+ *                    than ups)
+ */
+gfmRV snapshot_init(snapshot **ppCtx, int ups, int dps);
+
+/**
+ * Release the snapshots
+ *
+ * @param  [ in]ppCtx The snapshots
+ */
+void snapshot_clean(snapshot **ppCtx);
+
+/**
+ * Block the update thread from modifying the world (and vice-versa); Every
+ * call into GFraMe's context is made with this held (as it isn't
+ * thread-safe), so the render thread takes it around events and drawing,
+ * which also lets it read things that aren't on the snapshot (e.g., the
+ * broadphase's bounds, on debug builds)
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+void snapshot_lockWorld(snapshot *pCtx);
+
+/**
+ * Release the world
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+void snapshot_unlockWorld(snapshot *pCtx);
+
+/**
+ * Start recording a new snapshot (on the update thread)
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+gfmRV snapshot_begin(snapshot *pCtx);
+
+/**
+ * Push a tile into the snapshot being recorded
+ *
+ * @param  [ in]pCtx      The snapshots
+ * @param  [ in]pSset     Spriteset where the tile is
+ * @param  [ in]x         Position on the world (already offset)
+ * @param  [ in]y         Position on the world (already offset)
+ * @param  [ in]tile      The tile
+ * @param  [ in]isFlipped Whether the tile is horizontally flipped
+ * @param  [ in]pOwner    Entity that owns the tile (0 disables interpolation)
+ * @param  [ in]part      Distinguishes tiles from the same owner
+ */
+gfmRV snapshot_pushTile(snapshot *pCtx, gfmSpriteset *pSset, int x, int y,
+        int tile, int isFlipped, void *pOwner, int part);
+
+/**
+ * Push a tile fixed on the screen (e.g., a HUD's) into the snapshot being
+ * recorded; It's never interpolated
+ *
+ * @param  [ in]pCtx  The snapshots
+ * @param  [ in]pSset Spriteset where the tile is
+ * @param  [ in]x     Position on the screen
+ * @param  [ in]y     Position on the screen
+ * @param  [ in]tile  The tile
+ */
+gfmRV snapshot_pushHudTile(snapshot *pCtx, gfmSpriteset *pSset, int x, int y,
+        int tile);
+
+/**
+ * Push a sprite's current frame into the snapshot being recorded; The sprite
+ * is used as its owner
+ *
+ * @param  [ in]pCtx The snapshots
+ * @param  [ in]pSpr The sprite
+ * @param  [ in]pSset Sprite's spriteset
+ * @param  [ in]ox    Sprite's offset
+ * @param  [ in]oy    Sprite's offset
+ */
+gfmRV snapshot_pushSprite(snapshot *pCtx, gfmSprite *pSpr, gfmSpriteset *pSset,
+        int ox, int oy);
+
+/**
+ * Publish the recorded snapshot (with the current camera), replacing any
+ * other that wasn't yet consumed
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+gfmRV snapshot_publish(snapshot *pCtx);
+
+/**
+ * Take the latest published snapshot (on the render thread) and calculate
+ * how far between the last two snapshots the current frame is
+ *
+ * @param  [out]pCamX Interpolated camera position
+ * @param  [out]pCamY Interpolated camera position
+ * @param  [ in]pCtx  The snapshots
+ * @return            GFMRV_OK, GFMRV_FALSE (nothing was published yet)
+ */
+gfmRV snapshot_acquire(int *pCamX, int *pCamY, snapshot *pCtx);
+
+/**
+ * Retrieve the sequence number of the last published snapshot (on the update
+ * thread)
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+int snapshot_getPublished(snapshot *pCtx);
+
+/**
+ * Retrieve the sequence number of the acquired snapshot (on the render
+ * thread)
+ *
+ * @param  [ in]pCtx The snapshots
+ * @return           The sequence number, or -1 if nothing was acquired
+ */
+int snapshot_getAcquired(snapshot *pCtx);
+
+/**
+ * Draw every tile on the snapshot taken by the last snapshot_acquire, relative
+ * to the interpolated camera
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+gfmRV snapshot_draw(snapshot *pCtx);
+
+#endif /* __SNAPSHOT_H__ */
+
@@ -0,0 +1,200 @@
+/**
+ * Pool of collideable sprites (e.g., bullets and props)
+ *
+ * Sprites are alloc'ed in slabs, each twice as big as the previous one, as
+ * the pool gets crowded, and the last slab is released back after it stays
+ * empty for a while
+ *
+ * @file include/ld34/spritePool.h
+ */
+#ifndef __SPRITEPOOL_STRUCT__
+#define __SPRITEPOOL_STRUCT__
+
+typedef struct stSpritePool spritePool;
+typedef struct stSpritePoolNode spritePoolNode;
+typedef struct stSpritePoolDesc spritePoolDesc;
+
+#endif /* __SPRITEPOOL_STRUCT__ */
+
+#ifndef __SPRITEPOOL_H__
+#define __SPRITEPOOL_H__
+
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmSprite.h>
+#include <GFraMe/gfmSpriteset.h>
+
+/** Everything needed to spawn a single sprite */
+struct stSpritePoolDesc {
+    /** Initial position */
+    int x;
+    /** Initial position */
+    int y;
+    /** Initial velocity */
+    double vx;
+    /** Initial velocity */
+    double vy;
+    /** Acceleration */
+    double ax;
+    /** Acceleration */
+    double ay;
+    /** Animation played by the sprite */
+    int anim;
+};
+
+/**
+ * Alloc and initialize a sprite pool
+ *
+ * Every sprite gets the node as its child, so it may be removed from within a
+ * collision
+ *
+ * @param  [out]ppCtx       The sprite pool
+ * @param  [ in]type        Type of every sprite
+ * @param  [ in]pSset       Spriteset used to render the sprites
+ * @param  [ in]pAnimData   Animations, in the same format as a gfmGroup's
+ * @param  [ in]animDataLen Number of elements in pAnimData
+ * @param  [ in]w           Sprites' hitbox
+ * @param  [ in]h           Sprites' hitbox
+ * @param  [ in]ox          Rendering offset
+ * @param  [ in]oy          Rendering offset
+ * @param  [ in]ttl         For how long, in milliseconds, sprites live
+ * @param  [ in]initLen     Number of sprites on the first slab
+ * @param  [ in]maxLen      Maximum number of sprites
+ */
+gfmRV spritePool_init(spritePool **ppCtx, int type, gfmSpriteset *pSset,
+        int *pAnimData, int animDataLen, int w, int h, int ox, int oy, int ttl,
+        int initLen, int maxLen);
+
+/**
+ * Release the sprite pool and all of its sprites
+ *
+ * @param  [ in]ppCtx The sprite pool
+ */
+void spritePool_clean(spritePool **ppCtx);
+
+/**
+ * Retrieve a dead sprite (growing the pool, if needed)
+ *
+ * If the pool already reached its maximum size, the oldest sprite is reused
+ *
+ * @param  [out]ppSpr The sprite
+ * @param  [ in]pCtx  The sprite pool
+ */
+gfmRV spritePool_recycle(gfmSprite **ppSpr, spritePool *pCtx);
+
+/**
+ * Spawn every described sprite in a single pass, growing the pool only once
+ *
+ * If the pool reaches its maximum size, the oldest sprites are reused
+ *
+ * @param  [ in]pCtx   The sprite pool
+ * @param  [ in]pDescs The sprites
+ * @param  [ in]num    Number of elements in pDescs
+ */
+gfmRV spritePool_spawnBatch(spritePool *pCtx, spritePoolDesc *pDescs,
+        int num);
+
+/**
+ * Kill a sprite (e.g., after it collided)
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+gfmRV spritePool_removeNode(spritePoolNode *pNode);
+
+/**
+ * Queue the bookkeeping of every live sprite (aging it and putting it to
+ * sleep) on the job system
+ *
+ * Nothing may be spawned until spritePool_postUpdate is called (after
+ * jobs_wait)
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_update(spritePool *pCtx);
+
+/**
+ * Kill the sprites that expired during the update, move (and animate) the
+ * awake ones, wake those that were sleeping on top of a sprite that's gone
+ * and, after a quiet period, release the last slab
+ *
+ * GFraMe isn't reentrant (the sprites are updated through the shared
+ * gfmCtx), so this must run on the update thread
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_postUpdate(spritePool *pCtx);
+
+/**
+ * Add every sleeping sprite that's inside the camera to the broadphase
+ * (without testing it); Must be called before anything that may push those
+ * sprites is collided
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_populate(spritePool *pCtx);
+
+/**
+ * Wake a sprite (e.g., after it was pushed), so it's integrated and tested
+ * again; Whatever sleeps on top of it is woken on the next post update
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+void spritePool_wakeNode(spritePoolNode *pNode);
+
+/**
+ * Check whether a sprite is asleep
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+int spritePool_isAsleep(spritePoolNode *pNode);
+
+/**
+ * Mark a sprite as standing on top of another one (as if it were on the
+ * floor), so it may fall asleep
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+void spritePool_setSupported(spritePoolNode *pNode);
+
+/**
+ * Retrieve where a sprite was before it was last updated (or its current
+ * position, if it wasn't updated since it was spawned)
+ *
+ * @param  [out]pX    Horizontal position
+ * @param  [out]pY    Vertical position
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+gfmRV spritePool_getLastPosition(int *pX, int *pY, spritePoolNode *pNode);
+
+/**
+ * Collide every live sprite that's inside the camera (over the path it moved
+ * on this tick) against the broadphase
+ *
+ * Every overlap is collected first and only resolved after the last sprite
+ * was added to the broadphase, so the narrow phase may run in parallel
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_collide(spritePool *pCtx);
+
+/**
+ * Push every live sprite into the snapshot being recorded
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_draw(spritePool *pCtx);
+
+/**
+ * Retrieve the pool's usage
+ *
+ * @param  [out]pUsed      Number of live sprites
+ * @param  [out]pHighWater Maximum number of live sprites ever reached
+ * @param  [out]pLen       Number of sprites currently alloc'ed
+ * @param  [out]pStolen    Number of live sprites reused since the pool was
+ *                         full
+ * @param  [ in]pCtx       The sprite pool
+ */
+void spritePool_getStats(int *pUsed, int *pHighWater, int *pLen, int *pStolen,
+        spritePool *pCtx);
+
+#endif /* __SPRITEPOOL_H__ */
+
@@ -17,6 +17,8 @@ typedef struct stTextEvent textEvent;
 #include <GFraMe/gfmError.h>
 #include <GFraMe/gfmParser.h>
 
+#include <ld34/snapshot.h>
+
 /**
  * Alloc a new text manager
  *
@@ -81,11 +83,14 @@ gfmRV textManager_preUpdate(textManager *pCtx);
 gfmRV textManager_postUpdate(textManager *pCtx);
 
 /**
- * Render the currently display text, if any
+ * Push the currently displayed text, if any, into the snapshot being
+ * recorded (on the update thread); If it doesn't fit on the window, only its
+ * last lines are pushed
  *
- * @param  [ in]pCtx The text manager
+ * @param  [ in]pCtx      The text manager
+ * @param  [ in]pSnapshot The snapshots
  */
-gfmRV textManager_draw(textManager *pCtx);
+gfmRV textManager_snapshot(textManager *pCtx, snapshot *pSnapshot);
 
 #endif /* __TEXTMANAGER_H__ */
 
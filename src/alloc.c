@@ -0,0 +1,236 @@
+/**
+ * Allocation tracker
+ *
+ * The game defines its own malloc, calloc and realloc, which count the
+ * allocation and forward it to glibc. Since the executable defines those,
+ * they also replace the ones called by every shared library.
+ *
+ * Nothing here may allocate (nor call anything that might), so the
+ * scopes' data is kept on fixed arrays.
+ *
+ * @file src/alloc.c
+ */
+#define _GNU_SOURCE
+#include <ld34/alloc.h>
+
+#if defined(ALLOC_TRACKING)
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** glibc's own allocator */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+/** Every allocation made from a given place, within a given scope */
+struct stAllocSite {
+    /** Address to where the allocation returned (NULL, if unused) */
+    void *pCaller;
+    /** Scope where it was called */
+    allocScope scope;
+    /** Number of allocations */
+    int count;
+    /** Number of bytes requested */
+    size_t bytes;
+};
+typedef struct stAllocSite allocSite;
+
+/** Statistics of every run of a scope */
+struct stAllocFrames {
+    /** Number of runs (i.e., frames) */
+    int numRuns;
+    /** Number of runs that allocated anything */
+    int numDirty;
+    /** Most allocations on a single run */
+    int worst;
+};
+typedef struct stAllocFrames allocFrames;
+
+/** Every call site, hashed by its address and scope */
+static allocSite alloc_pSites[ALLOC_MAX_SITES];
+/** Allocations that didn't fit on the table */
+static int alloc_numLost;
+/** Protects every call site */
+static pthread_mutex_t alloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+/** Statistics of every scope; Only modified by the scope's thread */
+static allocFrames alloc_pFrames[ALLOC_NUM_SCOPES];
+/** Allocations made on each scope's current frame, by any thread */
+static int alloc_pFrameCounts[ALLOC_NUM_SCOPES];
+/** Every allocation made so far */
+static int alloc_total;
+
+/** Scope entered (or adopted) by the current thread */
+static __thread allocScope alloc_scope;
+
+/**
+ * Record an allocation, if the current thread is within a scope (other than
+ * its first frame)
+ *
+ * @param  [ in]pCaller Where the allocation was called
+ * @param  [ in]bytes   Number of bytes requested
+ */
+static void alloc_record(void *pCaller, size_t bytes) {
+    unsigned int i, num;
+
+    __atomic_add_fetch(&alloc_total, 1, __ATOMIC_RELAXED);
+    if (alloc_scope == ALLOC_NONE ||
+            alloc_pFrames[alloc_scope].numRuns == 0) {
+        return;
+    }
+    __atomic_add_fetch(alloc_pFrameCounts + alloc_scope, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&alloc_mutex);
+    i = (unsigned int)(((size_t)pCaller >> 2) * 31 + alloc_scope);
+    num = 0;
+    while (num < ALLOC_MAX_SITES) {
+        allocSite *pSite;
+
+        pSite = alloc_pSites + (i % ALLOC_MAX_SITES);
+        if (!pSite->pCaller) {
+            pSite->pCaller = pCaller;
+            pSite->scope = alloc_scope;
+        }
+        if (pSite->pCaller == pCaller && pSite->scope == alloc_scope) {
+            pSite->count++;
+            pSite->bytes += bytes;
+            break;
+        }
+        i++;
+        num++;
+    }
+    if (num == ALLOC_MAX_SITES) {
+        alloc_numLost++;
+    }
+    pthread_mutex_unlock(&alloc_mutex);
+}
+
+void *malloc(size_t size) {
+    alloc_record(__builtin_return_address(0), size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+    alloc_record(__builtin_return_address(0), num * size);
+    return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    alloc_record(__builtin_return_address(0), size);
+    return __libc_realloc(ptr, size);
+}
+
+/**
+ * Start recording every allocation made by the calling thread; Each scope
+ * must only ever be entered by a single thread
+ *
+ * @param  [ in]scope The scope
+ */
+void alloc_enter(allocScope scope) {
+    alloc_scope = scope;
+    __atomic_store_n(alloc_pFrameCounts + scope, 0, __ATOMIC_RELAXED);
+}
+
+/** Stop recording the calling thread's allocations and finish its frame */
+void alloc_leave() {
+    allocFrames *pFrames;
+    int count;
+
+    if (alloc_scope == ALLOC_NONE) {
+        return;
+    }
+
+    /* Every job pushed within the scope was already waited for */
+    count = __atomic_load_n(alloc_pFrameCounts + alloc_scope,
+            __ATOMIC_RELAXED);
+    pFrames = alloc_pFrames + alloc_scope;
+    if (count > 0) {
+        pFrames->numDirty++;
+        if (count > pFrames->worst) {
+            pFrames->worst = count;
+        }
+    }
+    pFrames->numRuns++;
+    alloc_scope = ALLOC_NONE;
+}
+
+/**
+ * Retrieve the scope the calling thread is recording into
+ */
+allocScope alloc_getScope() {
+    return alloc_scope;
+}
+
+/**
+ * Record the calling thread's allocations into another thread's scope (or stop
+ * recording, on ALLOC_NONE), without starting nor finishing any frame; Used
+ * by the job workers
+ *
+ * @param  [ in]scope The scope
+ */
+void alloc_adopt(allocScope scope) {
+    alloc_scope = scope;
+}
+
+/**
+ * Retrieve how many allocations were made (by every thread) so far
+ */
+int alloc_getTotal() {
+    return __atomic_load_n(&alloc_total, __ATOMIC_RELAXED);
+}
+
+/**
+ * Print every call site that allocated within a scope and how often frames
+ * allocated anything
+ *
+ * @param  [ in]pFp Where the report is printed
+ */
+void alloc_report(FILE *pFp) {
+    static const char *pNames[ALLOC_NUM_SCOPES] = { "none", "update",
+            "draw" };
+    /* Copied, so nothing is printed with the mutex held (as printing may
+     * allocate) */
+    static allocSite pSites[ALLOC_MAX_SITES];
+    int i, numLost;
+
+    pthread_mutex_lock(&alloc_mutex);
+    memcpy(pSites, alloc_pSites, sizeof(pSites));
+    numLost = alloc_numLost;
+    pthread_mutex_unlock(&alloc_mutex);
+
+    i = ALLOC_NONE + 1;
+    while (i < ALLOC_NUM_SCOPES) {
+        fprintf(pFp, "allocs: %s allocated on %i of %i frames (worst %i)\n",
+                pNames[i], alloc_pFrames[i].numDirty,
+                alloc_pFrames[i].numRuns, alloc_pFrames[i].worst);
+        i++;
+    }
+
+    i = 0;
+    while (i < ALLOC_MAX_SITES) {
+        Dl_info info;
+
+        if (pSites[i].pCaller) {
+            memset(&info, 0x0, sizeof(info));
+            dladdr(pSites[i].pCaller, &info);
+            fprintf(pFp, "allocs:   %-6s %6i (%lu bytes) at %s(%s+0x%lx) "
+                    "[%p]\n", pNames[pSites[i].scope], pSites[i].count,
+                    (unsigned long)pSites[i].bytes,
+                    info.dli_fname ? info.dli_fname : "?",
+                    info.dli_sname ? info.dli_sname : "?",
+                    (unsigned long)((char*)pSites[i].pCaller -
+                    (char*)(info.dli_saddr ? info.dli_saddr :
+                    info.dli_fbase)), pSites[i].pCaller);
+        }
+        i++;
+    }
+    if (numLost > 0) {
+        fprintf(pFp, "allocs:   %i allocations from unlisted sites\n",
+                numLost);
+    }
+}
+
+#endif /* ALLOC_TRACKING */
+
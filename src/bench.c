@@ -0,0 +1,745 @@
+/**
+ * Headless benchmark; Runs the game state on scripted stress scenes and
+ * reports how long each tick took
+ *
+ * Every scene is written as a regular (already split) level, on
+ * 'assets/bench/', and played through the same code as the game, for a fixed
+ * number of ticks. The player is left idle, so every run of a scene simulates
+ * the exact same thing.
+ *
+ * Allocations are only counted if tracked (see alloc.h); Every call site that
+ * allocated while updating is listed after every scene ran.
+ *
+ * Usage: bench [--ticks N] [SCENE ...]
+ *
+ * @file src/bench.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmCamera.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/alloc.h>
+#include <ld34/broadphase.h>
+#include <ld34/clock.h>
+#include <ld34/collide.h>
+#include <ld34/game.h>
+#include <ld34/gamestate.h>
+#include <ld34/jobs.h>
+#include <ld34/level.h>
+#include <ld34/mixer.h>
+#include <ld34/particles.h>
+#include <ld34/sfx.h>
+#include <ld34/snapshot.h>
+#include <ld34/spritePool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__WIN32) || defined(__WIN32__)
+#  include <direct.h>
+#else
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#endif
+
+/** Where the scenes are written, relative to the assets directory */
+#define BENCH_DIR "bench/"
+/** Default number of measured ticks on each scene */
+#define BENCH_TICKS 1200
+/** Ticks run (but not measured) before each scene, so it settles */
+#define BENCH_WARMUP 60
+/** Most ticks run before each scene while the broadphase is tuned */
+#define BENCH_MAX_WARMUP 1200
+/** Updates per second, as the game's default */
+#define BENCH_UPS 60
+/** Width of each sector, in tiles (as 'make level') */
+#define BENCH_SECTOR_WIDTH 40
+/** Height of every scene, in tiles */
+#define BENCH_HEIGHT 30
+/** First row of the floor */
+#define BENCH_FLOOR_ROW 27
+/** Vertical position of every object's bottom (i.e., the floor's top) */
+#define BENCH_FLOOR_Y (BENCH_FLOOR_ROW * 8)
+/** Tile on the floor's surface (and below it) */
+#define BENCH_FLOOR_TILE 80
+#define BENCH_GROUND_TILE 144
+/** Region, around the spawn, that's always loaded */
+#define BENCH_NEAR_X 48
+#define BENCH_NEAR_W 560
+/** Particles spawned on each burst (and bursts per tick) */
+#define BENCH_BURST_LEN 64
+#define BENCH_BURSTS 4
+/** Props thrown on each tick */
+#define BENCH_PROPS 16
+
+/** The game context; See main.c */
+gameCtx *pGame;
+gameAssets *pAssets;
+gameButtons *pButtons;
+void *pState;
+
+/** Same animations as the game's pools */
+static int grp_anim_data[] = {
+              /*   len|fps|loop|data... */
+/* BULLET    */    16 , 12, 0  , 68,69,70,69,70,69,70,69,70,69,70,69,70,69,70,69,
+/* PELLET1   */     1 , 0 , 0  , 71,
+/* PELLET2   */     1 , 0 , 0  , 72,
+/* EXPLOSION */     8 , 16, 0  , 73,74,75,76,77,77,77,77
+};
+static int grp_anim_dataLen = sizeof(grp_anim_data) / sizeof(int);
+
+/** Same tile types as the intro's */
+static const char *pTmDict[] = {
+    "floor"
+};
+static const int tmDictType[] = {
+    FLOOR
+};
+static const int tmDictLen = sizeof(tmDictType) / sizeof(int);
+
+/** Same sounds (on the same order) as the intro's */
+static const char *pSfxNames[] = {
+    "left_step",
+    "right_step",
+    "ene_crushed",
+    "ene_explosion",
+    "pl_hurt",
+    "checkpoint",
+    "ene_shoot",
+    "text"
+};
+static const int sfxLen = sizeof(pSfxNames) / sizeof(char*);
+
+/** A scripted scene */
+struct stBenchScene {
+    /** Name, as selected from the command line */
+    char *pName;
+    /** Width of the map, in tiles */
+    int width;
+    /** Number of turrets, spread around the spawn */
+    int numTurrets;
+    /** Number of lil tanks, spread around the spawn */
+    int numTanks;
+    /** Number of enemies on every sector (besides those around the spawn) */
+    int perSector;
+    /** Number of text triggers over the player */
+    int numTexts;
+    /** Whether every pool is kept full */
+    int doFillPools;
+    /** Whether the camera pans through the whole map (streaming it) */
+    int doPan;
+};
+typedef struct stBenchScene benchScene;
+
+static benchScene pScenes[] = {
+    /* name       width num     num    per    num   fill  pan */
+    { "turrets",  200,  64,     0,     0,     0,    0,    0 },
+    { "tanks",    200,  0,      128,   0,     0,    0,    0 },
+    { "particles", 200, 0,      0,     0,     0,    1,    0 },
+    { "texts",    200,  0,      0,     0,     300,  0,    0 },
+    { "wide",     4000, 0,      0,     2,     0,    0,    1 },
+    { "mixed",    400,  32,     32,    0,     50,   1,    0 }
+};
+static const int numScenes = sizeof(pScenes) / sizeof(benchScene);
+
+/**
+ * Write an enemy on the objects' file of the sector that contains it
+ *
+ * @param  [ in]ppFiles    Every sector's objects' file (opened as needed)
+ * @param  [ in]pNumObjs   Number of objects on every sector
+ * @param  [ in]pType      Object's type
+ * @param  [ in]x          Object's horizontal position
+ */
+static gfmRV bench_writeEnemy(FILE **ppFiles, int *pNumObjs, char *pType,
+        int x) {
+    char pPath[ASSETS_PATH_LEN + 64];
+    gfmRV rv;
+    int sector;
+
+    sector = x / (BENCH_SECTOR_WIDTH * 8);
+    if (!ppFiles[sector]) {
+        snprintf(pPath, sizeof(pPath), "%s%ssector_%03i_obj.gfm",
+                pGame->pAssetsPath, BENCH_DIR, sector);
+        ppFiles[sector] = fopen(pPath, "wt");
+        ASSERT(ppFiles[sector], GFMRV_FUNCTION_FAILED);
+    }
+    fprintf(ppFiles[sector], "obj %s %i %i 16 16\n", pType, x, BENCH_FLOOR_Y);
+    pNumObjs[sector]++;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Write a scene as a level, in the same format generated by 'make level'
+ *
+ * @param  [ in]pScene The scene
+ */
+static gfmRV bench_writeScene(benchScene *pScene) {
+    char pPath[ASSETS_PATH_LEN + 64];
+    FILE *pFp, **ppFiles;
+    gfmRV rv;
+    int i, *pNumObjs, numSectors;
+
+    pFp = 0;
+    numSectors = (pScene->width + BENCH_SECTOR_WIDTH - 1) /
+            BENCH_SECTOR_WIDTH;
+    ppFiles = (FILE**)calloc(numSectors, sizeof(FILE*));
+    pNumObjs = (int*)calloc(numSectors, sizeof(int));
+    ASSERT(ppFiles && pNumObjs, GFMRV_ALLOC_FAILED);
+
+    snprintf(pPath, sizeof(pPath), "%s%s", pGame->pAssetsPath, BENCH_DIR);
+#if defined(__WIN32) || defined(__WIN32__)
+    mkdir(pPath);
+#else
+    mkdir(pPath, 0755);
+#endif
+
+    /* Every sector is a flat floor */
+    i = 0;
+    while (i < numSectors) {
+        int len, x, y;
+
+        snprintf(pPath, sizeof(pPath), "%s%ssector_%03i_tile.gfm",
+                pGame->pAssetsPath, BENCH_DIR, i);
+        pFp = fopen(pPath, "wt");
+        ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+
+        len = pScene->width - i * BENCH_SECTOR_WIDTH;
+        if (len > BENCH_SECTOR_WIDTH) {
+            len = BENCH_SECTOR_WIDTH;
+        }
+        fprintf(pFp, "type floor %i\ntype floor %i\nmap %i %i\n",
+                BENCH_FLOOR_TILE, BENCH_GROUND_TILE, len, BENCH_HEIGHT);
+        y = 0;
+        while (y < BENCH_HEIGHT) {
+            x = 0;
+            while (x < len) {
+                if (y < BENCH_FLOOR_ROW) {
+                    fprintf(pFp, " -1");
+                }
+                else if (y == BENCH_FLOOR_ROW) {
+                    fprintf(pFp, " %i", BENCH_FLOOR_TILE);
+                }
+                else {
+                    fprintf(pFp, " %i", BENCH_GROUND_TILE);
+                }
+                x++;
+            }
+            fprintf(pFp, "\n");
+            y++;
+        }
+
+        fclose(pFp);
+        pFp = 0;
+        i++;
+    }
+
+    /* Enemies are crowded around the spawn (so they are always loaded) and
+     * spread through the rest of the map */
+    i = 0;
+    while (i < pScene->numTurrets) {
+        rv = bench_writeEnemy(ppFiles, pNumObjs, "turret",
+                BENCH_NEAR_X + i * BENCH_NEAR_W / pScene->numTurrets);
+        ASSERT(rv == GFMRV_OK, rv);
+        i++;
+    }
+    i = 0;
+    while (i < pScene->numTanks) {
+        rv = bench_writeEnemy(ppFiles, pNumObjs, "lil_tank",
+                BENCH_NEAR_X + i * BENCH_NEAR_W / pScene->numTanks);
+        ASSERT(rv == GFMRV_OK, rv);
+        i++;
+    }
+    i = 0;
+    while (i < numSectors * pScene->perSector) {
+        int x;
+
+        x = (i / pScene->perSector) * BENCH_SECTOR_WIDTH * 8 +
+                (i % pScene->perSector + 1) * 64;
+        if (x < pScene->width * 8) {
+            if (i % 2 == 0) {
+                rv = bench_writeEnemy(ppFiles, pNumObjs, "turret", x);
+            }
+            else {
+                rv = bench_writeEnemy(ppFiles, pNumObjs, "lil_tank",
+                        x);
+            }
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        i++;
+    }
+
+    /* The player and the text triggers are always loaded */
+    snprintf(pPath, sizeof(pPath), "%s%sobjects.gfm", pGame->pAssetsPath,
+            BENCH_DIR);
+    pFp = fopen(pPath, "wt");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+    fprintf(pFp, "obj player 8 %i 32 16\n", BENCH_FLOOR_Y - 24);
+    i = 0;
+    while (i < pScene->numTexts) {
+        fprintf(pFp, "obj text %i %i 24 64 [ repeat , t ] [ string , "
+                "\"BENCHMARK TEXT %03i\" ] [ ttl , 100 ]\n", i % 32,
+                BENCH_FLOOR_Y, i);
+        i++;
+    }
+    fclose(pFp);
+    pFp = 0;
+
+    snprintf(pPath, sizeof(pPath), "%s%slevel.txt", pGame->pAssetsPath,
+            BENCH_DIR);
+    pFp = fopen(pPath, "wt");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+    fprintf(pFp, "level %i %i %i %i\n", pScene->width, BENCH_HEIGHT,
+            BENCH_SECTOR_WIDTH, numSectors);
+    i = 0;
+    while (i < numSectors) {
+        fprintf(pFp, "sector %i %i\n", i, pNumObjs[i]);
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    if (pFp) {
+        fclose(pFp);
+    }
+    if (ppFiles) {
+        i = 0;
+        while (i < numSectors) {
+            if (ppFiles[i]) {
+                fclose(ppFiles[i]);
+            }
+            i++;
+        }
+        free(ppFiles);
+    }
+    free(pNumObjs);
+
+    return rv;
+}
+
+/**
+ * Script whatever the scene does besides the game itself; Called after each
+ * tick
+ *
+ * @param  [ in]pScene The scene
+ * @param  [ in]tick   Current tick
+ * @param  [ in]num    Number of ticks on the scene
+ */
+static gfmRV bench_script(benchScene *pScene, int tick, int num) {
+    gfmCamera *pCam;
+    gfmRV rv;
+    int camH, camW, camX, camY, i;
+
+    rv = gfm_getCamera(&pCam, pGame->pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmCamera_getPosition(&camX, &camY, pCam);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmCamera_getDimensions(&camW, &camH, pCam);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    if (pScene->doFillPools) {
+        spritePoolDesc pDescs[BENCH_PROPS];
+
+        /* Bursts are dropped once the pool is full */
+        i = 0;
+        while (i < BENCH_BURSTS) {
+            rv = particles_spawnBurst(pGame->pParticles,
+                    camX + camW * (i + 1) / (BENCH_BURSTS + 1),
+                    camY + camH / 2, BENCH_BURST_LEN, 20.0, P_EXPLOSION);
+            ASSERT(rv == GFMRV_OK, rv);
+            i++;
+        }
+
+        /* Pellets rain over the floor, so they pile up and collide */
+        i = 0;
+        while (i < BENCH_PROPS) {
+            pDescs[i].x = camX + (tick * 37 + i * camW / BENCH_PROPS) % camW;
+            pDescs[i].y = camY;
+            pDescs[i].vx = (double)(i % 5 - 2) * 10.0;
+            pDescs[i].vy = 0.0;
+            pDescs[i].ax = 0.0;
+            pDescs[i].ay = GRAV;
+            pDescs[i].anim = P_PELLET1;
+            i++;
+        }
+        rv = spritePool_spawnBatch(pGame->pProps, pDescs, BENCH_PROPS);
+        ASSERT(rv == GFMRV_OK, rv);
+        i = 0;
+        while (i < BENCH_PROPS) {
+            pDescs[i].vy = TURRET_BULLET_VY;
+            pDescs[i].y = BENCH_FLOOR_Y;
+            pDescs[i].ay = 0.0;
+            pDescs[i].anim = P_BULLET;
+            i++;
+        }
+        rv = spritePool_spawnBatch(pGame->pBullets, pDescs, BENCH_PROPS);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    if (pScene->doPan) {
+        /* Overrides the player's camera, so the next tick streams the
+         * sectors around this position */
+        rv = gfmCamera_setPosition(pCam,
+                (int)((double)(pScene->width * 8 - camW) * tick / num),
+                camY);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Run a single tick, as the game does
+ *
+ * @param  [ in]pSimTime Total simulated time
+ */
+static gfmRV bench_tick(double *pSimTime) {
+    gfmRV rv;
+    int lastTime;
+
+    lastTime = (int)*pSimTime;
+    *pSimTime += 1000.0 / BENCH_UPS;
+    pGame->elapsed = (int)*pSimTime - lastTime;
+    pGame->tickTime = clock_getTime();
+
+    rv = gamestate_update();
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = mixer_flush(pGame->pMixer);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gamestate_snapshot();
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Play a scene and report its timing
+ *
+ * @param  [ in]pScene   The scene
+ * @param  [ in]numTicks Number of measured ticks
+ * @param  [ in]type     Broadphase used
+ */
+static gfmRV bench_run(benchScene *pScene, int numTicks,
+        broadphaseType type) {
+    char pSetting[32];
+    double maxTime, simTime, totalTime;
+    broadphaseType bpType;
+    gfmRV rv;
+    int bpParam, i, isTuning, numAllocs, numOverlaps, numPairs, overlaps,
+            pairs;
+
+    rv = bench_writeScene(pScene);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    /* Tuned from scratch on every scene */
+    rv = broadphase_init(&(pGame->pBroadphase), type);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = level_init(&(pGame->pLevel), pGame->pAssetsPath, pGame->pLevelDir,
+            (char**)pTmDict, (int*)tmDictType, tmDictLen);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    /* Every scene starts with empty pools */
+    rv = particles_init(&(pGame->pParticles), pAssets->pSset8x8,
+            grp_anim_data, grp_anim_dataLen, 2/*w*/, 2/*h*/, -3/*ox*/,
+            -3/*oy*/, PARTICLE_TTL, 1/*deathOnLeave*/, INIT_PARTICLES,
+            NUM_PARTICLES);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_init(&(pGame->pBullets), BULLET, pAssets->pSset8x8,
+            grp_anim_data, grp_anim_dataLen, 2/*w*/, 2/*h*/, -3/*ox*/,
+            -3/*oy*/, PARTICLE_TTL, INIT_PARTICLES, NUM_PARTICLES);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_init(&(pGame->pProps), PROP, pAssets->pSset8x8,
+            grp_anim_data, grp_anim_dataLen, 2/*w*/, 2/*h*/, -3/*ox*/,
+            -3/*oy*/, PARTICLE_TTL, INIT_PARTICLES, NUM_PARTICLES);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    pGame->hitCount = 0;
+    pGame->enemiesKilled = 0;
+    pGame->exit = 0;
+    rv = gamestate_init();
+    ASSERT(rv == GFMRV_OK, rv);
+    pGame->curState = state_game;
+
+    simTime = 0.0;
+    i = 0;
+    isTuning = 1;
+    while (i < BENCH_WARMUP || (isTuning && i < BENCH_MAX_WARMUP)) {
+        rv = bench_tick(&simTime);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = bench_script(pScene, 0, numTicks);
+        ASSERT(rv == GFMRV_OK, rv);
+        broadphase_getSetting(&bpType, &bpParam, &isTuning,
+                pGame->pBroadphase);
+        i++;
+    }
+
+    numAllocs = alloc_getTotal();
+    collide_getStats(&numPairs, &numOverlaps);
+    maxTime = 0.0;
+    totalTime = 0.0;
+    i = 0;
+    while (i < numTicks) {
+        double time;
+
+        time = clock_getTime();
+        rv = bench_tick(&simTime);
+        time = clock_getTime() - time;
+        ASSERT(rv == GFMRV_OK, rv);
+
+        totalTime += time;
+        if (time > maxTime) {
+            maxTime = time;
+        }
+
+        rv = bench_script(pScene, i, numTicks);
+        ASSERT(rv == GFMRV_OK, rv);
+        i++;
+    }
+    numAllocs = alloc_getTotal() - numAllocs;
+    collide_getStats(&pairs, &overlaps);
+    numPairs = pairs - numPairs;
+    numOverlaps = overlaps - numOverlaps;
+    broadphase_getSetting(&bpType, &bpParam, &isTuning, pGame->pBroadphase);
+    if (bpParam > 0) {
+        snprintf(pSetting, sizeof(pSetting), "%s/%i",
+                broadphase_getName(bpType), bpParam);
+    }
+    else {
+        snprintf(pSetting, sizeof(pSetting), "%s",
+                broadphase_getName(bpType));
+    }
+
+    printf("%-10s %10.0f %10.0f", pScene->pName,
+            totalTime * 1000000.0 / numTicks, maxTime * 1000000.0);
+#if defined(ALLOC_TRACKING)
+    printf(" %10.2f", (double)numAllocs / numTicks);
+#else
+    printf(" %10s", "-");
+#endif
+    printf(" %10.1f %10.1f %s\n", (double)numPairs / numTicks,
+            (double)numOverlaps / numTicks, pSetting);
+    fflush(stdout);
+
+    rv = GFMRV_OK;
+__ret:
+    if (pState) {
+        gamestate_clean();
+    }
+    pGame->curState = state_none;
+    particles_clean(&(pGame->pParticles));
+    spritePool_clean(&(pGame->pBullets));
+    spritePool_clean(&(pGame->pProps));
+    level_clean(&(pGame->pLevel));
+    broadphase_clean(&(pGame->pBroadphase));
+
+    return rv;
+}
+
+/**
+ * Entry point
+ *
+ * @param  [ in]argc Number of arguments
+ * @param  [ in]argv List of arguments
+ */
+int main(int argc, char *argv[]) {
+    broadphaseType type;
+    gfmRV rv;
+    int *pSelected, i, numTicks;
+
+    pGame = 0;
+    pAssets = 0;
+    pButtons = 0;
+    pState = 0;
+
+    pSelected = (int*)calloc(numScenes, sizeof(int));
+    ASSERT(pSelected, GFMRV_ALLOC_FAILED);
+
+    numTicks = BENCH_TICKS;
+    type = BROADPHASE_AUTO;
+    i = 1;
+    while (i < argc) {
+        int j;
+
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            numTicks = atoi(argv[i + 1]);
+            ASSERT(numTicks > 0, GFMRV_ARGUMENTS_BAD);
+            i += 2;
+            continue;
+        }
+        else if (strcmp(argv[i], "--broadphase") == 0 && i + 1 < argc) {
+            j = 0;
+            while (j < BROADPHASE_NUM_TYPES && strcmp(argv[i + 1],
+                    broadphase_getName((broadphaseType)j)) != 0) {
+                j++;
+            }
+            ASSERT(j < BROADPHASE_NUM_TYPES, GFMRV_ARGUMENTS_BAD);
+            type = (broadphaseType)j;
+            i += 2;
+            continue;
+        }
+
+        j = 0;
+        while (j < numScenes) {
+            if (strcmp(argv[i], pScenes[j].pName) == 0) {
+                pSelected[j] = 1;
+                break;
+            }
+            j++;
+        }
+        if (j == numScenes) {
+            printf("Usage: %s [--ticks N] [--broadphase NAME] [SCENE ...]\n"
+                    "\nScenes:", argv[0]);
+            j = 0;
+            while (j < numScenes) {
+                printf(" %s", pScenes[j].pName);
+                j++;
+            }
+            printf("\nBroadphases:");
+            j = 0;
+            while (j < BROADPHASE_NUM_TYPES) {
+                printf(" %s", broadphase_getName((broadphaseType)j));
+                j++;
+            }
+            printf("\n");
+            free(pSelected);
+            return strcmp(argv[i], "--help") != 0;
+        }
+        i++;
+    }
+    /* Run everything, if nothing was selected */
+    i = 0;
+    while (i < numScenes && !pSelected[i]) {
+        i++;
+    }
+    if (i == numScenes) {
+        i = 0;
+        while (i < numScenes) {
+            pSelected[i] = 1;
+            i++;
+        }
+    }
+
+#if !(defined(__WIN32) || defined(__WIN32__))
+    /* Nothing is ever shown nor heard */
+    setenv("SDL_VIDEODRIVER", "dummy", 0/*overwrite*/);
+    setenv("SDL_RENDER_DRIVER", "software", 0/*overwrite*/);
+    setenv("SDL_AUDIODRIVER", "dummy", 0/*overwrite*/);
+#endif
+
+    pButtons = (gameButtons*)malloc(sizeof(gameButtons));
+    ASSERT(pButtons, GFMRV_ALLOC_FAILED);
+    memset(pButtons, 0x0, sizeof(gameButtons));
+    pAssets = (gameAssets*)malloc(sizeof(gameAssets));
+    ASSERT(pAssets, GFMRV_ALLOC_FAILED);
+    memset(pAssets, 0x0, sizeof(gameAssets));
+    pGame = (gameCtx*)malloc(sizeof(gameCtx));
+    ASSERT(pGame, GFMRV_ALLOC_FAILED);
+    memset(pGame, 0x0, sizeof(gameCtx));
+
+    /* Assets are found besides the binary */
+    do {
+        char *pSep;
+        int len;
+
+        pSep = strrchr(argv[0], '/');
+#if defined(__WIN32) || defined(__WIN32__)
+        if (!pSep) {
+            pSep = strrchr(argv[0], '\\');
+        }
+#endif
+        len = 0;
+        if (pSep) {
+            len = pSep - argv[0] + 1;
+        }
+        ASSERT(len + sizeof("assets/") <= ASSETS_PATH_LEN,
+                GFMRV_ARGUMENTS_BAD);
+        memcpy(pGame->pAssetsPath, argv[0], len);
+        strcpy(pGame->pAssetsPath + len, "assets/");
+    } while (0);
+    pGame->pLevelDir = BENCH_DIR;
+
+    rv = gfm_getNew(&(pGame->pCtx));
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_initStatic(pGame->pCtx, ORG, TITLE);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_initGameWindow(pGame->pCtx, BBWDT, BBHGT, BBWDT, BBHGT,
+            0/*canResize*/, 0/*vsync*/);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_setFPS(pGame->pCtx, BENCH_UPS);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_setStateFrameRate(pGame->pCtx, BENCH_UPS, BENCH_UPS);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = jobs_init(&(pGame->pJobs), JOBS_AUTO);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = snapshot_init(&(pGame->pSnapshot), BENCH_UPS, BENCH_UPS);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = gfm_loadTextureStatic(&(pAssets->texHandle), pGame->pCtx, TEXATLAS,
+            COLORKEY);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_createSpritesetCached(&(pAssets->pSset8x8), pGame->pCtx,
+            pAssets->texHandle, 8, 8);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_createSpritesetCached(&(pAssets->pSset16x16), pGame->pCtx,
+            pAssets->texHandle, 16, 16);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_createSpritesetCached(&(pAssets->pSset32x16), pGame->pCtx,
+            pAssets->texHandle, 32, 16);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = sfx_init(&(pGame->pSfx), pGame->pAssetsPath, (char**)pSfxNames,
+            sfxLen);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = mixer_init(&(pGame->pMixer), pGame->pSfx);
+    ASSERT(rv == GFMRV_OK, rv);
+    pAssets->sfxLeftStep = 0;
+    pAssets->sfxRightStep = 1;
+    pAssets->sfxEnemyCrushed = 2;
+    pAssets->sfxEnemyExplosion = 3;
+    pAssets->sfxPlHurt = 4;
+    pAssets->sfxCheckpoint = 5;
+    pAssets->sfxEnemyShoot = 6;
+    pAssets->sfxText = 7;
+
+    printf("%-10s %10s %10s %10s %10s %10s %s\n", "scene", "ns/tick",
+            "max ns", "allocs", "pairs", "overlaps", "broadphase");
+    i = 0;
+    while (i < numScenes) {
+        if (pSelected[i]) {
+            rv = bench_run(pScenes + i, numTicks, type);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        i++;
+    }
+    alloc_report(stdout);
+
+    rv = GFMRV_OK;
+__ret:
+    free(pSelected);
+    if (pGame) {
+        mixer_clean(&(pGame->pMixer));
+        sfx_clean(&(pGame->pSfx));
+        jobs_clean(&(pGame->pJobs));
+        snapshot_clean(&(pGame->pSnapshot));
+        collide_clean();
+        gfm_free(&(pGame->pCtx));
+        free(pGame);
+    }
+    if (pAssets) {
+        free(pAssets);
+    }
+    if (pButtons) {
+        free(pButtons);
+    }
+
+    return rv;
+}
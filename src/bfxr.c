@@ -0,0 +1,583 @@
+/**
+ * Synthesizer for bfxr's sound definitions
+ *
+ * Based on sfxr's synthesizer (and bfxr's extensions to it); Every sample is
+ * super-sampled 8 times and every length is expressed in samples.
+ *
+ * @file src/bfxr.c
+ */
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/bfxr.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#  define M_PI 3.14159265358979323846
+#endif
+
+/** Number of parameters on a definition */
+#define BFXR_NUM_PARAMS ((int)(sizeof(bfxrParams) / sizeof(float)))
+/** Length of the flanger's buffer (must be a power of 2) */
+#define BFXR_PHASER_LEN 1024
+/** Length of the noise buffer */
+#define BFXR_NOISE_LEN 32
+/** Seed for the noise generator */
+#define BFXR_SEED 0x1d34u
+/** How many sub-samples are generated for each sample */
+#define BFXR_SUPERSAMPLE 8
+
+enum enBfxrWave {
+    BFXR_SQUARE = 0,
+    BFXR_SAW,
+    BFXR_SINE,
+    BFXR_NOISE,
+    BFXR_TRIANGLE,
+    BFXR_NUM_WAVES
+};
+
+/** State of the synthesizer, reset on every repeat */
+struct stBfxrSynth {
+    bfxrParams *pParams;
+    unsigned int seed;
+    /* Frequency */
+    double period;
+    double maxPeriod;
+    double slide;
+    double deltaSlide;
+    double changeAmount;
+    int changeTime;
+    int changeLimit;
+    double changeAmount2;
+    int changeTime2;
+    int changeLimit2;
+    int changePeriod;
+    int changePeriodTime;
+    /* Square wave */
+    float squareDuty;
+    float dutySweep;
+    /* Repeat */
+    int repeatTime;
+    int repeatLimit;
+    /* Overtones */
+    int overtones;
+    float overtoneFalloff;
+    /* Filters */
+    float lpPos;
+    float lpDeltaPos;
+    float lpCutoff;
+    float lpCutoffSweep;
+    float lpDamping;
+    float hpPos;
+    float hpCutoff;
+    float hpCutoffSweep;
+    /* Vibrato */
+    float vibratoPhase;
+    float vibratoSpeed;
+    float vibratoAmplitude;
+    /* Envelope */
+    float envelopeVolume;
+    int envelopeStage;
+    int envelopeTime;
+    int pEnvelopeLength[3];
+    /* Flanger */
+    float flangerOffset;
+    float flangerDeltaOffset;
+    int flangerInt;
+    int flangerPos;
+    float pFlangerBuffer[BFXR_PHASER_LEN];
+    /* Noise */
+    float pNoiseBuffer[BFXR_NOISE_LEN];
+    /* Bit crush */
+    float bitCrushFreq;
+    float bitCrushFreqSweep;
+    float bitCrushPhase;
+    float bitCrushLast;
+    /* Compression */
+    float compressionFactor;
+    /* Wave generation */
+    int phase;
+    int intPeriod;
+    int isPlaying;
+};
+typedef struct stBfxrSynth bfxrSynth;
+
+/**
+ * Parse a sound definition; Empty fields are set to bfxr's defaults
+ *
+ * @param  [out]pParams The parameters
+ * @param  [ in]pText   The definition (as saved by bfxr)
+ * @param  [ in]len     Length of the definition
+ */
+gfmRV bfxr_parse(bfxrParams *pParams, char *pText, int len) {
+    float *pValues;
+    gfmRV rv;
+    int i, pos;
+
+    memset(pParams, 0x0, sizeof(bfxrParams));
+    pParams->masterVolume = 0.5f;
+    pParams->sustainTime = 0.3f;
+    pParams->decayTime = 0.4f;
+    pParams->compressionAmount = 0.3f;
+    pParams->lpFilterCutoff = 1.0f;
+
+    pValues = (float*)pParams;
+    i = 0;
+    pos = 0;
+    while (i < BFXR_NUM_PARAMS && pos < len) {
+        char pNum[32];
+        int numLen;
+
+        numLen = 0;
+        while (pos < len && pText[pos] != ',') {
+            ASSERT(numLen < (int)sizeof(pNum) - 1, GFMRV_READ_ERROR);
+            pNum[numLen] = pText[pos];
+            numLen++;
+            pos++;
+        }
+        pNum[numLen] = '\0';
+        /* Skip the separator */
+        pos++;
+
+        if (numLen > 0) {
+            char *pEnd;
+
+            pValues[i] = strtof(pNum, &pEnd);
+            ASSERT(pEnd != pNum, GFMRV_READ_ERROR);
+        }
+        i++;
+    }
+    ASSERT(i == BFXR_NUM_PARAMS, GFMRV_READ_ERROR);
+    ASSERT(pParams->waveType >= 0 && (int)pParams->waveType < BFXR_NUM_WAVES,
+            GFMRV_ARGUMENTS_BAD);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/** Retrieve a pseudo-random number in the range [-1, 1] */
+static float bfxr_random(bfxrSynth *pSynth) {
+    pSynth->seed = pSynth->seed * 1103515245u + 12345u;
+    return (float)((pSynth->seed >> 8) & 0xffff) / 32767.5f - 1.0f;
+}
+
+/**
+ * Reset the synthesizer
+ *
+ * @param  [ in]pSynth    The synthesizer
+ * @param  [ in]isRepeat  Whether only the pitch should be reset (on repeats)
+ */
+static void bfxr_reset(bfxrSynth *pSynth, int isRepeat) {
+    bfxrParams *pP;
+    int i;
+
+    pP = pSynth->pParams;
+
+    pSynth->period = 100.0 / (pP->startFrequency * pP->startFrequency
+            + 0.001);
+    pSynth->maxPeriod = 100.0 / (pP->minFrequency * pP->minFrequency + 0.001);
+    pSynth->slide = 1.0 - pow(pP->slide, 3.0) * 0.01;
+    pSynth->deltaSlide = -pow(pP->deltaSlide, 3.0) * 0.000001;
+
+    if ((int)pP->waveType == BFXR_SQUARE) {
+        pSynth->squareDuty = 0.5f - pP->squareDuty * 0.5f;
+        pSynth->dutySweep = -pP->dutySweep * 0.00005f;
+    }
+
+    pSynth->changePeriod = (int)(((1.0f - pP->changeRepeat) + 0.1f) / 1.1f
+            * 20000.0f + 32.0f);
+    pSynth->changePeriodTime = 0;
+
+#define BFXR_CHANGE_AMOUNT(amount) \
+    ((amount) > 0 ? 1.0 - pow((amount), 2.0) * 0.9 \
+                  : 1.0 + pow((amount), 2.0) * 10.0)
+#define BFXR_CHANGE_LIMIT(speed) \
+    ((speed) == 1.0f ? 0 : (int)((pow(1.0 - (speed), 2.0) * 20000.0 + 32.0) \
+            * ((1.0 - pP->changeRepeat + 0.1) / 1.1)))
+    pSynth->changeAmount = BFXR_CHANGE_AMOUNT(pP->changeAmount);
+    pSynth->changeTime = 0;
+    pSynth->changeLimit = BFXR_CHANGE_LIMIT(pP->changeSpeed);
+    pSynth->changeAmount2 = BFXR_CHANGE_AMOUNT(pP->changeAmount2);
+    pSynth->changeTime2 = 0;
+    pSynth->changeLimit2 = BFXR_CHANGE_LIMIT(pP->changeSpeed2);
+#undef BFXR_CHANGE_LIMIT
+#undef BFXR_CHANGE_AMOUNT
+
+    if (isRepeat) {
+        return;
+    }
+
+    pSynth->phase = 0;
+
+    pSynth->overtones = (int)(pP->overtones * 10.0f);
+    pSynth->overtoneFalloff = pP->overtoneFalloff;
+
+    pSynth->lpPos = 0.0f;
+    pSynth->lpDeltaPos = 0.0f;
+    pSynth->lpCutoff = (float)pow(pP->lpFilterCutoff, 3.0) * 0.1f;
+    pSynth->lpCutoffSweep = 1.0f + pP->lpFilterCutoffSweep * 0.0001f;
+    pSynth->lpDamping = 5.0f / (1.0f + (float)pow(pP->lpFilterResonance, 2.0)
+            * 20.0f) * (0.01f + pSynth->lpCutoff);
+    if (pSynth->lpDamping > 0.8f) {
+        pSynth->lpDamping = 0.8f;
+    }
+    pSynth->hpPos = 0.0f;
+    pSynth->hpCutoff = (float)pow(pP->hpFilterCutoff, 2.0) * 0.1f;
+    pSynth->hpCutoffSweep = 1.0f + pP->hpFilterCutoffSweep * 0.0003f;
+
+    pSynth->vibratoPhase = 0.0f;
+    pSynth->vibratoSpeed = (float)pow(pP->vibratoSpeed, 2.0) * 0.01f;
+    pSynth->vibratoAmplitude = pP->vibratoDepth * 0.5f;
+
+    pSynth->envelopeVolume = 0.0f;
+    pSynth->envelopeStage = 0;
+    pSynth->envelopeTime = 0;
+    pSynth->pEnvelopeLength[0] = (int)(pP->attackTime * pP->attackTime
+            * 100000.0f);
+    pSynth->pEnvelopeLength[1] = (int)(pP->sustainTime * pP->sustainTime
+            * 100000.0f);
+    pSynth->pEnvelopeLength[2] = (int)(pP->decayTime * pP->decayTime
+            * 100000.0f) + 10;
+
+    pSynth->flangerOffset = (float)pow(pP->flangerOffset, 2.0) * 1020.0f;
+    if (pP->flangerOffset < 0.0f) {
+        pSynth->flangerOffset = -pSynth->flangerOffset;
+    }
+    pSynth->flangerDeltaOffset = (float)pow(pP->flangerSweep, 2.0) * 1.0f;
+    if (pP->flangerSweep < 0.0f) {
+        pSynth->flangerDeltaOffset = -pSynth->flangerDeltaOffset;
+    }
+    pSynth->flangerInt = abs((int)pSynth->flangerOffset);
+    pSynth->flangerPos = 0;
+    memset(pSynth->pFlangerBuffer, 0x0, sizeof(pSynth->pFlangerBuffer));
+
+    i = 0;
+    while (i < BFXR_NOISE_LEN) {
+        pSynth->pNoiseBuffer[i] = bfxr_random(pSynth);
+        i++;
+    }
+
+    pSynth->repeatTime = 0;
+    if (pP->repeatSpeed == 0.0f) {
+        pSynth->repeatLimit = 0;
+    }
+    else {
+        pSynth->repeatLimit = (int)(pow(1.0f - pP->repeatSpeed, 2.0)
+                * 20000.0 + 32.0);
+    }
+
+    pSynth->bitCrushFreq = 1.0f - (float)pow(pP->bitCrush, 1.0 / 3.0);
+    pSynth->bitCrushFreqSweep = -pP->bitCrushSweep * 0.000015f;
+    pSynth->bitCrushPhase = 0.0f;
+    pSynth->bitCrushLast = 0.0f;
+
+    pSynth->compressionFactor = 1.0f / (1.0f + 4.0f * pP->compressionAmount);
+
+    pSynth->isPlaying = 1;
+}
+
+/**
+ * Generate a single sub-sample of the current wave
+ *
+ * @param  [ in]pSynth The synthesizer
+ * @param  [ in]pos    Position within the period, in the range [0, 1)
+ */
+static float bfxr_wave(bfxrSynth *pSynth, float pos) {
+    switch ((int)pSynth->pParams->waveType) {
+        case BFXR_SQUARE: return (pos < pSynth->squareDuty) ? 0.5f : -0.5f;
+        case BFXR_SAW: return 1.0f - pos * 2.0f;
+        case BFXR_SINE: return (float)sin(pos * 2.0 * M_PI);
+        case BFXR_NOISE: return pSynth->pNoiseBuffer[(int)(pos
+                * BFXR_NOISE_LEN) % BFXR_NOISE_LEN];
+        case BFXR_TRIANGLE: return fabsf(1.0f - pos * 2.0f) * 2.0f - 1.0f;
+        default: return 0.0f;
+    }
+}
+
+/**
+ * Generate the next sample
+ *
+ * @param  [ in]pSynth The synthesizer
+ * @return             The sample, in the range [-1, 1]
+ */
+static float bfxr_step(bfxrSynth *pSynth) {
+    bfxrParams *pP;
+    double periodTmp;
+    float sample;
+    int i;
+
+    pP = pSynth->pParams;
+
+    /* Repeat and pitch jumps */
+    if (pSynth->repeatLimit != 0) {
+        pSynth->repeatTime++;
+        if (pSynth->repeatTime >= pSynth->repeatLimit) {
+            pSynth->repeatTime = 0;
+            bfxr_reset(pSynth, 1/*isRepeat*/);
+        }
+    }
+    pSynth->changePeriodTime++;
+    if (pSynth->changePeriodTime >= pSynth->changePeriod) {
+        pSynth->changePeriodTime = 0;
+        pSynth->changeTime = 0;
+        pSynth->changeTime2 = 0;
+    }
+    if (pSynth->changeLimit != 0) {
+        pSynth->changeTime++;
+        if (pSynth->changeTime == pSynth->changeLimit) {
+            pSynth->period *= pSynth->changeAmount;
+        }
+    }
+    if (pSynth->changeLimit2 != 0) {
+        pSynth->changeTime2++;
+        if (pSynth->changeTime2 == pSynth->changeLimit2) {
+            pSynth->period *= pSynth->changeAmount2;
+        }
+    }
+
+    /* Frequency slide and vibrato */
+    pSynth->slide += pSynth->deltaSlide;
+    pSynth->period *= pSynth->slide;
+    if (pSynth->period > pSynth->maxPeriod) {
+        pSynth->period = pSynth->maxPeriod;
+        if (pP->minFrequency > 0.0f) {
+            pSynth->isPlaying = 0;
+        }
+    }
+    periodTmp = pSynth->period;
+    if (pSynth->vibratoAmplitude > 0.0f) {
+        pSynth->vibratoPhase += pSynth->vibratoSpeed;
+        periodTmp = pSynth->period * (1.0 + sin(pSynth->vibratoPhase)
+                * pSynth->vibratoAmplitude);
+    }
+    pSynth->intPeriod = (int)periodTmp;
+    if (pSynth->intPeriod < 8) {
+        pSynth->intPeriod = 8;
+    }
+
+    if ((int)pP->waveType == BFXR_SQUARE) {
+        pSynth->squareDuty += pSynth->dutySweep;
+        if (pSynth->squareDuty < 0.0f) {
+            pSynth->squareDuty = 0.0f;
+        }
+        else if (pSynth->squareDuty > 0.5f) {
+            pSynth->squareDuty = 0.5f;
+        }
+    }
+
+    /* Volume envelope */
+    pSynth->envelopeTime++;
+    if (pSynth->envelopeTime > pSynth->pEnvelopeLength[
+            pSynth->envelopeStage]) {
+        pSynth->envelopeTime = 0;
+        pSynth->envelopeStage++;
+        if (pSynth->envelopeStage == 3) {
+            pSynth->isPlaying = 0;
+            return 0.0f;
+        }
+    }
+    switch (pSynth->envelopeStage) {
+        case 0: {
+            pSynth->envelopeVolume = (float)pSynth->envelopeTime /
+                    (float)(pSynth->pEnvelopeLength[0] + 1);
+        } break;
+        case 1: {
+            pSynth->envelopeVolume = 1.0f + (1.0f - (float)pSynth->envelopeTime
+                    / (float)(pSynth->pEnvelopeLength[1] + 1)) * 2.0f
+                    * pP->sustainPunch;
+        } break;
+        default: {
+            pSynth->envelopeVolume = 1.0f - (float)pSynth->envelopeTime /
+                    (float)pSynth->pEnvelopeLength[2];
+        }
+    }
+
+    /* Flanger and filters' sweep */
+    pSynth->flangerOffset += pSynth->flangerDeltaOffset;
+    pSynth->flangerInt = abs((int)pSynth->flangerOffset);
+    if (pSynth->flangerInt > BFXR_PHASER_LEN - 1) {
+        pSynth->flangerInt = BFXR_PHASER_LEN - 1;
+    }
+    if (pSynth->hpCutoffSweep != 1.0f) {
+        pSynth->hpCutoff *= pSynth->hpCutoffSweep;
+        if (pSynth->hpCutoff < 0.00001f) {
+            pSynth->hpCutoff = 0.00001f;
+        }
+        else if (pSynth->hpCutoff > 0.1f) {
+            pSynth->hpCutoff = 0.1f;
+        }
+    }
+
+    sample = 0.0f;
+    i = 0;
+    while (i < BFXR_SUPERSAMPLE) {
+        float lpPrev, pos, subSample;
+
+        pSynth->phase++;
+        if (pSynth->phase >= pSynth->intPeriod) {
+            pSynth->phase %= pSynth->intPeriod;
+            if ((int)pP->waveType == BFXR_NOISE) {
+                int j;
+
+                j = 0;
+                while (j < BFXR_NOISE_LEN) {
+                    pSynth->pNoiseBuffer[j] = bfxr_random(pSynth);
+                    j++;
+                }
+            }
+        }
+        pos = (float)pSynth->phase / (float)pSynth->intPeriod;
+
+        if (pSynth->overtones > 0 && (int)pP->waveType != BFXR_NOISE) {
+            float amplitude, total;
+            int k;
+
+            /* Sum every overtone, each fainter than the previous */
+            subSample = 0.0f;
+            total = 0.0f;
+            amplitude = 1.0f;
+            k = 0;
+            while (k <= pSynth->overtones) {
+                subSample += bfxr_wave(pSynth, fmodf(pos * (k + 1), 1.0f))
+                        * amplitude;
+                total += amplitude;
+                amplitude *= pSynth->overtoneFalloff;
+                k++;
+            }
+            subSample /= total;
+        }
+        else {
+            subSample = bfxr_wave(pSynth, pos);
+        }
+
+        /* Low-pass filter */
+        lpPrev = pSynth->lpPos;
+        pSynth->lpCutoff *= pSynth->lpCutoffSweep;
+        if (pSynth->lpCutoff < 0.0f) {
+            pSynth->lpCutoff = 0.0f;
+        }
+        else if (pSynth->lpCutoff > 0.1f) {
+            pSynth->lpCutoff = 0.1f;
+        }
+        if (pP->lpFilterCutoff != 1.0f) {
+            pSynth->lpDeltaPos += (subSample - pSynth->lpPos)
+                    * pSynth->lpCutoff;
+            pSynth->lpDeltaPos -= pSynth->lpDeltaPos * pSynth->lpDamping;
+        }
+        else {
+            pSynth->lpPos = subSample;
+            pSynth->lpDeltaPos = 0.0f;
+        }
+        pSynth->lpPos += pSynth->lpDeltaPos;
+
+        /* High-pass filter */
+        pSynth->hpPos += pSynth->lpPos - lpPrev;
+        pSynth->hpPos -= pSynth->hpPos * pSynth->hpCutoff;
+        subSample = pSynth->hpPos;
+
+        /* Flanger */
+        pSynth->pFlangerBuffer[pSynth->flangerPos & (BFXR_PHASER_LEN - 1)] =
+                subSample;
+        subSample += pSynth->pFlangerBuffer[(pSynth->flangerPos
+                - pSynth->flangerInt + BFXR_PHASER_LEN)
+                & (BFXR_PHASER_LEN - 1)];
+        pSynth->flangerPos = (pSynth->flangerPos + 1) & (BFXR_PHASER_LEN - 1);
+
+        sample += subSample * pSynth->envelopeVolume;
+        i++;
+    }
+    sample = sample / BFXR_SUPERSAMPLE * pP->masterVolume * pP->masterVolume;
+
+    /* Bit crush */
+    pSynth->bitCrushPhase += pSynth->bitCrushFreq;
+    if (pSynth->bitCrushPhase > 1.0f) {
+        pSynth->bitCrushPhase = 0.0f;
+        pSynth->bitCrushLast = sample;
+    }
+    pSynth->bitCrushFreq += pSynth->bitCrushFreqSweep;
+    if (pSynth->bitCrushFreq < 0.0f) {
+        pSynth->bitCrushFreq = 0.0f;
+    }
+    else if (pSynth->bitCrushFreq > 1.0f) {
+        pSynth->bitCrushFreq = 1.0f;
+    }
+    sample = pSynth->bitCrushLast;
+
+    /* Compression */
+    if (sample > 0.0f) {
+        sample = powf(sample, pSynth->compressionFactor);
+    }
+    else {
+        sample = -powf(-sample, pSynth->compressionFactor);
+    }
+
+    if (sample > 1.0f) {
+        sample = 1.0f;
+    }
+    else if (sample < -1.0f) {
+        sample = -1.0f;
+    }
+    return sample;
+}
+
+/**
+ * Render a sound
+ *
+ * @param  [out]ppSamples   The samples (must be freed by the caller)
+ * @param  [out]pNumSamples Number of samples
+ * @param  [ in]pParams     The parameters
+ */
+gfmRV bfxr_render(short **ppSamples, int *pNumSamples, bfxrParams *pParams) {
+    bfxrSynth *pSynth;
+    short *pTmp;
+    gfmRV rv;
+    int num;
+
+    *ppSamples = 0;
+    pSynth = 0;
+
+    pSynth = (bfxrSynth*)malloc(sizeof(bfxrSynth));
+    ASSERT(pSynth, GFMRV_ALLOC_FAILED);
+    memset(pSynth, 0x0, sizeof(bfxrSynth));
+    pSynth->pParams = pParams;
+    pSynth->seed = BFXR_SEED;
+    bfxr_reset(pSynth, 0/*isRepeat*/);
+
+    *ppSamples = (short*)malloc(sizeof(short) * BFXR_MAX_SAMPLES);
+    ASSERT(*ppSamples, GFMRV_ALLOC_FAILED);
+
+    num = 0;
+    while (num < BFXR_MAX_SAMPLES) {
+        float sample;
+
+        sample = bfxr_step(pSynth);
+        if (!pSynth->isPlaying) {
+            break;
+        }
+        (*ppSamples)[num] = (short)(sample * 32767.0f);
+        num++;
+    }
+    ASSERT(num > 0, GFMRV_FUNCTION_FAILED);
+
+    /* Release the unused space */
+    pTmp = (short*)realloc(*ppSamples, sizeof(short) * num);
+    if (pTmp) {
+        *ppSamples = pTmp;
+    }
+    *pNumSamples = num;
+
+    rv = GFMRV_OK;
+__ret:
+    free(pSynth);
+    if (rv != GFMRV_OK) {
+        free(*ppSamples);
+        *ppSamples = 0;
+    }
+
+    return rv;
+}
+
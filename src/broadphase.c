@@ -0,0 +1,1093 @@
+/**
+ * Collision broadphase
+ *
+ * The hash and the sweep gather every overlap as soon as an object is
+ * collided, and then report them one at a time. The hash keeps every cell's
+ * objects on a linked list of nodes (all on a single array) and cells from
+ * previous ticks are recognized by their stamp, so nothing has to be cleared
+ * between ticks. The sweep keeps two lists sorted by the objects' left edges
+ * (one for small and other for wide objects), along with the rightmost edge
+ * of every object up to each one, so it may stop searching as soon as nothing
+ * to the left can overlap. New small objects are kept on a short (and also
+ * sorted) list, merged into the main one once it's full.
+ *
+ * Swept objects are simply added with bounds covering their whole path. The
+ * quadtree's proxies are objects kept on a pool (so they aren't alloc'ed
+ * every tick), whose child is the object they stand for.
+ *
+ * Settings are compared by the work they did (objects tested, hash cells
+ * visited and sweep entries merged) rather than by how long they took, so
+ * the same scene always picks the same setting (and thus, reports its pairs
+ * in the same order) regardless of the machine's load. GFraMe's quadtree
+ * only reports the pairs it found (and not how many objects it tested to find
+ * them), so it isn't tuned: it's only used when explicitly requested, and
+ * then with the setting the game always used.
+ *
+ * @file src/broadphase.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmObject.h>
+#include <GFraMe/gfmQuadtree.h>
+#include <GFraMe/gfmSprite.h>
+
+#include <ld34/broadphase.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial length of every buffer */
+#define BROADPHASE_INIT_LEN 256
+/** Objects wider than this (in pixels) are kept on their own list by the
+ * sweep */
+#define BROADPHASE_SWEEP_WIDE 64
+/** Objects added to the sweep before they are merged into its list */
+#define BROADPHASE_SWEEP_PENDING 64
+
+/** How a backend may be set up */
+struct stBroadphaseSetting {
+    /** The backend */
+    broadphaseType type;
+    /** Quadtree's maximum depth */
+    int maxDepth;
+    /** Quadtree's maximum number of objects on a node before it's split */
+    int maxNodes;
+    /** Hash's cells dimensions, in pixels */
+    int cellSize;
+};
+typedef struct stBroadphaseSetting broadphaseSetting;
+
+static const broadphaseSetting broadphase_pSettings[] = {
+    /* What the game always used */
+    { BROADPHASE_QUADTREE, 6, 10, 0 },
+    /* Two tiles (as most sprites), a large sprite and a few sprites */
+    { BROADPHASE_HASH, 0, 0, 16 },
+    { BROADPHASE_HASH, 0, 0, 32 },
+    { BROADPHASE_HASH, 0, 0, 64 },
+    { BROADPHASE_SWEEP, 0, 0, 0 },
+};
+#define BROADPHASE_NUM_SETTINGS (int)(sizeof(broadphase_pSettings) / \
+        sizeof(broadphaseSetting))
+
+static const char *broadphase_pNames[BROADPHASE_NUM_TYPES] = { "auto",
+        "quadtree", "hash", "sweep" };
+
+/** An object added on the current tick */
+struct stBroadphaseEntry {
+    gfmObject *pObj;
+    /** Bounds, in pixels (with the right and bottom edges exclusive) */
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    /** Sweep: Rightmost edge of every object on the list up to this one */
+    int maxX1;
+    /** Hash: Last query that tested this object */
+    int query;
+};
+typedef struct stBroadphaseEntry broadphaseEntry;
+
+/** One of the sweep's lists */
+struct stBroadphaseList {
+    /** Every object, sorted by its left edge */
+    broadphaseEntry *pEntries;
+    int len;
+    int used;
+};
+typedef struct stBroadphaseList broadphaseList;
+
+/** An object on one of the hash's cells */
+struct stBroadphaseNode {
+    /** Index of the object */
+    int entry;
+    /** Next node on the same cell (or -1) */
+    int next;
+};
+typedef struct stBroadphaseNode broadphaseNode;
+
+struct stBroadphase {
+    /** GFraMe's quadtree */
+    gfmQuadtreeRoot *pQt;
+    /** Quadtree: Proxies of swept objects */
+    gfmObject **ppProxies;
+    int proxiesLen;
+    int proxiesUsed;
+
+    /** Hash: Every object added on this tick */
+    broadphaseEntry *pEntries;
+    int entriesLen;
+    int entriesUsed;
+    /** Hash: Every object on every cell */
+    broadphaseNode *pNodes;
+    int nodesLen;
+    int nodesUsed;
+    /** Hash: First node on each cell (only valid if stamped this tick) */
+    int *pHeads;
+    /** Hash: Tick on which each cell was last used */
+    int *pStamps;
+    int cellsLen;
+    /** Hash: Grid's dimensions, in cells */
+    int cols;
+    int rows;
+    /** Hash: Grid's position, in pixels */
+    int x;
+    int y;
+    /** Hash: Incremented on every collision, to test each object only once */
+    int query;
+
+    /** Sweep: Objects no wider than BROADPHASE_SWEEP_WIDE */
+    broadphaseList narrow;
+    /** Sweep: Every wider object (e.g., the floor) */
+    broadphaseList wide;
+    /** Sweep: Small objects not yet merged into their list */
+    broadphaseList pending;
+
+    /** Hash and sweep: Object being collided */
+    gfmObject *pSelf;
+    /** Hash and sweep: Every object it overlaps */
+    gfmObject **ppOverlaps;
+    int overlapsLen;
+    int overlapsUsed;
+    /** Hash and sweep: Overlap currently reported */
+    int curOverlap;
+
+    /** Requested backend */
+    broadphaseType type;
+    /** Setting in use */
+    int setting;
+    /** Number of settings of the requested backend */
+    int numCandidates;
+    /** Incremented on every reset */
+    int tick;
+    /** Number of objects added on the current tick */
+    int numObjects;
+    /** Whether settings are being tried */
+    int isTuning;
+    /** Ticks run on the current setting while tuning */
+    int trialTicks;
+    /** Work done on the current setting while tuning (see above) */
+    double trialCost;
+    /** Objects added while tuning */
+    int trialObjects;
+    /** Average work per tick of every setting tried */
+    double pCosts[BROADPHASE_NUM_SETTINGS];
+    /** Average objects per tick when tuning last finished */
+    int tunedObjects;
+    /** Ticks since objects were last counted (when not tuning) */
+    int windowTicks;
+    /** Objects added since objects were last counted (when not tuning) */
+    int windowObjects;
+};
+
+/**
+ * Expand a buffer, if needed
+ *
+ * @param  [ in]pBuf   The buffer
+ * @param  [ in]pLen   The buffer's length (updated if it's expanded)
+ * @param  [ in]needed Minimum number of elements
+ * @param  [ in]size   Size of each element
+ * @return             The (possibly moved) buffer, or NULL on failure
+ */
+static void* broadphase_grow(void *pBuf, int *pLen, int needed, size_t size) {
+    void *pTmp;
+    int len;
+
+    if (needed <= *pLen) {
+        return pBuf;
+    }
+
+    len = *pLen * 2;
+    if (len < BROADPHASE_INIT_LEN) {
+        len = BROADPHASE_INIT_LEN;
+    }
+    while (len < needed) {
+        len *= 2;
+    }
+    pTmp = realloc(pBuf, size * len);
+    if (pTmp) {
+        *pLen = len;
+    }
+
+    return pTmp;
+}
+
+/**
+ * Find the next setting of the requested backend (the quadtree isn't tried
+ * automatically, as it isn't tuned)
+ *
+ * @param  [ in]pCtx  The broadphase
+ * @param  [ in]first First setting checked
+ * @return            The setting, or -1 if there's none
+ */
+static int broadphase_nextSetting(broadphase *pCtx, int first) {
+    while (first < BROADPHASE_NUM_SETTINGS) {
+        broadphaseType type;
+
+        type = broadphase_pSettings[first].type;
+        if (type == pCtx->type || (pCtx->type == BROADPHASE_AUTO &&
+                type != BROADPHASE_QUADTREE)) {
+            return first;
+        }
+        first++;
+    }
+
+    return -1;
+}
+
+/**
+ * Alloc the broadphase
+ *
+ * @param  [out]ppCtx The broadphase
+ * @param  [ in]type  Backend used (or BROADPHASE_AUTO)
+ */
+gfmRV broadphase_init(broadphase **ppCtx, broadphaseType type) {
+    broadphase *pCtx;
+    gfmRV rv;
+    int i;
+
+    *ppCtx = 0;
+    ASSERT(type >= BROADPHASE_AUTO && type < BROADPHASE_NUM_TYPES,
+            GFMRV_ARGUMENTS_BAD);
+
+    pCtx = (broadphase*)malloc(sizeof(broadphase));
+    ASSERT(pCtx, GFMRV_ALLOC_FAILED);
+    memset(pCtx, 0x0, sizeof(broadphase));
+    *ppCtx = pCtx;
+
+    rv = gfmQuadtree_getNew(&(pCtx->pQt));
+    ASSERT(rv == GFMRV_OK, rv);
+    pCtx->pending.pEntries = (broadphaseEntry*)malloc(sizeof(broadphaseEntry)
+            * BROADPHASE_SWEEP_PENDING);
+    ASSERT(pCtx->pending.pEntries, GFMRV_ALLOC_FAILED);
+    pCtx->pending.len = BROADPHASE_SWEEP_PENDING;
+
+    pCtx->type = type;
+    pCtx->setting = broadphase_nextSetting(pCtx, 0);
+    i = pCtx->setting;
+    while (i != -1) {
+        pCtx->numCandidates++;
+        i = broadphase_nextSetting(pCtx, i + 1);
+    }
+    pCtx->isTuning = (pCtx->numCandidates > 1);
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK) {
+        broadphase_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Release the broadphase
+ *
+ * @param  [ in]ppCtx The broadphase
+ */
+void broadphase_clean(broadphase **ppCtx) {
+    broadphase *pCtx;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+    pCtx = *ppCtx;
+
+    if (pCtx->pQt) {
+        gfmQuadtree_free(&(pCtx->pQt));
+    }
+    while (pCtx->proxiesLen > 0) {
+        pCtx->proxiesLen--;
+        gfmObject_free(&(pCtx->ppProxies[pCtx->proxiesLen]));
+    }
+    free(pCtx->ppProxies);
+    free(pCtx->pEntries);
+    free(pCtx->pNodes);
+    free(pCtx->pHeads);
+    free(pCtx->pStamps);
+    free(pCtx->narrow.pEntries);
+    free(pCtx->wide.pEntries);
+    free(pCtx->pending.pEntries);
+    free(pCtx->ppOverlaps);
+
+    free(pCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Retrieve a backend's name
+ *
+ * @param  [ in]type The backend
+ * @return           The name (as accepted on the command line)
+ */
+const char* broadphase_getName(broadphaseType type) {
+    if (type < BROADPHASE_AUTO || type >= BROADPHASE_NUM_TYPES) {
+        return "?";
+    }
+    return broadphase_pNames[type];
+}
+
+/**
+ * Account for the tick that just finished and, if every setting was tried,
+ * keep the one that did the least work; If the number of objects changed too
+ * much since, try them again
+ *
+ * @param  [ in]pCtx The broadphase
+ */
+static void broadphase_tune(broadphase *pCtx) {
+    if (pCtx->isTuning) {
+        pCtx->trialTicks++;
+        pCtx->trialObjects += pCtx->numObjects;
+        if (pCtx->trialTicks == 1) {
+            /* Ignore the first tick, as buffers are expanded on it */
+            pCtx->trialCost = 0;
+        }
+        else if (pCtx->trialTicks > BROADPHASE_TRIAL_TICKS) {
+            int i;
+
+            pCtx->pCosts[pCtx->setting] = pCtx->trialCost /
+                    BROADPHASE_TRIAL_TICKS;
+            pCtx->setting = broadphase_nextSetting(pCtx, pCtx->setting + 1);
+            pCtx->trialTicks = 0;
+            pCtx->trialCost = 0;
+            if (pCtx->setting != -1) {
+                return;
+            }
+
+            /* Every setting was tried */
+            pCtx->setting = broadphase_nextSetting(pCtx, 0);
+            i = broadphase_nextSetting(pCtx, pCtx->setting + 1);
+            while (i != -1) {
+                if (pCtx->pCosts[i] < pCtx->pCosts[pCtx->setting]) {
+                    pCtx->setting = i;
+                }
+                i = broadphase_nextSetting(pCtx, i + 1);
+            }
+            pCtx->tunedObjects = pCtx->trialObjects / (pCtx->numCandidates *
+                    (BROADPHASE_TRIAL_TICKS + 1));
+            pCtx->isTuning = 0;
+            pCtx->windowTicks = 0;
+            pCtx->windowObjects = 0;
+        }
+    }
+    else if (pCtx->numCandidates > 1) {
+        pCtx->windowTicks++;
+        pCtx->windowObjects += pCtx->numObjects;
+        if (pCtx->windowTicks >= BROADPHASE_TRIAL_TICKS) {
+            int avg;
+
+            avg = pCtx->windowObjects / pCtx->windowTicks;
+            if (abs(avg - pCtx->tunedObjects) >= BROADPHASE_RETUNE_MIN &&
+                    (avg > pCtx->tunedObjects * BROADPHASE_RETUNE_FACTOR ||
+                    avg * BROADPHASE_RETUNE_FACTOR < pCtx->tunedObjects)) {
+                pCtx->setting = broadphase_nextSetting(pCtx, 0);
+                pCtx->isTuning = 1;
+                pCtx->trialTicks = 0;
+                pCtx->trialCost = 0;
+                pCtx->trialObjects = 0;
+            }
+            pCtx->windowTicks = 0;
+            pCtx->windowObjects = 0;
+        }
+    }
+}
+
+/**
+ * Remove every object and start a new tick; If the broadphase is being tuned,
+ * this is when the setting changes
+ *
+ * @param  [ in]pCtx   The broadphase
+ * @param  [ in]x      World's horizontal position
+ * @param  [ in]y      World's vertical position
+ * @param  [ in]width  World's width
+ * @param  [ in]height World's height
+ */
+gfmRV broadphase_reset(broadphase *pCtx, int x, int y, int width,
+        int height) {
+    const broadphaseSetting *pSetting;
+    gfmRV rv;
+
+    if (pCtx->tick > 0) {
+        broadphase_tune(pCtx);
+    }
+    pCtx->tick++;
+    pCtx->numObjects = 0;
+    pCtx->overlapsUsed = 0;
+    pCtx->curOverlap = 0;
+
+    pSetting = broadphase_pSettings + pCtx->setting;
+    switch (pSetting->type) {
+        case BROADPHASE_QUADTREE: {
+            rv = gfmQuadtree_initRoot(pCtx->pQt, x, y, width, height,
+                    pSetting->maxDepth, pSetting->maxNodes);
+            ASSERT(rv == GFMRV_OK, rv);
+            pCtx->proxiesUsed = 0;
+        } break;
+        case BROADPHASE_HASH: {
+            int num;
+
+            pCtx->cols = width / pSetting->cellSize + 1;
+            pCtx->rows = height / pSetting->cellSize + 1;
+            pCtx->x = x;
+            pCtx->y = y;
+            num = pCtx->cols * pCtx->rows;
+            if (num > pCtx->cellsLen) {
+                int *pTmp;
+
+                pTmp = (int*)realloc(pCtx->pHeads, sizeof(int) * num);
+                ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+                pCtx->pHeads = pTmp;
+                pTmp = (int*)realloc(pCtx->pStamps, sizeof(int) * num);
+                ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+                pCtx->pStamps = pTmp;
+                memset(pCtx->pStamps, 0x0, sizeof(int) * num);
+                pCtx->cellsLen = num;
+            }
+            pCtx->entriesUsed = 0;
+            pCtx->nodesUsed = 0;
+        } break;
+        default: {
+            pCtx->narrow.used = 0;
+            pCtx->wide.used = 0;
+            pCtx->pending.used = 0;
+        }
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Test two objects and store the second one if they overlap (or touch)
+ *
+ * @param  [ in]pCtx   The broadphase
+ * @param  [ in]pSelf  The object being collided
+ * @param  [ in]pOther An object already added
+ */
+static gfmRV broadphase_test(broadphase *pCtx, broadphaseEntry *pSelf,
+        broadphaseEntry *pOther) {
+    gfmObject **ppTmp;
+    gfmRV rv;
+
+    pCtx->trialCost++;
+    if (pSelf->x0 > pOther->x1 || pOther->x0 > pSelf->x1 ||
+            pSelf->y0 > pOther->y1 || pOther->y0 > pSelf->y1) {
+        return GFMRV_OK;
+    }
+
+    ppTmp = (gfmObject**)broadphase_grow(pCtx->ppOverlaps,
+            &(pCtx->overlapsLen), pCtx->overlapsUsed + 1, sizeof(gfmObject*));
+    ASSERT(ppTmp, GFMRV_ALLOC_FAILED);
+    pCtx->ppOverlaps = ppTmp;
+    pCtx->ppOverlaps[pCtx->overlapsUsed] = pOther->pObj;
+    pCtx->overlapsUsed++;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Convert a position into a cell, clamped to the grid
+ *
+ * @param  [ in]pos  The position, relative to the grid
+ * @param  [ in]size The cells' dimensions
+ * @param  [ in]num  Number of cells
+ */
+static inline int broadphase_getCell(int pos, int size, int num) {
+    if (pos < 0) {
+        return 0;
+    }
+    else if (pos / size >= num) {
+        return num - 1;
+    }
+    return pos / size;
+}
+
+/**
+ * Add an object to the hash
+ *
+ * @param  [ in]pCtx   The broadphase
+ * @param  [ in]pEnt   The object
+ * @param  [ in]doTest Whether it should be tested against every other object
+ */
+static gfmRV broadphase_hashAdd(broadphase *pCtx, broadphaseEntry *pEnt,
+        int doTest) {
+    broadphaseEntry *pSelf;
+    void *pTmp;
+    gfmRV rv;
+    int cx, cx0, cx1, cy, cy0, cy1, entry, size;
+
+    size = broadphase_pSettings[pCtx->setting].cellSize;
+    cx0 = broadphase_getCell(pEnt->x0 - pCtx->x, size, pCtx->cols);
+    cx1 = broadphase_getCell(pEnt->x1 - pCtx->x, size, pCtx->cols);
+    cy0 = broadphase_getCell(pEnt->y0 - pCtx->y, size, pCtx->rows);
+    cy1 = broadphase_getCell(pEnt->y1 - pCtx->y, size, pCtx->rows);
+
+    pTmp = broadphase_grow(pCtx->pEntries, &(pCtx->entriesLen),
+            pCtx->entriesUsed + 1, sizeof(broadphaseEntry));
+    ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+    pCtx->pEntries = (broadphaseEntry*)pTmp;
+    pTmp = broadphase_grow(pCtx->pNodes, &(pCtx->nodesLen),
+            pCtx->nodesUsed + (cx1 - cx0 + 1) * (cy1 - cy0 + 1),
+            sizeof(broadphaseNode));
+    ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+    pCtx->pNodes = (broadphaseNode*)pTmp;
+
+    entry = pCtx->entriesUsed;
+    pCtx->entriesUsed++;
+    pCtx->query++;
+    pSelf = pCtx->pEntries + entry;
+    *pSelf = *pEnt;
+    pSelf->query = pCtx->query;
+
+    cy = cy0;
+    while (cy <= cy1) {
+        cx = cx0;
+        while (cx <= cx1) {
+            int cell, i;
+
+            cell = cy * pCtx->cols + cx;
+            pCtx->trialCost++;
+            if (pCtx->pStamps[cell] != pCtx->tick) {
+                pCtx->pStamps[cell] = pCtx->tick;
+                pCtx->pHeads[cell] = -1;
+            }
+
+            i = pCtx->pHeads[cell];
+            while (doTest && i != -1) {
+                broadphaseEntry *pOther;
+
+                /* Objects on many cells are tested only once */
+                pOther = pCtx->pEntries + pCtx->pNodes[i].entry;
+                if (pOther->query != pCtx->query) {
+                    pOther->query = pCtx->query;
+                    rv = broadphase_test(pCtx, pSelf, pOther);
+                    ASSERT(rv == GFMRV_OK, rv);
+                }
+                else {
+                    pCtx->trialCost++;
+                }
+                i = pCtx->pNodes[i].next;
+            }
+
+            pCtx->pNodes[pCtx->nodesUsed].entry = entry;
+            pCtx->pNodes[pCtx->nodesUsed].next = pCtx->pHeads[cell];
+            pCtx->pHeads[cell] = pCtx->nodesUsed;
+            pCtx->nodesUsed++;
+
+            cx++;
+        }
+        cy++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Find the first object on a sweep's list at or to the right of a position
+ *
+ * @param  [ in]pList The list
+ * @param  [ in]x     The position
+ */
+static int broadphase_sweepFind(broadphaseList *pList, int x) {
+    int first, last;
+
+    first = 0;
+    last = pList->used;
+    while (first < last) {
+        int mid;
+
+        mid = (first + last) / 2;
+        if (pList->pEntries[mid].x0 < x) {
+            first = mid + 1;
+        }
+        else {
+            last = mid;
+        }
+    }
+
+    return first;
+}
+
+/**
+ * Update the rightmost edge of every object on a sweep's list
+ *
+ * @param  [ in]pList The list
+ * @param  [ in]first First modified object
+ */
+static void broadphase_sweepFix(broadphaseList *pList, int first) {
+    while (first < pList->used) {
+        broadphaseEntry *pEnt;
+
+        pEnt = pList->pEntries + first;
+        pEnt->maxX1 = pEnt->x1;
+        if (first > 0 && pEnt[-1].maxX1 > pEnt->maxX1) {
+            pEnt->maxX1 = pEnt[-1].maxX1;
+        }
+        first++;
+    }
+}
+
+/**
+ * Test an object against every object on a sweep's list
+ *
+ * @param  [ in]pCtx  The broadphase
+ * @param  [ in]pList The list
+ * @param  [ in]pEnt  The object
+ */
+static gfmRV broadphase_sweepQuery(broadphase *pCtx, broadphaseList *pList,
+        broadphaseEntry *pEnt) {
+    gfmRV rv;
+    int i;
+
+    /* Walk left from the last object that starts before this one ends, until
+     * nothing to the left reaches it */
+    i = broadphase_sweepFind(pList, pEnt->x1 + 1) - 1;
+    while (i >= 0 && pList->pEntries[i].maxX1 >= pEnt->x0) {
+        rv = broadphase_test(pCtx, pEnt, pList->pEntries + i);
+        ASSERT(rv == GFMRV_OK, rv);
+        i--;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Insert an object on a sweep's list
+ *
+ * @param  [ in]pList The list
+ * @param  [ in]pEnt  The object
+ */
+static gfmRV broadphase_sweepInsert(broadphaseList *pList,
+        broadphaseEntry *pEnt) {
+    broadphaseEntry *pTmp;
+    gfmRV rv;
+    int i;
+
+    pTmp = (broadphaseEntry*)broadphase_grow(pList->pEntries, &(pList->len),
+            pList->used + 1, sizeof(broadphaseEntry));
+    ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+    pList->pEntries = pTmp;
+
+    i = broadphase_sweepFind(pList, pEnt->x0);
+    memmove(pList->pEntries + i + 1, pList->pEntries + i,
+            sizeof(broadphaseEntry) * (pList->used - i));
+    pList->pEntries[i] = *pEnt;
+    pList->used++;
+    broadphase_sweepFix(pList, i);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Merge every pending object into the list of small objects
+ *
+ * @param  [ in]pCtx The broadphase
+ */
+static gfmRV broadphase_sweepMerge(broadphase *pCtx) {
+    broadphaseEntry *pPending, *pTmp;
+    broadphaseList *pList;
+    gfmRV rv;
+    int i, j, k;
+
+    pList = &(pCtx->narrow);
+    pPending = pCtx->pending.pEntries;
+    pTmp = (broadphaseEntry*)broadphase_grow(pList->pEntries, &(pList->len),
+            pList->used + pCtx->pending.used, sizeof(broadphaseEntry));
+    ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+    pList->pEntries = pTmp;
+
+    /* Both are sorted, so merge them from the end */
+    i = pList->used - 1;
+    j = pCtx->pending.used - 1;
+    k = pList->used + pCtx->pending.used - 1;
+    while (j >= 0) {
+        if (i >= 0 && pList->pEntries[i].x0 > pPending[j].x0) {
+            pList->pEntries[k] = pList->pEntries[i];
+            i--;
+        }
+        else {
+            pList->pEntries[k] = pPending[j];
+            j--;
+        }
+        k--;
+    }
+    pCtx->trialCost += pList->used - (i + 1) + pCtx->pending.used;
+    pList->used += pCtx->pending.used;
+    pCtx->pending.used = 0;
+    broadphase_sweepFix(pList, i + 1);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Add an object to the sweep
+ *
+ * @param  [ in]pCtx   The broadphase
+ * @param  [ in]pEnt   The object
+ * @param  [ in]doTest Whether it should be tested against every other object
+ */
+static gfmRV broadphase_sweepAdd(broadphase *pCtx, broadphaseEntry *pEnt,
+        int doTest) {
+    gfmRV rv;
+
+    if (doTest) {
+        rv = broadphase_sweepQuery(pCtx, &(pCtx->wide), pEnt);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = broadphase_sweepQuery(pCtx, &(pCtx->narrow), pEnt);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = broadphase_sweepQuery(pCtx, &(pCtx->pending), pEnt);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    if (pEnt->x1 - pEnt->x0 > BROADPHASE_SWEEP_WIDE) {
+        rv = broadphase_sweepInsert(&(pCtx->wide), pEnt);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+    else {
+        if (pCtx->pending.used >= BROADPHASE_SWEEP_PENDING) {
+            rv = broadphase_sweepMerge(pCtx);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        rv = broadphase_sweepInsert(&(pCtx->pending), pEnt);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve an object's bounds
+ *
+ * @param  [out]pEnt The bounds
+ * @param  [ in]pObj The object
+ */
+static gfmRV broadphase_getEntry(broadphaseEntry *pEnt, gfmObject *pObj) {
+    gfmRV rv;
+    int height, width;
+
+    rv = gfmObject_getPosition(&(pEnt->x0), &(pEnt->y0), pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getDimensions(&width, &height, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    pEnt->pObj = pObj;
+    pEnt->x1 = pEnt->x0 + width;
+    pEnt->y1 = pEnt->y0 + height;
+    pEnt->maxX1 = pEnt->x1;
+    pEnt->query = 0;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve a proxy covering a swept object's path, to be added to the
+ * quadtree
+ *
+ * @param  [out]ppProxy The proxy
+ * @param  [ in]pCtx    The broadphase
+ * @param  [ in]pEnt    The object's (swept) bounds
+ */
+static gfmRV broadphase_getProxy(gfmObject **ppProxy, broadphase *pCtx,
+        broadphaseEntry *pEnt) {
+    gfmObject *pProxy;
+    gfmRV rv;
+
+    if (pCtx->proxiesUsed >= pCtx->proxiesLen) {
+        gfmObject **ppTmp;
+        int len;
+
+        len = pCtx->proxiesLen;
+        ppTmp = (gfmObject**)broadphase_grow(pCtx->ppProxies, &len,
+                pCtx->proxiesUsed + 1, sizeof(gfmObject*));
+        ASSERT(ppTmp, GFMRV_ALLOC_FAILED);
+        pCtx->ppProxies = ppTmp;
+        while (pCtx->proxiesLen < len) {
+            rv = gfmObject_getNew(&(pCtx->ppProxies[pCtx->proxiesLen]));
+            ASSERT(rv == GFMRV_OK, rv);
+            pCtx->proxiesLen++;
+        }
+    }
+
+    pProxy = pCtx->ppProxies[pCtx->proxiesUsed];
+    pCtx->proxiesUsed++;
+    rv = gfmObject_init(pProxy, pEnt->x0, pEnt->y0, pEnt->x1 - pEnt->x0,
+            pEnt->y1 - pEnt->y0, pEnt->pObj, BROADPHASE_PROXY);
+    ASSERT(rv == GFMRV_OK, rv);
+    *ppProxy = pProxy;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Add an object to the current backend
+ *
+ * @param  [ in]pCtx    The broadphase
+ * @param  [ in]pEnt    The object and its bounds
+ * @param  [ in]isSwept Whether the bounds cover more than the object
+ * @param  [ in]doTest  Whether it should be tested against every other
+ *                      object
+ * @return              GFMRV_OK (if not tested), GFMRV_QUADTREE_OVERLAPED,
+ *                      GFMRV_QUADTREE_DONE, ...
+ */
+static gfmRV broadphase_add(broadphase *pCtx, broadphaseEntry *pEnt,
+        int isSwept, int doTest) {
+    broadphaseType type;
+    gfmObject *pObj;
+    gfmRV rv;
+
+    pCtx->numObjects++;
+    pCtx->overlapsUsed = 0;
+    pCtx->curOverlap = 0;
+    pCtx->pSelf = pEnt->pObj;
+
+    pObj = pEnt->pObj;
+    type = broadphase_pSettings[pCtx->setting].type;
+    if (type == BROADPHASE_QUADTREE && isSwept) {
+        rv = broadphase_getProxy(&pObj, pCtx, pEnt);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    if (type == BROADPHASE_QUADTREE && doTest) {
+        rv = gfmQuadtree_collideObject(pCtx->pQt, pObj);
+    }
+    else if (type == BROADPHASE_QUADTREE) {
+        rv = gfmQuadtree_populateObject(pCtx->pQt, pObj);
+    }
+    else {
+        if (type == BROADPHASE_HASH) {
+            rv = broadphase_hashAdd(pCtx, pEnt, doTest);
+        }
+        else {
+            rv = broadphase_sweepAdd(pCtx, pEnt, doTest);
+        }
+        ASSERT(rv == GFMRV_OK, rv);
+
+        if (doTest && pCtx->overlapsUsed > 0) {
+            rv = GFMRV_QUADTREE_OVERLAPED;
+        }
+        else if (doTest) {
+            rv = GFMRV_QUADTREE_DONE;
+        }
+    }
+
+__ret:
+    return rv;
+}
+
+/**
+ * Add an object without testing it (e.g., because it's static)
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pObj The object
+ */
+gfmRV broadphase_populateObject(broadphase *pCtx, gfmObject *pObj) {
+    broadphaseEntry ent;
+    gfmRV rv;
+
+    rv = broadphase_getEntry(&ent, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = broadphase_add(pCtx, &ent, 0/*isSwept*/, 0/*doTest*/);
+__ret:
+    return rv;
+}
+
+/**
+ * Test an object against every other one and add it
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pObj The object
+ * @return           GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_collideObject(broadphase *pCtx, gfmObject *pObj) {
+    broadphaseEntry ent;
+    gfmRV rv;
+
+    rv = broadphase_getEntry(&ent, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = broadphase_add(pCtx, &ent, 0/*isSwept*/, 1/*doTest*/);
+__ret:
+    return rv;
+}
+
+/**
+ * Test a sprite against every other object and add it
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pSpr The sprite
+ * @return           GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_collideSprite(broadphase *pCtx, gfmSprite *pSpr) {
+    gfmObject *pObj;
+    gfmRV rv;
+
+    rv = gfmSprite_getObject(&pObj, pSpr);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = broadphase_collideObject(pCtx, pObj);
+__ret:
+    return rv;
+}
+
+/**
+ * Test an object, over the whole path it moved on this tick, against every
+ * other object and add it
+ *
+ * @param  [ in]pCtx  The broadphase
+ * @param  [ in]pObj  The object
+ * @param  [ in]lastX Horizontal position at the start of the tick
+ * @param  [ in]lastY Vertical position at the start of the tick
+ * @return            GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_collideSwept(broadphase *pCtx, gfmObject *pObj, int lastX,
+        int lastY) {
+    broadphaseEntry ent;
+    gfmRV rv;
+    int dx, dy;
+
+    rv = broadphase_getEntry(&ent, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    dx = lastX - ent.x0;
+    dy = lastY - ent.y0;
+    if (dx < 0) {
+        ent.x0 += dx;
+    }
+    else {
+        ent.x1 += dx;
+    }
+    if (dy < 0) {
+        ent.y0 += dy;
+    }
+    else {
+        ent.y1 += dy;
+    }
+    ent.maxX1 = ent.x1;
+
+    rv = broadphase_add(pCtx, &ent, (dx != 0 || dy != 0), 1/*doTest*/);
+__ret:
+    return rv;
+}
+
+/**
+ * Replace a quadtree's proxy by the object it stands for
+ *
+ * @param  [ in]ppObj The object (modified only if it's a proxy)
+ */
+static gfmRV broadphase_unproxy(gfmObject **ppObj) {
+    gfmRV rv;
+    void *pChild;
+    int type;
+
+    rv = gfmObject_getChild(&pChild, &type, *ppObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    if (type == BROADPHASE_PROXY) {
+        *ppObj = (gfmObject*)pChild;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve the current overlap
+ *
+ * @param  [out]ppObj1 The object being collided
+ * @param  [out]ppObj2 The object it overlaps
+ * @param  [ in]pCtx   The broadphase
+ */
+gfmRV broadphase_getOverlaping(gfmObject **ppObj1, gfmObject **ppObj2,
+        broadphase *pCtx) {
+    gfmRV rv;
+
+    if (broadphase_pSettings[pCtx->setting].type == BROADPHASE_QUADTREE) {
+        rv = gfmQuadtree_getOverlaping(ppObj1, ppObj2, pCtx->pQt);
+        ASSERT(rv == GFMRV_OK, rv);
+        if (pCtx->proxiesUsed > 0) {
+            rv = broadphase_unproxy(ppObj1);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = broadphase_unproxy(ppObj2);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        return GFMRV_OK;
+    }
+
+    ASSERT(pCtx->curOverlap < pCtx->overlapsUsed, GFMRV_OPERATION_NOT_ACTIVE);
+    *ppObj1 = pCtx->pSelf;
+    *ppObj2 = pCtx->ppOverlaps[pCtx->curOverlap];
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Move to the next overlap
+ *
+ * @param  [ in]pCtx The broadphase
+ * @return           GFMRV_QUADTREE_OVERLAPED, GFMRV_QUADTREE_DONE, ...
+ */
+gfmRV broadphase_continue(broadphase *pCtx) {
+
+    if (broadphase_pSettings[pCtx->setting].type != BROADPHASE_QUADTREE) {
+        pCtx->curOverlap++;
+        if (pCtx->curOverlap < pCtx->overlapsUsed) {
+            return GFMRV_QUADTREE_OVERLAPED;
+        }
+        return GFMRV_QUADTREE_DONE;
+    }
+
+    /* The quadtree searches for the next overlap only now */
+    return gfmQuadtree_continue(pCtx->pQt);
+}
+
+/**
+ * Draw the broadphase's structure (only the quadtree has any)
+ *
+ * @param  [ in]pCtx The broadphase
+ * @param  [ in]pGfm GFraMe's context
+ */
+gfmRV broadphase_drawBounds(broadphase *pCtx, gfmCtx *pGfm) {
+    if (broadphase_pSettings[pCtx->setting].type != BROADPHASE_QUADTREE) {
+        return GFMRV_OK;
+    }
+    return gfmQuadtree_drawBounds(pCtx->pQt, pGfm, 0);
+}
+
+/**
+ * Retrieve the setting currently in use
+ *
+ * @param  [out]pType     The backend
+ * @param  [out]pParam    The quadtree's maximum depth or the hash's cell size
+ *                        (0, for the sweep)
+ * @param  [out]pIsTuning Whether settings are still being tried
+ * @param  [ in]pCtx      The broadphase
+ */
+void broadphase_getSetting(broadphaseType *pType, int *pParam, int *pIsTuning,
+        broadphase *pCtx) {
+    const broadphaseSetting *pSetting;
+
+    pSetting = broadphase_pSettings + pCtx->setting;
+    *pType = pSetting->type;
+    *pParam = pSetting->maxDepth + pSetting->cellSize;
+    *pIsTuning = pCtx->isTuning;
+}
+
@@ -0,0 +1,50 @@
+/**
+ * High resolution, monotonic clock
+ *
+ * @file src/clock.c
+ */
+#include <ld34/clock.h>
+
+#if defined(__WIN32) || defined(__WIN32__)
+#  include <windows.h>
+#else
+#  include <time.h>
+#  include <unistd.h>
+#endif
+
+/**
+ * Retrieve the time since an arbitrary point, in milliseconds
+ */
+double clock_getTime() {
+#if defined(__WIN32) || defined(__WIN32__)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+
+    return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1000000.0;
+#endif
+}
+
+/**
+ * Suspend the calling thread
+ *
+ * @param  [ in]ms For how long, in milliseconds
+ */
+void clock_sleep(int ms) {
+#if defined(__WIN32) || defined(__WIN32__)
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
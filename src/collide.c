@@ -1,28 +1,163 @@
 /**
  * Handle collisions
  *
+ * Legs, bullets and props are swept: they are collided over the whole path
+ * they moved on the tick, and a pair that overlapped only during the tick
+ * (e.g., a bullet that went through a leg) is moved back to where it first
+ * touched before being responded to.
+ *
+ * Pairs are only ordered within a batch: every collide_resolve (i.e., each
+ * collide_run, or a whole pool's spritePool_collide) responds to the pairs
+ * collected since the last one in the order they first touched, so a falling
+ * leg lands on the first floor on its way. Batches themselves run in the
+ * order the game state collides its objects (bullets, props, the player,
+ * enemies...), and each one sees the responses of the previous ones; An
+ * earlier batch's pair is responded to first, even if a later batch's pair
+ * touched before it on the tick.
+ *
+ * Props touching each other aren't responded to right away. Their contacts
+ * are gathered and, after every other pair was responded to, solved
+ * together: a few passes push the props apart (sleeping props and props on
+ * the floor act as supports), their velocities along each contact are
+ * merged and everything is written back at once. A sleeping prop hit hard
+ * enough (or pushed deep enough) is woken and solved as any other prop.
+ *
+ * The player is a single compound body on the broadphase. Each overlap it
+ * reports is only then split into pairs for the limbs that may touch the
+ * other object (so the limbs are never tested against each other).
+ *
  * @file src/collide.c
  */
 #include <GFraMe/gfmAssert.h>
 #include <GFraMe/gfmError.h>
 #include <GFraMe/gfmObject.h>
-#include <GFraMe/gfmQuadtree.h>
 #include <GFraMe/gfmSave.h>
 #include <GFraMe/gfmSprite.h>
 #include <GFraMe/gfmSpriteset.h>
 
+#include <ld34/broadphase.h>
 #include <ld34/collide.h>
 #include <ld34/enemy.h>
 #include <ld34/game.h>
+#include <ld34/jobs.h>
+#include <ld34/mixer.h>
+#include <ld34/particles.h>
 #include <ld34/player.h>
+#include <ld34/spritePool.h>
 #include <ld34/textManager.h>
 
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if defined(DEBUG) && !(defined(__WIN32) || defined(__WIN32__))
 #  include <signal.h>
 #endif
 
+/** Initial number of pairs on the buffer */
+#define COLLIDE_INIT_PAIRS 256
+/** Number of pairs narrow-phased by each job */
+#define COLLIDE_JOB_GRAIN 256
+/** Number of passes over every contact between props */
+#define COLLIDE_SOLVER_PASSES 4
+/** Fraction of its horizontal velocity kept by a prop on top of another */
+#define COLLIDE_SOLVER_FRICTION 0.5
+/** Speed (in pixels per second) toward a sleeping prop that wakes it */
+#define COLLIDE_WAKE_SPEED 16.0
+/** Penetration (in pixels) into a sleeping prop that wakes it */
+#define COLLIDE_WAKE_DEPTH 1.0
+
+/** A pair of objects reported by the broadphase (i.e., the quadtree) */
+struct stCollidePair {
+    gfmObject *pObj1;
+    gfmObject *pObj2;
+    void *pChild1;
+    void *pChild2;
+    int type1;
+    int type2;
+    /** Whether the pair passed the narrow phase and must be responded to */
+    int isActive;
+    /** Whether the pair overlapped during the tick, but not at its end */
+    int didTunnel;
+    /** When the pair first overlapped, as a fraction of the tick (1, if
+     * neither object is swept) */
+    double toi;
+};
+typedef struct stCollidePair collidePair;
+
+/** How an object moved during the tick */
+struct stCollideMotion {
+    /** Position at the start of the tick */
+    int x;
+    int y;
+    /** Displacement since then */
+    int dx;
+    int dy;
+    int width;
+    int height;
+};
+typedef struct stCollideMotion collideMotion;
+
+/** Two props that touched */
+struct stCollideContact {
+    gfmObject *pObj1;
+    gfmObject *pObj2;
+    spritePoolNode *pNode1;
+    spritePoolNode *pNode2;
+    /** Index of each prop's body (only valid while solving) */
+    int body1;
+    int body2;
+};
+typedef struct stCollideContact collideContact;
+
+/** A prop being solved, read once and written back at the end */
+struct stCollideBody {
+    gfmObject *pObj;
+    spritePoolNode *pNode;
+    double x;
+    double y;
+    double vx;
+    double vy;
+    int width;
+    int height;
+    /** Whether it's asleep (and thus, never moved) */
+    int isStatic;
+    /** Whether it's on the floor, even if on top of other props (and thus,
+     * never pushed down) */
+    int isGrounded;
+    /** Whether it's on top of another prop */
+    int isSupported;
+};
+typedef struct stCollideBody collideBody;
+
+/** Every pair collected since the last resolve, in the order found */
+static collidePair *pPairs = 0;
+/** Number of pairs that fit on the buffer */
+static int pairsLen = 0;
+/** Number of pairs on the buffer */
+static int pairsUsed = 0;
+/** Indexes of the pairs to be responded to, followed by as many for
+ * sorting them */
+static int *pOrder = 0;
+/** Number of indexes that fit on each half of pOrder */
+static int orderLen = 0;
+/** Contacts between props, solved at the end of collide_resolve */
+static collideContact *pContacts = 0;
+static int contactsLen = 0;
+static int contactsUsed = 0;
+/** Every prop on a contact */
+static collideBody *pBodies = 0;
+static int bodiesLen = 0;
+static int bodiesUsed = 0;
+/** Bodies, hashed by their objects (-1, if empty) */
+static int *pSlots = 0;
+/** Number of slots; Always a power of two */
+static int slotsLen = 0;
+/** Number of pairs ever collected (i.e., reported by the broadphase) */
+static int numPairs = 0;
+/** Number of pairs ever responded to (i.e., that passed the narrow phase) */
+static int numOverlaps = 0;
+
 static inline gfmRV collide_checkpoint(gfmObject *pPl, gfmObject *pCheckpoint) {
     gfmRV rv;
     gfmSave *pSave;
@@ -30,11 +165,6 @@ static inline gfmRV collide_checkpoint(gfmObject *pPl, gfmObject *pCheckpoint) {
 
     pSave = 0;
 
-    rv = gfmObject_isOverlaping(pPl, pCheckpoint);
-    if (rv != GFMRV_TRUE) {
-        return GFMRV_OK;
-    }
-
     rv = gfmObject_getPosition(&x, &y, pPl);
     ASSERT(rv == GFMRV_OK, rv);
     rv = gfmObject_setPosition(pCheckpoint, -100, -100);
@@ -54,7 +184,7 @@ static inline gfmRV collide_checkpoint(gfmObject *pPl, gfmObject *pCheckpoint) {
     rv = textManager_pushTextStatic(pGame->pTextManager, "               CHECKPOINT", 2000);
     ASSERT(rv == GFMRV_OK, rv);
 
-    rv = gfm_playAudio(0, pGame->pCtx, pAssets->sfxCheckpoint, 0.4);
+    rv = mixer_play(pGame->pMixer, pAssets->sfxCheckpoint, 0.4);
     ASSERT(rv == GFMRV_OK, rv);
 
     rv = GFMRV_OK;
@@ -66,23 +196,19 @@ __ret:
 
 static inline gfmRV collide_handlePlEnemy(player *pPl, gfmObject *pPlObj,
         enemy *pEne, gfmObject *pEneObj) {
+    double vy;
     gfmRV rv;
 
-    rv = gfmObject_isOverlaping(pPlObj, pEneObj);
-    if (rv == GFMRV_TRUE) {
-        double vy;
-
-        rv = gfmObject_getVerticalVelocity(&vy, pPlObj);
-        ASSERT(rv == GFMRV_OK, rv);
-        rv = enemy_getHurt(pEne, vy);
-        ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getVerticalVelocity(&vy, pPlObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = enemy_getHurt(pEne, vy);
+    ASSERT(rv == GFMRV_OK, rv);
 
-        rv = gfmObject_setFixed(pEneObj);
-        ASSERT(rv == GFMRV_OK, rv);
-        gfmObject_separateVertical(pEneObj, pPlObj);
-        rv = gfmObject_setMovable(pEneObj);
-        ASSERT(rv == GFMRV_OK, rv);
-    }
+    rv = gfmObject_setFixed(pEneObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    gfmObject_separateVertical(pEneObj, pPlObj);
+    rv = gfmObject_setMovable(pEneObj);
+    ASSERT(rv == GFMRV_OK, rv);
 
     rv = GFMRV_OK;
 __ret:
@@ -90,24 +216,20 @@ __ret:
 }
 
 
-static inline gfmRV collide_spawnExplosion(gfmGroupNode *pCtx, gfmObject *pObj) {
+static inline gfmRV collide_spawnExplosion(spritePoolNode *pCtx, gfmObject *pObj) {
     gfmRV rv;
-    gfmSprite *pSpr;
     int x, y;
 
-    rv = gfmGroup_removeNode(pCtx);
+    rv = spritePool_removeNode(pCtx);
     ASSERT(rv == GFMRV_OK, rv);
     rv = gfmObject_getPosition(&x, &y, pObj);
     ASSERT(rv == GFMRV_OK, rv);
 
-    rv = gfmGroup_recycle(&pSpr, pGame->pParticles);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setPosition(pGame->pParticles, x, y);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setAnimation(pGame->pParticles, P_EXPLOSION);
+    rv = particles_spawn(pGame->pParticles, x, y, 0.0, 0.0, 0.0, 0.0,
+            P_EXPLOSION);
     ASSERT(rv == GFMRV_OK, rv);
 
-    rv = gfm_playAudio(0, pGame->pCtx, pAssets->sfxPlHurt, 0.4);
+    rv = mixer_playAt(pGame->pMixer, pAssets->sfxPlHurt, 0.4, x, y);
     ASSERT(rv == GFMRV_OK, rv);
 
     pGame->hitCount++;
@@ -159,298 +281,1044 @@ __ret:
     return rv;
 }
 
-gfmRV collide_elastic(gfmObject *pObj1, gfmObject *pObj2) {
+static inline gfmRV collide_getSubtype(void **ppObj, int *pType, gfmObject *pObj) {
+    gfmRV rv;
+
+    rv = gfmObject_getChild(ppObj, pType, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    if (*pType == gfmType_sprite) {
+        gfmSprite *pSpr;
+
+        pSpr = *((gfmSprite**)ppObj);
+        rv = gfmSprite_getChild(ppObj, pType, pSpr);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/** Whether objects of a given type are collided over their whole movement */
+static inline int collide_isSwept(int type) {
+    return type == PL_LEFT_LEG || type == PL_RIGHT_LEG || type == BULLET ||
+            type == PROP;
+}
+
+/**
+ * Retrieve how an object moved during the tick; Pure, so it may run on any
+ * thread
+ *
+ * @param  [out]pMotion The movement
+ * @param  [ in]pObj    The object
+ * @param  [ in]pChild  The object's child
+ * @param  [ in]type    The child's type
+ */
+static gfmRV collide_getMotion(collideMotion *pMotion, gfmObject *pObj,
+        void *pChild, int type) {
+    gfmRV rv;
+    int x, y;
+
+    rv = gfmObject_getPosition(&x, &y, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getDimensions(&(pMotion->width), &(pMotion->height),
+            pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    switch (type) {
+        case PL_LEFT_LEG:
+        case PL_RIGHT_LEG: {
+            rv = player_getLastPosition(&(pMotion->x), &(pMotion->y),
+                    (player*)pChild, type);
+        } break;
+        case BULLET:
+        case PROP: {
+            rv = spritePool_getLastPosition(&(pMotion->x), &(pMotion->y),
+                    (spritePoolNode*)pChild);
+        } break;
+        default: {
+            pMotion->x = x;
+            pMotion->y = y;
+        }
+    }
+    ASSERT(rv == GFMRV_OK, rv);
+    pMotion->dx = x - pMotion->x;
+    pMotion->dy = y - pMotion->y;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Find when, along a single axis, an object moving relative to another one
+ * overlaps it
+ *
+ * @param  [out]pEnter When it starts to overlap
+ * @param  [out]pExit  When it stops overlapping
+ * @param  [ in]pos    Relative position at the start of the tick
+ * @param  [ in]delta  Relative displacement
+ * @param  [ in]size1  Moving object's dimension
+ * @param  [ in]size2  Other object's dimension
+ * @return             Whether it ever overlaps
+ */
+static inline int collide_sweepAxis(double *pEnter, double *pExit, int pos,
+        int delta, int size1, int size2) {
+    double t0, t1;
+
+    if (delta == 0) {
+        *pEnter = -1.0;
+        *pExit = 2.0;
+        return (pos > -size1 && pos < size2);
+    }
+
+    t0 = (-size1 - pos) / (double)delta;
+    t1 = (size2 - pos) / (double)delta;
+    if (t0 < t1) {
+        *pEnter = t0;
+        *pExit = t1;
+    }
+    else {
+        *pEnter = t1;
+        *pExit = t0;
+    }
+    return 1;
+}
+
+/**
+ * Find when two objects first overlapped during the tick, by sweeping the
+ * first one relative to the second one
+ *
+ * @param  [out]pToi     When they first overlapped, in [0, 1]
+ * @param  [out]pAxis    Axis along which they touched (0: horizontal, 1:
+ *                       vertical)
+ * @param  [ in]pMotion1 The first object's movement
+ * @param  [ in]pMotion2 The second object's movement
+ * @return               Whether they overlapped at all
+ */
+static int collide_sweep(double *pToi, int *pAxis, collideMotion *pMotion1,
+        collideMotion *pMotion2) {
+    double enterX, enterY, exitX, exitY, enter, exit;
+
+    if (!collide_sweepAxis(&enterX, &exitX, pMotion1->x - pMotion2->x,
+            pMotion1->dx - pMotion2->dx, pMotion1->width, pMotion2->width) ||
+            !collide_sweepAxis(&enterY, &exitY, pMotion1->y - pMotion2->y,
+            pMotion1->dy - pMotion2->dy, pMotion1->height,
+            pMotion2->height)) {
+        return 0;
+    }
+
+    enter = enterX;
+    *pAxis = 0;
+    if (enterY > enterX) {
+        enter = enterY;
+        *pAxis = 1;
+    }
+    exit = exitX;
+    if (exitY < exitX) {
+        exit = exitY;
+    }
+    if (enter >= exit || enter >= 1.0 || exit <= 0.0) {
+        return 0;
+    }
+
+    *pToi = 0.0;
+    if (enter > 0.0) {
+        *pToi = enter;
+    }
+    return 1;
+}
+
+/**
+ * Check whether two objects overlap or touch each other; Pure, so it may run
+ * on any thread
+ *
+ * @param  [out]pIsTouching Whether they do
+ * @param  [ in]pObj1       An object
+ * @param  [ in]pObj2       The other object
+ */
+static gfmRV collide_isTouching(int *pIsTouching, gfmObject *pObj1,
+        gfmObject *pObj2) {
     gfmRV rv;
-    int x1, x2, y1, y2;
-    double vx1, vx2, vy1, vy2;
+    int h1, h2, w1, w2, x1, x2, y1, y2;
 
     rv = gfmObject_getPosition(&x1, &y1, pObj1);
     ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getDimensions(&w1, &h1, pObj1);
+    ASSERT(rv == GFMRV_OK, rv);
     rv = gfmObject_getPosition(&x2, &y2, pObj2);
     ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getDimensions(&w2, &h2, pObj2);
+    ASSERT(rv == GFMRV_OK, rv);
 
-    rv = gfmObject_collide(pObj1, pObj2);
-    ASSERT(rv == GFMRV_TRUE || rv == GFMRV_FALSE, rv);
+    *pIsTouching = (x1 <= x2 + w2 && x2 <= x1 + w1 && y1 <= y2 + h2 &&
+            y2 <= y1 + h1);
 
-    if (rv == GFMRV_TRUE) {
-        if (y1 > y2) {
-            rv = gfmObject_setMovable(pObj1);
-        }
-        else {
-            rv = gfmObject_setMovable(pObj2);
-        }
-        ASSERT(rv == GFMRV_OK, rv);
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
 
-        rv = gfmObject_getVelocity(&vx1, &vy1, pObj1);
-        ASSERT(rv == GFMRV_OK, rv);
-        rv = gfmObject_getVelocity(&vx2, &vy2, pObj2);
+/**
+ * Check whether a pair should be responded to; Pure, so it may run on any
+ * thread
+ *
+ * @param  [ in]pPair The pair
+ */
+static inline gfmRV collide_narrowPair(collidePair *pPair) {
+    gfmRV rv;
+    int isOverlaping;
+
+    pPair->isActive = 0;
+    pPair->didTunnel = 0;
+    pPair->toi = 1.0;
+
+    rv = collide_getSubtype(&(pPair->pChild1), &(pPair->type1), pPair->pObj1);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = collide_getSubtype(&(pPair->pChild2), &(pPair->type2), pPair->pObj2);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    switch (pPair->type1 | (pPair->type2 << 16)) {
+        /* Filter those collisions */
+        case PL_UPPER | (PL_UPPER << 16):
+        case PL_UPPER | (PL_LOWER << 16):
+        case PL_UPPER | (PL_LEFT_LEG << 16):
+        case PL_UPPER | (PL_RIGHT_LEG << 16):
+        case PL_UPPER | (FLOOR << 16):
+        case PL_UPPER | (PROP << 16):
+        case PL_LOWER | (PL_UPPER << 16):
+        case PL_LOWER | (PL_LOWER << 16):
+        case PL_LOWER | (PL_LEFT_LEG << 16):
+        case PL_LOWER | (PL_RIGHT_LEG << 16):
+        case PL_LOWER | (FLOOR << 16):
+        case PL_LOWER | (PROP << 16):
+        case PL_LOWER | (CHECKPOINT << 16):
+        case PL_LOWER | (EXIT << 16):
+        case PL_LEFT_LEG | (PL_UPPER << 16):
+        case PL_LEFT_LEG | (PL_LOWER << 16):
+        case PL_LEFT_LEG | (PL_LEFT_LEG << 16):
+        case PL_LEFT_LEG | (PL_RIGHT_LEG << 16):
+        case PL_LEFT_LEG | (CHECKPOINT << 16):
+        case PL_LEFT_LEG | (EXIT << 16):
+        case PL_RIGHT_LEG | (PL_UPPER << 16):
+        case PL_RIGHT_LEG | (PL_LOWER << 16):
+        case PL_RIGHT_LEG | (PL_LEFT_LEG << 16):
+        case PL_RIGHT_LEG | (PL_RIGHT_LEG << 16):
+        case PL_RIGHT_LEG | (CHECKPOINT << 16):
+        case PL_RIGHT_LEG | (EXIT << 16):
+        case FLOOR | (PL_UPPER << 16):
+        case FLOOR | (PL_LOWER << 16):
+        case FLOOR | (FLOOR << 16):
+        case FLOOR | (BULLET << 16):
+        case FLOOR | (TEXT << 16):
+        case FLOOR | (CHECKPOINT << 16):
+        case FLOOR | (EXIT << 16):
+        case BULLET | (FLOOR << 16):
+        case BULLET | (LIL_TANK << 16):
+        case BULLET | (TURRET << 16):
+        case BULLET | (BULLET << 16):
+        case BULLET | (PROP << 16):
+        case BULLET | (TEXT << 16):
+        case BULLET | (CHECKPOINT << 16):
+        case BULLET | (EXIT << 16):
+        case LIL_TANK | (BULLET << 16):
+        case LIL_TANK | (TEXT << 16):
+        case TURRET | (BULLET << 16):
+        case TURRET | (TEXT << 16):
+        case PROP | (BULLET << 16):
+        case PROP | (TEXT << 16):
+        case PROP | (CHECKPOINT << 16):
+        case PROP | (EXIT << 16):
+        case TEXT | (FLOOR << 16):
+        case TEXT | (LIL_TANK << 16):
+        case TEXT | (TURRET << 16):
+        case TEXT | (BULLET << 16):
+        case TEXT | (PROP << 16):
+        case TEXT | (TEXT << 16):
+        case TEXT | (CHECKPOINT << 16):
+        case TEXT | (EXIT << 16):
+        case PL_UPPER | (TURRET << 16):
+        case PL_LOWER | (TURRET << 16):
+        case TURRET | (PL_UPPER << 16):
+        case TURRET | (PL_LOWER << 16):
+        case PL_UPPER | (LIL_TANK << 16):
+        case PL_LOWER | (LIL_TANK << 16):
+        case LIL_TANK | (PL_UPPER << 16):
+        case LIL_TANK | (PL_LOWER << 16):
+        case LIL_TANK | (LIL_TANK << 16):
+        case CHECKPOINT | (TEXT << 16):
+        case CHECKPOINT | (PROP << 16):
+        case CHECKPOINT | (BULLET << 16):
+        case CHECKPOINT | (FLOOR << 16):
+        case CHECKPOINT | (PL_LEFT_LEG << 16):
+        case CHECKPOINT | (PL_RIGHT_LEG << 16):
+        case CHECKPOINT | (PL_LOWER << 16):
+        case EXIT | (TEXT << 16):
+        case EXIT | (PROP << 16):
+        case EXIT | (BULLET << 16):
+        case EXIT | (FLOOR << 16):
+        case EXIT | (PL_LEFT_LEG << 16):
+        case EXIT | (PL_RIGHT_LEG << 16):
+        case EXIT | (PL_LOWER << 16):
+        case PL_LEFT_LEG | (PROP << 16):
+        case PL_RIGHT_LEG | (PROP << 16):
+        case PROP | (PL_LEFT_LEG << 16):
+        case PROP | (PL_RIGHT_LEG << 16):
+            return GFMRV_OK;
+        default: {}
+    }
+
+    isOverlaping = (gfmObject_isOverlaping(pPair->pObj1, pPair->pObj2) ==
+            GFMRV_TRUE);
+    if (!isOverlaping && pPair->type1 == PROP && pPair->type2 == PROP) {
+        /* Props resting on each other only touch, but must still be solved */
+        rv = collide_isTouching(&isOverlaping, pPair->pObj1, pPair->pObj2);
         ASSERT(rv == GFMRV_OK, rv);
+    }
+    if (collide_isSwept(pPair->type1) || collide_isSwept(pPair->type2)) {
+        collideMotion motion1, motion2;
+        double toi;
+        int axis;
 
-        rv = gfmObject_setVelocity(pObj1, -vx1 * 0.5, vy1 * 0.5);
+        rv = collide_getMotion(&motion1, pPair->pObj1, pPair->pChild1,
+                pPair->type1);
         ASSERT(rv == GFMRV_OK, rv);
-        rv = gfmObject_setVelocity(pObj2, -vx2 * 0.5, vy2 * 0.5);
+        rv = collide_getMotion(&motion2, pPair->pObj2, pPair->pChild2,
+                pPair->type2);
         ASSERT(rv == GFMRV_OK, rv);
+
+        if (collide_sweep(&toi, &axis, &motion1, &motion2)) {
+            pPair->toi = toi;
+            pPair->didTunnel = !isOverlaping;
+            pPair->isActive = 1;
+        }
+    }
+    if (isOverlaping) {
+        pPair->isActive = 1;
     }
 
     rv = GFMRV_OK;
 __ret:
+    return rv;
+}
+
+/**
+ * Job that narrow-phases a range of the collected pairs; Each pair is only
+ * written by the job that owns it
+ *
+ * @param  [ in]pArg  Unused
+ * @param  [ in]first First pair
+ * @param  [ in]last  One past the last pair
+ */
+static gfmRV collide_narrowJob(void *pArg, int first, int last) {
+    gfmRV rv;
+    int i;
+
+    i = first;
+    while (i < last) {
+        rv = collide_narrowPair(pPairs + i);
+        ASSERT(rv == GFMRV_OK, rv);
+        i++;
+    }
 
+    rv = GFMRV_OK;
+__ret:
     return rv;
 }
 
-static inline gfmRV collide_getSubtype(void **ppObj, int *pType, gfmObject *pObj) {
+/**
+ * Move a pair that overlapped only during the tick back to where it first
+ * touched (with the swept object slightly inside the other one), so the
+ * response separates it as if it had been collided then
+ *
+ * Since earlier responses may have moved either object, the pair is swept
+ * again from where they are now
+ *
+ * @param  [ in]pPair The pair
+ * @return            GFMRV_TRUE (if it must still be responded to),
+ *                    GFMRV_FALSE, ...
+ */
+static gfmRV collide_rewind(collidePair *pPair) {
+    collideMotion motion1, motion2, *pMoving, *pOther;
+    double toi;
+    gfmObject *pObj;
     gfmRV rv;
+    int axis, dx, dy, x, y;
 
-    rv = gfmObject_getChild(ppObj, pType, pObj);
+    if (gfmObject_isOverlaping(pPair->pObj1, pPair->pObj2) == GFMRV_TRUE) {
+        return GFMRV_TRUE;
+    }
+
+    rv = collide_getMotion(&motion1, pPair->pObj1, pPair->pChild1,
+            pPair->type1);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = collide_getMotion(&motion2, pPair->pObj2, pPair->pChild2,
+            pPair->type2);
     ASSERT(rv == GFMRV_OK, rv);
+    if (!collide_sweep(&toi, &axis, &motion1, &motion2)) {
+        return GFMRV_FALSE;
+    }
+    /* Texts only have to know that they were touched */
+    if (pPair->type1 == TEXT || pPair->type2 == TEXT) {
+        return GFMRV_TRUE;
+    }
 
-    if (*pType == gfmType_sprite) {
-        gfmSprite *pSpr;
+    /* Move the swept object (or the bullet, which is about to explode) */
+    if (collide_isSwept(pPair->type1) && pPair->type2 != BULLET) {
+        pMoving = &motion1;
+        pOther = &motion2;
+        pObj = pPair->pObj1;
+    }
+    else {
+        pMoving = &motion2;
+        pOther = &motion1;
+        pObj = pPair->pObj2;
+    }
 
-        pSpr = *((gfmSprite**)ppObj);
-        rv = gfmSprite_getChild(ppObj, pType, pSpr);
-        ASSERT(rv == GFMRV_OK, rv);
+    /* Place it where it touched, relative to where the other object is */
+    dx = pMoving->dx - pOther->dx;
+    dy = pMoving->dy - pOther->dy;
+    x = pMoving->x + pOther->dx + (int)(dx * toi + (dx > 0 ? 0.5 : -0.5));
+    y = pMoving->y + pOther->dy + (int)(dy * toi + (dy > 0 ? 0.5 : -0.5));
+    if (axis == 0) {
+        x += (dx > 0) - (dx < 0);
+    }
+    else {
+        y += (dy > 0) - (dy < 0);
+    }
+
+    rv = gfmObject_setPosition(pObj, x, y);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_TRUE;
+__ret:
+    return rv;
+}
+
+/**
+ * Sort the pairs to be responded to by when they first touched, keeping the
+ * pairs that touched at the same time in the order they were collected
+ *
+ * @param  [ in]num Number of pairs on pOrder
+ * @return          The sorted indexes (either half of pOrder)
+ */
+static int* collide_sortOrder(int num) {
+    int *pDst, *pSrc, *pTmp;
+    int width;
+
+    pSrc = pOrder;
+    pDst = pOrder + orderLen;
+    width = 1;
+    while (width < num) {
+        int i;
+
+        /* Merge every two adjacent runs */
+        i = 0;
+        while (i < num) {
+            int j, k, mid, end;
+
+            mid = i + width;
+            if (mid > num) {
+                mid = num;
+            }
+            end = mid + width;
+            if (end > num) {
+                end = num;
+            }
+
+            j = i;
+            k = mid;
+            while (i < end) {
+                if (k >= end || (j < mid &&
+                        pPairs[pSrc[j]].toi <= pPairs[pSrc[k]].toi)) {
+                    pDst[i] = pSrc[j];
+                    j++;
+                }
+                else {
+                    pDst[i] = pSrc[k];
+                    k++;
+                }
+                i++;
+            }
+        }
+
+        pTmp = pSrc;
+        pSrc = pDst;
+        pDst = pTmp;
+        width *= 2;
     }
 
+    return pSrc;
+}
+
+/**
+ * Store a contact between two props, to be solved with every other one
+ *
+ * @param  [ in]pObj1  The first prop
+ * @param  [ in]pNode1 The first prop's node
+ * @param  [ in]pObj2  The second prop
+ * @param  [ in]pNode2 The second prop's node
+ */
+static gfmRV collide_addContact(gfmObject *pObj1, spritePoolNode *pNode1,
+        gfmObject *pObj2, spritePoolNode *pNode2) {
+    collideContact *pContact;
+    gfmRV rv;
+
+    if (contactsUsed >= contactsLen) {
+        collideContact *pTmp;
+        int len;
+
+        len = contactsLen * 2;
+        if (len == 0) {
+            len = COLLIDE_INIT_PAIRS;
+        }
+        pTmp = (collideContact*)realloc(pContacts,
+                sizeof(collideContact) * len);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pContacts = pTmp;
+        contactsLen = len;
+    }
+
+    pContact = pContacts + contactsUsed;
+    pContact->pObj1 = pObj1;
+    pContact->pObj2 = pObj2;
+    pContact->pNode1 = pNode1;
+    pContact->pNode2 = pNode2;
+    contactsUsed++;
+
     rv = GFMRV_OK;
 __ret:
     return rv;
 }
 
-/** Continue the currently executing collision */
-gfmRV collide_run() {
+/**
+ * Retrieve a prop's body, reading its state if it's the first contact it's
+ * on
+ *
+ * @param  [out]pIndex The body's index
+ * @param  [ in]pObj   The prop
+ * @param  [ in]pNode  The prop's node
+ */
+static gfmRV collide_getBody(int *pIndex, gfmObject *pObj,
+        spritePoolNode *pNode) {
+    collideBody *pBody;
+    gfmCollision dir;
     gfmRV rv;
+    unsigned int i;
+    int x, y;
 
-    rv = GFMRV_QUADTREE_OVERLAPED;
-    while (rv != GFMRV_QUADTREE_DONE) {
-        gfmObject *pObj1, *pObj2;
-        void *pChild1, *pChild2;
-        int type1, type2, orType;
+    i = (unsigned int)((size_t)pObj >> 4) * 2654435761u;
+    i &= (unsigned int)(slotsLen - 1);
+    while (pSlots[i] != -1) {
+        if (pBodies[pSlots[i]].pObj == pObj) {
+            *pIndex = pSlots[i];
+            return GFMRV_OK;
+        }
+        i = (i + 1) & (unsigned int)(slotsLen - 1);
+    }
+
+    pBody = pBodies + bodiesUsed;
+    pBody->pObj = pObj;
+    pBody->pNode = pNode;
+    rv = gfmObject_getPosition(&x, &y, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    pBody->x = x;
+    pBody->y = y;
+    rv = gfmObject_getVelocity(&(pBody->vx), &(pBody->vy), pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getDimensions(&(pBody->width), &(pBody->height), pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getCollision(&dir, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+    pBody->isStatic = spritePool_isAsleep(pNode);
+    pBody->isGrounded = ((dir & gfmCollision_down) != 0);
+    pBody->isSupported = 0;
+
+    pSlots[i] = bodiesUsed;
+    *pIndex = bodiesUsed;
+    bodiesUsed++;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Push two props apart along the axis they overlap the least and, if they
+ * are moving toward each other, make them move together along it; A
+ * sleeping prop that's being shoved is woken first
+ *
+ * @param  [ in]pContact The contact
+ */
+static void collide_solveContact(collideContact *pContact) {
+    collideBody *pFirst, *pSecond;
+    double dist, overlapX, overlapY, share, v;
+    double *pPos1, *pPos2, *pVel1, *pVel2;
+    int axis, im1, im2;
+
+    /* Sort them along each axis, so the first is on the top or the left */
+    pFirst = pBodies + pContact->body1;
+    pSecond = pBodies + pContact->body2;
+    overlapX = (pFirst->x < pSecond->x ? pFirst->x + pFirst->width -
+            pSecond->x : pSecond->x + pSecond->width - pFirst->x);
+    overlapY = (pFirst->y < pSecond->y ? pFirst->y + pFirst->height -
+            pSecond->y : pSecond->y + pSecond->height - pFirst->y);
+    /* Props only touching (but not on a corner) still hold each other */
+    if (overlapX < 0.0 || overlapY < 0.0 ||
+            (overlapX == 0.0 && overlapY == 0.0)) {
+        return;
+    }
+
+    axis = (overlapY <= overlapX);
+    if ((axis && pFirst->y > pSecond->y) ||
+            (!axis && pFirst->x > pSecond->x)) {
+        collideBody *pTmp;
+
+        pTmp = pFirst;
+        pFirst = pSecond;
+        pSecond = pTmp;
+    }
+
+    /* Wake a sleeping prop that's being shoved, instead of pushing its
+     * partner back every tick */
+    if (pFirst->isStatic != pSecond->isStatic) {
+        double approach, depth;
+
+        if (axis) {
+            approach = pFirst->vy - pSecond->vy;
+            depth = overlapY;
+        }
+        else {
+            approach = pFirst->vx - pSecond->vx;
+            depth = overlapX;
+        }
+        if (approach > COLLIDE_WAKE_SPEED || depth > COLLIDE_WAKE_DEPTH) {
+            collideBody *pStatic;
+
+            pStatic = (pFirst->isStatic ? pFirst : pSecond);
+            pStatic->isStatic = 0;
+            spritePool_wakeNode(pStatic->pNode);
+        }
+    }
+
+    /* Static props never move and props on the floor aren't pushed down */
+    im1 = !pFirst->isStatic;
+    im2 = !pSecond->isStatic && !(axis && pSecond->isGrounded);
+    if (im1 + im2 == 0) {
+        im2 = !pSecond->isStatic;
+        if (im2 == 0) {
+            return;
+        }
+    }
+    share = im1 / (double)(im1 + im2);
+
+    if (axis) {
+        dist = overlapY;
+        pPos1 = &(pFirst->y);
+        pPos2 = &(pSecond->y);
+        pVel1 = &(pFirst->vy);
+        pVel2 = &(pSecond->vy);
+        pFirst->isSupported = 1;
+        /* So whatever is on top of it also rests on the floor */
+        pFirst->isGrounded |= (pSecond->isGrounded || pSecond->isStatic);
+    }
+    else {
+        dist = overlapX;
+        pPos1 = &(pFirst->x);
+        pPos2 = &(pSecond->x);
+        pVel1 = &(pFirst->vx);
+        pVel2 = &(pSecond->vx);
+    }
+    *pPos1 -= dist * share;
+    *pPos2 += dist * (1.0 - share);
+
+    if (*pVel1 > *pVel2) {
+        if (im1 == 0) {
+            v = *pVel1;
+        }
+        else if (im2 == 0) {
+            v = *pVel2;
+        }
+        else {
+            v = (*pVel1 + *pVel2) * 0.5;
+        }
+        *pVel1 = v;
+        *pVel2 = v;
+    }
+}
+
+/**
+ * Solve every contact between props gathered since the last resolve and
+ * write the props back
+ */
+static gfmRV collide_solveContacts() {
+    gfmRV rv;
+    int i, pass;
+
+    if (bodiesLen < contactsUsed * 2) {
+        collideBody *pTmp;
+
+        pTmp = (collideBody*)realloc(pBodies,
+                sizeof(collideBody) * contactsLen * 2);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pBodies = pTmp;
+        bodiesLen = contactsLen * 2;
+    }
+    if (slotsLen < contactsUsed * 4) {
+        int *pTmp, len;
+
+        len = slotsLen;
+        if (len == 0) {
+            len = COLLIDE_INIT_PAIRS;
+        }
+        while (len < contactsUsed * 4) {
+            len *= 2;
+        }
+        pTmp = (int*)realloc(pSlots, sizeof(int) * len);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pSlots = pTmp;
+        slotsLen = len;
+    }
+    memset(pSlots, 0xff, sizeof(int) * slotsLen);
+    bodiesUsed = 0;
+
+    i = 0;
+    while (i < contactsUsed) {
+        collideContact *pContact;
 
-        rv = gfmQuadtree_getOverlaping(&pObj1, &pObj2, pGame->pQt);
+        pContact = pContacts + i;
+        rv = collide_getBody(&(pContact->body1), pContact->pObj1,
+                pContact->pNode1);
         ASSERT(rv == GFMRV_OK, rv);
+        rv = collide_getBody(&(pContact->body2), pContact->pObj2,
+                pContact->pNode2);
+        ASSERT(rv == GFMRV_OK, rv);
+        i++;
+    }
+
+    pass = 0;
+    while (pass < COLLIDE_SOLVER_PASSES) {
+        i = 0;
+        while (i < contactsUsed) {
+            collide_solveContact(pContacts + i);
+            i++;
+        }
+        pass++;
+    }
 
-        rv = collide_getSubtype(&pChild1, &type1, pObj1);
+    i = 0;
+    while (i < bodiesUsed) {
+        collideBody *pBody;
+
+        pBody = pBodies + i;
+        i++;
+        if (pBody->isStatic) {
+            continue;
+        }
+
+        if (pBody->isSupported) {
+            pBody->vx *= COLLIDE_SOLVER_FRICTION;
+            spritePool_setSupported(pBody->pNode);
+        }
+        rv = gfmObject_setPosition(pBody->pObj, (int)floor(pBody->x + 0.5),
+                (int)floor(pBody->y + 0.5));
         ASSERT(rv == GFMRV_OK, rv);
-        rv = collide_getSubtype(&pChild2, &type2, pObj2);
+        rv = gfmObject_setVelocity(pBody->pObj, pBody->vx, pBody->vy);
         ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    contactsUsed = 0;
+    return rv;
+}
+
+/**
+ * Apply the response to a pair that passed the narrow phase
+ *
+ * Since earlier responses may have moved either object, the pair is tested
+ * again where they are now (pairs that tunneled were already swept again, by
+ * collide_rewind), so the responses never act on stale positions
+ *
+ * @param  [ in]pPair The pair
+ * @return            GFMRV_TRUE (if it was responded to), GFMRV_FALSE (if it
+ *                    no longer overlaps), ...
+ */
+static gfmRV collide_respond(collidePair *pPair) {
+    gfmObject *pObj1, *pObj2;
+    gfmRV rv;
+    void *pChild1, *pChild2;
+    int type1, type2;
+
+    pObj1 = pPair->pObj1;
+    pObj2 = pPair->pObj2;
+    pChild1 = pPair->pChild1;
+    pChild2 = pPair->pChild2;
+    type1 = pPair->type1;
+    type2 = pPair->type2;
+
+    if (!pPair->didTunnel) {
+        int isOverlaping;
 
-        orType = type1 | (type2 << 16);
-
-        rv = GFMRV_OK;
-        switch (orType) {
-            /* Filter those collisions */
-            case PL_UPPER | (PL_UPPER << 16):
-            case PL_UPPER | (PL_LOWER << 16):
-            case PL_UPPER | (PL_LEFT_LEG << 16):
-            case PL_UPPER | (PL_RIGHT_LEG << 16):
-            case PL_UPPER | (FLOOR << 16):
-            case PL_UPPER | (PROP << 16):
-            case PL_LOWER | (PL_UPPER << 16):
-            case PL_LOWER | (PL_LOWER << 16):
-            case PL_LOWER | (PL_LEFT_LEG << 16):
-            case PL_LOWER | (PL_RIGHT_LEG << 16):
-            case PL_LOWER | (FLOOR << 16):
-            case PL_LOWER | (PROP << 16):
-            case PL_LOWER | (CHECKPOINT << 16):
-            case PL_LOWER | (EXIT << 16):
-            case PL_LEFT_LEG | (PL_UPPER << 16):
-            case PL_LEFT_LEG | (PL_LOWER << 16):
-            case PL_LEFT_LEG | (PL_LEFT_LEG << 16):
-            case PL_LEFT_LEG | (PL_RIGHT_LEG << 16):
-            case PL_LEFT_LEG | (CHECKPOINT << 16):
-            case PL_LEFT_LEG | (EXIT << 16):
-            case PL_RIGHT_LEG | (PL_UPPER << 16):
-            case PL_RIGHT_LEG | (PL_LOWER << 16):
-            case PL_RIGHT_LEG | (PL_LEFT_LEG << 16):
-            case PL_RIGHT_LEG | (PL_RIGHT_LEG << 16):
-            case PL_RIGHT_LEG | (CHECKPOINT << 16):
-            case PL_RIGHT_LEG | (EXIT << 16):
-            case FLOOR | (PL_UPPER << 16):
-            case FLOOR | (PL_LOWER << 16):
-            case FLOOR | (FLOOR << 16):
-            case FLOOR | (BULLET << 16):
-            case FLOOR | (TEXT << 16):
-            case FLOOR | (CHECKPOINT << 16):
-            case FLOOR | (EXIT << 16):
-            case BULLET | (FLOOR << 16):
-            case BULLET | (LIL_TANK << 16):
-            case BULLET | (TURRET << 16):
-            case BULLET | (BULLET << 16):
-            case BULLET | (PROP << 16):
-            case BULLET | (TEXT << 16):
-            case BULLET | (CHECKPOINT << 16):
-            case BULLET | (EXIT << 16):
-            case LIL_TANK | (BULLET << 16):
-            case LIL_TANK | (TEXT << 16):
-            case TURRET | (BULLET << 16):
-            case TURRET | (TEXT << 16):
-            case PROP | (BULLET << 16):
-            case PROP | (TEXT << 16):
-            case PROP | (CHECKPOINT << 16):
-            case PROP | (EXIT << 16):
-            case TEXT | (FLOOR << 16):
-            case TEXT | (LIL_TANK << 16):
-            case TEXT | (TURRET << 16):
-            case TEXT | (BULLET << 16):
-            case TEXT | (PROP << 16):
-            case TEXT | (TEXT << 16):
-            case TEXT | (CHECKPOINT << 16):
-            case TEXT | (EXIT << 16):
-            case PL_UPPER | (TURRET << 16):
-            case PL_LOWER | (TURRET << 16):
-            case TURRET | (PL_UPPER << 16):
-            case TURRET | (PL_LOWER << 16):
-            case PL_UPPER | (LIL_TANK << 16):
-            case PL_LOWER | (LIL_TANK << 16):
-            case LIL_TANK | (PL_UPPER << 16):
-            case LIL_TANK | (PL_LOWER << 16):
-            case LIL_TANK | (LIL_TANK << 16):
-            case CHECKPOINT | (TEXT << 16):
-            case CHECKPOINT | (PROP << 16):
-            case CHECKPOINT | (BULLET << 16):
-            case CHECKPOINT | (FLOOR << 16):
-            case CHECKPOINT | (PL_LEFT_LEG << 16):
-            case CHECKPOINT | (PL_RIGHT_LEG << 16):
-            case CHECKPOINT | (PL_LOWER << 16):
-            case EXIT | (TEXT << 16):
-            case EXIT | (PROP << 16):
-            case EXIT | (BULLET << 16):
-            case EXIT | (FLOOR << 16):
-            case EXIT | (PL_LEFT_LEG << 16):
-            case EXIT | (PL_RIGHT_LEG << 16):
-            case EXIT | (PL_LOWER << 16):
-
-            case PL_LEFT_LEG | (PROP << 16):
-            case PL_RIGHT_LEG | (PROP << 16):
-            case PROP | (PL_LEFT_LEG << 16):
-            case PROP | (PL_RIGHT_LEG << 16):
-
-            break;
-            /* Collide against floor */
-            case PL_LEFT_LEG | (FLOOR << 16):
-            case PL_RIGHT_LEG | (FLOOR << 16): {
-                rv = player_collideLimbFloor((player*)pChild1, type1, pObj2);
-            } break;
-            case FLOOR | (PL_LEFT_LEG << 16):
-            case FLOOR | (PL_RIGHT_LEG << 16): {
-                rv = player_collideLimbFloor((player*)pChild2, type2, pObj1);
-            } break;
+        isOverlaping = (gfmObject_isOverlaping(pObj1, pObj2) == GFMRV_TRUE);
+        if (!isOverlaping && type1 == PROP && type2 == PROP) {
+            rv = collide_isTouching(&isOverlaping, pObj1, pObj2);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        if (!isOverlaping) {
+            return GFMRV_FALSE;
+        }
+    }
+
+    rv = GFMRV_OK;
+    switch (type1 | (type2 << 16)) {
+        /* Collide against floor */
+        case PL_LEFT_LEG | (FLOOR << 16):
+        case PL_RIGHT_LEG | (FLOOR << 16): {
+            rv = player_collideLimbFloor((player*)pChild1, type1, pObj2);
+        } break;
+        case FLOOR | (PL_LEFT_LEG << 16):
+        case FLOOR | (PL_RIGHT_LEG << 16): {
+            rv = player_collideLimbFloor((player*)pChild2, type2, pObj1);
+        } break;
 #if 0
-            /* Walk over pellets */
-            case PL_LEFT_LEG | (PROP << 16):
-            case PL_RIGHT_LEG | (PROP << 16): {
-                rv = gfmObject_setFixed(pObj2);
-                ASSERT(rv == GFMRV_OK, rv);
-                rv = player_collideLimbFloor((player*)pChild1, type1, pObj2);
-                ASSERT(rv == GFMRV_OK, rv);
-                rv = gfmObject_setMovable(pObj2);
-            } break;
-            case PROP | (PL_LEFT_LEG << 16):
-            case PROP | (PL_RIGHT_LEG << 16): {
-                rv = gfmObject_setFixed(pObj1);
-                ASSERT(rv == GFMRV_OK, rv);
-                rv = player_collideLimbFloor((player*)pChild2, type2, pObj1);
-                ASSERT(rv == GFMRV_OK, rv);
-                rv = gfmObject_setMovable(pObj1);
-            } break;
+        /* Walk over pellets */
+        case PL_LEFT_LEG | (PROP << 16):
+        case PL_RIGHT_LEG | (PROP << 16): {
+            rv = gfmObject_setFixed(pObj2);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = player_collideLimbFloor((player*)pChild1, type1, pObj2);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = gfmObject_setMovable(pObj2);
+        } break;
+        case PROP | (PL_LEFT_LEG << 16):
+        case PROP | (PL_RIGHT_LEG << 16): {
+            rv = gfmObject_setFixed(pObj1);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = player_collideLimbFloor((player*)pChild2, type2, pObj1);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = gfmObject_setMovable(pObj1);
+        } break;
 #endif
-            /* Hurt player */
-            case PL_UPPER | (BULLET << 16):
-            case PL_LOWER | (BULLET << 16):
-            case PL_LEFT_LEG | (BULLET << 16):
-            case PL_RIGHT_LEG | (BULLET << 16): {
-                rv = collide_spawnExplosion((gfmGroupNode*)pChild2, pObj2);
-            } break;
-            case BULLET | (PL_UPPER << 16):
-            case BULLET | (PL_LOWER << 16):
-            case BULLET | (PL_LEFT_LEG << 16):
-            case BULLET | (PL_RIGHT_LEG << 16): {
-                rv = collide_spawnExplosion((gfmGroupNode*)pChild1, pObj1);
-            } break;
-            /* Hurt player or kill enemy */
-            case PL_LEFT_LEG | (TURRET << 16):
-            case PL_RIGHT_LEG | (TURRET << 16):
-            case PL_LEFT_LEG | (LIL_TANK << 16):
-            case PL_RIGHT_LEG | (LIL_TANK << 16): {
-                rv = collide_handlePlEnemy((player*)pChild1, pObj1,
-                        (enemy*)pChild2, pObj2);
-            } break;
-            case TURRET | (PL_LEFT_LEG << 16):
-            case TURRET | (PL_RIGHT_LEG << 16):
-            case LIL_TANK | (PL_LEFT_LEG << 16):
-            case LIL_TANK | (PL_RIGHT_LEG << 16): {
-                rv = collide_handlePlEnemy((player*)pChild2, pObj2,
-                        (enemy*)pChild1, pObj1);
-            } break;
-            /* Collide enemy with floor */
-            case TURRET | (FLOOR << 16):
-            case LIL_TANK | (FLOOR << 16): {
-                rv = enemy_collideFloor((enemy*)pChild1, pObj2);
-            } break;
-            case FLOOR | (TURRET << 16):
-            case FLOOR | (LIL_TANK << 16): {
-                rv = enemy_collideFloor((enemy*)pChild2, pObj1);
-            } break;
-            /* Make enemies push pellets */
-            case TURRET | (PROP << 16):
-            case LIL_TANK | (PROP << 16): {
-                rv = collide_pushObject(pObj1, pObj2);
-            } break;
-            case PROP | (TURRET << 16):
-            case PROP | (LIL_TANK << 16): {
-                rv = collide_pushObject(pObj2, pObj1);
-            } break;
-            /* Bounce pellets off floor and itsef */
-            case FLOOR | (PROP << 16): {
-                rv = collide_bounceOff(pObj2, pObj1);
-            } break;
-            case PROP | (FLOOR << 16): {
-                rv = collide_bounceOff(pObj1, pObj2);
-            } break;
-            case PROP | (PROP << 16): {
-                rv = collide_elastic(pObj1, pObj2);
-            } break;
-            /* Queue a text to be displayed */
-            case PL_LEFT_LEG | (TEXT << 16):
-            case PL_RIGHT_LEG | (TEXT << 16): {
-                textManager_pushEvent(pGame->pTextManager, (textEvent*)pChild2);
-                rv = GFMRV_OK;
-            } break;
-            case TEXT | (PL_LEFT_LEG << 16):
-            case TEXT | (PL_RIGHT_LEG << 16): {
-                textManager_pushEvent(pGame->pTextManager, (textEvent*)pChild1);
-                rv = GFMRV_OK;
-            } break;
-            /* Checkpoint! */
-            case PL_UPPER | (CHECKPOINT << 16): {
-                rv = collide_checkpoint(pObj1, pObj2);
-            } break;
-            case CHECKPOINT | (PL_UPPER << 16): {
-                rv = collide_checkpoint(pObj2, pObj1);
-            } break;
-            /* Exit! */
-            case PL_UPPER | (EXIT << 16): {
-                if (!pGame->exit) {
-                    pGame->exit = 1;
-                }
-            } break;
-            case EXIT | (PL_UPPER << 16): {
-                if (!pGame->exit) {
-                    pGame->exit = 1;
-                }
-            } break;
-            default: {
+        /* Hurt player */
+        case PL_UPPER | (BULLET << 16):
+        case PL_LOWER | (BULLET << 16):
+        case PL_LEFT_LEG | (BULLET << 16):
+        case PL_RIGHT_LEG | (BULLET << 16): {
+            rv = collide_spawnExplosion((spritePoolNode*)pChild2, pObj2);
+        } break;
+        case BULLET | (PL_UPPER << 16):
+        case BULLET | (PL_LOWER << 16):
+        case BULLET | (PL_LEFT_LEG << 16):
+        case BULLET | (PL_RIGHT_LEG << 16): {
+            rv = collide_spawnExplosion((spritePoolNode*)pChild1, pObj1);
+        } break;
+        /* Hurt player or kill enemy */
+        case PL_LEFT_LEG | (TURRET << 16):
+        case PL_RIGHT_LEG | (TURRET << 16):
+        case PL_LEFT_LEG | (LIL_TANK << 16):
+        case PL_RIGHT_LEG | (LIL_TANK << 16): {
+            rv = collide_handlePlEnemy((player*)pChild1, pObj1,
+                    (enemy*)pChild2, pObj2);
+        } break;
+        case TURRET | (PL_LEFT_LEG << 16):
+        case TURRET | (PL_RIGHT_LEG << 16):
+        case LIL_TANK | (PL_LEFT_LEG << 16):
+        case LIL_TANK | (PL_RIGHT_LEG << 16): {
+            rv = collide_handlePlEnemy((player*)pChild2, pObj2,
+                    (enemy*)pChild1, pObj1);
+        } break;
+        /* Collide enemy with floor */
+        case TURRET | (FLOOR << 16):
+        case LIL_TANK | (FLOOR << 16): {
+            rv = enemy_collideFloor((enemy*)pChild1, pObj2);
+        } break;
+        case FLOOR | (TURRET << 16):
+        case FLOOR | (LIL_TANK << 16): {
+            rv = enemy_collideFloor((enemy*)pChild2, pObj1);
+        } break;
+        /* Make enemies push (and wake) pellets */
+        case TURRET | (PROP << 16):
+        case LIL_TANK | (PROP << 16): {
+            spritePool_wakeNode((spritePoolNode*)pChild2);
+            rv = collide_pushObject(pObj1, pObj2);
+        } break;
+        case PROP | (TURRET << 16):
+        case PROP | (LIL_TANK << 16): {
+            spritePool_wakeNode((spritePoolNode*)pChild1);
+            rv = collide_pushObject(pObj2, pObj1);
+        } break;
+        /* Bounce pellets off floor and itsef */
+        case FLOOR | (PROP << 16): {
+            rv = collide_bounceOff(pObj2, pObj1);
+        } break;
+        case PROP | (FLOOR << 16): {
+            rv = collide_bounceOff(pObj1, pObj2);
+        } break;
+        case PROP | (PROP << 16): {
+            rv = collide_addContact(pObj1, (spritePoolNode*)pChild1, pObj2,
+                    (spritePoolNode*)pChild2);
+        } break;
+        /* Queue a text to be displayed */
+        case PL_LEFT_LEG | (TEXT << 16):
+        case PL_RIGHT_LEG | (TEXT << 16): {
+            textManager_pushEvent(pGame->pTextManager, (textEvent*)pChild2);
+            rv = GFMRV_OK;
+        } break;
+        case TEXT | (PL_LEFT_LEG << 16):
+        case TEXT | (PL_RIGHT_LEG << 16): {
+            textManager_pushEvent(pGame->pTextManager, (textEvent*)pChild1);
+            rv = GFMRV_OK;
+        } break;
+        /* Checkpoint! */
+        case PL_UPPER | (CHECKPOINT << 16): {
+            rv = collide_checkpoint(pObj1, pObj2);
+        } break;
+        case CHECKPOINT | (PL_UPPER << 16): {
+            rv = collide_checkpoint(pObj2, pObj1);
+        } break;
+        /* Exit! */
+        case PL_UPPER | (EXIT << 16): {
+            if (!pGame->exit) {
+                pGame->exit = 1;
+            }
+        } break;
+        case EXIT | (PL_UPPER << 16): {
+            if (!pGame->exit) {
+                pGame->exit = 1;
+            }
+        } break;
+        default: {
 #if defined(DEBUG) && !(defined(__WIN32) || defined(__WIN32__))
-                /* Unfiltered collision, do something about it */
-                raise(SIGINT);
-                rv = GFMRV_INTERNAL_ERROR;
+            /* Unfiltered collision, do something about it */
+            raise(SIGINT);
+            rv = GFMRV_INTERNAL_ERROR;
 #endif
+        }
+    }
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_TRUE;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve the shapes that must be tested in place of an object; The player is
+ * a compound body, replaced by the limbs that may touch the other object over
+ * the whole path it moved on this tick (so swept objects that went through a
+ * limb aren't missed)
+ *
+ * @param  [out]ppShapes The shapes (at least PL_NUM_LIMBS of those)
+ * @param  [out]pNum     How many shapes were retrieved
+ * @param  [ in]pObj     The object
+ * @param  [ in]pOther   The object it overlapped
+ */
+static gfmRV collide_getShapes(gfmObject **ppShapes, int *pNum,
+        gfmObject *pObj, gfmObject *pOther) {
+    collideMotion motion;
+    gfmRV rv;
+    void *pChild, *pOtherChild;
+    int type, otherType, x, y;
+
+    rv = gfmObject_getChild(&pChild, &type, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    if (type != PL_BODY) {
+        ppShapes[0] = pObj;
+        *pNum = 1;
+        return GFMRV_OK;
+    }
+
+    rv = collide_getSubtype(&pOtherChild, &otherType, pOther);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = collide_getMotion(&motion, pOther, pOtherChild, otherType);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    x = motion.x;
+    y = motion.y;
+    if (motion.dx < 0) {
+        x += motion.dx;
+    }
+    if (motion.dy < 0) {
+        y += motion.dy;
+    }
+    rv = player_getLimbs(ppShapes, pNum, (player*)pChild, x, y,
+            motion.width + abs(motion.dx), motion.height + abs(motion.dy));
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Store an overlap reported by the broadphase, replacing compound bodies by
+ * their shapes
+ *
+ * @param  [ in]pObj1 The object being collided
+ * @param  [ in]pObj2 The object it overlaps
+ */
+static gfmRV collide_addPair(gfmObject *pObj1, gfmObject *pObj2) {
+    gfmObject *ppShapes1[PL_NUM_LIMBS];
+    gfmObject *ppShapes2[PL_NUM_LIMBS];
+    gfmRV rv;
+    int i, num1, num2;
+
+    rv = collide_getShapes(ppShapes1, &num1, pObj1, pObj2);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = collide_getShapes(ppShapes2, &num2, pObj2, pObj1);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    i = 0;
+    while (i < num1 * num2) {
+        collidePair *pPair;
+
+        if (pairsUsed >= pairsLen) {
+            collidePair *pTmp;
+            int len;
+
+            len = pairsLen * 2;
+            if (len == 0) {
+                len = COLLIDE_INIT_PAIRS;
             }
+            pTmp = (collidePair*)realloc(pPairs, sizeof(collidePair) * len);
+            ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+            pPairs = pTmp;
+            pairsLen = len;
         }
+
+        pPair = pPairs + pairsUsed;
+        pPair->pObj1 = ppShapes1[i / num2];
+        pPair->pObj2 = ppShapes2[i % num2];
+        pairsUsed++;
+
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Store every overlap from the currently executing collision, so they may be
+ * resolved later by collide_resolve
+ */
+gfmRV collide_collect() {
+    gfmRV rv;
+
+    rv = GFMRV_QUADTREE_OVERLAPED;
+    while (rv != GFMRV_QUADTREE_DONE) {
+        gfmObject *pObj1, *pObj2;
+
+        rv = broadphase_getOverlaping(&pObj1, &pObj2, pGame->pBroadphase);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = collide_addPair(pObj1, pObj2);
         ASSERT(rv == GFMRV_OK, rv);
 
-        rv = gfmQuadtree_continue(pGame->pQt);
+        rv = broadphase_continue(pGame->pBroadphase);
         ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE,
                 rv);
     }
@@ -460,3 +1328,142 @@ __ret:
     return rv;
 }
 
+/**
+ * Narrow-phase every collected pair (in parallel, if there are enough of
+ * those) and then respond to the overlapping ones on this thread, in the
+ * order they first touched (or in the order they were collected, if at the
+ * same time); Only pairs collected since the last resolve are ordered, so
+ * this ordering doesn't span the whole tick
+ */
+gfmRV collide_resolve() {
+    gfmRV rv;
+    int *pSorted;
+    int doSort, i, num;
+
+    if (pairsUsed > orderLen) {
+        int *pTmp;
+
+        pTmp = (int*)realloc(pOrder, sizeof(int) * pairsLen * 2);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pOrder = pTmp;
+        orderLen = pairsLen;
+    }
+
+    if (pairsUsed >= COLLIDE_JOB_GRAIN * 2) {
+        rv = jobs_push(pGame->pJobs, collide_narrowJob, 0/*pArg*/, pairsUsed,
+                COLLIDE_JOB_GRAIN);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = jobs_wait(pGame->pJobs);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+    else {
+        rv = collide_narrowJob(0/*pArg*/, 0, pairsUsed);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    num = 0;
+    doSort = 0;
+    i = 0;
+    while (i < pairsUsed) {
+        if (pPairs[i].isActive) {
+            pOrder[num] = i;
+            num++;
+            doSort |= (pPairs[i].toi < 1.0);
+        }
+        i++;
+    }
+
+    pSorted = pOrder;
+    if (doSort) {
+        pSorted = collide_sortOrder(num);
+    }
+
+    i = 0;
+    while (i < num) {
+        collidePair *pPair;
+
+        pPair = pPairs + pSorted[i];
+        rv = GFMRV_TRUE;
+        if (pPair->didTunnel) {
+            rv = collide_rewind(pPair);
+            ASSERT(rv == GFMRV_TRUE || rv == GFMRV_FALSE, rv);
+        }
+        if (rv == GFMRV_TRUE) {
+            rv = collide_respond(pPair);
+            ASSERT(rv == GFMRV_TRUE || rv == GFMRV_FALSE, rv);
+        }
+        if (rv == GFMRV_TRUE) {
+            numOverlaps++;
+        }
+        i++;
+    }
+    numPairs += pairsUsed;
+
+    if (contactsUsed > 0) {
+        rv = collide_solveContacts();
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    pairsUsed = 0;
+    contactsUsed = 0;
+    return rv;
+}
+
+/** Continue the currently executing collision */
+gfmRV collide_run() {
+    gfmRV rv;
+
+    rv = collide_collect();
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = collide_resolve();
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve how many pairs were collided since the game started
+ *
+ * @param  [out]pNumPairs    Pairs reported by the broadphase
+ * @param  [out]pNumOverlaps Pairs that actually overlapped
+ */
+void collide_getStats(int *pNumPairs, int *pNumOverlaps) {
+    *pNumPairs = numPairs;
+    *pNumOverlaps = numOverlaps;
+}
+
+/** Release the buffers used to store the collected pairs */
+void collide_clean() {
+    if (pPairs) {
+        free(pPairs);
+    }
+    if (pOrder) {
+        free(pOrder);
+    }
+    if (pContacts) {
+        free(pContacts);
+    }
+    if (pBodies) {
+        free(pBodies);
+    }
+    if (pSlots) {
+        free(pSlots);
+    }
+    pPairs = 0;
+    pairsLen = 0;
+    pairsUsed = 0;
+    pOrder = 0;
+    orderLen = 0;
+    pContacts = 0;
+    contactsLen = 0;
+    contactsUsed = 0;
+    pBodies = 0;
+    bodiesLen = 0;
+    pSlots = 0;
+    slotsLen = 0;
+}
+
@@ -0,0 +1,365 @@
+/**
+ * Game's configuration, loaded from a file and overridable from the command
+ * line
+ *
+ * @file src/config.c
+ */
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/broadphase.h>
+#include <ld34/config.h>
+#include <ld34/game.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Longest accepted line on the configuration file */
+#define CONFIG_LINE_LEN 256
+
+struct stConfigOption {
+    /** Key on the file/option on the command line (without the '--') */
+    char *pName;
+    /** Where the value is stored on configCtx */
+    size_t offset;
+    /** Minimum accepted value */
+    int min;
+    /** Maximum accepted value */
+    int max;
+    /** Description printed by '--help' */
+    char *pDesc;
+};
+typedef struct stConfigOption configOption;
+
+static const configOption configOptions[] = {
+    { "fps", offsetof(configCtx, fps), 1, 1000,
+            "Frequency of the game's timer (raised to fit ups and dps)" },
+    { "ups", offsetof(configCtx, ups), 1, 1000, "Updates per second" },
+    { "max-steps", offsetof(configCtx, maxSteps), 1, 100,
+            "Maximum number of updates run to catch up after a slow frame" },
+    { "dps", offsetof(configCtx, dps), 1, 1000, "Draws per second" },
+    { "vsync", offsetof(configCtx, vsync), 0, 1, "Whether vsync is enabled" },
+    { "width", offsetof(configCtx, width), BBWDT, 8192, "Window's width" },
+    { "height", offsetof(configCtx, height), BBHGT, 8192, "Window's height" },
+    { "particles", offsetof(configCtx, initParticles), 1, 1 << 20,
+            "Initial number of particles/sprites on each pool" },
+    { "max-particles", offsetof(configCtx, maxParticles), 1, 1 << 20,
+            "Maximum number of particles/sprites on each pool" },
+    { "latency", offsetof(configCtx, latency), 0, 1,
+            "Whether input latency and frame times are logged to '"
+            LATENCY_FILE "'" },
+    { "broadphase", offsetof(configCtx, broadphase), BROADPHASE_AUTO,
+            BROADPHASE_NUM_TYPES - 1, "Collision broadphase (0: tuned "
+            "automatically, 1: quadtree, 2: spatial hash, 3: sort and sweep)" },
+};
+static const int configOptionsLen = sizeof(configOptions) /
+        sizeof(configOption);
+
+/**
+ * Parse and store an option's value
+ *
+ * @param  [ in]pConfig The configuration
+ * @param  [ in]pName   Option's name
+ * @param  [ in]pValue  Option's value (as a string)
+ * @param  [ in]pWhere  Where the option came from (for error messages)
+ */
+static gfmRV config_set(configCtx *pConfig, char *pName, char *pValue,
+        char *pWhere) {
+    const configOption *pOpt;
+    gfmRV rv;
+    char *pEnd;
+    long val;
+    int i;
+
+    pOpt = 0;
+    i = 0;
+    while (i < configOptionsLen) {
+        if (strcmp(configOptions[i].pName, pName) == 0) {
+            pOpt = configOptions + i;
+            break;
+        }
+        i++;
+    }
+    if (!pOpt) {
+        fprintf(stderr, "%s: unknown option '%s'\n", pWhere, pName);
+        ASSERT(0, GFMRV_ARGUMENTS_BAD);
+    }
+
+    if (pOpt->min == 0 && pOpt->max == 1 && (strcmp(pValue, "yes") == 0 ||
+            strcmp(pValue, "true") == 0)) {
+        val = 1;
+    }
+    else if (pOpt->min == 0 && pOpt->max == 1 && (strcmp(pValue, "no") == 0 ||
+            strcmp(pValue, "false") == 0)) {
+        val = 0;
+    }
+    else {
+        val = strtol(pValue, &pEnd, 10);
+        if (pEnd == pValue || *pEnd != '\0') {
+            fprintf(stderr, "%s: invalid value '%s' for '%s'\n", pWhere,
+                    pValue, pName);
+            ASSERT(0, GFMRV_ARGUMENTS_BAD);
+        }
+    }
+    if (val < pOpt->min || val > pOpt->max) {
+        fprintf(stderr, "%s: '%s' must be between %i and %i\n", pWhere, pName,
+                pOpt->min, pOpt->max);
+        ASSERT(0, GFMRV_ARGUMENTS_BAD);
+    }
+
+    *((int*)((char*)pConfig + pOpt->offset)) = (int)val;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Set every option to its default value
+ *
+ * @param  [ in]pConfig The configuration
+ */
+void config_setDefault(configCtx *pConfig) {
+    pConfig->dps = 60;
+    pConfig->fps = 60;
+    pConfig->vsync = 0;
+    pConfig->ups = 60;
+    pConfig->maxSteps = 5;
+    pConfig->width = WNWDT;
+    pConfig->height = WNHGT;
+    pConfig->initParticles = INIT_PARTICLES;
+    pConfig->maxParticles = NUM_PARTICLES;
+    pConfig->latency = 0;
+    pConfig->broadphase = BROADPHASE_AUTO;
+}
+
+/**
+ * Remove leading and trailing whitespaces from a string
+ *
+ * @param  [ in]pStr The string (modified in place)
+ * @return           The first non-blank character
+ */
+static char* config_trim(char *pStr) {
+    int len;
+
+    while (*pStr == ' ' || *pStr == '\t') {
+        pStr++;
+    }
+    len = strlen(pStr);
+    while (len > 0 && (pStr[len - 1] == ' ' || pStr[len - 1] == '\t' ||
+            pStr[len - 1] == '\r' || pStr[len - 1] == '\n')) {
+        len--;
+    }
+    pStr[len] = '\0';
+
+    return pStr;
+}
+
+/**
+ * Load options from a file; Options missing from the file are left untouched
+ *
+ * @param  [ in]pConfig   The configuration
+ * @param  [ in]pFilename The file
+ * @return                GFMRV_OK, GFMRV_FALSE (the file doesn't exist),
+ *                        GFMRV_ARGUMENTS_BAD
+ */
+gfmRV config_loadFile(configCtx *pConfig, char *pFilename) {
+    char pLine[CONFIG_LINE_LEN];
+    char pWhere[CONFIG_LINE_LEN];
+    FILE *pFp;
+    gfmRV rv;
+    int line;
+
+    pFp = fopen(pFilename, "rt");
+    if (!pFp) {
+        return GFMRV_FALSE;
+    }
+
+    line = 0;
+    while (fgets(pLine, sizeof(pLine), pFp)) {
+        char *pKey, *pValue, *pTmp;
+
+        line++;
+
+        pTmp = strchr(pLine, '#');
+        if (pTmp) {
+            *pTmp = '\0';
+        }
+        pKey = config_trim(pLine);
+        if (*pKey == '\0') {
+            continue;
+        }
+
+        snprintf(pWhere, sizeof(pWhere), "%s:%i", pFilename, line);
+        pValue = strchr(pKey, '=');
+        if (!pValue) {
+            fprintf(stderr, "%s: expected 'key = value'\n", pWhere);
+            ASSERT(0, GFMRV_ARGUMENTS_BAD);
+        }
+        *pValue = '\0';
+        pKey = config_trim(pKey);
+        pValue = config_trim(pValue + 1);
+
+        rv = config_set(pConfig, pKey, pValue, pWhere);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    fclose(pFp);
+
+    return rv;
+}
+
+/**
+ * Search the command line for an alternative configuration file
+ *
+ * @param  [ in]argc Number of arguments
+ * @param  [ in]argv List of arguments
+ * @return           The file passed through '--config', or CONFIG_FILE
+ */
+char* config_getFilename(int argc, char *argv[]) {
+    int i;
+
+    i = 1;
+    while (i < argc) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            return argv[i + 1];
+        }
+        else if (strncmp(argv[i], "--config=", 9) == 0) {
+            return argv[i] + 9;
+        }
+        i++;
+    }
+
+    return CONFIG_FILE;
+}
+
+/**
+ * Print every accepted option
+ *
+ * @param  [ in]pName Executable's name
+ */
+static void config_printUsage(char *pName) {
+    int i;
+
+    printf("Usage: %s [OPTION]...\n\n", pName);
+    printf("Options may also be set on '%s' (or on the file passed to\n"
+            "'--config'), as 'key = value' lines.\n\n", CONFIG_FILE);
+    printf("  --config FILE\n      Load options from FILE\n");
+    printf("  --no-vsync\n      Same as '--vsync 0'\n");
+    i = 0;
+    while (i < configOptionsLen) {
+        printf("  --%s N\n      %s (between %i and %i)\n",
+                configOptions[i].pName, configOptions[i].pDesc,
+                configOptions[i].min, configOptions[i].max);
+        i++;
+    }
+    printf("  -h, --help\n      Print this message\n");
+}
+
+/**
+ * Override options from the command line
+ *
+ * @param  [ in]pConfig The configuration
+ * @param  [ in]argc    Number of arguments
+ * @param  [ in]argv    List of arguments
+ * @return              GFMRV_OK, GFMRV_FALSE (help was requested),
+ *                      GFMRV_ARGUMENTS_BAD
+ */
+gfmRV config_parseArgs(configCtx *pConfig, int argc, char *argv[]) {
+    char pName[CONFIG_LINE_LEN];
+    gfmRV rv;
+    int i;
+
+    i = 1;
+    while (i < argc) {
+        char *pArg, *pValue;
+
+        pArg = argv[i];
+        i++;
+
+        if (strcmp(pArg, "-h") == 0 || strcmp(pArg, "--help") == 0) {
+            config_printUsage(argv[0]);
+            return GFMRV_FALSE;
+        }
+        else if (strcmp(pArg, "--config") == 0) {
+            /* Already loaded; Simply skip its value */
+            i++;
+            continue;
+        }
+        else if (strncmp(pArg, "--config=", 9) == 0) {
+            continue;
+        }
+        else if (strcmp(pArg, "--vsync") == 0 && (i >= argc ||
+                strncmp(argv[i], "--", 2) == 0)) {
+            pConfig->vsync = 1;
+            continue;
+        }
+        else if (strcmp(pArg, "--no-vsync") == 0) {
+            pConfig->vsync = 0;
+            continue;
+        }
+        else if (strncmp(pArg, "--", 2) != 0) {
+            fprintf(stderr, "Unexpected argument '%s' (see '--help')\n", pArg);
+            ASSERT(0, GFMRV_ARGUMENTS_BAD);
+        }
+
+        /* Accept both '--key value' and '--key=value' */
+        strncpy(pName, pArg + 2, sizeof(pName) - 1);
+        pName[sizeof(pName) - 1] = '\0';
+        pValue = strchr(pName, '=');
+        if (pValue) {
+            *pValue = '\0';
+            pValue++;
+        }
+        else if (i < argc) {
+            pValue = argv[i];
+            i++;
+        }
+        else {
+            fprintf(stderr, "Missing value for '%s'\n", pArg);
+            ASSERT(0, GFMRV_ARGUMENTS_BAD);
+        }
+
+        rv = config_set(pConfig, pName, pValue, "command line");
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Check that the options are sane, adjusting those that depend on others
+ * (e.g., the timer frequency is raised to fit the update and draw rates)
+ *
+ * @param  [ in]pConfig The configuration
+ */
+gfmRV config_validate(configCtx *pConfig) {
+    gfmRV rv;
+
+    if (pConfig->initParticles > pConfig->maxParticles) {
+        fprintf(stderr, "'particles' (%i) can't be greater than "
+                "'max-particles' (%i)\n", pConfig->initParticles,
+                pConfig->maxParticles);
+        ASSERT(0, GFMRV_ARGUMENTS_BAD);
+    }
+
+    /* GFraMe only updates/draws when its timer fires, so it must be at least
+     * as fast as the fastest of both */
+    if (pConfig->fps < pConfig->ups) {
+        pConfig->fps = pConfig->ups;
+    }
+    if (pConfig->fps < pConfig->dps) {
+        pConfig->fps = pConfig->dps;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
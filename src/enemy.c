@@ -3,17 +3,24 @@
  */
 #include <GFraMe/gfmAssert.h>
 #include <GFraMe/gfmError.h>
-#include <GFraMe/gfmParser.h>
 #include <GFraMe/gfmSprite.h>
 #include <GFraMe/gfmSpriteset.h>
 
+#include <ld34/broadphase.h>
 #include <ld34/collide.h>
 #include <ld34/enemy.h>
 #include <ld34/game.h>
+#include <ld34/mixer.h>
+#include <ld34/particles.h>
+#include <ld34/snapshot.h>
+#include <ld34/spritePool.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+/** Initial number of shots queued per tick */
+#define ENEMY_INIT_SHOTS 16
+
 int en_liltank_data[] = {
               /* len|fps|loop|data... */
 /* WALKING  */    4 , 6 , 1  , 64,65,66,67,
@@ -29,13 +36,30 @@ int en_turret_data[] = {
 
 struct stEnemy {
     gfmSprite *pSpr;
+    /** Spriteset and offset, used to push the sprite into snapshots */
+    gfmSpriteset *pSset;
+    int offX;
+    int offY;
     int timeToAction;
     int switchDir;
     int num;
     int type;
     int isHurt;
+    /** Sector that spawned the enemy (-1, if it's always loaded) */
+    int sector;
+    /** Index within the sector, so it's kept dead once killed */
+    int index;
 };
 
+/** Bullets shot by every enemy on this tick */
+static spritePoolDesc *pBulletDescs = 0;
+/** Pellets ejected by every shot on this tick */
+static spritePoolDesc *pPelletDescs = 0;
+/** Number of shots that fit on both arrays */
+static int shotsLen = 0;
+/** Number of shots queued on this tick */
+static int shotsUsed = 0;
+
 /**
  * Alloc a new enemy
  *
@@ -65,24 +89,36 @@ void enemy_clean(enemy **ppEnemy) {
 }
 
 /**
- * Initialize an enemy from the parser
+ * Initialize an enemy from its spawn position; Inactive enemies may be
+ * re-initialized
  *
- * @param  [ in]pEnemy  The enemy
- * @param  [ in]pParser The parser
- * @param  [ in]type    The enemie's type
+ * @param  [ in]pEnemy The enemy
+ * @param  [ in]type   The enemie's type
+ * @param  [ in]x      Spawn's horizontal position (as on the map)
+ * @param  [ in]y      Spawn's vertical position (as on the map, i.e., its
+ *                     bottom)
+ * @param  [ in]w      Spawn's width
+ * @param  [ in]h      Spawn's height
+ * @param  [ in]sector Sector that spawned the enemy (-1, if always loaded)
+ * @param  [ in]index  Index of the enemy within its sector (-1, if always
+ *                     loaded)
  */
-gfmRV enemy_init(enemy *pEnemy, gfmParser *pParser, int type) {
+gfmRV enemy_init(enemy *pEnemy, int type, int x, int y, int w, int h,
+        int sector, int index) {
     gfmRV rv;
     gfmSpriteset *pSset;
-    int dataLen, firstAnim, h, ox, oy, *pData, w, x, y;
+    int dataLen, firstAnim, ox, oy, *pData;
 
+    /* Start from a clean sprite, so no animation is kept from its last use */
+    if (pEnemy->pSpr) {
+        gfmSprite_free(&(pEnemy->pSpr));
+    }
     rv = gfmSprite_getNew(&(pEnemy->pSpr));
     ASSERT(rv == GFMRV_OK, rv);
-
-    rv = gfmParser_getPos(&x, &y, pParser);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmParser_getDimensions(&w, &h, pParser);
-    ASSERT(rv == GFMRV_OK, rv);
+    pEnemy->isHurt = 0;
+    pEnemy->switchDir = 0;
+    pEnemy->sector = sector;
+    pEnemy->index = index;
 
     y -= h;
 
@@ -121,6 +157,9 @@ gfmRV enemy_init(enemy *pEnemy, gfmParser *pParser, int type) {
 
     rv = gfmSprite_init(pEnemy->pSpr, x, y, w, h, pSset, ox, oy, pEnemy, type);
     ASSERT(rv == GFMRV_OK, rv);
+    pEnemy->pSset = pSset;
+    pEnemy->offX = ox;
+    pEnemy->offY = oy;
 
     if (pData) {
         rv = gfmSprite_addAnimations(pEnemy->pSpr, pData, dataLen);
@@ -156,6 +195,131 @@ __ret:
     return rv;
 }
 
+/**
+ * Check whether the enemy is still active (i.e., wasn't killed nor despawned)
+ *
+ * @param  [ in]pEnemy The enemy
+ * @return             GFMRV_TRUE, GFMRV_FALSE
+ */
+gfmRV enemy_isActive(enemy *pEnemy) {
+    if (pEnemy->pSpr && pEnemy->isHurt < 3) {
+        return GFMRV_TRUE;
+    }
+    return GFMRV_FALSE;
+}
+
+/**
+ * Retrieve the sector that spawned the enemy
+ *
+ * @param  [ in]pEnemy The enemy
+ * @return             The sector (-1, if it's always loaded)
+ */
+int enemy_getSector(enemy *pEnemy) {
+    return pEnemy->sector;
+}
+
+/**
+ * Deactivate the enemy (without killing it), so it may be reused
+ *
+ * @param  [ in]pEnemy The enemy
+ */
+void enemy_despawn(enemy *pEnemy) {
+    pEnemy->isHurt = 3;
+}
+
+/**
+ * Queue a bullet and the pellet ejected by the shot, to be spawned by
+ * enemy_spawnShots (together with every other shot on this tick)
+ *
+ * @param  [ in]x   Horizontal position of both
+ * @param  [ in]by  Bullet's vertical position
+ * @param  [ in]bvx Bullet's velocity
+ * @param  [ in]bvy Bullet's velocity
+ * @param  [ in]py  Pellet's vertical position
+ * @param  [ in]pvx Pellet's velocity
+ * @param  [ in]pvy Pellet's velocity
+ */
+static gfmRV enemy_shoot(int x, int by, double bvx, double bvy, int py,
+        double pvx, double pvy) {
+    spritePoolDesc *pDesc;
+    gfmRV rv;
+
+    if (shotsUsed == shotsLen) {
+        spritePoolDesc *pTmp;
+        int len;
+
+        len = shotsLen * 2;
+        if (len == 0) {
+            len = ENEMY_INIT_SHOTS;
+        }
+        pTmp = (spritePoolDesc*)realloc(pBulletDescs,
+                sizeof(spritePoolDesc) * len);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pBulletDescs = pTmp;
+        pTmp = (spritePoolDesc*)realloc(pPelletDescs,
+                sizeof(spritePoolDesc) * len);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pPelletDescs = pTmp;
+        shotsLen = len;
+    }
+
+    pDesc = pBulletDescs + shotsUsed;
+    pDesc->x = x;
+    pDesc->y = by;
+    pDesc->vx = bvx;
+    pDesc->vy = bvy;
+    pDesc->ax = 0.0;
+    pDesc->ay = 0.0;
+    pDesc->anim = P_BULLET;
+
+    pDesc = pPelletDescs + shotsUsed;
+    pDesc->x = x;
+    pDesc->y = py;
+    pDesc->vx = pvx;
+    pDesc->vy = pvy;
+    pDesc->ax = 0.0;
+    pDesc->ay = GRAV;
+    pDesc->anim = P_PELLET1;
+
+    shotsUsed++;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Spawn every shot queued (by every enemy) on this tick, with a single batch
+ * per pool
+ */
+gfmRV enemy_spawnShots() {
+    gfmRV rv;
+
+    if (shotsUsed == 0) {
+        return GFMRV_OK;
+    }
+
+    rv = spritePool_spawnBatch(pGame->pBullets, pBulletDescs, shotsUsed);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_spawnBatch(pGame->pProps, pPelletDescs, shotsUsed);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    shotsUsed = 0;
+    return rv;
+}
+
+/** Release the shots' queues */
+void enemy_cleanShots() {
+    free(pBulletDescs);
+    free(pPelletDescs);
+    pBulletDescs = 0;
+    pPelletDescs = 0;
+    shotsLen = 0;
+    shotsUsed = 0;
+}
+
 /**
  * Update the enemy (and collide it against the quadtree)
  *
@@ -169,48 +333,22 @@ gfmRV enemy_preUpdate(enemy *pEnemy) {
         return GFMRV_OK;
     }
     else if (pEnemy->isHurt == 2) {
-        int i;
-
         rv = gfmSprite_update(pEnemy->pSpr, pGame->pCtx);
         ASSERT(rv == GFMRV_OK, rv);
 
         rv = gfmSprite_didAnimationFinish(pEnemy->pSpr);
         if (rv == GFMRV_TRUE || rv == GFMRV_NO_ANIMATION_PLAYING) {
-            i = 0;
-            while (i < 8) {
-                gfmSprite *pSpr;
-                int vx, vy, x, y;
-
-                if (i % 4 == 0) {
-                    vx = 0;
-                    vy = 75 * (1 - 2 * (i == 0));
-                }
-                else if (i % 4 == 2) {
-                    vx = 75 * (1 - 2 * (i == 0));
-                    vy = 0;
-                }
-                else {
-                    vx = 75 * 0.707106781 * (1 - 2 * (i > 4));
-                    vy = 75 * 0.707106781 * (1 - 2 * (((i + 1) % 8) > 4));
-                }
-
-                rv = gfmSprite_getPosition(&x, &y, pEnemy->pSpr);
-                ASSERT(rv == GFMRV_OK, rv);
-
-                rv = gfmGroup_recycle(&pSpr, pGame->pParticles);
-                ASSERT(rv == GFMRV_OK, rv);
-                rv = gfmGroup_setPosition(pGame->pParticles, x, y);
-                ASSERT(rv == GFMRV_OK, rv);
-                rv = gfmGroup_setVelocity(pGame->pParticles, vx, vy);
-                ASSERT(rv == GFMRV_OK, rv);
-                rv = gfmGroup_setAnimation(pGame->pParticles, P_EXPLOSION);
-                ASSERT(rv == GFMRV_OK, rv);
+            int x, y;
 
-                i++;
-            }
+            rv = gfmSprite_getPosition(&x, &y, pEnemy->pSpr);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = particles_spawnBurst(pGame->pParticles, x, y, 8/*num*/,
+                    75.0/*speed*/, P_EXPLOSION);
+            ASSERT(rv == GFMRV_OK, rv);
 
             pEnemy->isHurt = 3;
-            rv = gfm_playAudio(0, pGame->pCtx, pAssets->sfxEnemyExplosion, 0.4);
+            rv = mixer_playAt(pGame->pMixer, pAssets->sfxEnemyExplosion, 0.4,
+                    x, y);
             ASSERT(rv == GFMRV_OK, rv);
             pGame->enemiesKilled++;
         }
@@ -218,8 +356,7 @@ gfmRV enemy_preUpdate(enemy *pEnemy) {
         return GFMRV_OK;
     }
 
-    rv = gfm_getElapsedTime(&elapsed, pGame->pCtx);
-    ASSERT(rv == GFMRV_OK, rv);
+    elapsed = pGame->elapsed;
 
     if (pEnemy->timeToAction > 0) {
         pEnemy->timeToAction -= elapsed;
@@ -229,7 +366,6 @@ gfmRV enemy_preUpdate(enemy *pEnemy) {
         switch (pEnemy->type) {
             case TURRET: {
                 if (pEnemy->num > 0) {
-                    gfmSprite *pSpr;
                     int x, y;
 
                     rv = gfmSprite_getPosition(&x, &y, pEnemy->pSpr);
@@ -237,42 +373,13 @@ gfmRV enemy_preUpdate(enemy *pEnemy) {
 
                     x += 4;
 
-                    do {
-                        gfmCamera *pCam;
-
-                        pCam = 0;
-                        rv = gfm_getCamera(&pCam, pGame->pCtx);
-                        ASSERT(rv == GFMRV_OK, rv);
-                        rv = gfmCamera_isSpriteInside(pCam, pEnemy->pSpr);
-                        if (rv == GFMRV_TRUE) {
-                            rv = gfm_playAudio(0, pGame->pCtx,
-                                    pAssets->sfxEnemyShoot, 0.3);
-                            ASSERT(rv == GFMRV_OK, rv);
-                        }
-                    } while (0);
-
-                    /* Spawn a bullet */
-                    rv = gfmGroup_recycle(&pSpr, pGame->pBullets);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setPosition(pGame->pBullets, x, y-3);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setAnimation(pGame->pBullets, P_BULLET);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setVelocity(pGame->pBullets, 0.0, TURRET_BULLET_VY);
+                    rv = mixer_playAt(pGame->pMixer, pAssets->sfxEnemyShoot,
+                            0.3, x, y);
                     ASSERT(rv == GFMRV_OK, rv);
 
-                    /* Spawn a pellet */
-                    rv = gfmGroup_recycle(&pSpr, pGame->pProps);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setPosition(pGame->pProps, x, y-1);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setAnimation(pGame->pProps, P_PELLET1);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setVelocity(pGame->pProps, 25,
+                    rv = enemy_shoot(x, y-3, 0.0, TURRET_BULLET_VY, y-1, 25,
                             TURRET_BULLET_VY * 0.75);
                     ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setAcceleration(pGame->pProps, 0, GRAV);
-                    ASSERT(rv == GFMRV_OK, rv);
 
 
                     pEnemy->timeToAction = LIL_TANK_BETWEEN_SHOOT;
@@ -290,7 +397,6 @@ gfmRV enemy_preUpdate(enemy *pEnemy) {
                 ASSERT(rv == GFMRV_OK, rv);
 
                 if (pEnemy->num > 0) {
-                    gfmSprite *pSpr;
                     int vx, vy, x, y;
 
                     rv = gfmSprite_setHorizontalVelocity(pEnemy->pSpr, 0.0);
@@ -308,26 +414,7 @@ gfmRV enemy_preUpdate(enemy *pEnemy) {
                     }
                     vy = -30;
 
-                    /* Spawn a bullet */
-                    rv = gfmGroup_recycle(&pSpr, pGame->pBullets);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setPosition(pGame->pBullets, x, y-1);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setAnimation(pGame->pBullets, P_BULLET);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setVelocity(pGame->pBullets, vx, vy);
-                    ASSERT(rv == GFMRV_OK, rv);
-
-                    /* Spawn a pellet */
-                    rv = gfmGroup_recycle(&pSpr, pGame->pProps);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setPosition(pGame->pProps, x, y-1);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setAnimation(pGame->pProps, P_PELLET1);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setVelocity(pGame->pProps, -vx, vy);
-                    ASSERT(rv == GFMRV_OK, rv);
-                    rv = gfmGroup_setAcceleration(pGame->pProps, 0, GRAV);
+                    rv = enemy_shoot(x, y-1, vx, vy, y-1, -vx, vy);
                     ASSERT(rv == GFMRV_OK, rv);
 
 
@@ -358,7 +445,7 @@ gfmRV enemy_preUpdate(enemy *pEnemy) {
     rv = gfmSprite_update(pEnemy->pSpr, pGame->pCtx);
     ASSERT(rv == GFMRV_OK, rv);
 
-    rv = gfmQuadtree_collideSprite(pGame->pQt, pEnemy->pSpr);
+    rv = broadphase_collideSprite(pGame->pBroadphase, pEnemy->pSpr);
     ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
     if (rv == GFMRV_QUADTREE_OVERLAPED) {
         rv = collide_run();
@@ -428,7 +515,8 @@ gfmRV enemy_draw(enemy *pEnemy) {
     gfmRV rv;
 
     if (pEnemy->isHurt < 3) {
-        rv = gfmSprite_draw(pEnemy->pSpr, pGame->pCtx);
+        rv = snapshot_pushSprite(pGame->pSnapshot, pEnemy->pSpr, pEnemy->pSset,
+                pEnemy->offX, pEnemy->offY);
         ASSERT(rv == GFMRV_OK, rv);
     }
 
@@ -483,9 +571,15 @@ gfmRV enemy_getHurt(enemy *pEnemy, double vy) {
 
     if (vy > 10.0) {
         if (!pEnemy->isHurt) {
+            int x, y;
+
             pEnemy->isHurt = 1;
+            level_killSpawn(pGame->pLevel, pEnemy->sector, pEnemy->index);
 
-            rv = gfm_playAudio(0, pGame->pCtx, pAssets->sfxEnemyCrushed, 0.4);
+            rv = gfmSprite_getPosition(&x, &y, pEnemy->pSpr);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = mixer_playAt(pGame->pMixer, pAssets->sfxEnemyCrushed, 0.4, x,
+                    y);
             ASSERT(rv == GFMRV_OK, rv);
         }
     }
@@ -8,16 +8,23 @@
 #include <GFraMe/gfmError.h>
 #include <GFraMe/gfmGenericArray.h>
 #include <GFraMe/gfmParser.h>
-#include <GFraMe/gfmQuadtree.h>
 #include <GFraMe/gfmSave.h>
-#include <GFraMe/gfmTilemap.h>
 
+#include <ld34/alloc.h>
+#include <ld34/broadphase.h>
 #include <ld34/collide.h>
 #include <ld34/enemy.h>
 #include <ld34/game.h>
 #include <ld34/gamestate.h>
+#include <ld34/jobs.h>
+#include <ld34/level.h>
+#include <ld34/mixer.h>
+#include <ld34/particles.h>
 #include <ld34/player.h>
+#include <ld34/snapshot.h>
+#include <ld34/spritePool.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -25,66 +32,88 @@
 #  include <signal.h>
 #endif
 
+/** Longest path (relative to the assets directory) to an objects' file */
+#define GAMESTATE_PATH_LEN 128
+
 gfmGenArr_define(enemy);
 gfmGenArr_define(gfmObject);
 
-static const char *pTmDict[] = {
-    "floor"
-};
-static const int tmDictType[] = {
-    FLOOR
-};
-static const int tmDictLen = sizeof(tmDictType) / sizeof(int);
-
 struct stGamestate {
     player *pPlayer;
-    gfmTilemap *pTm;
+    /** Where the player was spawned; The level is first loaded around it */
+    int spawnX;
+    int spawnY;
     gfmGenArr_var(enemy, pEnes);
     gfmGenArr_var(gfmObject, pChkPoints);
 };
 typedef struct stGamestate gamestate;
 
 /**
- * Initialize the game state
+ * Spawn an enemy, reusing any that was killed or despawned
  *
- * NOTE: pState will be overwritten!
+ * @param  [ in]pGamestate The game state
+ * @param  [ in]pType      The enemy's type, as on the map
+ * @param  [ in]x          Position, as on the map
+ * @param  [ in]y          Position, as on the map
+ * @param  [ in]w          Dimensions, as on the map
+ * @param  [ in]h          Dimensions, as on the map
+ * @param  [ in]sector     Sector that spawned the enemy (-1, if always
+ *                         loaded)
+ * @param  [ in]index      Index of the enemy within its sector (-1, if
+ *                         always loaded)
  */
-gfmRV gamestate_init() {
-    gamestate *pGamestate;
-    gfmCamera *pCam;
-    gfmParser *pParser;
+static gfmRV gamestate_spawnEnemy(gamestate *pGamestate, char *pType, int x,
+        int y, int w, int h, int sector, int index) {
+    enemy *pEnemy;
     gfmRV rv;
+    int i, type;
 
-    pParser = 0;
-
-    pGamestate = (gamestate*)malloc(sizeof(gamestate));
-    ASSERT(pGamestate, GFMRV_ALLOC_FAILED);
-    memset(pGamestate, 0x0, sizeof(gamestate));
-
-    rv = textManager_init(&(pGame->pTextManager), 0, 0, BBWDT / 8, 7, 1);
-    ASSERT(rv == GFMRV_OK, rv);
+    if (strcmp("lil_tank", pType) == 0) {
+        type = LIL_TANK;
+    }
+    else if (strcmp("turret", pType) == 0) {
+        type = TURRET;
+    }
+    else {
+#if defined(DEBUG) && !(defined(__WIN32) || defined(__WIN32__))
+        raise(SIGINT);
+#endif
+        ASSERT(0, GFMRV_INTERNAL_ERROR);
+    }
 
-    /* Initialize everything */
-    /* Load the map */
-    rv = gfmTilemap_getNew(&(pGamestate->pTm));
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmTilemap_init(pGamestate->pTm, pAssets->pSset8x8, 100/*widthInTiles*/,
-            40/*heightInTiles*/, -1/*defTile*/);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmTilemap_loadf(pGamestate->pTm, pGame->pCtx, "game_tile.gfm", 13, (char**)pTmDict,
-            (int*)tmDictType, tmDictLen);
-    ASSERT(rv == GFMRV_OK, rv);
+    pEnemy = 0;
+    i = 0;
+    while (i < gfmGenArr_getUsed(pGamestate->pEnes)) {
+        pEnemy = gfmGenArr_getObject(pGamestate->pEnes, i);
+        if (enemy_isActive(pEnemy) == GFMRV_FALSE) {
+            break;
+        }
+        i++;
+    }
+    if (i == gfmGenArr_getUsed(pGamestate->pEnes)) {
+        gfmGenArr_getNextRef(enemy, pGamestate->pEnes, 1, pEnemy, enemy_getNew);
+        gfmGenArr_push(pGamestate->pEnes);
+    }
 
-    rv = gfmTilemap_getDimension(&(pGame->width), &(pGame->height),
-            pGamestate->pTm);
+    rv = enemy_init(pEnemy, type, x, y, w, h, sector, index);
     ASSERT(rv == GFMRV_OK, rv);
 
-    /* Parse and spawn stuff */
-    rv = gfmParser_getNew(&pParser);
-    ASSERT(rv == GFMRV_OK, rv);
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
 
-    rv = gfmParser_initStatic(pParser, pGame->pCtx, "game_obj.gfm");
-    ASSERT(rv == GFMRV_OK, rv);
+/**
+ * Spawn every object on a parser
+ *
+ * @param  [ in]pGamestate The game state
+ * @param  [ in]pParser    The parser
+ * @param  [ in]sector     Sector that spawned the objects (-1, if always
+ *                         loaded)
+ */
+static gfmRV gamestate_spawnObjects(gamestate *pGamestate, gfmParser *pParser,
+        int sector) {
+    gfmRV rv;
 
     while (1) {
         gfmParserType type;
@@ -136,22 +165,17 @@ gfmRV gamestate_init() {
             rv = gfmParser_getIngameType(&pType, pParser);
             ASSERT(rv == GFMRV_OK, rv);
 
-            if (strcmp("lil_tank", pType) == 0) {
-                enemy *pEnemy;
+            if (strcmp("lil_tank", pType) == 0 ||
+                    strcmp("turret", pType) == 0) {
+                int h, w, x, y;
 
-                gfmGenArr_getNextRef(enemy, pGamestate->pEnes, 1, pEnemy, enemy_getNew);
-                gfmGenArr_push(pGamestate->pEnes);
-
-                rv = enemy_init(pEnemy, pParser, LIL_TANK);
+                rv = gfmParser_getPos(&x, &y, pParser);
+                ASSERT(rv == GFMRV_OK, rv);
+                rv = gfmParser_getDimensions(&w, &h, pParser);
                 ASSERT(rv == GFMRV_OK, rv);
-            }
-            else if (strcmp("turret", pType) == 0) {
-                enemy *pEnemy;
-
-                gfmGenArr_getNextRef(enemy, pGamestate->pEnes, 1, pEnemy, enemy_getNew);
-                gfmGenArr_push(pGamestate->pEnes);
 
-                rv = enemy_init(pEnemy, pParser, TURRET);
+                rv = gamestate_spawnEnemy(pGamestate, pType, x, y, w, h,
+                        sector, -1/*index*/);
                 ASSERT(rv == GFMRV_OK, rv);
             }
             else if (strcmp("player", pType) == 0) {
@@ -161,6 +185,8 @@ gfmRV gamestate_init() {
                 ASSERT(rv == GFMRV_OK, rv);
                 x += 16;
                 y -= 32;
+                pGamestate->spawnX = x;
+                pGamestate->spawnY = y;
 
                 rv = player_init(&(pGamestate->pPlayer), x, y);
                 ASSERT(rv == GFMRV_OK, rv);
@@ -178,6 +204,104 @@ gfmRV gamestate_init() {
         }
     }
 
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Spawn (or despawn) a sector's enemies, as it's installed (or released)
+ *
+ * The sector's file was already parsed by the level's loader thread, so this
+ * never touches the disk
+ *
+ * @param  [ in]pArg      The game state
+ * @param  [ in]sector    The sector
+ * @param  [ in]pSpawns   Objects on the sector's file
+ * @param  [ in]numSpawns Number of objects on pSpawns
+ * @param  [ in]isLoaded  Whether the sector was installed (or released)
+ */
+static gfmRV gamestate_onSector(void *pArg, int sector, levelSpawn *pSpawns,
+        int numSpawns, int isLoaded) {
+    gamestate *pGamestate;
+    gfmRV rv;
+    int i;
+
+    pGamestate = (gamestate*)pArg;
+
+    i = 0;
+    if (!isLoaded) {
+        while (i < gfmGenArr_getUsed(pGamestate->pEnes)) {
+            enemy *pEnemy;
+
+            pEnemy = gfmGenArr_getObject(pGamestate->pEnes, i);
+            if (enemy_getSector(pEnemy) == sector) {
+                enemy_despawn(pEnemy);
+            }
+
+            i++;
+        }
+    }
+    else {
+        while (i < numSpawns) {
+            levelSpawn *pSpawn;
+
+            pSpawn = pSpawns + i;
+            rv = gamestate_spawnEnemy(pGamestate, pSpawn->pName, pSpawn->x,
+                    pSpawn->y, pSpawn->width, pSpawn->height, sector,
+                    pSpawn->index);
+            ASSERT(rv == GFMRV_OK, rv);
+
+            i++;
+        }
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Initialize the game state
+ *
+ * NOTE: pState will be overwritten!
+ */
+gfmRV gamestate_init() {
+    char pFile[GAMESTATE_PATH_LEN];
+    gamestate *pGamestate;
+    gfmCamera *pCam;
+    gfmParser *pParser;
+    gfmRV rv;
+    int len;
+
+    pParser = 0;
+
+    pGamestate = (gamestate*)malloc(sizeof(gamestate));
+    ASSERT(pGamestate, GFMRV_ALLOC_FAILED);
+    memset(pGamestate, 0x0, sizeof(gamestate));
+
+    rv = textManager_init(&(pGame->pTextManager), 0, 0, BBWDT / 8, 7, 1);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    /* Initialize everything */
+    /* The level was opened while loading; Its sectors are streamed as the
+     * camera moves */
+    level_setCallback(pGame->pLevel, pAssets->pSset8x8, gamestate_onSector,
+            pGamestate);
+    level_getDimensions(&(pGame->width), &(pGame->height), pGame->pLevel);
+
+    /* Parse and spawn whatever is always loaded */
+    rv = gfmParser_getNew(&pParser);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    len = snprintf(pFile, sizeof(pFile), "%sobjects.gfm", pGame->pLevelDir);
+    ASSERT(len < (int)sizeof(pFile), GFMRV_ARGUMENTS_BAD);
+    rv = gfmParser_init(pParser, pGame->pCtx, pFile, len);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = gamestate_spawnObjects(pGamestate, pParser, -1/*sector*/);
+    ASSERT(rv == GFMRV_OK, rv);
+
     pCam = 0;
     rv = gfm_getCamera(&pCam, pGame->pCtx);
     ASSERT(rv == GFMRV_OK, rv);
@@ -190,6 +314,19 @@ gfmRV gamestate_init() {
     rv = gfmCamera_setDeadzone(pCam, 16/*x*/, 0/*y*/, 96/*w*/, 240);
     ASSERT(rv == GFMRV_OK, rv);
 
+    /* Wait for the sectors around the player, so it doesn't start falling */
+    do {
+        int camH, camW, camX, camY;
+
+        gfmCamera_centerAtPoint(pCam, pGamestate->spawnX, pGamestate->spawnY);
+        rv = gfmCamera_getPosition(&camX, &camY, pCam);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmCamera_getDimensions(&camW, &camH, pCam);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = level_update(pGame->pLevel, camX, camW, 1/*doWait*/);
+        ASSERT(rv == GFMRV_OK, rv);
+    } while (0);
+
     pState = pGamestate;
     rv = GFMRV_OK;
 __ret:
@@ -207,14 +344,37 @@ gfmRV gamestate_update() {
     int i;
 
     pGamestate = (gamestate*)pState;
+    /* Nothing should be allocated on a steady state */
+    alloc_enter(ALLOC_UPDATE);
 
-    rv = gfmQuadtree_initRoot(pGame->pQt, -16, -16, pGame->width, pGame->height,
-            6 /* maxDepth */, 10 /* maxNodes */);
+    rv = broadphase_reset(pGame->pBroadphase, -16, -16, pGame->width,
+            pGame->height);
     ASSERT(rv == GFMRV_OK, rv);
 
-    rv = gfmTilemap_update(pGamestate->pTm, pGame->pCtx);
+    /* Stream the sectors (and listen to the sounds) around the camera (as
+     * of the last tick) */
+    do {
+        gfmCamera *pCam;
+        int camH, camW, camX, camY;
+
+        rv = gfm_getCamera(&pCam, pGame->pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmCamera_getPosition(&camX, &camY, pCam);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmCamera_getDimensions(&camW, &camH, pCam);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = level_update(pGame->pLevel, camX, camW, 0/*doWait*/);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = mixer_setListener(pGame->pMixer, camX + camW / 2,
+                camY + camH / 2);
+        ASSERT(rv == GFMRV_OK, rv);
+    } while (0);
+
+    rv = level_populateBroadphase(pGame->pLevel, pGame->pBroadphase,
+            pGame->pCtx);
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmQuadtree_populateTilemap(pGame->pQt, pGamestate->pTm);
+    /* Sleeping props must be there before the enemies (that push them) */
+    rv = spritePool_populate(pGame->pProps);
     ASSERT(rv == GFMRV_OK, rv);
 
     /* Update the game */
@@ -229,6 +389,8 @@ gfmRV gamestate_update() {
 
         i++;
     }
+    rv = enemy_spawnShots();
+    ASSERT(rv == GFMRV_OK, rv);
 
     i = 0;
     while (i < gfmGenArr_getUsed(pGamestate->pChkPoints)) {
@@ -238,31 +400,35 @@ gfmRV gamestate_update() {
 
         rv = gfmObject_update(pObj, pGame->pCtx);
         ASSERT(rv == GFMRV_OK, rv);
-        rv = gfmQuadtree_populateObject(pGame->pQt, pObj);
+        rv = broadphase_populateObject(pGame->pBroadphase, pObj);
         ASSERT(rv == GFMRV_OK, rv);
 
         i++;
     }
 
-    rv = gfmGroup_update(pGame->pParticles, pGame->pCtx);
+    /* Integrate the particles and age the sprites in parallel; They only
+     * touch their own data (GFraMe, which isn't reentrant, moves the sprites
+     * on the post update) */
+    rv = particles_update(pGame->pParticles);
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_update(pGame->pBullets, pGame->pCtx);
+    rv = spritePool_update(pGame->pBullets);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_update(pGame->pProps);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = jobs_wait(pGame->pJobs);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = particles_postUpdate(pGame->pParticles);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_postUpdate(pGame->pBullets);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_postUpdate(pGame->pProps);
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmQuadtree_collideGroup(pGame->pQt, pGame->pBullets);
-    ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
-    if (rv == GFMRV_QUADTREE_OVERLAPED) {
-        rv = collide_run();
-        ASSERT(rv == GFMRV_OK, rv);
-    }
 
-    rv = gfmGroup_update(pGame->pProps, pGame->pCtx);
+    /* Collisions stay on this thread, so they are resolved deterministically */
+    rv = spritePool_collide(pGame->pBullets);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_collide(pGame->pProps);
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmQuadtree_collideGroup(pGame->pQt, pGame->pProps);
-    ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
-    if (rv == GFMRV_QUADTREE_OVERLAPED) {
-        rv = collide_run();
-        ASSERT(rv == GFMRV_OK, rv);
-    }
 
     rv = player_preUpdate(pGamestate->pPlayer);
     ASSERT(rv == GFMRV_OK, rv);
@@ -331,21 +497,42 @@ gfmRV gamestate_update() {
 
     rv = GFMRV_OK;
 __ret:
+    alloc_leave();
+
     return rv;
 }
 
-/** Render the current state as a gamestate */
-gfmRV gamestate_draw() {
+/**
+ * Record the visible tiles, every entity and the HUD of the current state
+ * into a new snapshot and publish it; Must be called from the update thread
+ */
+gfmRV gamestate_snapshot() {
     gamestate *pGamestate;
     gfmRV rv;
     int i;
 
     pGamestate = (gamestate*)pState;
 
-    /* Render the game */
-    rv = gfmTilemap_draw(pGamestate->pTm, pGame->pCtx);
+    rv = snapshot_begin(pGame->pSnapshot);
     ASSERT(rv == GFMRV_OK, rv);
 
+    /* The tiles go first, so they are drawn behind everything */
+    do {
+        gfmCamera *pCam;
+        int camH, camW, camX, camY;
+
+        rv = gfm_getCamera(&pCam, pGame->pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmCamera_getPosition(&camX, &camY, pCam);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmCamera_getDimensions(&camW, &camH, pCam);
+        ASSERT(rv == GFMRV_OK, rv);
+        /* Also push a tile around it, as the interpolated camera may lag */
+        rv = level_snapshot(pGame->pLevel, pGame->pSnapshot, camX - 8,
+                camY - 8, camW + 16, camH + 16);
+        ASSERT(rv == GFMRV_OK, rv);
+    } while (0);
+
     rv = player_draw(pGamestate->pPlayer);
     ASSERT(rv == GFMRV_OK, rv);
 
@@ -361,25 +548,57 @@ gfmRV gamestate_draw() {
         i++;
     }
 
-    rv = gfmGroup_draw(pGame->pParticles, pGame->pCtx);
+    rv = particles_draw(pGame->pParticles);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_draw(pGame->pBullets);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_draw(pGame->pProps);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    /* And the HUD, in front of everything */
+    rv = textManager_snapshot(pGame->pTextManager, pGame->pSnapshot);
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_draw(pGame->pBullets, pGame->pCtx);
+
+    rv = snapshot_publish(pGame->pSnapshot);
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_draw(pGame->pProps, pGame->pCtx);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Render the current state as a gamestate; Runs on the render thread (with the
+ * world locked) and only draws the latest snapshot
+ */
+gfmRV gamestate_draw() {
+    gfmRV rv;
+    int camX, camY;
+
+    rv = snapshot_acquire(&camX, &camY, pGame->pSnapshot);
+    if (rv == GFMRV_FALSE) {
+        /* Nothing was recorded yet */
+        return GFMRV_OK;
+    }
     ASSERT(rv == GFMRV_OK, rv);
+    alloc_enter(ALLOC_DRAW);
 
-    rv = textManager_draw(pGame->pTextManager);
+    rv = snapshot_draw(pGame->pSnapshot);
     ASSERT(rv == GFMRV_OK, rv);
 
 #ifdef DEBUG
-    if (pGame->drawQt) {
-        rv = gfmQuadtree_drawBounds(pGame->pQt, pGame->pCtx, 0);
+    /* The broadphase isn't on the snapshot, so it's read from the world (and
+     * from the camera the update thread last set); Debug only */
+    if (pGame->drawQt && pGame->curState == state_game && pState) {
+        rv = broadphase_drawBounds(pGame->pBroadphase, pGame->pCtx);
         ASSERT(rv == GFMRV_OK, rv);
     }
 #endif
 
     rv = GFMRV_OK;
 __ret:
+    alloc_leave();
+
     return rv;
 }
 
@@ -394,9 +613,11 @@ void gamestate_clean() {
     pGamestate = (gamestate*)pState;
 
     /* TODO Release everything alloc'ed for the gamestate */
-    gfmTilemap_free(&(pGamestate->pTm));
+    level_reset(pGame->pLevel);
+    level_setCallback(pGame->pLevel, 0, 0, 0);
     player_clean(&(pGamestate->pPlayer));
     gfmGenArr_clean(pGamestate->pEnes, enemy_clean);
+    enemy_cleanShots();
     gfmGenArr_clean(pGamestate->pChkPoints, gfmObject_free);
     textManager_clean(&(pGame->pTextManager));
 
@@ -0,0 +1,274 @@
+/**
+ * Event-driven input
+ *
+ * @file src/input.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmInput.h>
+
+#include <ld34/input.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of events that may be queued between two ticks */
+#define INPUT_QUEUE_LEN 64
+
+struct stInputEvent {
+    /** When the events that reported the change were pumped */
+    double time;
+    /** Which button changed */
+    int index;
+    /** Whether it was pressed (or released) */
+    int isPressed;
+};
+typedef struct stInputEvent inputEvent;
+
+struct stInput {
+    /** Every queued event, in order */
+    inputEvent pQueue[INPUT_QUEUE_LEN];
+    /** GFraMe's virtual key of every button */
+    int pHandles[INPUT_MAX_BUTTONS];
+    /** When each button was last pressed */
+    double pPressTime[INPUT_MAX_BUTTONS];
+    /** When each button was last released */
+    double pReleaseTime[INPUT_MAX_BUTTONS];
+    /** Protects the queue */
+    pthread_mutex_t mutex;
+    /** Number of buttons */
+    int numButtons;
+    /** Number of queued events */
+    int numEvents;
+    /** Buttons held as of the last queued events (render thread) */
+    unsigned int polled;
+    /** Buttons held on the current tick (update thread) */
+    unsigned int pressed;
+    /** Buttons pressed since the last tick */
+    unsigned int justPressed;
+    /** Buttons released since the last tick */
+    unsigned int justReleased;
+};
+
+/**
+ * Queue an event; Must be called with the mutex
+ *
+ * @param  [ in]pCtx      The input
+ * @param  [ in]index     Which button changed
+ * @param  [ in]isPressed Whether it was pressed (or released)
+ * @param  [ in]time      When it happened
+ */
+static void input_queue(input *pCtx, int index, int isPressed, double time) {
+    inputEvent *pEv;
+
+    /* If the update thread falls that far behind, drop the oldest */
+    if (pCtx->numEvents == INPUT_QUEUE_LEN) {
+        memmove(pCtx->pQueue, pCtx->pQueue + 1,
+                sizeof(inputEvent) * (INPUT_QUEUE_LEN - 1));
+        pCtx->numEvents--;
+    }
+
+    pEv = pCtx->pQueue + pCtx->numEvents;
+    pEv->time = time;
+    pEv->index = index;
+    pEv->isPressed = isPressed;
+    pCtx->numEvents++;
+}
+
+/**
+ * Alloc the input
+ *
+ * @param  [out]ppCtx      The input
+ * @param  [ in]pHandles   GFraMe's virtual key of every button; The n-th
+ *                         button is reported on the n-th bit
+ * @param  [ in]numButtons Number of buttons
+ */
+gfmRV input_init(input **ppCtx, int *pHandles, int numButtons) {
+    gfmRV rv;
+
+    *ppCtx = 0;
+    ASSERT(numButtons > 0 && numButtons <= INPUT_MAX_BUTTONS,
+            GFMRV_ARGUMENTS_BAD);
+
+    *ppCtx = (input*)malloc(sizeof(input));
+    ASSERT(*ppCtx, GFMRV_ALLOC_FAILED);
+    memset(*ppCtx, 0x0, sizeof(input));
+
+    pthread_mutex_init(&((*ppCtx)->mutex), 0);
+    memcpy((*ppCtx)->pHandles, pHandles, sizeof(int) * numButtons);
+    (*ppCtx)->numButtons = numButtons;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Release the input
+ *
+ * @param  [ in]ppCtx The input
+ */
+void input_clean(input **ppCtx) {
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+
+    pthread_mutex_destroy(&((*ppCtx)->mutex));
+    free(*ppCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Queue every press and release reported by the events that were just
+ * handled (on the render thread)
+ *
+ * @param  [ in]pCtx     The input
+ * @param  [ in]pGfm     GFraMe's context
+ * @param  [ in]pumpTime When the events were pumped (from clock_getTime)
+ */
+gfmRV input_poll(input *pCtx, gfmCtx *pGfm, double pumpTime) {
+    gfmRV rv;
+    unsigned int polled;
+    int i;
+
+    polled = pCtx->polled;
+    pthread_mutex_lock(&(pCtx->mutex));
+    i = 0;
+    while (i < pCtx->numButtons) {
+        gfmInputState state;
+        unsigned int bit;
+        int num;
+
+        rv = gfm_getKeyState(&state, &num, pGfm, pCtx->pHandles[i]);
+        ASSERT(rv == GFMRV_OK, rv);
+        bit = 1u << i;
+
+        /* GFraMe clears the 'just' flags as it handles events, so these are
+         * the edges since the last pump; If the button ended the other way
+         * around from what was last queued, the opposite edge also happened
+         * on this pump (e.g., a tap) */
+        if ((state & gfmInput_justPressed) == gfmInput_justPressed) {
+            if (polled & bit) {
+                input_queue(pCtx, i, 0/*isPressed*/, pumpTime);
+            }
+            input_queue(pCtx, i, 1/*isPressed*/, pumpTime);
+            polled |= bit;
+        }
+        else if ((state & gfmInput_justReleased) == gfmInput_justReleased) {
+            if (!(polled & bit)) {
+                input_queue(pCtx, i, 1/*isPressed*/, pumpTime);
+            }
+            input_queue(pCtx, i, 0/*isPressed*/, pumpTime);
+            polled &= ~bit;
+        }
+
+        i++;
+    }
+    pCtx->polled = polled;
+
+    rv = GFMRV_OK;
+__ret:
+    pthread_mutex_unlock(&(pCtx->mutex));
+    return rv;
+}
+
+/**
+ * Drain every queued event into the current tick's state (on the update
+ * thread)
+ *
+ * @param  [ in]pCtx The input
+ */
+void input_update(input *pCtx) {
+    unsigned int changed, cur;
+    int i, j;
+
+    changed = 0;
+    cur = pCtx->pressed;
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    i = 0;
+    while (i < pCtx->numEvents) {
+        inputEvent *pEv;
+        unsigned int bit;
+
+        pEv = pCtx->pQueue + i;
+        bit = 1u << pEv->index;
+        /* Leave the rest for the next tick, so a tap (press and release
+         * before a tick) is seen as a press and then as a release */
+        if (changed & bit) {
+            break;
+        }
+
+        if (pEv->isPressed) {
+            cur |= bit;
+            pCtx->pPressTime[pEv->index] = pEv->time;
+        }
+        else {
+            cur &= ~bit;
+            pCtx->pReleaseTime[pEv->index] = pEv->time;
+        }
+        changed |= bit;
+        i++;
+    }
+    /* A button pressed on this tick may have its release already queued
+     * (i.e., it was tapped); Its time is known already, so the hold may be
+     * cut short on this tick (even though the edge comes on the next one) */
+    j = i;
+    while (j < pCtx->numEvents) {
+        inputEvent *pEv;
+
+        pEv = pCtx->pQueue + j;
+        if (!pEv->isPressed && (cur & changed & (1u << pEv->index)) &&
+                pCtx->pReleaseTime[pEv->index] <
+                pCtx->pPressTime[pEv->index]) {
+            pCtx->pReleaseTime[pEv->index] = pEv->time;
+        }
+        j++;
+    }
+    pCtx->numEvents -= i;
+    if (pCtx->numEvents > 0) {
+        memmove(pCtx->pQueue, pCtx->pQueue + i,
+                sizeof(inputEvent) * pCtx->numEvents);
+    }
+    pthread_mutex_unlock(&(pCtx->mutex));
+
+    pCtx->justPressed = cur & ~pCtx->pressed;
+    pCtx->justReleased = ~cur & pCtx->pressed;
+    pCtx->pressed = cur;
+}
+
+/**
+ * Retrieve the current tick's state, as bitsets (one bit per button)
+ *
+ * @param  [out]pPressed      Buttons currently held
+ * @param  [out]pJustPressed  Buttons pressed since the last tick
+ * @param  [out]pJustReleased Buttons released since the last tick
+ * @param  [ in]pCtx          The input
+ */
+void input_getState(unsigned int *pPressed, unsigned int *pJustPressed,
+        unsigned int *pJustReleased, input *pCtx) {
+    *pPressed = pCtx->pressed;
+    *pJustPressed = pCtx->justPressed;
+    *pJustReleased = pCtx->justReleased;
+}
+
+/**
+ * Retrieve when a button last changed; Times come from clock_getTime
+ *
+ * If a button was pressed and released between two ticks, its release time
+ * is already reported on the tick it's pressed (so the release time may be
+ * later than the press time, even though the button is still held)
+ *
+ * @param  [out]pPressTime   When it was last pressed (0, if never)
+ * @param  [out]pReleaseTime When it was last released (0, if never)
+ * @param  [ in]pCtx         The input
+ * @param  [ in]index        The button
+ */
+void input_getTimes(double *pPressTime, double *pReleaseTime, input *pCtx,
+        int index) {
+    *pPressTime = pCtx->pPressTime[index];
+    *pReleaseTime = pCtx->pReleaseTime[index];
+}
+
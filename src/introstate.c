@@ -0,0 +1,301 @@
+/**
+ * Loading screen, shown while the assets are loaded
+ *
+ * @file src/introstate.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/bfxr.h>
+#include <ld34/game.h>
+#include <ld34/introstate.h>
+#include <ld34/level.h>
+#include <ld34/mixer.h>
+#include <ld34/music.h>
+#include <ld34/sfx.h>
+#include <ld34/snapshot.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Every step: the sound effects, the song, the level and the texture */
+#define INTRO_NUM_STEPS 4
+/** Length of the progress bar, in tiles */
+#define INTRO_BAR_LEN 20
+
+static const char *pTmDict[] = {
+    "floor"
+};
+static const int tmDictType[] = {
+    FLOOR
+};
+static const int tmDictLen = sizeof(tmDictType) / sizeof(int);
+
+/** Every sound effect's definition; Its index is the sound's id */
+static const char *pSfxNames[] = {
+    "left_step",
+    "right_step",
+    "ene_crushed",
+    "ene_explosion",
+    "pl_hurt",
+    "checkpoint",
+    "ene_shoot",
+    "text"
+};
+static const int sfxLen = sizeof(pSfxNames) / sizeof(char*);
+
+struct stIntrostate {
+    /** The worker loading the sound effects and the level */
+    pthread_t worker;
+    /** Whether the worker was created (and not yet joined) */
+    int didCreate;
+    /** Number of steps finished by the worker */
+    int numLoaded;
+    /** Whether the sound effects and the song were decoded, so the render
+     * thread may open the audio device */
+    int isDecoded;
+    /** Whether the worker finished (successfully or not) */
+    int isDone;
+    /** Worker's return value */
+    gfmRV workerRv;
+};
+typedef struct stIntrostate introstate;
+
+/**
+ * Worker thread; Renders (or maps from the cache) every sound effect, starts
+ * the song and opens the level, while the render thread uploads the texture
+ *
+ * Only file I/O and decoding are done here: the audio device (as everything
+ * else from SDL and GFraMe) is opened by the render thread, on
+ * introstate_openAudio
+ *
+ * @param  [ in]pArg The intro state
+ */
+static void* introstate_worker(void *pArg) {
+    introstate *pIntro;
+    gfmRV rv;
+
+    pIntro = (introstate*)pArg;
+
+    /* Also kept through every reset */
+    if (!pGame->pSfx) {
+        rv = sfx_init(&(pGame->pSfx), pGame->pAssetsPath, (char**)pSfxNames,
+                sfxLen);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+    /* Same order as pSfxNames */
+    pAssets->sfxLeftStep = 0;
+    pAssets->sfxRightStep = 1;
+    pAssets->sfxEnemyCrushed = 2;
+    pAssets->sfxEnemyExplosion = 3;
+    pAssets->sfxPlHurt = 4;
+    pAssets->sfxCheckpoint = 5;
+    pAssets->sfxEnemyShoot = 6;
+    pAssets->sfxText = 7;
+    __atomic_add_fetch(&(pIntro->numLoaded), 1, __ATOMIC_RELEASE);
+
+    /* The song keeps playing through every reset */
+    if (!pGame->pMusic) {
+        rv = music_init(&(pGame->pMusic), pGame->pAssetsPath, SONG,
+                BFXR_SAMPLE_RATE);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+    __atomic_add_fetch(&(pIntro->numLoaded), 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&(pIntro->isDecoded), 1, __ATOMIC_RELEASE);
+
+    /* Only opened once, and kept through every reset */
+    if (!pGame->pLevel) {
+        rv = level_init(&(pGame->pLevel), pGame->pAssetsPath,
+                pGame->pLevelDir, (char**)pTmDict, (int*)tmDictType,
+                tmDictLen);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+    __atomic_add_fetch(&(pIntro->numLoaded), 1, __ATOMIC_RELEASE);
+
+    rv = GFMRV_OK;
+__ret:
+    pIntro->workerRv = rv;
+    __atomic_store_n(&(pIntro->isDone), 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * Initialize the intro state and start loading the assets
+ *
+ * NOTE: pState will be overwritten!
+ */
+gfmRV introstate_init() {
+    introstate *pIntro;
+    gfmRV rv;
+
+    pIntro = (introstate*)malloc(sizeof(introstate));
+    ASSERT(pIntro, GFMRV_ALLOC_FAILED);
+    memset(pIntro, 0x0, sizeof(introstate));
+
+    if (pthread_create(&(pIntro->worker), 0, introstate_worker, pIntro) != 0) {
+        free(pIntro);
+        ASSERT(0, GFMRV_INTERNAL_ERROR);
+    }
+    pIntro->didCreate = 1;
+
+    pState = pIntro;
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/** Update the current state as an intro state; Starts the game once loaded */
+gfmRV introstate_update() {
+    introstate *pIntro;
+    gfmRV rv;
+
+    pIntro = (introstate*)pState;
+
+    if (pIntro->didCreate) {
+        if (!__atomic_load_n(&(pIntro->isDone), __ATOMIC_ACQUIRE)) {
+            return GFMRV_OK;
+        }
+        pthread_join(pIntro->worker, 0);
+        pIntro->didCreate = 0;
+        ASSERT(pIntro->workerRv == GFMRV_OK, pIntro->workerRv);
+    }
+
+    /* The texture and the audio device are loaded by the render thread (with
+     * the world locked) */
+    if (!pAssets->pSset8x8 || !pGame->pMixer) {
+        return GFMRV_OK;
+    }
+
+    pGame->nextState = state_game;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Open the audio device, once the worker decoded the sound effects and the
+ * song; Must be called from the render thread (which owns SDL), with the
+ * world locked
+ */
+gfmRV introstate_openAudio() {
+    introstate *pIntro;
+    gfmRV rv;
+
+    rv = GFMRV_OK;
+
+    pIntro = (introstate*)pState;
+    /* The mixer is kept through every reset */
+    if (pGame->curState == state_intro && pIntro && !pGame->pMixer &&
+            __atomic_load_n(&(pIntro->isDecoded), __ATOMIC_ACQUIRE)) {
+        rv = mixer_init(&(pGame->pMixer), pGame->pSfx);
+        if (rv == GFMRV_OK) {
+            rv = mixer_setMusic(pGame->pMixer, pGame->pMusic);
+        }
+    }
+
+    return rv;
+}
+
+/**
+ * Draw a string, from the 8x8 spriteset's font
+ *
+ * @param  [ in]x    Horizontal position
+ * @param  [ in]y    Vertical position
+ * @param  [ in]pStr The string
+ */
+static gfmRV introstate_drawText(int x, int y, char *pStr) {
+    gfmRV rv;
+
+    while (*pStr) {
+        if (*pStr != ' ') {
+            rv = gfm_drawTile(pGame->pCtx, pAssets->pSset8x8, x, y,
+                    *pStr - '!', 0/*isFlipped*/);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        x += 8;
+        pStr++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Draw the progress bar
+ *
+ * @param  [ in]pIntro The intro state
+ */
+static gfmRV introstate_drawProgress(introstate *pIntro) {
+    char pBar[INTRO_BAR_LEN + 1];
+    gfmRV rv;
+    int i, num;
+
+    /* The texture counts as a step, even though it isn't the worker's */
+    num = __atomic_load_n(&(pIntro->numLoaded), __ATOMIC_ACQUIRE) + 1;
+    num = num * INTRO_BAR_LEN / INTRO_NUM_STEPS;
+    i = 0;
+    while (i < INTRO_BAR_LEN) {
+        if (i < num) {
+            pBar[i] = '=';
+        }
+        else {
+            pBar[i] = '-';
+        }
+        i++;
+    }
+    pBar[INTRO_BAR_LEN] = '\0';
+
+    rv = introstate_drawText((BBWDT - 7 * 8) / 2, BBHGT / 2 - 16, "LOADING");
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = introstate_drawText((BBWDT - INTRO_BAR_LEN * 8) / 2, BBHGT / 2,
+            pBar);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Render the loading progress; Runs on the render thread (with the world
+ * locked) and only draws anything after the texture was loaded
+ */
+gfmRV introstate_draw() {
+    gfmRV rv;
+
+    rv = GFMRV_OK;
+
+    /* Only the background is presented until the texture is loaded */
+    if (pGame->curState == state_intro && pState && pAssets->pSset8x8) {
+        rv = introstate_drawProgress((introstate*)pState);
+    }
+
+    return rv;
+}
+
+/**
+ * Free all intro state related resources
+ *
+ * NOTE: pState will be overwritten!
+ */
+void introstate_clean() {
+    introstate *pIntro;
+
+    pIntro = (introstate*)pState;
+    if (!pIntro) {
+        return;
+    }
+
+    if (pIntro->didCreate) {
+        pthread_join(pIntro->worker, 0);
+    }
+
+    free(pState);
+    pState = 0;
+}
+
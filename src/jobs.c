@@ -0,0 +1,434 @@
+/**
+ * Small job system, used to spread independent work across every core
+ *
+ * Each queue is a ring buffer protected by its own mutex: its owner pops jobs
+ * from the tail (so it keeps working on the most recent, and hottest, data)
+ * while the other threads steal from the head
+ *
+ * @file src/jobs.c
+ */
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/alloc.h>
+#include <ld34/jobs.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__WIN32) || defined(__WIN32__)
+#  include <windows.h>
+#else
+#  include <unistd.h>
+#endif
+
+/** Maximum number of worker threads */
+#define JOBS_MAX_WORKERS 15
+/** Number of jobs on each queue; Jobs that don't fit run as soon as pushed */
+#define JOBS_QUEUE_LEN 256
+
+struct stJob {
+    /** Function run by the job */
+    jobFunc func;
+    /** Argument passed to the function */
+    void *pArg;
+    /** First element on the range */
+    int first;
+    /** One past the last element on the range */
+    int last;
+    /** Allocation scope of the thread that pushed the job */
+    allocScope scope;
+};
+typedef struct stJob job;
+
+struct stJobQueue {
+    /** Protects everything below */
+    pthread_mutex_t mutex;
+    /** The queued jobs */
+    job pJobs[JOBS_QUEUE_LEN];
+    /** Oldest job (where thieves take from) */
+    int head;
+    /** One past the newest job (where the owner takes from) */
+    int tail;
+};
+typedef struct stJobQueue jobQueue;
+
+struct stJobWorker {
+    /** The job system */
+    jobs *pCtx;
+    /** Index of the worker's queue */
+    int id;
+};
+typedef struct stJobWorker jobWorker;
+
+struct stJobs {
+    /** Every worker's queue; The first one belongs to the pushing thread */
+    jobQueue pQueues[JOBS_MAX_WORKERS + 1];
+    /** Every worker thread */
+    pthread_t pThreads[JOBS_MAX_WORKERS];
+    /** Arguments for every worker thread */
+    jobWorker pWorkers[JOBS_MAX_WORKERS];
+    /** Protects the condition variables and 'quit' */
+    pthread_mutex_t mutex;
+    /** Signaled whenever jobs are pushed (or on quit) */
+    pthread_cond_t hasWork;
+    /** Signaled when the last pending job finishes */
+    pthread_cond_t isDone;
+    /** Number of jobs waiting on any queue */
+    volatile int numQueued;
+    /** Number of jobs that haven't finished yet */
+    volatile int numPending;
+    /** Error returned by the first job that failed */
+    volatile gfmRV err;
+    /** Number of worker threads */
+    int numWorkers;
+    /** Queue that shall receive the next job */
+    int next;
+    /** Whether the workers should exit */
+    int quit;
+};
+
+/**
+ * Retrieve the number of cores on the system
+ */
+static int jobs_getNumCores() {
+#if defined(__WIN32) || defined(__WIN32__)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long num;
+
+    num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num < 1) {
+        return 1;
+    }
+    return (int)num;
+#endif
+}
+
+/**
+ * Take a job from a queue
+ *
+ * @param  [out]pJob    The job
+ * @param  [ in]pQueue  The queue
+ * @param  [ in]isOwner Whether the job should be taken from the tail
+ * @return              Whether a job was taken
+ */
+static int jobs_take(job *pJob, jobQueue *pQueue, int isOwner) {
+    int ok;
+
+    ok = 0;
+    pthread_mutex_lock(&(pQueue->mutex));
+    if (pQueue->tail > pQueue->head) {
+        if (isOwner) {
+            pQueue->tail--;
+            *pJob = pQueue->pJobs[pQueue->tail % JOBS_QUEUE_LEN];
+        }
+        else {
+            *pJob = pQueue->pJobs[pQueue->head % JOBS_QUEUE_LEN];
+            pQueue->head++;
+        }
+        /* Rewind the indexes so they never overflow */
+        if (pQueue->head == pQueue->tail) {
+            pQueue->head = 0;
+            pQueue->tail = 0;
+        }
+        ok = 1;
+    }
+    pthread_mutex_unlock(&(pQueue->mutex));
+
+    return ok;
+}
+
+/**
+ * Retrieve a job from the thread's own queue or, if it's empty, steal one
+ * from another thread
+ *
+ * @param  [out]pJob The job
+ * @param  [ in]pCtx The job system
+ * @param  [ in]id   Index of the thread's queue
+ * @return           Whether a job was found
+ */
+static int jobs_find(job *pJob, jobs *pCtx, int id) {
+    int i, num;
+
+    if (__atomic_load_n(&(pCtx->numQueued), __ATOMIC_ACQUIRE) == 0) {
+        return 0;
+    }
+
+    num = pCtx->numWorkers + 1;
+    if (jobs_take(pJob, pCtx->pQueues + id, 1/*isOwner*/)) {
+        __sync_fetch_and_sub(&(pCtx->numQueued), 1);
+        return 1;
+    }
+    i = 1;
+    while (i < num) {
+        if (jobs_take(pJob, pCtx->pQueues + (id + i) % num, 0/*isOwner*/)) {
+            __sync_fetch_and_sub(&(pCtx->numQueued), 1);
+            return 1;
+        }
+        i++;
+    }
+
+    return 0;
+}
+
+/**
+ * Run a job and signal if it was the last pending one
+ *
+ * @param  [ in]pCtx The job system
+ * @param  [ in]pJob The job
+ */
+static void jobs_run(jobs *pCtx, job *pJob) {
+    allocScope scope;
+    gfmRV rv;
+
+    /* Attribute the job's allocations to whoever pushed it */
+    scope = alloc_getScope();
+    alloc_adopt(pJob->scope);
+    rv = pJob->func(pJob->pArg, pJob->first, pJob->last);
+    alloc_adopt(scope);
+    if (rv != GFMRV_OK) {
+        __sync_bool_compare_and_swap(&(pCtx->err), GFMRV_OK, rv);
+    }
+
+    if (__sync_sub_and_fetch(&(pCtx->numPending), 1) == 0) {
+        pthread_mutex_lock(&(pCtx->mutex));
+        pthread_cond_broadcast(&(pCtx->isDone));
+        pthread_mutex_unlock(&(pCtx->mutex));
+    }
+}
+
+/**
+ * Worker's main loop
+ *
+ * @param  [ in]pArg The worker (a jobWorker)
+ */
+static void* jobs_worker(void *pArg) {
+    jobWorker *pWorker;
+    jobs *pCtx;
+
+    pWorker = (jobWorker*)pArg;
+    pCtx = pWorker->pCtx;
+
+    while (1) {
+        job curJob;
+
+        if (jobs_find(&curJob, pCtx, pWorker->id)) {
+            jobs_run(pCtx, &curJob);
+            continue;
+        }
+
+        pthread_mutex_lock(&(pCtx->mutex));
+        while (!pCtx->quit &&
+                __atomic_load_n(&(pCtx->numQueued), __ATOMIC_ACQUIRE) == 0) {
+            pthread_cond_wait(&(pCtx->hasWork), &(pCtx->mutex));
+        }
+        if (pCtx->quit) {
+            pthread_mutex_unlock(&(pCtx->mutex));
+            break;
+        }
+        pthread_mutex_unlock(&(pCtx->mutex));
+    }
+
+    return 0;
+}
+
+/**
+ * Alloc the job system and spawn its workers
+ *
+ * @param  [out]ppCtx      The job system
+ * @param  [ in]numWorkers Number of worker threads (0 runs every job on the
+ *                         thread that calls jobs_wait), or JOBS_AUTO
+ */
+gfmRV jobs_init(jobs **ppCtx, int numWorkers) {
+    gfmRV rv;
+    int i;
+
+    *ppCtx = 0;
+    if (numWorkers == JOBS_AUTO) {
+        numWorkers = jobs_getNumCores() - 1;
+    }
+    ASSERT(numWorkers >= 0, GFMRV_ARGUMENTS_BAD);
+    if (numWorkers > JOBS_MAX_WORKERS) {
+        numWorkers = JOBS_MAX_WORKERS;
+    }
+
+    *ppCtx = (jobs*)malloc(sizeof(jobs));
+    ASSERT(*ppCtx, GFMRV_ALLOC_FAILED);
+    memset(*ppCtx, 0x0, sizeof(jobs));
+
+    pthread_mutex_init(&((*ppCtx)->mutex), 0);
+    pthread_cond_init(&((*ppCtx)->hasWork), 0);
+    pthread_cond_init(&((*ppCtx)->isDone), 0);
+    i = 0;
+    while (i < JOBS_MAX_WORKERS + 1) {
+        pthread_mutex_init(&((*ppCtx)->pQueues[i].mutex), 0);
+        i++;
+    }
+    (*ppCtx)->err = GFMRV_OK;
+
+    i = 0;
+    while (i < numWorkers) {
+        jobWorker *pWorker;
+
+        pWorker = (*ppCtx)->pWorkers + i;
+        pWorker->pCtx = *ppCtx;
+        pWorker->id = i + 1;
+
+        ASSERT(pthread_create((*ppCtx)->pThreads + i, 0, jobs_worker,
+                pWorker) == 0, GFMRV_INTERNAL_ERROR);
+        /* Only count workers that were actually spawned (so clean can join
+         * them) */
+        (*ppCtx)->numWorkers++;
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK) {
+        jobs_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Stop every worker and release the job system
+ *
+ * @param  [ in]ppCtx The job system
+ */
+void jobs_clean(jobs **ppCtx) {
+    int i;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+
+    pthread_mutex_lock(&((*ppCtx)->mutex));
+    (*ppCtx)->quit = 1;
+    pthread_cond_broadcast(&((*ppCtx)->hasWork));
+    pthread_mutex_unlock(&((*ppCtx)->mutex));
+
+    i = 0;
+    while (i < (*ppCtx)->numWorkers) {
+        pthread_join((*ppCtx)->pThreads[i], 0);
+        i++;
+    }
+
+    i = 0;
+    while (i < JOBS_MAX_WORKERS + 1) {
+        pthread_mutex_destroy(&((*ppCtx)->pQueues[i].mutex));
+        i++;
+    }
+    pthread_cond_destroy(&((*ppCtx)->isDone));
+    pthread_cond_destroy(&((*ppCtx)->hasWork));
+    pthread_mutex_destroy(&((*ppCtx)->mutex));
+
+    free(*ppCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Split [0, num) into ranges of (at most) grain elements and queue one job
+ * for each of those
+ *
+ * @param  [ in]pCtx  The job system
+ * @param  [ in]func  Function run by every job
+ * @param  [ in]pArg  Argument passed to every job
+ * @param  [ in]num   Number of elements
+ * @param  [ in]grain Maximum number of elements per job
+ */
+gfmRV jobs_push(jobs *pCtx, jobFunc func, void *pArg, int num, int grain) {
+    allocScope scope;
+    gfmRV rv;
+    int first;
+
+    ASSERT(func, GFMRV_ARGUMENTS_BAD);
+    ASSERT(num >= 0, GFMRV_ARGUMENTS_BAD);
+    ASSERT(grain > 0, GFMRV_ARGUMENTS_BAD);
+
+    scope = alloc_getScope();
+    first = 0;
+    while (first < num) {
+        jobQueue *pQueue;
+        job newJob;
+        int isQueued;
+
+        newJob.func = func;
+        newJob.pArg = pArg;
+        newJob.first = first;
+        newJob.scope = scope;
+        newJob.last = first + grain;
+        if (newJob.last > num) {
+            newJob.last = num;
+        }
+        first = newJob.last;
+
+        __sync_fetch_and_add(&(pCtx->numPending), 1);
+
+        pQueue = pCtx->pQueues + pCtx->next;
+        pCtx->next = (pCtx->next + 1) % (pCtx->numWorkers + 1);
+
+        isQueued = 0;
+        pthread_mutex_lock(&(pQueue->mutex));
+        if (pQueue->tail - pQueue->head < JOBS_QUEUE_LEN) {
+            pQueue->pJobs[pQueue->tail % JOBS_QUEUE_LEN] = newJob;
+            pQueue->tail++;
+            __sync_fetch_and_add(&(pCtx->numQueued), 1);
+            isQueued = 1;
+        }
+        pthread_mutex_unlock(&(pQueue->mutex));
+
+        if (!isQueued) {
+            jobs_run(pCtx, &newJob);
+        }
+    }
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    pthread_cond_broadcast(&(pCtx->hasWork));
+    pthread_mutex_unlock(&(pCtx->mutex));
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Help running the queued jobs and wait until every one has finished
+ *
+ * @param  [ in]pCtx The job system
+ * @return           GFMRV_OK or the error returned by the first job that
+ *                   failed
+ */
+gfmRV jobs_wait(jobs *pCtx) {
+    gfmRV rv;
+    job curJob;
+
+    while (jobs_find(&curJob, pCtx, 0/*id*/)) {
+        jobs_run(pCtx, &curJob);
+    }
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    while (__atomic_load_n(&(pCtx->numPending), __ATOMIC_ACQUIRE) > 0) {
+        pthread_cond_wait(&(pCtx->isDone), &(pCtx->mutex));
+    }
+    pthread_mutex_unlock(&(pCtx->mutex));
+
+    rv = __sync_lock_test_and_set(&(pCtx->err), GFMRV_OK);
+
+    return rv;
+}
+
+/**
+ * Retrieve the number of threads that run jobs (i.e., workers + the caller)
+ *
+ * @param  [ in]pCtx The job system
+ */
+int jobs_getNumThreads(jobs *pCtx) {
+    return pCtx->numWorkers + 1;
+}
+
@@ -0,0 +1,305 @@
+/**
+ * Frame pacing and input-to-present latency instrumentation
+ *
+ * @file src/latency.c
+ */
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/clock.h>
+#include <ld34/latency.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of samples kept for each metric (older ones are overwritten) */
+#define LATENCY_MAX_SAMPLES 4096
+
+enum enLatencyMetric {
+    LAT_TOTAL = 0,
+    LAT_EVENTS_TO_SAMPLE,
+    LAT_SAMPLE_TO_UPDATE,
+    LAT_UPDATE_TO_PRESENT,
+    LAT_FRAME_TIME,
+    LAT_MAX
+};
+typedef enum enLatencyMetric latencyMetric;
+
+static const char *pLatencyNames[LAT_MAX] = {
+    "input-to-present",
+    "  events-to-sample",
+    "  sample-to-update",
+    "  update-to-present",
+    "frame time"
+};
+
+struct stLatency {
+    /** Samples of every metric, in milliseconds */
+    float pSamples[LAT_MAX][LATENCY_MAX_SAMPLES];
+    /** Total number of samples taken for every metric */
+    int pNumSamples[LAT_MAX];
+    /** Synchronize both threads */
+    pthread_mutex_t mutex;
+    /** When events were last handled */
+    double eventsTime;
+    /** When the tracked input's events were handled */
+    double inputEventsTime;
+    /** When the tracked input was sampled */
+    double inputSampleTime;
+    /** When the tracked input's snapshot was published */
+    double inputUpdateTime;
+    /** When the last frame was presented */
+    double presentTime;
+    /** Snapshot that has the tracked input's effect (-1, if not published) */
+    int inputSeq;
+    /** Whether an input is being tracked */
+    int isTracking;
+};
+
+/**
+ * Store a sample
+ *
+ * @param  [ in]pCtx   The instrumentation
+ * @param  [ in]metric Which metric was measured
+ * @param  [ in]value  The sample, in milliseconds
+ */
+static void latency_addSample(latency *pCtx, latencyMetric metric,
+        double value) {
+    int i;
+
+    i = pCtx->pNumSamples[metric] % LATENCY_MAX_SAMPLES;
+    pCtx->pSamples[metric][i] = (float)value;
+    pCtx->pNumSamples[metric]++;
+}
+
+/**
+ * Alloc the instrumentation
+ *
+ * @param  [out]ppCtx The instrumentation
+ */
+gfmRV latency_init(latency **ppCtx) {
+    gfmRV rv;
+
+    *ppCtx = (latency*)malloc(sizeof(latency));
+    ASSERT(*ppCtx, GFMRV_ALLOC_FAILED);
+    memset(*ppCtx, 0x0, sizeof(latency));
+
+    pthread_mutex_init(&((*ppCtx)->mutex), 0);
+    (*ppCtx)->inputSeq = -1;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Release the instrumentation
+ *
+ * @param  [ in]ppCtx The instrumentation
+ */
+void latency_clean(latency **ppCtx) {
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+
+    pthread_mutex_destroy(&((*ppCtx)->mutex));
+    free(*ppCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Mark that events were just handled (on the render thread)
+ *
+ * @param  [ in]pCtx The instrumentation
+ */
+void latency_markEvents(latency *pCtx) {
+    if (!pCtx) {
+        return;
+    }
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    pCtx->eventsTime = clock_getTime();
+    pthread_mutex_unlock(&(pCtx->mutex));
+}
+
+/**
+ * Mark that a changed input was just sampled (on the update thread); Only the
+ * first input is tracked until it's presented
+ *
+ * @param  [ in]pCtx The instrumentation
+ */
+void latency_markInput(latency *pCtx) {
+    if (!pCtx) {
+        return;
+    }
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    if (!pCtx->isTracking) {
+        pCtx->inputEventsTime = pCtx->eventsTime;
+        pCtx->inputSampleTime = clock_getTime();
+        pCtx->inputSeq = -1;
+        pCtx->isTracking = 1;
+    }
+    pthread_mutex_unlock(&(pCtx->mutex));
+}
+
+/**
+ * Mark that the tick that consumed the tracked input published its snapshot
+ *
+ * @param  [ in]pCtx The instrumentation
+ * @param  [ in]seq  Sequence number of the published snapshot
+ */
+void latency_markUpdate(latency *pCtx, int seq) {
+    if (!pCtx) {
+        return;
+    }
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    if (pCtx->isTracking && pCtx->inputSeq == -1) {
+        pCtx->inputUpdateTime = clock_getTime();
+        pCtx->inputSeq = seq;
+    }
+    pthread_mutex_unlock(&(pCtx->mutex));
+}
+
+/**
+ * Mark that a frame was just presented (on the render thread)
+ *
+ * @param  [ in]pCtx The instrumentation
+ * @param  [ in]seq  Sequence number of the snapshot on the frame
+ */
+void latency_markPresent(latency *pCtx, int seq) {
+    double now;
+
+    if (!pCtx) {
+        return;
+    }
+
+    now = clock_getTime();
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    if (pCtx->presentTime > 0.0) {
+        latency_addSample(pCtx, LAT_FRAME_TIME, now - pCtx->presentTime);
+    }
+    pCtx->presentTime = now;
+
+    /* Snapshots may be skipped, so any newer one also has the input */
+    if (pCtx->isTracking && pCtx->inputSeq != -1 && seq >= pCtx->inputSeq) {
+        latency_addSample(pCtx, LAT_TOTAL, now - pCtx->inputEventsTime);
+        latency_addSample(pCtx, LAT_EVENTS_TO_SAMPLE,
+                pCtx->inputSampleTime - pCtx->inputEventsTime);
+        latency_addSample(pCtx, LAT_SAMPLE_TO_UPDATE,
+                pCtx->inputUpdateTime - pCtx->inputSampleTime);
+        latency_addSample(pCtx, LAT_UPDATE_TO_PRESENT,
+                now - pCtx->inputUpdateTime);
+        pCtx->isTracking = 0;
+        pCtx->inputSeq = -1;
+    }
+    pthread_mutex_unlock(&(pCtx->mutex));
+}
+
+/** Compare two samples, for qsort */
+static int latency_compare(const void *pA, const void *pB) {
+    float a, b;
+
+    a = *((const float*)pA);
+    b = *((const float*)pB);
+    if (a < b) {
+        return -1;
+    }
+    else if (a > b) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Write the percentiles of every measured leg, and the frame time jitter
+ *
+ * @param  [ in]pCtx      The instrumentation
+ * @param  [ in]pFilename The log file
+ */
+gfmRV latency_report(latency *pCtx, char *pFilename) {
+    float *pSorted;
+    FILE *pFp;
+    gfmRV rv;
+    int i;
+
+    if (!pCtx) {
+        return GFMRV_OK;
+    }
+
+    pFp = 0;
+    pSorted = (float*)malloc(sizeof(float) * LATENCY_MAX_SAMPLES);
+    ASSERT(pSorted, GFMRV_ALLOC_FAILED);
+
+    pFp = fopen(pFilename, "wt");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+
+    pthread_mutex_lock(&(pCtx->mutex));
+
+    fprintf(pFp, "%-20s %8s %8s %8s %8s %8s\n", "metric (ms)", "samples",
+            "p50", "p95", "p99", "max");
+    i = 0;
+    while (i < LAT_MAX) {
+        int num;
+
+        num = pCtx->pNumSamples[i];
+        if (num > LATENCY_MAX_SAMPLES) {
+            num = LATENCY_MAX_SAMPLES;
+        }
+        if (num == 0) {
+            fprintf(pFp, "%-20s %8i\n", pLatencyNames[i], 0);
+            i++;
+            continue;
+        }
+
+        memcpy(pSorted, pCtx->pSamples[i], sizeof(float) * num);
+        qsort(pSorted, num, sizeof(float), latency_compare);
+        fprintf(pFp, "%-20s %8i %8.2f %8.2f %8.2f %8.2f\n", pLatencyNames[i],
+                pCtx->pNumSamples[i], pSorted[num * 50 / 100],
+                pSorted[num * 95 / 100], pSorted[num * 99 / 100],
+                pSorted[num - 1]);
+
+        if (i == LAT_FRAME_TIME) {
+            double mean, var;
+            int j;
+
+            mean = 0.0;
+            j = 0;
+            while (j < num) {
+                mean += pSorted[j];
+                j++;
+            }
+            mean /= num;
+
+            var = 0.0;
+            j = 0;
+            while (j < num) {
+                var += (pSorted[j] - mean) * (pSorted[j] - mean);
+                j++;
+            }
+            var /= num;
+
+            fprintf(pFp, "%-20s %8s %8.2f (mean %.2f)\n", "frame jitter", "",
+                    sqrt(var), mean);
+        }
+
+        i++;
+    }
+
+    pthread_mutex_unlock(&(pCtx->mutex));
+
+    rv = GFMRV_OK;
+__ret:
+    if (pFp) {
+        fclose(pFp);
+    }
+    free(pSorted);
+
+    return rv;
+}
+
@@ -0,0 +1,1022 @@
+/**
+ * Streamed level
+ *
+ * @file src/level.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmObject.h>
+#include <GFraMe/gfmSpriteset.h>
+
+#include <ld34/broadphase.h>
+#include <ld34/level.h>
+#include <ld34/snapshot.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Longest accepted path */
+#define LEVEL_PATH_LEN 1024
+/** Longest accepted tile type name */
+#define LEVEL_NAME_LEN 64
+/** Maximum number of 'type' lines on a sector */
+#define LEVEL_MAX_TYPES 256
+/** Tiles are 8x8 */
+#define LEVEL_TILE_WIDTH 8
+/** Number of ints that describe an area (position, dimensions and type) */
+#define LEVEL_AREA_LEN 5
+/** Initial number of pooled area objects */
+#define LEVEL_INIT_AREAS 64
+
+enum enSectorState {
+    /** Not on memory */
+    SECTOR_UNLOADED = 0,
+    /** Waiting for the loader */
+    SECTOR_REQUESTED,
+    /** Being read by the loader */
+    SECTOR_LOADING,
+    /** Parsed, but not yet installed */
+    SECTOR_READY,
+    /** Has collision areas (and its objects were spawned) */
+    SECTOR_INSTALLED,
+    /** Couldn't be read */
+    SECTOR_FAILED
+};
+typedef enum enSectorState sectorState;
+
+struct stLevelSector {
+    /** Parsed tiles (while ready or installed); Drawn through the snapshot,
+     * so the render thread never reads the level */
+    int *pData;
+    /** Collision areas, as LEVEL_AREA_LEN ints each (only while ready) */
+    int *pAreas;
+    /** Collision areas; Alloc'ed by the loader (and only filled while
+     * installed) */
+    gfmObject **ppAreas;
+    /** Objects that start within the sector (while ready or installed) */
+    levelSpawn *pSpawns;
+    /** Number of objects on pSpawns */
+    int numSpawns;
+    /** One bit per object on the sector's file, set once it's killed; Kept
+     * while the sector is released, so killed objects stay dead */
+    unsigned char *pKilled;
+    /** Number of collision areas */
+    int numAreas;
+    /** Width of the sector, in tiles */
+    int width;
+    /** Number of objects on the sector */
+    int numObjects;
+    /** Whether the sector is installed; Only touched by the update thread */
+    int isInstalled;
+    /** Current state; Protected by the mutex */
+    sectorState state;
+};
+typedef struct stLevelSector levelSector;
+
+struct stLevel {
+    /** Every sector */
+    levelSector *pSectors;
+    /** Path to the level's directory */
+    char pPath[LEVEL_PATH_LEN];
+    /** Name of every tile type */
+    char **ppDictNames;
+    /** Type of every tile type */
+    int *pDictTypes;
+    /** Spriteset used by the tiles */
+    gfmSpriteset *pSset;
+    /** Called when a sector is installed/released */
+    levelCallback callback;
+    /** Passed to the callback */
+    void *pArg;
+    /** The loader thread */
+    pthread_t loader;
+    /** Protects every sector's state and the loader's flags */
+    pthread_mutex_t mutex;
+    /** Signaled when a sector is requested, loaded or on exit */
+    pthread_cond_t cond;
+    /** Number of tile types */
+    int dictLen;
+    /** Dimensions of the level, in tiles */
+    int width;
+    int height;
+    /** Width of every (but maybe the last) sector, in tiles */
+    int sectorWidth;
+    /** Number of sectors */
+    int numSectors;
+    /** Sector on the view's center; Nearer sectors are loaded first */
+    int center;
+    /** Whether the loader thread was created */
+    int didCreate;
+    /** Whether the loader should stop */
+    int doQuit;
+    /** Collision areas of released sectors, reused as others are installed
+     * (so no object is alloc'ed once enough were); Only touched by the
+     * update thread */
+    gfmObject **ppFreeAreas;
+    /** Number of objects that fit on ppFreeAreas */
+    int freeAreasLen;
+    /** Number of objects on ppFreeAreas */
+    int freeAreasUsed;
+    /** Number of area objects ever alloc'ed (all of which fit on
+     * ppFreeAreas) */
+    int numAreaObjs;
+};
+
+/**
+ * Merge the sector's typed tiles into as few rectangles as possible: Tiles of
+ * the same type are merged into horizontal runs, which are then merged with
+ * identical runs right above them
+ *
+ * @param  [out]ppAreas   The areas, as LEVEL_AREA_LEN ints each (in pixels)
+ * @param  [out]pNumAreas Number of areas
+ * @param  [ in]pData     The sector's tiles
+ * @param  [ in]width     The sector's width, in tiles
+ * @param  [ in]height    The sector's height, in tiles
+ * @param  [ in]pTypes    Tile types, as pairs of tile and type
+ * @param  [ in]typesLen  Number of ints on pTypes
+ * @param  [ in]x         The sector's horizontal position, in pixels
+ */
+static gfmRV level_getAreas(int **ppAreas, int *pNumAreas, int *pData,
+        int width, int height, int *pTypes, int typesLen, int x) {
+    gfmRV rv;
+    int *pAreas, *pRow, num, tx, ty;
+
+    pAreas = 0;
+    pRow = 0;
+    num = 0;
+
+    pAreas = (int*)malloc(sizeof(int) * LEVEL_AREA_LEN * width * height);
+    ASSERT(pAreas, GFMRV_ALLOC_FAILED);
+    pRow = (int*)malloc(sizeof(int) * width);
+    ASSERT(pRow, GFMRV_ALLOC_FAILED);
+
+    ty = 0;
+    while (ty < height) {
+        /* Type of every tile on the row (-1, if none) */
+        tx = 0;
+        while (tx < width) {
+            int i;
+
+            pRow[tx] = -1;
+            i = 0;
+            while (i < typesLen) {
+                if (pTypes[i] == pData[ty * width + tx]) {
+                    pRow[tx] = pTypes[i + 1];
+                    break;
+                }
+                i += 2;
+            }
+            tx++;
+        }
+
+        tx = 0;
+        while (tx < width) {
+            int i, len;
+
+            if (pRow[tx] == -1) {
+                tx++;
+                continue;
+            }
+            len = 1;
+            while (tx + len < width && pRow[tx + len] == pRow[tx]) {
+                len++;
+            }
+
+            /* Extend an area that ends right above, if it's as wide */
+            i = 0;
+            while (i < num) {
+                int *pArea;
+
+                pArea = pAreas + i * LEVEL_AREA_LEN;
+                if (pArea[1] + pArea[3] == ty * LEVEL_TILE_WIDTH &&
+                        pArea[0] == x + tx * LEVEL_TILE_WIDTH &&
+                        pArea[2] == len * LEVEL_TILE_WIDTH &&
+                        pArea[4] == pRow[tx]) {
+                    pArea[3] += LEVEL_TILE_WIDTH;
+                    break;
+                }
+                i++;
+            }
+            if (i == num) {
+                int *pArea;
+
+                pArea = pAreas + num * LEVEL_AREA_LEN;
+                pArea[0] = x + tx * LEVEL_TILE_WIDTH;
+                pArea[1] = ty * LEVEL_TILE_WIDTH;
+                pArea[2] = len * LEVEL_TILE_WIDTH;
+                pArea[3] = LEVEL_TILE_WIDTH;
+                pArea[4] = pRow[tx];
+                num++;
+            }
+
+            tx += len;
+        }
+        ty++;
+    }
+
+    *ppAreas = pAreas;
+    *pNumAreas = num;
+    pAreas = 0;
+    rv = GFMRV_OK;
+__ret:
+    free(pAreas);
+    free(pRow);
+
+    return rv;
+}
+
+/**
+ * Read the objects that start within a sector; Runs on the loader thread,
+ * without the mutex
+ *
+ * Sector files only hold enemies (see tools/splitlevel), which have no
+ * properties, so each line is simply 'obj <name> <x> <y> <width> <height>'
+ *
+ * @param  [ in]pCtx   The level
+ * @param  [ in]pSec   Where the parsed objects are stored
+ * @param  [ in]sector The sector's index
+ */
+static gfmRV level_readSpawns(level *pCtx, levelSector *pSec, int sector) {
+    char pPath[LEVEL_PATH_LEN], pKind[LEVEL_NAME_LEN], pName[LEVEL_NAME_LEN];
+    FILE *pFp;
+    gfmRV rv;
+    levelSpawn *pSpawns;
+    int num, numObjects;
+
+    pSpawns = 0;
+    num = 0;
+    /* Only set on level_init, so it's safe to read here */
+    numObjects = pCtx->pSectors[sector].numObjects;
+
+    snprintf(pPath, sizeof(pPath), "%ssector_%03i_obj.gfm",
+            pCtx->pPath, sector);
+    pFp = fopen(pPath, "rt");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+
+    pSpawns = (levelSpawn*)malloc(sizeof(levelSpawn) * numObjects);
+    ASSERT(pSpawns, GFMRV_ALLOC_FAILED);
+
+    while (fscanf(pFp, "%63s", pKind) == 1) {
+        levelSpawn *pSpawn;
+
+        ASSERT(strcmp(pKind, "obj") == 0, GFMRV_READ_ERROR);
+        ASSERT(num < numObjects, GFMRV_READ_ERROR);
+        pSpawn = pSpawns + num;
+        ASSERT(fscanf(pFp, "%63s %i %i %i %i", pName, &(pSpawn->x),
+                &(pSpawn->y), &(pSpawn->width), &(pSpawn->height)) == 5,
+                GFMRV_READ_ERROR);
+        ASSERT(strlen(pName) < LEVEL_SPAWN_NAME_LEN, GFMRV_READ_ERROR);
+        strcpy(pSpawn->pName, pName);
+        pSpawn->index = num;
+        num++;
+    }
+
+    pSec->pSpawns = pSpawns;
+    pSec->numSpawns = num;
+    pSpawns = 0;
+    rv = GFMRV_OK;
+__ret:
+    if (pFp) {
+        fclose(pFp);
+    }
+    free(pSpawns);
+
+    return rv;
+}
+
+/**
+ * Read and parse a sector; Runs on the loader thread, without the mutex
+ *
+ * @param  [ in]pCtx   The level
+ * @param  [ in]pSec   Where the parsed data is stored
+ * @param  [ in]sector The sector's index
+ */
+static gfmRV level_readSector(level *pCtx, levelSector *pSec, int sector) {
+    char pPath[LEVEL_PATH_LEN], pToken[LEVEL_NAME_LEN];
+    FILE *pFp;
+    gfmRV rv;
+    gfmObject **ppAreas;
+    int h, i, *pAreas, *pData, *pTypes, numAreas, typesLen, w;
+
+    ppAreas = 0;
+    pAreas = 0;
+    pData = 0;
+    pTypes = 0;
+    typesLen = 0;
+    w = 0;
+    h = 0;
+
+    snprintf(pPath, sizeof(pPath), "%ssector_%03i_tile.gfm",
+            pCtx->pPath, sector);
+    pFp = fopen(pPath, "rt");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+
+    pTypes = (int*)malloc(sizeof(int) * LEVEL_MAX_TYPES * 2);
+    ASSERT(pTypes, GFMRV_ALLOC_FAILED);
+
+    while (fscanf(pFp, "%63s", pToken) == 1) {
+        if (strcmp(pToken, "type") == 0) {
+            int tile;
+
+            ASSERT(fscanf(pFp, "%63s %i", pToken, &tile) == 2,
+                    GFMRV_READ_ERROR);
+            ASSERT(typesLen < LEVEL_MAX_TYPES * 2, GFMRV_READ_ERROR);
+
+            i = 0;
+            while (i < pCtx->dictLen) {
+                if (strcmp(pToken, pCtx->ppDictNames[i]) == 0) {
+                    break;
+                }
+                i++;
+            }
+            ASSERT(i < pCtx->dictLen, GFMRV_READ_ERROR);
+
+            pTypes[typesLen] = tile;
+            pTypes[typesLen + 1] = pCtx->pDictTypes[i];
+            typesLen += 2;
+        }
+        else if (strcmp(pToken, "map") == 0) {
+            ASSERT(fscanf(pFp, "%i %i", &w, &h) == 2, GFMRV_READ_ERROR);
+            ASSERT(w > 0 && h == pCtx->height, GFMRV_READ_ERROR);
+            break;
+        }
+        else {
+            ASSERT(0, GFMRV_READ_ERROR);
+        }
+    }
+    ASSERT(w > 0, GFMRV_READ_ERROR);
+
+    pData = (int*)malloc(sizeof(int) * w * h);
+    ASSERT(pData, GFMRV_ALLOC_FAILED);
+    i = 0;
+    while (i < w * h) {
+        ASSERT(fscanf(pFp, "%i", pData + i) == 1, GFMRV_READ_ERROR);
+        i++;
+    }
+
+    rv = level_getAreas(&pAreas, &numAreas, pData, w, h, pTypes, typesLen,
+            sector * pCtx->sectorWidth * LEVEL_TILE_WIDTH);
+    ASSERT(rv == GFMRV_OK, rv);
+    /* Filled on install, but alloc'ed here to keep it off the update thread */
+    ppAreas = (gfmObject**)calloc(numAreas + 1, sizeof(gfmObject*));
+    ASSERT(ppAreas, GFMRV_ALLOC_FAILED);
+
+    if (pCtx->pSectors[sector].numObjects > 0) {
+        rv = level_readSpawns(pCtx, pSec, sector);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    pSec->pData = pData;
+    pSec->pAreas = pAreas;
+    pSec->ppAreas = ppAreas;
+    pSec->numAreas = numAreas;
+    pSec->width = w;
+    pData = 0;
+    pAreas = 0;
+    ppAreas = 0;
+    rv = GFMRV_OK;
+__ret:
+    if (pFp) {
+        fclose(pFp);
+    }
+    free(pData);
+    free(pTypes);
+    free(pAreas);
+    free(ppAreas);
+
+    return rv;
+}
+
+/**
+ * Loader thread; Reads the requested sectors, nearest to the view first
+ *
+ * @param  [ in]pArg The level
+ */
+static void* level_loaderThread(void *pArg) {
+    level *pCtx;
+
+    pCtx = (level*)pArg;
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    while (!pCtx->doQuit) {
+        levelSector sec;
+        gfmRV rv;
+        int best, dist, i;
+
+        best = -1;
+        dist = 0;
+        i = 0;
+        while (i < pCtx->numSectors) {
+            if (pCtx->pSectors[i].state == SECTOR_REQUESTED) {
+                int tmp;
+
+                tmp = abs(i - pCtx->center);
+                if (best == -1 || tmp < dist) {
+                    best = i;
+                    dist = tmp;
+                }
+            }
+            i++;
+        }
+        if (best == -1) {
+            pthread_cond_wait(&(pCtx->cond), &(pCtx->mutex));
+            continue;
+        }
+
+        pCtx->pSectors[best].state = SECTOR_LOADING;
+        pthread_mutex_unlock(&(pCtx->mutex));
+
+        memset(&sec, 0x0, sizeof(levelSector));
+        rv = level_readSector(pCtx, &sec, best);
+
+        pthread_mutex_lock(&(pCtx->mutex));
+        if (pCtx->pSectors[best].state != SECTOR_LOADING) {
+            /* Released while it was being read */
+            free(sec.pData);
+            free(sec.pAreas);
+            free(sec.ppAreas);
+            free(sec.pSpawns);
+        }
+        else if (rv != GFMRV_OK) {
+            free(sec.pData);
+            free(sec.pAreas);
+            free(sec.ppAreas);
+            free(sec.pSpawns);
+            pCtx->pSectors[best].state = SECTOR_FAILED;
+        }
+        else {
+            pCtx->pSectors[best].pData = sec.pData;
+            pCtx->pSectors[best].pAreas = sec.pAreas;
+            pCtx->pSectors[best].ppAreas = sec.ppAreas;
+            pCtx->pSectors[best].numAreas = sec.numAreas;
+            pCtx->pSectors[best].pSpawns = sec.pSpawns;
+            pCtx->pSectors[best].numSpawns = sec.numSpawns;
+            pCtx->pSectors[best].width = sec.width;
+            pCtx->pSectors[best].state = SECTOR_READY;
+        }
+        pthread_cond_broadcast(&(pCtx->cond));
+    }
+    pthread_mutex_unlock(&(pCtx->mutex));
+
+    return 0;
+}
+
+/**
+ * Read the level's index and start the loader thread
+ *
+ * @param  [out]ppCtx       The level
+ * @param  [ in]pAssetsPath Path to the assets directory (with a trailing '/')
+ * @param  [ in]pLevelDir   The level's directory, relative to the assets (with
+ *                          a trailing '/')
+ * @param  [ in]ppDictNames Name of every tile type
+ * @param  [ in]pDictTypes  Type of every tile type
+ * @param  [ in]dictLen     Number of tile types
+ */
+gfmRV level_init(level **ppCtx, char *pAssetsPath, char *pLevelDir,
+        char **ppDictNames, int *pDictTypes, int dictLen) {
+    char pPath[LEVEL_PATH_LEN];
+    FILE *pFp;
+    gfmRV rv;
+    level *pCtx;
+    int i;
+
+    *ppCtx = 0;
+    pFp = 0;
+    ASSERT(strlen(pAssetsPath) + strlen(pLevelDir) < LEVEL_PATH_LEN,
+            GFMRV_ARGUMENTS_BAD);
+
+    pCtx = (level*)malloc(sizeof(level));
+    ASSERT(pCtx, GFMRV_ALLOC_FAILED);
+    memset(pCtx, 0x0, sizeof(level));
+    *ppCtx = pCtx;
+
+    pthread_mutex_init(&(pCtx->mutex), 0);
+    pthread_cond_init(&(pCtx->cond), 0);
+    snprintf(pCtx->pPath, LEVEL_PATH_LEN, "%s%s", pAssetsPath, pLevelDir);
+    pCtx->ppDictNames = ppDictNames;
+    pCtx->pDictTypes = pDictTypes;
+    pCtx->dictLen = dictLen;
+
+    snprintf(pPath, sizeof(pPath), "%slevel.txt", pCtx->pPath);
+    pFp = fopen(pPath, "rt");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+
+    ASSERT(fscanf(pFp, "level %i %i %i %i", &(pCtx->width), &(pCtx->height),
+            &(pCtx->sectorWidth), &(pCtx->numSectors)) == 4,
+            GFMRV_READ_ERROR);
+    ASSERT(pCtx->width > 0 && pCtx->height > 0 && pCtx->sectorWidth > 0 &&
+            pCtx->numSectors > 0, GFMRV_READ_ERROR);
+
+    pCtx->pSectors = (levelSector*)malloc(sizeof(levelSector) *
+            pCtx->numSectors);
+    ASSERT(pCtx->pSectors, GFMRV_ALLOC_FAILED);
+    memset(pCtx->pSectors, 0x0, sizeof(levelSector) * pCtx->numSectors);
+
+    i = 0;
+    while (i < pCtx->numSectors) {
+        int index, num;
+
+        ASSERT(fscanf(pFp, " sector %i %i", &index, &num) == 2,
+                GFMRV_READ_ERROR);
+        ASSERT(index >= 0 && index < pCtx->numSectors, GFMRV_READ_ERROR);
+        pCtx->pSectors[index].numObjects = num;
+        if (num > 0) {
+            pCtx->pSectors[index].pKilled = (unsigned char*)calloc(
+                    (num + 7) / 8, sizeof(unsigned char));
+            ASSERT(pCtx->pSectors[index].pKilled, GFMRV_ALLOC_FAILED);
+        }
+        i++;
+    }
+
+    ASSERT(pthread_create(&(pCtx->loader), 0, level_loaderThread, pCtx) == 0,
+            GFMRV_INTERNAL_ERROR);
+    pCtx->didCreate = 1;
+
+    rv = GFMRV_OK;
+__ret:
+    if (pFp) {
+        fclose(pFp);
+    }
+    if (rv != GFMRV_OK) {
+        level_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Release a sector's tiles and collision areas; The areas' objects are kept
+ * for the next installed sectors
+ *
+ * @param  [ in]pCtx The level
+ * @param  [ in]pSec The sector
+ */
+static void level_uninstall(level *pCtx, levelSector *pSec) {
+    int i;
+
+    free(pSec->pData);
+    free(pSec->pSpawns);
+    pSec->pData = 0;
+    pSec->pSpawns = 0;
+    pSec->numSpawns = 0;
+    pSec->isInstalled = 0;
+    i = 0;
+    while (pSec->ppAreas && i < pSec->numAreas) {
+        /* Every object fits, as ppFreeAreas grows with numAreaObjs */
+        if (pSec->ppAreas[i]) {
+            pCtx->ppFreeAreas[pCtx->freeAreasUsed] = pSec->ppAreas[i];
+            pCtx->freeAreasUsed++;
+        }
+        i++;
+    }
+    free(pSec->ppAreas);
+    pSec->ppAreas = 0;
+}
+
+/**
+ * Stop the loader thread and release every sector; Objects aren't despawned
+ *
+ * @param  [ in]ppCtx The level
+ */
+void level_clean(level **ppCtx) {
+    level *pCtx;
+    int i;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+    pCtx = *ppCtx;
+
+    if (pCtx->didCreate) {
+        pthread_mutex_lock(&(pCtx->mutex));
+        pCtx->doQuit = 1;
+        pthread_cond_broadcast(&(pCtx->cond));
+        pthread_mutex_unlock(&(pCtx->mutex));
+        pthread_join(pCtx->loader, 0);
+    }
+
+    i = 0;
+    while (pCtx->pSectors && i < pCtx->numSectors) {
+        level_uninstall(pCtx, pCtx->pSectors + i);
+        free(pCtx->pSectors[i].pAreas);
+        free(pCtx->pSectors[i].pKilled);
+        i++;
+    }
+    free(pCtx->pSectors);
+    while (pCtx->freeAreasUsed > 0) {
+        pCtx->freeAreasUsed--;
+        gfmObject_free(&(pCtx->ppFreeAreas[pCtx->freeAreasUsed]));
+    }
+    free(pCtx->ppFreeAreas);
+
+    pthread_cond_destroy(&(pCtx->cond));
+    pthread_mutex_destroy(&(pCtx->mutex));
+    free(pCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Set how sectors are installed; Until a spriteset is set, sectors are only
+ * read (but not installed)
+ *
+ * @param  [ in]pCtx     The level
+ * @param  [ in]pSset    Spriteset used by the tiles
+ * @param  [ in]callback Called when a sector is installed/released (may be
+ *                       NULL)
+ * @param  [ in]pArg     Passed to the callback
+ */
+void level_setCallback(level *pCtx, gfmSpriteset *pSset,
+        levelCallback callback, void *pArg) {
+    pCtx->pSset = pSset;
+    pCtx->callback = callback;
+    pCtx->pArg = pArg;
+}
+
+/**
+ * Mark an object spawned by a sector as killed, so it isn't spawned again
+ * whenever its sector gets reinstalled (until the level is reset)
+ *
+ * @param  [ in]pCtx   The level
+ * @param  [ in]sector The sector that spawned the object
+ * @param  [ in]index  The object's index (from its levelSpawn)
+ */
+void level_killSpawn(level *pCtx, int sector, int index) {
+    levelSector *pSec;
+
+    if (sector < 0 || sector >= pCtx->numSectors) {
+        return;
+    }
+    pSec = pCtx->pSectors + sector;
+    if (index < 0 || index >= pSec->numObjects) {
+        return;
+    }
+
+    /* Only touched by the update thread, so the mutex isn't needed */
+    pSec->pKilled[index / 8] |= 1 << (index % 8);
+}
+
+/**
+ * Release every installed sector, without calling the callback (e.g., because
+ * every object is being released as well), and forget which objects were
+ * killed; Sectors already read are kept
+ *
+ * @param  [ in]pCtx The level
+ */
+void level_reset(level *pCtx) {
+    int i;
+
+    i = 0;
+    while (i < pCtx->numSectors) {
+        if (pCtx->pSectors[i].pKilled) {
+            memset(pCtx->pSectors[i].pKilled, 0x0,
+                    (pCtx->pSectors[i].numObjects + 7) / 8);
+        }
+        if (pCtx->pSectors[i].isInstalled) {
+            level_uninstall(pCtx, pCtx->pSectors + i);
+            /* Only the update thread touches installed sectors, but the state
+             * is still protected by the mutex */
+            pthread_mutex_lock(&(pCtx->mutex));
+            pCtx->pSectors[i].state = SECTOR_UNLOADED;
+            pthread_mutex_unlock(&(pCtx->mutex));
+        }
+        i++;
+    }
+}
+
+/**
+ * Retrieve the level's dimensions
+ *
+ * @param  [out]pWidth  The width, in pixels
+ * @param  [out]pHeight The height, in pixels
+ * @param  [ in]pCtx    The level
+ */
+void level_getDimensions(int *pWidth, int *pHeight, level *pCtx) {
+    *pWidth = pCtx->width * LEVEL_TILE_WIDTH;
+    *pHeight = pCtx->height * LEVEL_TILE_WIDTH;
+}
+
+/**
+ * Create a parsed sector's collision areas and spawn its objects; Must be
+ * called without the mutex (the sector is no longer touched by the loader)
+ *
+ * @param  [ in]pCtx   The level
+ * @param  [ in]sector The sector
+ */
+static gfmRV level_install(level *pCtx, int sector) {
+    gfmRV rv;
+    levelSector *pSec;
+    int i, num;
+
+    pSec = pCtx->pSectors + sector;
+    pSec->isInstalled = 1;
+
+    /* The floor is collided through objects of its own, so it works with any
+     * broadphase; Those are taken from released sectors, if possible */
+    i = 0;
+    while (i < pSec->numAreas) {
+        int *pArea;
+
+        pArea = pSec->pAreas + i * LEVEL_AREA_LEN;
+        if (pCtx->freeAreasUsed > 0) {
+            pCtx->freeAreasUsed--;
+            pSec->ppAreas[i] = pCtx->ppFreeAreas[pCtx->freeAreasUsed];
+        }
+        else {
+            /* Grown beforehand, so releasing never allocs */
+            if (pCtx->numAreaObjs == pCtx->freeAreasLen) {
+                gfmObject **ppTmp;
+                int len;
+
+                len = pCtx->freeAreasLen * 2;
+                if (len == 0) {
+                    len = LEVEL_INIT_AREAS;
+                }
+                ppTmp = (gfmObject**)realloc(pCtx->ppFreeAreas,
+                        sizeof(gfmObject*) * len);
+                ASSERT(ppTmp, GFMRV_ALLOC_FAILED);
+                pCtx->ppFreeAreas = ppTmp;
+                pCtx->freeAreasLen = len;
+            }
+            rv = gfmObject_getNew(pSec->ppAreas + i);
+            ASSERT(rv == GFMRV_OK, rv);
+            pCtx->numAreaObjs++;
+        }
+        rv = gfmObject_init(pSec->ppAreas[i], pArea[0], pArea[1], pArea[2],
+                pArea[3], 0/*pChild*/, pArea[4]);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmObject_setFixed(pSec->ppAreas[i]);
+        ASSERT(rv == GFMRV_OK, rv);
+        i++;
+    }
+
+    /* Only the tiles are kept */
+    free(pSec->pAreas);
+    pSec->pAreas = 0;
+
+    /* Drop whatever was killed the last time the sector was installed (the
+     * spawns are parsed again on every load, so they may be discarded) */
+    num = 0;
+    i = 0;
+    while (i < pSec->numSpawns) {
+        int index;
+
+        index = pSec->pSpawns[i].index;
+        if (!(pSec->pKilled[index / 8] & (1 << (index % 8)))) {
+            pSec->pSpawns[num] = pSec->pSpawns[i];
+            num++;
+        }
+        i++;
+    }
+    pSec->numSpawns = num;
+
+    if (pCtx->callback) {
+        rv = pCtx->callback(pCtx->pArg, sector, pSec->pSpawns,
+                pSec->numSpawns, 1/*isLoaded*/);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Request the sectors around the view, install the ones that were loaded and
+ * release the ones far from it; The world must be locked by the caller
+ *
+ * @param  [ in]pCtx   The level
+ * @param  [ in]x      View's horizontal position
+ * @param  [ in]width  View's width
+ * @param  [ in]doWait Whether to wait until the visible sectors are loaded
+ */
+gfmRV level_update(level *pCtx, int x, int width, int doWait) {
+    gfmRV rv;
+    int first, i, isLocked, last, secWidth;
+
+    isLocked = 0;
+
+    secWidth = pCtx->sectorWidth * LEVEL_TILE_WIDTH;
+    if (x < 0) {
+        width += x;
+        x = 0;
+    }
+    first = x / secWidth;
+    last = (x + width - 1) / secWidth;
+
+    pthread_mutex_lock(&(pCtx->mutex));
+    isLocked = 1;
+
+    pCtx->center = (first + last) / 2;
+    i = 0;
+    while (i < pCtx->numSectors) {
+        levelSector *pSec;
+
+        pSec = pCtx->pSectors + i;
+        ASSERT(pSec->state != SECTOR_FAILED, GFMRV_READ_ERROR);
+
+        if (i >= first - LEVEL_LOAD_MARGIN && i <= last + LEVEL_LOAD_MARGIN &&
+                pSec->state == SECTOR_UNLOADED) {
+            pSec->state = SECTOR_REQUESTED;
+        }
+        else if (i < first - LEVEL_KEEP_MARGIN ||
+                i > last + LEVEL_KEEP_MARGIN) {
+            switch (pSec->state) {
+                case SECTOR_INSTALLED: {
+                    pSec->state = SECTOR_UNLOADED;
+                    pthread_mutex_unlock(&(pCtx->mutex));
+                    isLocked = 0;
+
+                    level_uninstall(pCtx, pSec);
+                    if (pCtx->callback) {
+                        rv = pCtx->callback(pCtx->pArg, i, 0/*pSpawns*/,
+                                0/*numSpawns*/, 0/*isLoaded*/);
+                        ASSERT(rv == GFMRV_OK, rv);
+                    }
+
+                    pthread_mutex_lock(&(pCtx->mutex));
+                    isLocked = 1;
+                } break;
+                case SECTOR_READY: {
+                    free(pSec->pData);
+                    free(pSec->pAreas);
+                    free(pSec->ppAreas);
+                    free(pSec->pSpawns);
+                    pSec->pData = 0;
+                    pSec->pAreas = 0;
+                    pSec->ppAreas = 0;
+                    pSec->pSpawns = 0;
+                    pSec->numSpawns = 0;
+                    pSec->state = SECTOR_UNLOADED;
+                } break;
+                /* If loading, the loader will discard it */
+                case SECTOR_REQUESTED:
+                case SECTOR_LOADING: pSec->state = SECTOR_UNLOADED; break;
+                default: {}
+            }
+        }
+        i++;
+    }
+    pthread_cond_broadcast(&(pCtx->cond));
+
+    if (doWait) {
+        /* Block until every visible sector was read */
+        i = first;
+        while (i <= last && i < pCtx->numSectors) {
+            sectorState state;
+
+            state = pCtx->pSectors[i].state;
+            ASSERT(state != SECTOR_FAILED, GFMRV_READ_ERROR);
+            if (state == SECTOR_REQUESTED || state == SECTOR_LOADING) {
+                pthread_cond_wait(&(pCtx->cond), &(pCtx->mutex));
+                continue;
+            }
+            i++;
+        }
+    }
+
+    /* Install whatever is ready */
+    i = 0;
+    while (pCtx->pSset && i < pCtx->numSectors) {
+        if (pCtx->pSectors[i].state == SECTOR_READY) {
+            pCtx->pSectors[i].state = SECTOR_INSTALLED;
+            pthread_mutex_unlock(&(pCtx->mutex));
+            isLocked = 0;
+
+            rv = level_install(pCtx, i);
+            ASSERT(rv == GFMRV_OK, rv);
+
+            pthread_mutex_lock(&(pCtx->mutex));
+            isLocked = 1;
+        }
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    if (isLocked) {
+        pthread_mutex_unlock(&(pCtx->mutex));
+    }
+
+    return rv;
+}
+
+/**
+ * Add every installed sector's collision areas to the broadphase
+ *
+ * @param  [ in]pCtx The level
+ * @param  [ in]pBp  The broadphase
+ * @param  [ in]pGfm GFraMe's context
+ */
+gfmRV level_populateBroadphase(level *pCtx, broadphase *pBp, gfmCtx *pGfm) {
+    gfmRV rv;
+    int i;
+
+    /* Only the update thread installs and releases sectors, so they may be
+     * accessed without the mutex */
+    i = 0;
+    while (i < pCtx->numSectors) {
+        levelSector *pSec;
+        int j;
+
+        pSec = pCtx->pSectors + i;
+        i++;
+        if (!pSec->isInstalled) {
+            continue;
+        }
+
+        j = 0;
+        while (j < pSec->numAreas) {
+            rv = gfmObject_update(pSec->ppAreas[j], pGfm);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = broadphase_populateObject(pBp, pSec->ppAreas[j]);
+            ASSERT(rv == GFMRV_OK, rv);
+            j++;
+        }
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Push every installed tile inside the view into the snapshot being recorded
+ * (on the update thread)
+ *
+ * @param  [ in]pCtx      The level
+ * @param  [ in]pSnapshot The snapshots
+ * @param  [ in]x         View's horizontal position
+ * @param  [ in]y         View's vertical position
+ * @param  [ in]width     View's width
+ * @param  [ in]height    View's height
+ */
+gfmRV level_snapshot(level *pCtx, snapshot *pSnapshot, int x, int y,
+        int width, int height) {
+    gfmRV rv;
+    int i, secWidth, ty0, ty1;
+
+    secWidth = pCtx->sectorWidth * LEVEL_TILE_WIDTH;
+    ty0 = y / LEVEL_TILE_WIDTH;
+    ty1 = (y + height - 1) / LEVEL_TILE_WIDTH;
+    if (ty0 < 0) {
+        ty0 = 0;
+    }
+    if (ty1 >= pCtx->height) {
+        ty1 = pCtx->height - 1;
+    }
+
+    i = 0;
+    while (i < pCtx->numSectors) {
+        levelSector *pSec;
+        int secX, tx0, tx1, ty;
+
+        pSec = pCtx->pSectors + i;
+        secX = i * secWidth;
+        i++;
+        if (!pSec->isInstalled || x + width <= secX) {
+            continue;
+        }
+
+        /* View's columns, relative to the sector */
+        tx0 = (x - secX) / LEVEL_TILE_WIDTH;
+        tx1 = (x + width - 1 - secX) / LEVEL_TILE_WIDTH;
+        if (tx0 >= pSec->width) {
+            continue;
+        }
+        if (tx0 < 0) {
+            tx0 = 0;
+        }
+        if (tx1 >= pSec->width) {
+            tx1 = pSec->width - 1;
+        }
+
+        ty = ty0;
+        while (ty <= ty1) {
+            int tx;
+
+            tx = tx0;
+            while (tx <= tx1) {
+                int tile;
+
+                tile = pSec->pData[ty * pSec->width + tx];
+                if (tile >= 0) {
+                    rv = snapshot_pushTile(pSnapshot, pCtx->pSset,
+                            secX + tx * LEVEL_TILE_WIDTH,
+                            ty * LEVEL_TILE_WIDTH, tile, 0/*isFlipped*/,
+                            0/*pOwner*/, 0/*part*/);
+                    ASSERT(rv == GFMRV_OK, rv);
+                }
+                tx++;
+            }
+            ty++;
+        }
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
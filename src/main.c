@@ -4,16 +4,29 @@
  * @file src/main.c
  */
 #include <GFraMe/gframe.h>
-#include <GFraMe/gfmGroup.h>
 #include <GFraMe/gfmAssert.h>
 #include <GFraMe/gfmError.h>
 #include <GFraMe/gfmSave.h>
-#include <GFraMe/gfmQuadtree.h>
-#include <GFraMe/core/gfmAudio_bkend.h>
 
+#include <ld34/alloc.h>
+#include <ld34/broadphase.h>
+#include <ld34/clock.h>
+#include <ld34/collide.h>
+#include <ld34/config.h>
 #include <ld34/game.h>
 #include <ld34/gamestate.h>
-
+#include <ld34/introstate.h>
+#include <ld34/jobs.h>
+#include <ld34/level.h>
+#include <ld34/mixer.h>
+#include <ld34/music.h>
+#include <ld34/particles.h>
+#include <ld34/sfx.h>
+#include <ld34/snapshot.h>
+#include <ld34/spritePool.h>
+
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,62 +51,64 @@ static int grp_anim_data[] = {
 };
 static int grp_anim_dataLen = sizeof(grp_anim_data) / sizeof(int);
 
+/** Requests from the update thread that the render thread must handle (as
+ * they touch the window), as a bitset */
+enum enMainRequest {
+    MAIN_REQ_QUIT       = 0x1,
+    MAIN_REQ_FULLSCREEN = 0x2,
+    MAIN_REQ_GIF        = 0x4
+};
+/** Pending requests (enMainRequest) */
+static volatile int main_requests;
+
+/**
+ * Drain the input events into the buttons' states; Each button is the bit at
+ * its position on gameButtons
+ */
 static gfmRV main_updateButtons() {
-    gfmRV rv;
+    button *pList;
+    unsigned int justPressed, justReleased, pressed;
+    int i;
 
-    rv = gfm_getKeyState(&(pButtons->left_legBack.state),
-            &(pButtons->left_legBack.num), pGame->pCtx,
-            pButtons->left_legBack.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->left_leg.state), &(pButtons->left_leg.num),
-            pGame->pCtx, pButtons->left_leg.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->right_legBack.state),
-            &(pButtons->right_legBack.num), pGame->pCtx,
-            pButtons->right_legBack.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->right_leg.state),
-            &(pButtons->right_leg.num), pGame->pCtx,
-            pButtons->right_leg.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->left_start.state),
-            &(pButtons->left_start.num), pGame->pCtx,
-            pButtons->left_start.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->right_start.state),
-            &(pButtons->right_start.num), pGame->pCtx,
-            pButtons->right_start.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->quit.state), &(pButtons->quit.num),
-            pGame->pCtx, pButtons->quit.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->fullscreen.state),
-            &(pButtons->fullscreen.num), pGame->pCtx,
-            pButtons->fullscreen.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->drawQt.state), &(pButtons->drawQt.num),
-            pGame->pCtx, pButtons->drawQt.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->reset.state), &(pButtons->reset.num),
-            pGame->pCtx, pButtons->reset.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->gif.state), &(pButtons->gif.num),
-            pGame->pCtx, pButtons->gif.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->run.state), &(pButtons->run.num),
-            pGame->pCtx, pButtons->run.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->next.state), &(pButtons->next.num),
-            pGame->pCtx, pButtons->next.handle);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_getKeyState(&(pButtons->pause.state), &(pButtons->pause.num),
-            pGame->pCtx, pButtons->pause.handle);
-    ASSERT(rv == GFMRV_OK, rv);
+    input_update(pGame->pInput);
+    input_getState(&pressed, &justPressed, &justReleased, pGame->pInput);
+
+    pList = (button*)pButtons;
+    i = 0;
+    while (i < NUM_BUTTONS) {
+        unsigned int bit;
+
+        bit = 1u << i;
+        if (justPressed & bit) {
+            pList[i].state = gfmInput_justPressed;
+        }
+        else if (justReleased & bit) {
+            pList[i].state = gfmInput_justReleased;
+        }
+        else if (pressed & bit) {
+            pList[i].state = gfmInput_pressed;
+        }
+        else {
+            pList[i].state = gfmInput_released;
+        }
+        if ((justPressed | justReleased) & bit) {
+            input_getTimes(&(pList[i].pressTime), &(pList[i].releaseTime),
+                    pGame->pInput, i);
+        }
+        i++;
+    }
+
+    /* Track when a gameplay input changed, to measure its latency */
+    if ((pButtons->left_leg.state | pButtons->left_legBack.state |
+            pButtons->right_leg.state | pButtons->right_legBack.state |
+            pButtons->left_start.state | pButtons->right_start.state) &
+            gfmInput_justAction) {
+        latency_markInput(pGame->pLatency);
+    }
 
     if ((pButtons->quit.state & gfmInput_justReleased) ==
             gfmInput_justReleased) {
-        rv = gfm_setQuitFlag(pGame->pCtx);
-        ASSERT(rv == GFMRV_OK, rv);
+        __atomic_or_fetch(&main_requests, MAIN_REQ_QUIT, __ATOMIC_RELEASE);
     }
 
     if ((pButtons->drawQt.state & gfmInput_justReleased) ==
@@ -111,11 +126,7 @@ static gfmRV main_updateButtons() {
     if ((pButtons->gif.state & gfmInput_justReleased) ==
             gfmInput_justReleased) {
 #ifdef DEBUG
-        rv =  gfm_didExportGif(pGame->pCtx);
-        if (rv == GFMRV_TRUE || rv == GFMRV_GIF_OPERATION_NOT_ACTIVE) {
-            rv = gfm_recordGif(pGame->pCtx, 10000, "anim.gif", 8, 0);
-            ASSERT(rv == GFMRV_OK, rv);
-        }
+        __atomic_or_fetch(&main_requests, MAIN_REQ_GIF, __ATOMIC_RELEASE);
 #endif
     }
 
@@ -141,6 +152,29 @@ static gfmRV main_updateButtons() {
 
     if ((pButtons->fullscreen.state & gfmInput_justReleased) ==
             gfmInput_justReleased) {
+        __atomic_or_fetch(&main_requests, MAIN_REQ_FULLSCREEN,
+                __ATOMIC_RELEASE);
+    }
+
+    return GFMRV_OK;
+}
+
+/**
+ * Handle every request made by the update thread; Must be called from the
+ * render thread
+ */
+static gfmRV main_handleRequests() {
+    gfmRV rv;
+    int req;
+
+    req = __atomic_exchange_n(&main_requests, 0, __ATOMIC_ACQ_REL);
+
+    if (req & MAIN_REQ_QUIT) {
+        rv = gfm_setQuitFlag(pGame->pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    if (req & MAIN_REQ_FULLSCREEN) {
         if (pGame->isFullscreen) {
             rv = gfm_setWindowed(pGame->pCtx);
             ASSERT(rv == GFMRV_OK, rv);
@@ -153,100 +187,385 @@ static gfmRV main_updateButtons() {
         }
     }
 
+#ifdef DEBUG
+    if (req & MAIN_REQ_GIF) {
+        rv =  gfm_didExportGif(pGame->pCtx);
+        if (rv == GFMRV_TRUE || rv == GFMRV_GIF_OPERATION_NOT_ACTIVE) {
+            rv = gfm_recordGif(pGame->pCtx, 10000, "anim.gif", 8, 0);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+    }
+#endif
+
     rv = GFMRV_OK;
 __ret:
     return rv;
 }
 
-static gfmRV main_loop() {
+/** Initial number of particles/sprites on each pool */
+static int main_initParticles;
+/** Maximum number of particles/sprites on each pool */
+static int main_maxParticles;
+
+/**
+ * Load the texture and everything that depends on its spritesets; Must be
+ * called from the render thread (as it uploads the texture), with the world
+ * locked, after the first frame was presented, so the window shows up as soon
+ * as possible
+ *
+ * The 8x8 spriteset is only set after everything else is ready, signaling the
+ * loading screen that the texture was loaded
+ */
+static gfmRV main_loadTexture() {
+    gfmSpriteset *pSset8x8;
     gfmRV rv;
 
-    while (gfm_didGetQuitFlag(pGame->pCtx) != GFMRV_TRUE) {
-        /* Check if switching states */
-        if (pGame->nextState != state_none) {
-            /* Init the current state */
-            switch (pGame->nextState) {
-                case state_intro: ASSERT(0, GFMRV_FUNCTION_NOT_IMPLEMENTED); break;
-                case state_game: rv = gamestate_init(); break;
-                default: ASSERT(0, GFMRV_INTERNAL_ERROR);
-            }
-            ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_loadTextureStatic(&(pAssets->texHandle), pGame->pCtx, TEXATLAS,
+            COLORKEY);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_createSpritesetCached(&pSset8x8, pGame->pCtx, pAssets->texHandle,
+            8, 8);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_createSpritesetCached(&(pAssets->pSset16x16), pGame->pCtx,
+            pAssets->texHandle, 16, 16);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfm_createSpritesetCached(&(pAssets->pSset32x16), pGame->pCtx,
+            pAssets->texHandle, 32, 16);
+    ASSERT(rv == GFMRV_OK, rv);
 
-            pGame->curState = pGame->nextState;
-            pGame->nextState = state_none;
-        }
+    /* Create all particles groups */
+    rv = particles_init(&(pGame->pParticles), pSset8x8, grp_anim_data,
+            grp_anim_dataLen, 2/*w*/, 2/*h*/, -3/*ox*/, -3/*oy*/, PARTICLE_TTL,
+            1/*deathOnLeave*/, main_initParticles, main_maxParticles);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = spritePool_init(&(pGame->pBullets), BULLET, pSset8x8,
+            grp_anim_data, grp_anim_dataLen, 2/*w*/, 2/*h*/, -3/*ox*/, -3/*oy*/,
+            PARTICLE_TTL, main_initParticles, main_maxParticles);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = spritePool_init(&(pGame->pProps), PROP, pSset8x8,
+            grp_anim_data, grp_anim_dataLen, 2/*w*/, 2/*h*/, -3/*ox*/, -3/*oy*/,
+            PARTICLE_TTL, main_initParticles, main_maxParticles);
+    ASSERT(rv == GFMRV_OK, rv);
+
+#ifdef DEBUG
+    rv = gfm_initFPSCounter(pGame->pCtx, pSset8x8, 0/*firstTile*/);
+    ASSERT(rv == GFMRV_OK, rv);
+#endif /* DEBUG */
+
+    pAssets->pSset8x8 = pSset8x8;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
 
-        rv = gfm_handleEvents(pGame->pCtx);
+/** Whether both threads should keep running */
+static volatile int main_isRunning;
+/** Error that stopped the update thread */
+static gfmRV main_updateRv;
+/** Length of each fixed tick, in milliseconds */
+static double main_stepTime;
+/** Maximum number of ticks run on a single frame */
+static int main_maxSteps;
+/** Time not yet simulated */
+static double main_accumulator;
+/** When the accumulator was last updated */
+static double main_lastTime;
+/** Total simulated time; Used to split fractional steps into integer ms */
+static double main_simTime;
+
+/**
+ * Run every pending tick (switching states as requested) and publish a
+ * snapshot after each one; The world must be locked by the caller
+ *
+ * Ticks have a fixed length and are paid from an accumulator of real time, so
+ * the gameplay doesn't depend on the frame rate. If the simulation falls too
+ * far behind (e.g., after a hitch), the excess is dropped instead of being
+ * caught up, so slow ticks can't keep generating more ticks
+ */
+static gfmRV main_update() {
+    gfmRV rv;
+    double now;
+
+    /* Check if switching states */
+    if (pGame->nextState != state_none) {
+        /* Init the current state */
+        switch (pGame->nextState) {
+            case state_intro: rv = introstate_init(); break;
+            case state_game: rv = gamestate_init(); break;
+            default: ASSERT(0, GFMRV_INTERNAL_ERROR);
+        }
         ASSERT(rv == GFMRV_OK, rv);
 
-        while (gfm_isUpdating(pGame->pCtx) == GFMRV_TRUE) {
-            rv = gfm_fpsCounterUpdateBegin(pGame->pCtx);
-            ASSERT(rv == GFMRV_OK, rv);
+        __atomic_store_n(&(pGame->curState), pGame->nextState,
+                __ATOMIC_RELEASE);
+        pGame->nextState = state_none;
+    }
 
-            rv = main_updateButtons();
-            ASSERT(rv == GFMRV_OK, rv);
+    now = clock_getTime();
+    main_accumulator += now - main_lastTime;
+    main_lastTime = now;
+    if (main_accumulator > main_stepTime * main_maxSteps) {
+        pGame->droppedTime += main_accumulator - main_stepTime * main_maxSteps;
+        pGame->numDroppedFrames++;
+        main_accumulator = main_stepTime * main_maxSteps;
+    }
+
+    while (main_accumulator >= main_stepTime) {
+        int lastTime;
+
+        lastTime = (int)main_simTime;
+        main_simTime += main_stepTime;
+        pGame->elapsed = (int)main_simTime - lastTime;
+        main_accumulator -= main_stepTime;
+        pGame->tickTime = main_lastTime - main_accumulator;
+
+        rv = gfm_fpsCounterUpdateBegin(pGame->pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        rv = main_updateButtons();
+        ASSERT(rv == GFMRV_OK, rv);
 
 #if defined(DEBUG)
-            if (pGame->run || pGame->next) {
+        if (pGame->run || pGame->next) {
 #endif
 
-            /* Update the current state */
-            switch (pGame->curState) {
-                case state_intro: ASSERT(0, GFMRV_FUNCTION_NOT_IMPLEMENTED); break;
-                case state_game: rv = gamestate_update(); break;
-                default: ASSERT(0, GFMRV_INTERNAL_ERROR);
-            }
-            ASSERT(rv == GFMRV_OK, rv);
+        /* Update the current state */
+        switch (pGame->curState) {
+            case state_intro: rv = introstate_update(); break;
+            case state_game: rv = gamestate_update(); break;
+            default: ASSERT(0, GFMRV_INTERNAL_ERROR);
+        }
+        ASSERT(rv == GFMRV_OK, rv);
 
 #if defined(DEBUG)
-                if (pGame->next) {
-                    pGame->next = 0;
-                }
+            if (pGame->next) {
+                pGame->next = 0;
             }
+        }
 #endif
 
-            rv = gfm_fpsCounterUpdateEnd(pGame->pCtx);
+        /* Start every sound requested by the tick at once, on any state;
+         * The render thread only opens the mixer while loading, so there's
+         * nothing to flush before that */
+        if (pGame->pMixer) {
+            rv = mixer_flush(pGame->pMixer);
             ASSERT(rv == GFMRV_OK, rv);
         }
-        while (gfm_isDrawing(pGame->pCtx) == GFMRV_TRUE) {
-            rv = gfm_drawBegin(pGame->pCtx);
-            ASSERT(rv == GFMRV_OK, rv);
 
-            /* Render the current state */
-            switch (pGame->curState) {
-                case state_intro: ASSERT(0, GFMRV_FUNCTION_NOT_IMPLEMENTED); break;
-                case state_game: rv = gamestate_draw(); break;
-                default: ASSERT(0, GFMRV_INTERNAL_ERROR);
-            }
+        /* Hand the state to the render thread */
+        switch (pGame->curState) {
+            /* The loading screen is drawn directly from its state */
+            case state_intro: rv = GFMRV_OK; break;
+            case state_game: rv = gamestate_snapshot(); break;
+            default: ASSERT(0, GFMRV_INTERNAL_ERROR);
+        }
+        ASSERT(rv == GFMRV_OK, rv);
+        latency_markUpdate(pGame->pLatency,
+                snapshot_getPublished(pGame->pSnapshot));
+
+        rv = gfm_fpsCounterUpdateEnd(pGame->pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    /* Check if switching states */
+    if (pGame->nextState != state_none) {
+        /* Clear the current state */
+        switch (pGame->curState) {
+            case state_intro: introstate_clean(); break;
+            case state_game: gamestate_clean(); break;
+            default: ASSERT(0, GFMRV_INTERNAL_ERROR);
+        }
+
+        __atomic_store_n(&(pGame->curState), state_none, __ATOMIC_RELEASE);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Simulation thread; Keeps running ticks until the game quits or fails
+ *
+ * @param  [ in]pArg Unused
+ */
+static void* main_updateThread(void *pArg) {
+    gfmRV rv;
+
+    rv = GFMRV_OK;
+    main_accumulator = 0.0;
+    main_simTime = 0.0;
+    main_lastTime = clock_getTime();
+    while (__atomic_load_n(&main_isRunning, __ATOMIC_ACQUIRE)) {
+        int wait;
+
+        snapshot_lockWorld(pGame->pSnapshot);
+        rv = main_update();
+        wait = (int)(main_stepTime - main_accumulator);
+        snapshot_unlockWorld(pGame->pSnapshot);
+        if (rv != GFMRV_OK) {
+            break;
+        }
+
+        /* Sleep until the next tick is due */
+        if (wait < 1) {
+            wait = 1;
+        }
+        clock_sleep(wait);
+    }
+
+    main_updateRv = rv;
+    __atomic_store_n(&main_isRunning, 0, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * Handle events, poll the input and do whatever is pending on the render
+ * thread (e.g., loading the texture); The world is locked throughout, as
+ * GFraMe isn't reentrant and its context is also used by the update thread
+ *
+ * @param  [ in]didPresent Whether any frame was presented yet
+ * @return                 GFMRV_TRUE (if the game should quit), GFMRV_OK, ...
+ */
+static gfmRV main_pump(int didPresent) {
+    double pumpTime;
+    gfmRV rv;
+    state curState;
+
+    snapshot_lockWorld(pGame->pSnapshot);
+
+    if (gfm_didGetQuitFlag(pGame->pCtx) == GFMRV_TRUE) {
+        snapshot_unlockWorld(pGame->pSnapshot);
+        return GFMRV_TRUE;
+    }
+    pumpTime = clock_getTime();
+    rv = gfm_handleEvents(pGame->pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+    latency_markEvents(pGame->pLatency);
+    rv = input_poll(pGame->pInput, pGame->pCtx, pumpTime);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = main_handleRequests();
+    ASSERT(rv == GFMRV_OK, rv);
+    curState = __atomic_load_n(&(pGame->curState), __ATOMIC_ACQUIRE);
+
+    /* Upload the texture once the window is showing something */
+    if (didPresent && !pAssets->pSset8x8) {
+        rv = main_loadTexture();
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+    /* Likewise, SDL's audio is only initialized from this thread */
+    if (curState == state_intro) {
+        rv = introstate_openAudio();
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    snapshot_unlockWorld(pGame->pSnapshot);
+
+    return rv;
+}
+
+/**
+ * Draw every frame due; The world is locked throughout, as GFraMe isn't
+ * reentrant and its context is also used by the update thread
+ *
+ * @param  [out]pDidPresent Set if any frame was presented
+ */
+static gfmRV main_draw(int *pDidPresent) {
+    gfmRV rv;
+    state curState;
+
+    snapshot_lockWorld(pGame->pSnapshot);
+
+    curState = __atomic_load_n(&(pGame->curState), __ATOMIC_ACQUIRE);
+    while (gfm_isDrawing(pGame->pCtx) == GFMRV_TRUE) {
+
+        rv = gfm_drawBegin(pGame->pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        /* Render the current state */
+        switch (curState) {
+            case state_intro: rv = introstate_draw(); break;
+            case state_game: rv = gamestate_draw(); break;
+            default: rv = GFMRV_OK;
+        }
+        ASSERT(rv == GFMRV_OK, rv);
 
 #ifdef DEBUG
+        if (pAssets->pSset8x8) {
             rv = gfm_drawRenderInfo(pGame->pCtx, pAssets->pSset8x8,
                     BBWDT - 8*7/*x*/, 0/*y*/, 0/*tile*/);
             ASSERT(rv == GFMRV_OK, rv);
-#endif /* DEBUG */
-            rv = gfm_drawEnd(pGame->pCtx);
-            ASSERT(rv == GFMRV_OK, rv);
         }
+#endif /* DEBUG */
+        rv = gfm_drawEnd(pGame->pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+        *pDidPresent = 1;
+        latency_markPresent(pGame->pLatency,
+                snapshot_getAcquired(pGame->pSnapshot));
+    }
 
-        /* Check if switching states */
-        if (pGame->nextState != state_none) {
-            /* Clear the current state */
-            switch (pGame->curState) {
-                case state_intro: ASSERT(0, GFMRV_FUNCTION_NOT_IMPLEMENTED); break;
-                case state_game: gamestate_clean(); break;
-                default: ASSERT(0, GFMRV_INTERNAL_ERROR);
-            }
+    rv = GFMRV_OK;
+__ret:
+    snapshot_unlockWorld(pGame->pSnapshot);
+
+    return rv;
+}
+
+/**
+ * Render thread; Handles events (which must be done by the thread that
+ * created the window) and draws the latest snapshot, while the simulation runs
+ * on its own thread
+ *
+ * Every call into GFraMe is made with the world locked, as its context is
+ * shared with the update thread; The lock is released between pumping and
+ * drawing (and the update thread releases it between ticks), so neither
+ * thread holds the other for longer than a frame or a tick. Input reaches the
+ * update thread through its own queue, and everything drawn comes from the
+ * snapshot
+ */
+static gfmRV main_loop() {
+    pthread_t updateThread;
+    gfmRV rv;
+    int didCreate, didPresent;
+
+    didCreate = 0;
+    didPresent = 0;
+    main_updateRv = GFMRV_OK;
+    main_isRunning = 1;
+
+    ASSERT(pthread_create(&updateThread, 0, main_updateThread, 0) == 0,
+            GFMRV_INTERNAL_ERROR);
+    didCreate = 1;
 
-            pGame->curState = state_none;
+    while (__atomic_load_n(&main_isRunning, __ATOMIC_ACQUIRE)) {
+        rv = main_pump(didPresent);
+        if (rv == GFMRV_TRUE) {
+            break;
         }
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = main_draw(&didPresent);
+        ASSERT(rv == GFMRV_OK, rv);
     }
 
     rv = GFMRV_OK;
 __ret:
+    __atomic_store_n(&main_isRunning, 0, __ATOMIC_RELEASE);
+    if (didCreate) {
+        pthread_join(updateThread, 0);
+        if (rv == GFMRV_OK) {
+            rv = main_updateRv;
+        }
+    }
+
     if (pGame->curState != state_none) {
         /* Clear the current state */
         switch (pGame->curState) {
-            case state_intro: ASSERT(0, GFMRV_FUNCTION_NOT_IMPLEMENTED); break;
+            case state_intro: introstate_clean(); break;
             case state_game: gamestate_clean(); break;
             default: {}
         }
@@ -274,11 +593,18 @@ int main(int argc, char *argv[]) {
     pState = 0;
     pSave = 0;
 
-    /* Set all default values */
-    config.dps = 60;
-    config.fps = 60;
-    config.vsync = 0;
-    config.ups = 60;
+    /* Load the configuration: defaults, then the file, then the CLI */
+    config_setDefault(&config);
+    rv = config_loadFile(&config, config_getFilename(argc, argv));
+    ASSERT(rv == GFMRV_OK || rv == GFMRV_FALSE, rv);
+    rv = config_parseArgs(&config, argc, argv);
+    if (rv == GFMRV_FALSE) {
+        /* Only the help was requested */
+        return 0;
+    }
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = config_validate(&config);
+    ASSERT(rv == GFMRV_OK, rv);
 
     /* Alloc the buttons struct */
     pButtons = (gameButtons*)malloc(sizeof(gameButtons));
@@ -295,14 +621,34 @@ int main(int argc, char *argv[]) {
     ASSERT(pGame, GFMRV_ALLOC_FAILED);
     memset(pGame, 0x0, sizeof(gameCtx));
 
+    /* Assets are found besides the binary */
+    do {
+        char *pSep;
+        int len;
+
+        pSep = strrchr(argv[0], '/');
+#if defined(__WIN32) || defined(__WIN32__)
+        if (!pSep) {
+            pSep = strrchr(argv[0], '\\');
+        }
+#endif
+        len = 0;
+        if (pSep) {
+            len = pSep - argv[0] + 1;
+        }
+        ASSERT(len + sizeof("assets/") <= ASSETS_PATH_LEN,
+                GFMRV_ARGUMENTS_BAD);
+        memcpy(pGame->pAssetsPath, argv[0], len);
+        strcpy(pGame->pAssetsPath + len, "assets/");
+    } while (0);
+    pGame->pLevelDir = LEVEL_DIR;
+
     rv = gfm_getNew(&(pGame->pCtx));
     ASSERT(rv == GFMRV_OK, rv);
 
     rv = gfm_initStatic(pGame->pCtx, ORG, TITLE);
     ASSERT(rv == GFMRV_OK, rv);
 
-    /* TODO Load config file */
-
     /* Erase the save file */
     rv = gfmSave_getNew(&pSave);
     ASSERT(rv == GFMRV_OK, rv);
@@ -313,49 +659,15 @@ int main(int argc, char *argv[]) {
     gfmSave_free(&pSave);
     pSave = 0;
 
-    rv = gfm_initGameWindow(pGame->pCtx, BBWDT, BBHGT, WNWDT, WNHGT, CAN_RESIZE,
-            config.vsync);
+    rv = gfm_initGameWindow(pGame->pCtx, BBWDT, BBHGT, config.width,
+            config.height, CAN_RESIZE, config.vsync);
     ASSERT(rv == GFMRV_OK, rv);
 
     rv = gfm_setBackground(pGame->pCtx, BGCOLOR);
     ASSERT(rv == GFMRV_OK, rv);
 
-    /* Enable audio */
-    rv = gfm_initAudio(pGame->pCtx, gfmAudio_defQuality);
-    ASSERT(rv == GFMRV_OK, rv);
-
-    rv = gfm_loadTextureStatic(&(pAssets->texHandle), pGame->pCtx, TEXATLAS,
-            COLORKEY);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_createSpritesetCached(&(pAssets->pSset8x8), pGame->pCtx,
-            pAssets->texHandle, 8, 8);
-    rv = gfm_createSpritesetCached(&(pAssets->pSset16x16), pGame->pCtx,
-            pAssets->texHandle, 16, 16);
-    rv = gfm_createSpritesetCached(&(pAssets->pSset32x16), pGame->pCtx,
-            pAssets->texHandle, 32, 16);
-    ASSERT(rv == GFMRV_OK, rv);
-    /* Load audio assets */
-#if 0
-    rv = gfm_loadAudio(&(pAssets->audBass1), pGame->pCtx, "bass_1.mml", 10);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_loadAudio(&(pAssets->audBass2), pGame->pCtx, "bass_2.mml", 10);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_loadAudio(&(pAssets->audMelody), pGame->pCtx, "melody.mml", 10);
-    ASSERT(rv == GFMRV_OK, rv);
-#endif
-
-#define LOAD_SFX(var, name) \
-    rv = gfm_loadAudio(&(pAssets->sfx##var), pGame->pCtx, name, \
-            sizeof(name) - 1); \
-    ASSERT(rv == GFMRV_OK, rv)
-    LOAD_SFX(LeftStep, "left_step.wav");
-    LOAD_SFX(RightStep, "right_step.wav");
-    LOAD_SFX(EnemyCrushed, "ene_crushed.wav");
-    LOAD_SFX(EnemyExplosion, "ene_explosion.wav");
-    LOAD_SFX(PlHurt, "pl_hurt.wav");
-    LOAD_SFX(Checkpoint, "checkpoint.wav");
-    LOAD_SFX(EnemyShoot, "ene_shoot.wav");
-    LOAD_SFX(Text, "text.wav");
+    /* The texture, every sound effect and the song are loaded by the intro
+     * state */
 
     /* Initialize all buttons */
     rv = gfm_addVirtualKey(&(pButtons->left_leg.handle), pGame->pCtx);
@@ -464,120 +776,54 @@ int main(int argc, char *argv[]) {
             1/*port*/);
     ASSERT(rv == GFMRV_OK, rv);
 
-    /* Create all particles groups */
-    rv = gfmGroup_getNew(&(pGame->pParticles));
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefType(pGame->pParticles, BULLET);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefSpriteset(pGame->pParticles, pAssets->pSset8x8);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefAnimData(pGame->pParticles, grp_anim_data,
-            grp_anim_dataLen);
-    rv = gfmGroup_setDefDimensions(pGame->pParticles, 2, 2, -3, -3);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefVelocity(pGame->pParticles, 0, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefAcceleration(pGame->pParticles, 0, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDeathOnLeave(pGame->pParticles, 1);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDeathOnTime(pGame->pParticles, PARTICLE_TTL);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDrawOrder(pGame->pParticles, gfmDrawOrder_linear);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_preCache(pGame->pParticles, NUM_PARTICLES, NUM_PARTICLES);
-    ASSERT(rv == GFMRV_OK, rv);
+    /* Sample every button through events, on the bit at its position */
+    do {
+        int pHandles[INPUT_MAX_BUTTONS];
+        button *pList;
+        int i;
 
-    rv = gfmGroup_getNew(&(pGame->pBullets));
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefType(pGame->pBullets, BULLET);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefSpriteset(pGame->pBullets, pAssets->pSset8x8);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefAnimData(pGame->pBullets, grp_anim_data,
-            grp_anim_dataLen);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefDimensions(pGame->pBullets, 2, 2, -3, -3);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefVelocity(pGame->pBullets, 0, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefAcceleration(pGame->pBullets, 0, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDeathOnLeave(pGame->pBullets, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDeathOnTime(pGame->pBullets, PARTICLE_TTL);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDrawOrder(pGame->pBullets, gfmDrawOrder_linear);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_preCache(pGame->pBullets, NUM_PARTICLES, NUM_PARTICLES);
-    ASSERT(rv == GFMRV_OK, rv);
-#if 0
-    /* This would be a terrible idea (so, I really want to enable it :D) */
-    rv = gfmGroup_setCollisionQuality(pGame->pBullets,
-            gfmCollisionQuality_collideEverything);
-#endif
-    rv = gfmGroup_setCollisionQuality(pGame->pBullets,
-            gfmCollisionQuality_visibleOnly);
+        pList = (button*)pButtons;
+        i = 0;
+        while (i < NUM_BUTTONS) {
+            pHandles[i] = pList[i].handle;
+            i++;
+        }
 
-    rv = gfmGroup_getNew(&(pGame->pProps));
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefType(pGame->pProps, PROP);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefSpriteset(pGame->pProps, pAssets->pSset8x8);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefAnimData(pGame->pProps, grp_anim_data,
-            grp_anim_dataLen);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefDimensions(pGame->pProps, 2, 2, -3, -3);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefVelocity(pGame->pProps, 0, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDefAcceleration(pGame->pProps, 0, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDeathOnLeave(pGame->pProps, 0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDeathOnTime(pGame->pProps, PARTICLE_TTL);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_setDrawOrder(pGame->pProps, gfmDrawOrder_linear);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmGroup_preCache(pGame->pProps, NUM_PARTICLES, NUM_PARTICLES);
-    ASSERT(rv == GFMRV_OK, rv);
-#if 0
-    /* This would be a terrible idea (so, I really want to enable it :D) */
-    rv = gfmGroup_setCollisionQuality(pGame->pProps,
-            gfmCollisionQuality_collideEverything);
-#endif
-    rv = gfmGroup_setCollisionQuality(pGame->pProps,
-            gfmCollisionQuality_visibleOnly);
-    ASSERT(rv == GFMRV_OK, rv);
+        rv = input_init(&(pGame->pInput), pHandles, NUM_BUTTONS);
+        ASSERT(rv == GFMRV_OK, rv);
+    } while (0);
 
-#ifdef DEBUG
-    rv = gfm_initFPSCounter(pGame->pCtx, pAssets->pSset8x8, 0/*firstTile*/);
+    rv = jobs_init(&(pGame->pJobs), JOBS_AUTO);
     ASSERT(rv == GFMRV_OK, rv);
-#endif /* DEBUG */
-
-    rv = gfmQuadtree_getNew(&(pGame->pQt));
+    rv = snapshot_init(&(pGame->pSnapshot), config.ups, config.dps);
     ASSERT(rv == GFMRV_OK, rv);
+    if (config.latency) {
+        rv = latency_init(&(pGame->pLatency));
+        ASSERT(rv == GFMRV_OK, rv);
+    }
 
-    /* Play the audio */
-#if 0
-    rv = gfm_playAudio(0, pGame->pCtx, pAssets->audBass1, 1.0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_playAudio(0, pGame->pCtx, pAssets->audBass2, 1.0);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfm_playAudio(0, pGame->pCtx, pAssets->audMelody, 1.0);
+    main_initParticles = config.initParticles;
+    main_maxParticles = config.maxParticles;
+
+    rv = broadphase_init(&(pGame->pBroadphase),
+            (broadphaseType)config.broadphase);
     ASSERT(rv == GFMRV_OK, rv);
-#endif
 
-    /* TODO Set the main state as the intro */
-    pGame->nextState = state_game;
+    pGame->nextState = state_intro;
     pGame->run = 1;
 
     rv = gfm_setFPS(pGame->pCtx, config.fps);
     ASSERT(rv == GFMRV_OK, rv);
+    /* GFraMe integrates its objects over a fixed period of 1000/ups, which is
+     * exactly the tick's length; So its elapsed time is driven by this (and
+     * nothing else), and its own update timer (i.e., gfm_isUpdating) is never
+     * polled, since the accumulator times the ticks */
     rv = gfm_setStateFrameRate(pGame->pCtx, config.ups, config.dps);
     ASSERT(rv == GFMRV_OK, rv);
 
+    main_stepTime = 1000.0 / config.ups;
+    main_maxSteps = config.maxSteps;
+
     rv = main_loop();
     ASSERT(rv == GFMRV_OK, rv);
 
@@ -586,10 +832,56 @@ __ret:
     gfmSave_free(&pSave);
     if (pGame) {
         /* TODO Free everything else */
-        gfmQuadtree_free(&(pGame->pQt));
-        gfmGroup_free(&(pGame->pParticles));
-        gfmGroup_free(&(pGame->pBullets));
-        gfmGroup_free(&(pGame->pProps));
+        broadphase_clean(&(pGame->pBroadphase));
+#ifdef DEBUG
+        if (pGame->pParticles && pGame->pBullets && pGame->pProps) {
+            int used, highWater, len, lost;
+
+            particles_getStats(&used, &highWater, &len, &lost,
+                    pGame->pParticles);
+            printf("particles: high-water %i, len %i, dropped %i\n",
+                    highWater, len, lost);
+            spritePool_getStats(&used, &highWater, &len, &lost,
+                    pGame->pBullets);
+            printf("bullets: high-water %i, len %i, stolen %i\n",
+                    highWater, len, lost);
+            spritePool_getStats(&used, &highWater, &len, &lost,
+                    pGame->pProps);
+            printf("props: high-water %i, len %i, stolen %i\n",
+                    highWater, len, lost);
+        }
+        if (pGame->pMixer) {
+            int stolen, coalesced, culled;
+
+            mixer_getStats(&stolen, &coalesced, &culled, pGame->pMixer);
+            printf("mixer: stolen %i, coalesced %i, culled %i\n", stolen,
+                    coalesced, culled);
+        }
+        if (pGame->pMusic) {
+            int underruns;
+
+            music_getStats(&underruns, pGame->pMusic);
+            printf("music: underruns %i\n", underruns);
+        }
+        printf("timing: dropped %.0fms over %i frames\n",
+                pGame->droppedTime, pGame->numDroppedFrames);
+#endif /* DEBUG */
+        alloc_report(stdout);
+        particles_clean(&(pGame->pParticles));
+        spritePool_clean(&(pGame->pBullets));
+        spritePool_clean(&(pGame->pProps));
+        level_clean(&(pGame->pLevel));
+        /* The mixer plays straight from the sound effects' cache and from
+         * the music's ring */
+        mixer_clean(&(pGame->pMixer));
+        music_clean(&(pGame->pMusic));
+        sfx_clean(&(pGame->pSfx));
+        jobs_clean(&(pGame->pJobs));
+        snapshot_clean(&(pGame->pSnapshot));
+        latency_report(pGame->pLatency, LATENCY_FILE);
+        latency_clean(&(pGame->pLatency));
+        input_clean(&(pGame->pInput));
+        collide_clean();
         gfm_free(&(pGame->pCtx));
     }
     if (pGame) {
@@ -0,0 +1,521 @@
+/**
+ * Plays the pre-rendered sound effects
+ *
+ * @file src/mixer.c
+ */
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/bfxr.h>
+#include <ld34/mixer.h>
+#include <ld34/music.h>
+#include <ld34/sfx.h>
+
+#include <SDL2/SDL.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Highest sample output by the limiter */
+#define MIXER_LIMIT 32000
+/** How much of the gain's reduction the limiter recovers on each block */
+#define MIXER_RELEASE 0.05f
+
+/** A sound being played */
+struct stVoice {
+    /** The sound's samples (NULL, if the voice is free) */
+    short *pSamples;
+    /** Number of samples */
+    int numSamples;
+    /** Next sample to be played */
+    int pos;
+    /** Volume, in 8.8 fixed point */
+    int volume;
+    /** The sound */
+    int id;
+};
+typedef struct stVoice voice;
+
+/** A sound requested during the current tick */
+struct stRequest {
+    /** The sound's samples */
+    short *pSamples;
+    /** Number of samples */
+    int numSamples;
+    /** The sound */
+    int id;
+    /** Loudest volume requested */
+    double volume;
+};
+typedef struct stRequest request;
+
+struct stMixer {
+    /** Every voice; Only modified with the device locked */
+    voice pVoices[MIXER_MAX_VOICES];
+    /** Sounds requested during the current tick; Only accessed by the
+     * update thread */
+    request pRequests[MIXER_MAX_VOICES];
+    /** Number of requests */
+    int numRequests;
+    /** Last mixed block; Only accessed by the audio thread */
+    short pBlock[MIXER_BLOCK_LEN];
+    /** Next sample from the block to be output */
+    int blockPos;
+    /** Limiter's current gain */
+    float gain;
+    /** Number of voices stolen (from the same or from another sound) */
+    int numStolen;
+    /** Number of requests merged into another of the same tick */
+    int numCoalesced;
+    /** Number of requests too far to be heard */
+    int numCulled;
+    /** Listener's position; Only accessed by the update thread */
+    int listenerX;
+    int listenerY;
+    /** The sound effects */
+    sfx *pSfx;
+    /** The music (NULL, if none); Only modified with the device locked */
+    music *pMusic;
+    /** The audio device */
+    SDL_AudioDeviceID dev;
+    /** Whether the audio subsystem was initialized */
+    int didInit;
+};
+
+/**
+ * Mix every voice into the next block, limiting the output so it doesn't clip
+ *
+ * @param  [ in]pCtx The mixer
+ */
+static void mixer_mixBlock(mixer *pCtx) {
+    int pAcc[MIXER_BLOCK_LEN];
+    float gain, target, step;
+    int i, peak;
+
+    memset(pAcc, 0x0, sizeof(pAcc));
+    if (pCtx->pMusic) {
+        music_mix(pCtx->pMusic, pAcc, MIXER_BLOCK_LEN);
+    }
+
+    i = 0;
+    while (i < MIXER_MAX_VOICES) {
+        voice *pVoice;
+        short *pSrc;
+        int j, count, volume;
+
+        pVoice = pCtx->pVoices + i;
+        i++;
+        if (!pVoice->pSamples) {
+            continue;
+        }
+
+        count = pVoice->numSamples - pVoice->pos;
+        if (count > MIXER_BLOCK_LEN) {
+            count = MIXER_BLOCK_LEN;
+        }
+        pSrc = pVoice->pSamples + pVoice->pos;
+        volume = pVoice->volume;
+        j = 0;
+        while (j < count) {
+            pAcc[j] += (pSrc[j] * volume) >> 8;
+            j++;
+        }
+
+        pVoice->pos += count;
+        if (pVoice->pos >= pVoice->numSamples) {
+            pVoice->pSamples = 0;
+        }
+    }
+
+    /* Reduce the gain at once, if the block would clip, and slowly recover
+     * it afterward; The gain is never above what the block requires */
+    peak = 0;
+    i = 0;
+    while (i < MIXER_BLOCK_LEN) {
+        int val;
+
+        val = abs(pAcc[i]);
+        if (val > peak) {
+            peak = val;
+        }
+        i++;
+    }
+    target = 1.0f;
+    if (peak > MIXER_LIMIT) {
+        target = (float)MIXER_LIMIT / (float)peak;
+    }
+    gain = pCtx->gain + (1.0f - pCtx->gain) * MIXER_RELEASE;
+    if (gain > target) {
+        gain = target;
+    }
+    if (gain < pCtx->gain) {
+        /* Attack: Apply the reduced gain to the whole block */
+        pCtx->gain = gain;
+        step = 0.0f;
+    }
+    else {
+        /* Release: Ramp into the new gain, to avoid clicks */
+        step = (gain - pCtx->gain) / MIXER_BLOCK_LEN;
+    }
+
+    i = 0;
+    while (i < MIXER_BLOCK_LEN) {
+        int val;
+
+        val = (int)(pAcc[i] * pCtx->gain);
+        if (val > 32767) {
+            val = 32767;
+        }
+        else if (val < -32768) {
+            val = -32768;
+        }
+        pCtx->pBlock[i] = (short)val;
+        pCtx->gain += step;
+        i++;
+    }
+    pCtx->gain = gain;
+    pCtx->blockPos = 0;
+}
+
+/**
+ * Output the mixed samples, a block at a time; Runs on SDL's audio thread
+ *
+ * @param  [ in]pArg The mixer
+ * @param  [ in]pBuf The device's buffer
+ * @param  [ in]len  Length of the buffer, in bytes
+ */
+static void mixer_callback(void *pArg, Uint8 *pBuf, int len) {
+    mixer *pCtx;
+    short *pOut;
+    int num;
+
+    pCtx = (mixer*)pArg;
+    pOut = (short*)pBuf;
+    num = len / sizeof(short);
+
+    while (num > 0) {
+        int count;
+
+        if (pCtx->blockPos >= MIXER_BLOCK_LEN) {
+            mixer_mixBlock(pCtx);
+        }
+
+        count = MIXER_BLOCK_LEN - pCtx->blockPos;
+        if (count > num) {
+            count = num;
+        }
+        memcpy(pOut, pCtx->pBlock + pCtx->blockPos, sizeof(short) * count);
+        pCtx->blockPos += count;
+        pOut += count;
+        num -= count;
+    }
+}
+
+/**
+ * Open the audio device and start mixing
+ *
+ * @param  [out]ppCtx The mixer
+ * @param  [ in]pSfx  The sound effects (must outlive the mixer)
+ */
+gfmRV mixer_init(mixer **ppCtx, sfx *pSfx) {
+    SDL_AudioSpec want;
+    gfmRV rv;
+    mixer *pCtx;
+
+    *ppCtx = 0;
+    ASSERT(pSfx, GFMRV_ARGUMENTS_BAD);
+
+    pCtx = (mixer*)malloc(sizeof(mixer));
+    ASSERT(pCtx, GFMRV_ALLOC_FAILED);
+    memset(pCtx, 0x0, sizeof(mixer));
+    *ppCtx = pCtx;
+    pCtx->pSfx = pSfx;
+    pCtx->blockPos = MIXER_BLOCK_LEN;
+    pCtx->gain = 1.0f;
+
+    ASSERT(SDL_InitSubSystem(SDL_INIT_AUDIO) == 0, GFMRV_INTERNAL_ERROR);
+    pCtx->didInit = 1;
+
+    /* Any difference from the device's format is converted by SDL */
+    memset(&want, 0x0, sizeof(SDL_AudioSpec));
+    want.freq = BFXR_SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = MIXER_BUFFER_LEN;
+    want.callback = mixer_callback;
+    want.userdata = pCtx;
+    pCtx->dev = SDL_OpenAudioDevice(0, 0/*isCapture*/, &want, 0, 0);
+    ASSERT(pCtx->dev != 0, GFMRV_INTERNAL_ERROR);
+
+    SDL_PauseAudioDevice(pCtx->dev, 0/*pauseOn*/);
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK) {
+        mixer_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Close the audio device
+ *
+ * @param  [ in]ppCtx The mixer
+ */
+void mixer_clean(mixer **ppCtx) {
+    mixer *pCtx;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+    pCtx = *ppCtx;
+
+    if (pCtx->dev != 0) {
+        SDL_CloseAudioDevice(pCtx->dev);
+    }
+    if (pCtx->didInit) {
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+
+    free(pCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Set the music mixed with the sounds
+ *
+ * @param  [ in]pCtx   The mixer
+ * @param  [ in]pMusic The music (or NULL, to stop it)
+ */
+gfmRV mixer_setMusic(mixer *pCtx, music *pMusic) {
+    gfmRV rv;
+
+    ASSERT(pCtx, GFMRV_ARGUMENTS_BAD);
+
+    SDL_LockAudioDevice(pCtx->dev);
+    pCtx->pMusic = pMusic;
+    SDL_UnlockAudioDevice(pCtx->dev);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Request a sound to be played; Requests are only started by mixer_flush, and
+ * requesting a sound more than once on a tick plays it only once (as loud as
+ * the loudest request)
+ *
+ * @param  [ in]pCtx   The mixer
+ * @param  [ in]id     The sound (as passed to sfx_init)
+ * @param  [ in]volume The sound's volume, in the range [0.0, 1.0]
+ */
+gfmRV mixer_play(mixer *pCtx, int id, double volume) {
+    request *pReq;
+    gfmRV rv;
+    int i;
+
+    ASSERT(pCtx, GFMRV_ARGUMENTS_BAD);
+    ASSERT(volume >= 0.0 && volume <= 1.0, GFMRV_ARGUMENTS_BAD);
+
+    i = 0;
+    while (i < pCtx->numRequests) {
+        if (pCtx->pRequests[i].id == id) {
+            if (volume > pCtx->pRequests[i].volume) {
+                pCtx->pRequests[i].volume = volume;
+            }
+            pCtx->numCoalesced++;
+            return GFMRV_OK;
+        }
+        i++;
+    }
+
+    /* More sounds than voices would only steal from each other */
+    if (pCtx->numRequests < MIXER_MAX_VOICES) {
+        pReq = pCtx->pRequests + pCtx->numRequests;
+        rv = sfx_getSamples(&(pReq->pSamples), &(pReq->numSamples),
+                pCtx->pSfx, id);
+        ASSERT(rv == GFMRV_OK, rv);
+        pReq->id = id;
+        pReq->volume = volume;
+        pCtx->numRequests++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Request a sound, emitted from a position in the world, to be played; It's
+ * attenuated by its distance to the listener and ignored if inaudible
+ *
+ * @param  [ in]pCtx   The mixer
+ * @param  [ in]id     The sound (as passed to sfx_init)
+ * @param  [ in]volume The sound's volume, in the range [0.0, 1.0]
+ * @param  [ in]x      Horizontal position of the sound
+ * @param  [ in]y      Vertical position of the sound
+ */
+gfmRV mixer_playAt(mixer *pCtx, int id, double volume, int x, int y) {
+    gfmRV rv;
+    int dist, dx, dy;
+
+    ASSERT(pCtx, GFMRV_ARGUMENTS_BAD);
+
+    dx = x - pCtx->listenerX;
+    dy = y - pCtx->listenerY;
+    dist = dx * dx + dy * dy;
+    if (dist >= MIXER_FAR_DIST * MIXER_FAR_DIST) {
+        pCtx->numCulled++;
+        return GFMRV_OK;
+    }
+    else if (dist > MIXER_NEAR_DIST * MIXER_NEAR_DIST) {
+        /* Fade linearly between both distances */
+        volume *= (MIXER_FAR_DIST - sqrt((double)dist)) /
+                (MIXER_FAR_DIST - MIXER_NEAR_DIST);
+    }
+
+    /* Would be silent after converted into the voice's volume */
+    if (volume * 256.0 < 1.0) {
+        pCtx->numCulled++;
+        return GFMRV_OK;
+    }
+
+    rv = mixer_play(pCtx, id, volume);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Set the listener's position (i.e., the camera's center)
+ *
+ * @param  [ in]pCtx The mixer
+ * @param  [ in]x    Horizontal position of the listener
+ * @param  [ in]y    Vertical position of the listener
+ */
+gfmRV mixer_setListener(mixer *pCtx, int x, int y) {
+    gfmRV rv;
+
+    ASSERT(pCtx, GFMRV_ARGUMENTS_BAD);
+
+    pCtx->listenerX = x;
+    pCtx->listenerY = y;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve a voice for a sound; Either a free one, the oldest voice playing
+ * the same sound (if it already reached MIXER_MAX_PER_SOUND) or the voice
+ * closest to finishing. Must be called with the device locked
+ *
+ * @param  [ in]pCtx The mixer
+ * @param  [ in]id   The sound
+ * @return           The voice
+ */
+static voice* mixer_getVoice(mixer *pCtx, int id) {
+    voice *pFree, *pOldest, *pShortest;
+    int i, numSame;
+
+    pFree = 0;
+    pOldest = 0;
+    pShortest = 0;
+    numSame = 0;
+    i = 0;
+    while (i < MIXER_MAX_VOICES) {
+        voice *pVoice;
+
+        pVoice = pCtx->pVoices + i;
+        i++;
+        if (!pVoice->pSamples) {
+            if (!pFree) {
+                pFree = pVoice;
+            }
+            continue;
+        }
+
+        if (pVoice->id == id) {
+            numSame++;
+            if (!pOldest || pVoice->pos > pOldest->pos) {
+                pOldest = pVoice;
+            }
+        }
+        if (!pShortest || pVoice->numSamples - pVoice->pos <
+                pShortest->numSamples - pShortest->pos) {
+            pShortest = pVoice;
+        }
+    }
+
+    if (numSame >= MIXER_MAX_PER_SOUND) {
+        pCtx->numStolen++;
+        return pOldest;
+    }
+    else if (pFree) {
+        return pFree;
+    }
+    pCtx->numStolen++;
+    return pShortest;
+}
+
+/**
+ * Start every sound requested during the tick; Should be called once at the
+ * end of every tick
+ *
+ * @param  [ in]pCtx The mixer
+ */
+gfmRV mixer_flush(mixer *pCtx) {
+    gfmRV rv;
+    int i;
+
+    ASSERT(pCtx, GFMRV_ARGUMENTS_BAD);
+
+    if (pCtx->numRequests == 0) {
+        return GFMRV_OK;
+    }
+
+    /* Every sound of the tick is started on a single lock */
+    SDL_LockAudioDevice(pCtx->dev);
+    i = 0;
+    while (i < pCtx->numRequests) {
+        request *pReq;
+        voice *pVoice;
+
+        pReq = pCtx->pRequests + i;
+        pVoice = mixer_getVoice(pCtx, pReq->id);
+        pVoice->pSamples = pReq->pSamples;
+        pVoice->numSamples = pReq->numSamples;
+        pVoice->pos = 0;
+        pVoice->volume = (int)(pReq->volume * 256.0);
+        pVoice->id = pReq->id;
+        i++;
+    }
+    SDL_UnlockAudioDevice(pCtx->dev);
+    pCtx->numRequests = 0;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve how many sounds were limited
+ *
+ * @param  [out]pNumStolen    Number of voices stolen
+ * @param  [out]pNumCoalesced Number of requests merged into another
+ * @param  [out]pNumCulled    Number of requests too far to be heard
+ * @param  [ in]pCtx          The mixer
+ */
+void mixer_getStats(int *pNumStolen, int *pNumCoalesced, int *pNumCulled,
+        mixer *pCtx) {
+    *pNumStolen = pCtx->numStolen;
+    *pNumCoalesced = pCtx->numCoalesced;
+    *pNumCulled = pCtx->numCulled;
+}
+
@@ -0,0 +1,297 @@
+/**
+ * Pre-rendered music
+ *
+ * c_synth renders every track whole, once (on the synthesizer thread, so
+ * loading isn't delayed by it), and then the thread mixes the rendered tracks
+ * into the ring, wrapping each one back to its loop point
+ *
+ * @file src/music.c
+ */
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <c_synth/synth.h>
+
+#include <ld34/music.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Longest path to the song */
+#define MUSIC_PATH_LEN 1100
+
+/** A track rendered by c_synth */
+struct stMusicTrack {
+    /** Every sample of the track */
+    short *pSamples;
+    /** Number of samples */
+    int len;
+    /** Sample from where the track restarts (or -1, if it only plays once) */
+    int loop;
+    /** Next sample mixed */
+    int pos;
+};
+typedef struct stMusicTrack musicTrack;
+
+struct stMusic {
+    /** Samples mixed ahead of playback */
+    short pRing[MUSIC_RING_LEN];
+    /** Total samples written; Only modified by the synthesizer */
+    unsigned int writePos;
+    /** Total samples read; Only modified by the audio thread */
+    unsigned int readPos;
+    /** Number of underruns; Only modified by the audio thread */
+    int numUnderruns;
+    /** c_synth's context, which owns the compiled song */
+    synthCtx *pSynth;
+    /** The compiled song */
+    int song;
+    /** Every track; Only touched by the synthesizer */
+    musicTrack pTracks[MUSIC_MAX_TRACKS];
+    /** Number of tracks */
+    int numTracks;
+    /** The synthesizer */
+    pthread_t thread;
+    /** Whether the thread was created (and not yet joined) */
+    int didCreate;
+    /** Cleared to stop the synthesizer */
+    int isRunning;
+};
+
+/**
+ * Render every track of the song through c_synth
+ *
+ * @param  [ in]pCtx The music
+ */
+static gfmRV music_render(music *pCtx) {
+    gfmRV rv;
+    int i;
+
+    i = 0;
+    while (i < pCtx->numTracks) {
+        musicTrack *pTrack;
+        synth_err srv;
+        int intro;
+
+        pTrack = pCtx->pTracks + i;
+        srv = synth_getTrackLength(&(pTrack->len), pCtx->pSynth, pCtx->song,
+                i);
+        ASSERT(srv == SYNTH_OK, GFMRV_FUNCTION_FAILED);
+        srv = synth_getTrackIntroLength(&intro, pCtx->pSynth, pCtx->song, i);
+        ASSERT(srv == SYNTH_OK, GFMRV_FUNCTION_FAILED);
+
+        /* A loop with no samples would never yield one */
+        pTrack->loop = -1;
+        if (intro >= 0 && intro < pTrack->len) {
+            pTrack->loop = intro;
+        }
+
+        if (pTrack->len > 0) {
+            pTrack->pSamples = (short*)malloc(sizeof(short) * pTrack->len);
+            ASSERT(pTrack->pSamples, GFMRV_ALLOC_FAILED);
+            srv = synth_renderTrack((char*)pTrack->pSamples, pCtx->pSynth,
+                    pCtx->song, i, SYNTH_1CHAN_16BITS);
+            ASSERT(srv == SYNTH_OK, GFMRV_FUNCTION_FAILED);
+        }
+
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Synthesizer thread; Renders the song and then keeps the ring filled
+ *
+ * @param  [ in]pArg The music
+ */
+static void* music_thread(void *pArg) {
+    music *pCtx;
+
+    pCtx = (music*)pArg;
+    if (music_render(pCtx) != GFMRV_OK) {
+        /* Simply play nothing */
+        return 0;
+    }
+
+    while (__atomic_load_n(&(pCtx->isRunning), __ATOMIC_ACQUIRE)) {
+        unsigned int readPos, writePos;
+        int i;
+
+        readPos = __atomic_load_n(&(pCtx->readPos), __ATOMIC_ACQUIRE);
+        writePos = pCtx->writePos;
+        if (MUSIC_RING_LEN - (writePos - readPos) < MUSIC_CHUNK_LEN) {
+            struct timespec delay;
+
+            delay.tv_sec = 0;
+            delay.tv_nsec = MUSIC_SLEEP_MS * 1000000L;
+            nanosleep(&delay, 0);
+            continue;
+        }
+
+        i = 0;
+        while (i < MUSIC_CHUNK_LEN) {
+            int j, sample;
+
+            sample = 0;
+            j = 0;
+            while (j < pCtx->numTracks) {
+                musicTrack *pTrack;
+
+                pTrack = pCtx->pTracks + j;
+                j++;
+                if (pTrack->pos >= pTrack->len) {
+                    continue;
+                }
+
+                sample += pTrack->pSamples[pTrack->pos] * MUSIC_GAIN / 128;
+                pTrack->pos++;
+                if (pTrack->pos >= pTrack->len && pTrack->loop >= 0) {
+                    pTrack->pos = pTrack->loop;
+                }
+            }
+            if (sample > 32767) {
+                sample = 32767;
+            }
+            else if (sample < -32768) {
+                sample = -32768;
+            }
+            pCtx->pRing[(writePos + i) & (MUSIC_RING_LEN - 1)] = (short)sample;
+            i++;
+        }
+        __atomic_store_n(&(pCtx->writePos), writePos + MUSIC_CHUNK_LEN,
+                __ATOMIC_RELEASE);
+    }
+
+    return 0;
+}
+
+/**
+ * Compile a song and start synthesizing it
+ *
+ * @param  [out]ppCtx       The music
+ * @param  [ in]pAssetsPath Path to the assets directory (with a trailing '/')
+ * @param  [ in]pFilename   The song's MML, relative to the assets directory
+ * @param  [ in]sampleRate  Rate at which the song will be played
+ */
+gfmRV music_init(music **ppCtx, char *pAssetsPath, char *pFilename,
+        int sampleRate) {
+    char pPath[MUSIC_PATH_LEN];
+    gfmRV rv;
+    music *pCtx;
+    synth_err srv;
+
+    *ppCtx = 0;
+    ASSERT(strlen(pAssetsPath) + strlen(pFilename) < MUSIC_PATH_LEN,
+            GFMRV_ARGUMENTS_BAD);
+
+    pCtx = (music*)malloc(sizeof(music));
+    ASSERT(pCtx, GFMRV_ALLOC_FAILED);
+    memset(pCtx, 0x0, sizeof(music));
+    *ppCtx = pCtx;
+
+    srv = synth_init(&(pCtx->pSynth), sampleRate);
+    ASSERT(srv == SYNTH_OK, GFMRV_FUNCTION_FAILED);
+
+    snprintf(pPath, sizeof(pPath), "%s%s", pAssetsPath, pFilename);
+    srv = synth_compileSongFromFile(&(pCtx->song), pCtx->pSynth, pPath);
+    ASSERT(srv == SYNTH_OK, GFMRV_READ_ERROR);
+    srv = synth_getSongNumTracks(&(pCtx->numTracks), pCtx->pSynth,
+            pCtx->song);
+    ASSERT(srv == SYNTH_OK, GFMRV_FUNCTION_FAILED);
+    ASSERT(pCtx->numTracks <= MUSIC_MAX_TRACKS, GFMRV_READ_ERROR);
+
+    pCtx->isRunning = 1;
+    ASSERT(pthread_create(&(pCtx->thread), 0, music_thread, pCtx) == 0,
+            GFMRV_INTERNAL_ERROR);
+    pCtx->didCreate = 1;
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK) {
+        music_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Stop the synthesizer and release the song; The mixer must already be
+ * closed
+ *
+ * @param  [ in]ppCtx The music
+ */
+void music_clean(music **ppCtx) {
+    music *pCtx;
+    int i;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+    pCtx = *ppCtx;
+
+    if (pCtx->didCreate) {
+        __atomic_store_n(&(pCtx->isRunning), 0, __ATOMIC_RELEASE);
+        pthread_join(pCtx->thread, 0);
+    }
+    i = 0;
+    while (i < MUSIC_MAX_TRACKS) {
+        free(pCtx->pTracks[i].pSamples);
+        i++;
+    }
+    if (pCtx->pSynth) {
+        synth_free(&(pCtx->pSynth));
+    }
+
+    free(pCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Add the next synthesized samples to a buffer; Called from the audio thread
+ *
+ * @param  [ in]pCtx The music
+ * @param  [ in]pAcc The buffer
+ * @param  [ in]num  Number of samples requested
+ */
+void music_mix(music *pCtx, int *pAcc, int num) {
+    unsigned int readPos, writePos;
+    int i, count;
+
+    readPos = pCtx->readPos;
+    writePos = __atomic_load_n(&(pCtx->writePos), __ATOMIC_ACQUIRE);
+    count = (int)(writePos - readPos);
+    if (count < num) {
+        /* Play whatever is ready; The rest is silence (which is expected
+         * while the song is still being rendered) */
+        if (writePos > 0) {
+            pCtx->numUnderruns++;
+        }
+    }
+    else {
+        count = num;
+    }
+
+    i = 0;
+    while (i < count) {
+        pAcc[i] += pCtx->pRing[(readPos + i) & (MUSIC_RING_LEN - 1)];
+        i++;
+    }
+    __atomic_store_n(&(pCtx->readPos), readPos + count, __ATOMIC_RELEASE);
+}
+
+/**
+ * Retrieve how many times the ring ran out of samples
+ *
+ * @param  [out]pNumUnderruns Number of underruns
+ * @param  [ in]pCtx          The music
+ */
+void music_getStats(int *pNumUnderruns, music *pCtx) {
+    *pNumUnderruns = pCtx->numUnderruns;
+}
+
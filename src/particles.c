@@ -0,0 +1,810 @@
+/**
+ * Pool of purely decorative particles (e.g., explosions)
+ *
+ * Every attribute is kept on its own array, aligned to PARTICLES_ALIGN bytes
+ * and padded to a multiple of PARTICLES_LANES, so the kernels may always
+ * process full vectors (lanes past the last live particle are simply ignored)
+ *
+ * @file src/particles.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmCamera.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmSpriteset.h>
+
+#include <ld34/game.h>
+#include <ld34/jobs.h>
+#include <ld34/particles.h>
+#include <ld34/snapshot.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define PARTICLES_LANES 8
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#  define PARTICLES_LANES 4
+#else
+#  define PARTICLES_LANES 1
+#endif
+#define PARTICLES_ALIGN 32
+/** For how long the pool must stay mostly empty before being trimmed */
+#define PARTICLES_TRIM_DELAY 2000
+/** Number of particles integrated by each job; Must be a multiple of 32 */
+#define PARTICLES_JOB_GRAIN 1024
+
+struct stParticles {
+    /** Horizontal position */
+    float *pX;
+    /** Vertical position */
+    float *pY;
+    /** Horizontal velocity */
+    float *pVx;
+    /** Vertical velocity */
+    float *pVy;
+    /** Horizontal acceleration */
+    float *pAx;
+    /** Vertical acceleration */
+    float *pAy;
+    /** For how long (in milliseconds) each particle has been alive */
+    float *pAge;
+    /** Animation played by each particle */
+    int *pAnim;
+    /** Bitmask of particles killed on the last update (one bit per lane) */
+    uint32_t *pDead;
+    /** Single allocation backing every array above */
+    void *pBuf;
+    /** Offset of each animation within pAnimData */
+    int *pAnimIndex;
+    /** Animations, in the same format as a gfmGroup's */
+    int *pAnimData;
+    /** Spriteset used to render the particles */
+    gfmSpriteset *pSset;
+    /** Number of animations */
+    int numAnims;
+    /** Number of particles that fit on the arrays */
+    int len;
+    /** Number of live particles (always packed at the start of the arrays) */
+    int used;
+    /** Maximum number of live particles ever reached */
+    int highWater;
+    /** Number of particles alloc'ed at first (and kept while trimming) */
+    int initLen;
+    /** Maximum number of particles */
+    int maxLen;
+    /** For how long the pool has been mostly empty */
+    int quietTime;
+    /** Elapsed time on the current frame (kept for the integration jobs) */
+    float elapsed;
+    /** Camera's position on the current frame */
+    float camX;
+    /** Camera's position on the current frame */
+    float camY;
+    /** Number of particles being integrated (i.e., padded 'used') */
+    int numIntegrated;
+    /** Number of particles that couldn't be spawned since the pool was full */
+    int numDropped;
+    /** For how long, in milliseconds, particles live */
+    int ttl;
+    /** Whether particles die when leaving the camera */
+    int deathOnLeave;
+    /** Dimensions used for culling */
+    int width;
+    /** Dimensions used for culling */
+    int height;
+    /** Rendering offset */
+    int offX;
+    /** Rendering offset */
+    int offY;
+};
+
+/** Round a number of particles up to a whole number of vectors */
+#define particles_padLen(len) \
+    (((len) + PARTICLES_LANES - 1) / PARTICLES_LANES * PARTICLES_LANES)
+
+/** Number of bytes required by a padded float/int array */
+#define particles_arrSize(len) \
+    (((sizeof(float) * (len)) + PARTICLES_ALIGN - 1) / PARTICLES_ALIGN * \
+    PARTICLES_ALIGN)
+
+/** Number of bytes required by the dead bitmask */
+#define particles_maskSize(len) \
+    (((sizeof(uint32_t) * (((len) + 31) / 32)) + PARTICLES_ALIGN - 1) / \
+    PARTICLES_ALIGN * PARTICLES_ALIGN)
+
+/**
+ * (Re)alloc every array, all from a single aligned buffer, keeping every live
+ * particle
+ *
+ * @param  [ in]pCtx The particle pool
+ * @param  [ in]len  Number of particles
+ */
+static gfmRV particles_resize(particles *pCtx, int len) {
+    char *pBuf;
+    gfmRV rv;
+    size_t arrSize;
+    void *pOldBuf;
+    float *pOldX, *pOldY, *pOldVx, *pOldVy, *pOldAx, *pOldAy, *pOldAge;
+    int *pOldAnim;
+
+    len = particles_padLen(len);
+    arrSize = particles_arrSize(len);
+
+    pOldBuf = pCtx->pBuf;
+    pOldX = pCtx->pX;
+    pOldY = pCtx->pY;
+    pOldVx = pCtx->pVx;
+    pOldVy = pCtx->pVy;
+    pOldAx = pCtx->pAx;
+    pOldAy = pCtx->pAy;
+    pOldAge = pCtx->pAge;
+    pOldAnim = pCtx->pAnim;
+
+    pBuf = (char*)malloc(arrSize * 8 + particles_maskSize(len) +
+            PARTICLES_ALIGN);
+    ASSERT(pBuf, GFMRV_ALLOC_FAILED);
+    pCtx->pBuf = pBuf;
+
+    pBuf += (PARTICLES_ALIGN - ((uintptr_t)pBuf % PARTICLES_ALIGN)) %
+            PARTICLES_ALIGN;
+    memset(pBuf, 0x0, arrSize * 8 + particles_maskSize(len));
+
+    pCtx->pX = (float*)(pBuf + arrSize * 0);
+    pCtx->pY = (float*)(pBuf + arrSize * 1);
+    pCtx->pVx = (float*)(pBuf + arrSize * 2);
+    pCtx->pVy = (float*)(pBuf + arrSize * 3);
+    pCtx->pAx = (float*)(pBuf + arrSize * 4);
+    pCtx->pAy = (float*)(pBuf + arrSize * 5);
+    pCtx->pAge = (float*)(pBuf + arrSize * 6);
+    pCtx->pAnim = (int*)(pBuf + arrSize * 7);
+    pCtx->pDead = (uint32_t*)(pBuf + arrSize * 8);
+    pCtx->len = len;
+
+    if (pOldBuf) {
+        memcpy(pCtx->pX, pOldX, sizeof(float) * pCtx->used);
+        memcpy(pCtx->pY, pOldY, sizeof(float) * pCtx->used);
+        memcpy(pCtx->pVx, pOldVx, sizeof(float) * pCtx->used);
+        memcpy(pCtx->pVy, pOldVy, sizeof(float) * pCtx->used);
+        memcpy(pCtx->pAx, pOldAx, sizeof(float) * pCtx->used);
+        memcpy(pCtx->pAy, pOldAy, sizeof(float) * pCtx->used);
+        memcpy(pCtx->pAge, pOldAge, sizeof(float) * pCtx->used);
+        memcpy(pCtx->pAnim, pOldAnim, sizeof(int) * pCtx->used);
+        free(pOldBuf);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Alloc and initialize a particle pool
+ *
+ * @param  [out]ppCtx        The particle pool
+ * @param  [ in]pSset        Spriteset used to render the particles
+ * @param  [ in]pAnimData    Animations, in the same format as a gfmGroup's
+ * @param  [ in]animDataLen  Number of elements in pAnimData
+ * @param  [ in]w            Particles' width (used only for culling)
+ * @param  [ in]h            Particles' height (used only for culling)
+ * @param  [ in]ox           Rendering offset
+ * @param  [ in]oy           Rendering offset
+ * @param  [ in]ttl          For how long, in milliseconds, particles live
+ * @param  [ in]deathOnLeave Whether particles die when leaving the camera
+ * @param  [ in]initLen      Number of particles alloc'ed at first
+ * @param  [ in]maxLen       Maximum number of particles
+ */
+gfmRV particles_init(particles **ppCtx, gfmSpriteset *pSset, int *pAnimData,
+        int animDataLen, int w, int h, int ox, int oy, int ttl,
+        int deathOnLeave, int initLen, int maxLen) {
+    gfmRV rv;
+    int i, num;
+
+    *ppCtx = 0;
+    ASSERT(initLen > 0 && initLen <= maxLen, GFMRV_ARGUMENTS_BAD);
+
+    *ppCtx = (particles*)malloc(sizeof(particles));
+    ASSERT(*ppCtx, GFMRV_ALLOC_FAILED);
+    memset(*ppCtx, 0x0, sizeof(particles));
+
+    /* Count and index every animation */
+    i = 0;
+    num = 0;
+    while (i < animDataLen) {
+        i += pAnimData[i] + 3;
+        num++;
+    }
+    ASSERT(i == animDataLen, GFMRV_ARGUMENTS_BAD);
+
+    (*ppCtx)->pAnimIndex = (int*)malloc(sizeof(int) * num);
+    ASSERT((*ppCtx)->pAnimIndex, GFMRV_ALLOC_FAILED);
+
+    i = 0;
+    num = 0;
+    while (i < animDataLen) {
+        (*ppCtx)->pAnimIndex[num] = i;
+        i += pAnimData[i] + 3;
+        num++;
+    }
+
+    rv = particles_resize(*ppCtx, initLen);
+    ASSERT(rv == GFMRV_OK, rv);
+    (*ppCtx)->initLen = (*ppCtx)->len;
+    (*ppCtx)->maxLen = particles_padLen(maxLen);
+
+    (*ppCtx)->pAnimData = pAnimData;
+    (*ppCtx)->numAnims = num;
+    (*ppCtx)->pSset = pSset;
+    (*ppCtx)->ttl = ttl;
+    (*ppCtx)->deathOnLeave = deathOnLeave;
+    (*ppCtx)->width = w;
+    (*ppCtx)->height = h;
+    (*ppCtx)->offX = ox;
+    (*ppCtx)->offY = oy;
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK) {
+        particles_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Release the particle pool
+ *
+ * @param  [ in]ppCtx The particle pool
+ */
+void particles_clean(particles **ppCtx) {
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+
+    if ((*ppCtx)->pBuf) {
+        free((*ppCtx)->pBuf);
+    }
+    if ((*ppCtx)->pAnimIndex) {
+        free((*ppCtx)->pAnimIndex);
+    }
+    free(*ppCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Make room for num more particles, doubling the pool as many times as
+ * needed (but never past its maximum size)
+ *
+ * @param  [out]pAvail Number of particles that actually fit
+ * @param  [ in]pCtx   The particle pool
+ * @param  [ in]num    Number of particles about to be spawned
+ */
+static gfmRV particles_reserve(int *pAvail, particles *pCtx, int num) {
+    gfmRV rv;
+    int len;
+
+    len = pCtx->len;
+    while (len < pCtx->used + num && len < pCtx->maxLen) {
+        len *= 2;
+    }
+    if (len > pCtx->maxLen) {
+        len = pCtx->maxLen;
+    }
+    if (len != pCtx->len) {
+        rv = particles_resize(pCtx, len);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    *pAvail = pCtx->len - pCtx->used;
+    if (*pAvail > num) {
+        *pAvail = num;
+    }
+    pCtx->numDropped += num - *pAvail;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Account for particles written past the last live one
+ *
+ * @param  [ in]pCtx The particle pool
+ * @param  [ in]num  Number of new particles
+ */
+static void particles_commit(particles *pCtx, int num) {
+    pCtx->used += num;
+    if (pCtx->used > pCtx->highWater) {
+        pCtx->highWater = pCtx->used;
+    }
+}
+
+/**
+ * Spawn a new particle, doubling the pool if it's full; If the pool already
+ * reached its maximum size, the particle is dropped
+ *
+ * @param  [ in]pCtx The particle pool
+ * @param  [ in]x    Initial position
+ * @param  [ in]y    Initial position
+ * @param  [ in]vx   Initial velocity
+ * @param  [ in]vy   Initial velocity
+ * @param  [ in]ax   Acceleration
+ * @param  [ in]ay   Acceleration
+ * @param  [ in]anim Animation played by the particle
+ */
+gfmRV particles_spawn(particles *pCtx, int x, int y, double vx, double vy,
+        double ax, double ay, int anim) {
+    particleDesc desc;
+
+    desc.x = x;
+    desc.y = y;
+    desc.vx = (float)vx;
+    desc.vy = (float)vy;
+    desc.ax = (float)ax;
+    desc.ay = (float)ay;
+    desc.anim = anim;
+
+    return particles_spawnBatch(pCtx, &desc, 1);
+}
+
+/**
+ * Spawn every described particle in a single pass; Particles that don't fit
+ * on the pool (even after it grows) are dropped
+ *
+ * @param  [ in]pCtx   The particle pool
+ * @param  [ in]pDescs The particles
+ * @param  [ in]num    Number of elements in pDescs
+ */
+gfmRV particles_spawnBatch(particles *pCtx, particleDesc *pDescs, int num) {
+    gfmRV rv;
+    int avail, i, j;
+
+    ASSERT(num >= 0, GFMRV_ARGUMENTS_BAD);
+    i = 0;
+    while (i < num) {
+        ASSERT(pDescs[i].anim >= 0 && pDescs[i].anim < pCtx->numAnims,
+                GFMRV_ARGUMENTS_BAD);
+        i++;
+    }
+
+    rv = particles_reserve(&avail, pCtx, num);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    i = 0;
+    j = pCtx->used;
+    while (i < avail) {
+        pCtx->pX[j] = (float)pDescs[i].x;
+        pCtx->pY[j] = (float)pDescs[i].y;
+        pCtx->pVx[j] = pDescs[i].vx;
+        pCtx->pVy[j] = pDescs[i].vy;
+        pCtx->pAx[j] = pDescs[i].ax;
+        pCtx->pAy[j] = pDescs[i].ay;
+        pCtx->pAge[j] = 0.0f;
+        pCtx->pAnim[j] = pDescs[i].anim;
+        i++;
+        j++;
+    }
+    particles_commit(pCtx, avail);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Spawn num particles moving away from a common center, evenly spaced around
+ * it (the first one moves right); Particles that don't fit are dropped
+ *
+ * The direction is rotated incrementally, so only a single sin/cos pair is
+ * evaluated per burst
+ *
+ * @param  [ in]pCtx  The particle pool
+ * @param  [ in]x     Burst's center
+ * @param  [ in]y     Burst's center
+ * @param  [ in]num   Number of particles
+ * @param  [ in]speed Particles' speed
+ * @param  [ in]anim  Animation played by every particle
+ */
+gfmRV particles_spawnBurst(particles *pCtx, int x, int y, int num,
+        double speed, int anim) {
+    gfmRV rv;
+    double c, s, dx, dy, tmp;
+    int avail, i, j;
+
+    ASSERT(num >= 0, GFMRV_ARGUMENTS_BAD);
+    ASSERT(anim >= 0 && anim < pCtx->numAnims, GFMRV_ARGUMENTS_BAD);
+
+    rv = particles_reserve(&avail, pCtx, num);
+    ASSERT(rv == GFMRV_OK, rv);
+    if (avail == 0) {
+        return GFMRV_OK;
+    }
+
+    c = cos(2.0 * M_PI / num);
+    s = sin(2.0 * M_PI / num);
+    dx = speed;
+    dy = 0.0;
+
+    i = 0;
+    j = pCtx->used;
+    while (i < avail) {
+        pCtx->pX[j] = (float)x;
+        pCtx->pY[j] = (float)y;
+        pCtx->pVx[j] = (float)dx;
+        pCtx->pVy[j] = (float)dy;
+        pCtx->pAx[j] = 0.0f;
+        pCtx->pAy[j] = 0.0f;
+        pCtx->pAge[j] = 0.0f;
+        pCtx->pAnim[j] = anim;
+
+        tmp = dx * c - dy * s;
+        dy = dx * s + dy * c;
+        dx = tmp;
+
+        i++;
+        j++;
+    }
+    particles_commit(pCtx, avail);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Integrate particles [first, last) and flag every dead one on pDead
+ *
+ * Both first and last must be multiples of 32 (or last == pCtx->len), so each
+ * call writes whole words of the bitmask
+ *
+ * @param  [ in]pCtx  The particle pool
+ * @param  [ in]first First particle
+ * @param  [ in]last  One past the last particle
+ * @param  [ in]ms    Elapsed time, in milliseconds
+ * @param  [ in]camX  Camera's position
+ * @param  [ in]camY  Camera's position
+ */
+static void particles_integrate(particles *pCtx, int first, int last,
+        float ms, float camX, float camY) {
+    float *pX, *pY, *pVx, *pVy, *pAx, *pAy, *pAge;
+    uint32_t *pDead;
+    float dt, maxX, maxY, minX, minY, ttl;
+    int cull, i;
+
+    pX = pCtx->pX;
+    pY = pCtx->pY;
+    pVx = pCtx->pVx;
+    pVy = pCtx->pVy;
+    pAx = pCtx->pAx;
+    pAy = pCtx->pAy;
+    pAge = pCtx->pAge;
+    pDead = pCtx->pDead;
+
+    dt = ms / 1000.0f;
+    ttl = (float)pCtx->ttl;
+    cull = pCtx->deathOnLeave;
+    /* A particle is outside if x + w < camX or x > camX + BBWDT */
+    minX = camX - (float)pCtx->width;
+    minY = camY - (float)pCtx->height;
+    maxX = camX + (float)BBWDT;
+    maxY = camY + (float)BBHGT;
+
+    memset(pDead + first / 32, 0x0, sizeof(uint32_t) * ((last - first + 31) /
+            32));
+
+    i = first;
+#if defined(__AVX2__)
+    do {
+        __m256 vAge, vAx, vAy, vDead, vDt, vMaxX, vMaxY, vMinX, vMinY, vMs;
+        __m256 vTtl, vVx, vVy, vX, vY;
+
+        vDt = _mm256_set1_ps(dt);
+        vMs = _mm256_set1_ps(ms);
+        vTtl = _mm256_set1_ps(ttl);
+        vMinX = _mm256_set1_ps(minX);
+        vMinY = _mm256_set1_ps(minY);
+        vMaxX = _mm256_set1_ps(maxX);
+        vMaxY = _mm256_set1_ps(maxY);
+
+        while (i < last) {
+            vVx = _mm256_load_ps(pVx + i);
+            vVy = _mm256_load_ps(pVy + i);
+            vAx = _mm256_load_ps(pAx + i);
+            vAy = _mm256_load_ps(pAy + i);
+            vX = _mm256_load_ps(pX + i);
+            vY = _mm256_load_ps(pY + i);
+            vAge = _mm256_load_ps(pAge + i);
+
+            vVx = _mm256_add_ps(vVx, _mm256_mul_ps(vAx, vDt));
+            vVy = _mm256_add_ps(vVy, _mm256_mul_ps(vAy, vDt));
+            vX = _mm256_add_ps(vX, _mm256_mul_ps(vVx, vDt));
+            vY = _mm256_add_ps(vY, _mm256_mul_ps(vVy, vDt));
+            vAge = _mm256_add_ps(vAge, vMs);
+
+            _mm256_store_ps(pVx + i, vVx);
+            _mm256_store_ps(pVy + i, vVy);
+            _mm256_store_ps(pX + i, vX);
+            _mm256_store_ps(pY + i, vY);
+            _mm256_store_ps(pAge + i, vAge);
+
+            vDead = _mm256_cmp_ps(vAge, vTtl, _CMP_GE_OQ);
+            if (cull) {
+                vDead = _mm256_or_ps(vDead, _mm256_cmp_ps(vX, vMinX,
+                        _CMP_LT_OQ));
+                vDead = _mm256_or_ps(vDead, _mm256_cmp_ps(vY, vMinY,
+                        _CMP_LT_OQ));
+                vDead = _mm256_or_ps(vDead, _mm256_cmp_ps(vX, vMaxX,
+                        _CMP_GT_OQ));
+                vDead = _mm256_or_ps(vDead, _mm256_cmp_ps(vY, vMaxY,
+                        _CMP_GT_OQ));
+            }
+            pDead[i / 32] |= (uint32_t)_mm256_movemask_ps(vDead) << (i % 32);
+
+            i += 8;
+        }
+    } while (0);
+#elif defined(__SSE2__)
+    do {
+        __m128 vAge, vAx, vAy, vDead, vDt, vMaxX, vMaxY, vMinX, vMinY, vMs;
+        __m128 vTtl, vVx, vVy, vX, vY;
+
+        vDt = _mm_set1_ps(dt);
+        vMs = _mm_set1_ps(ms);
+        vTtl = _mm_set1_ps(ttl);
+        vMinX = _mm_set1_ps(minX);
+        vMinY = _mm_set1_ps(minY);
+        vMaxX = _mm_set1_ps(maxX);
+        vMaxY = _mm_set1_ps(maxY);
+
+        while (i < last) {
+            vVx = _mm_load_ps(pVx + i);
+            vVy = _mm_load_ps(pVy + i);
+            vAx = _mm_load_ps(pAx + i);
+            vAy = _mm_load_ps(pAy + i);
+            vX = _mm_load_ps(pX + i);
+            vY = _mm_load_ps(pY + i);
+            vAge = _mm_load_ps(pAge + i);
+
+            vVx = _mm_add_ps(vVx, _mm_mul_ps(vAx, vDt));
+            vVy = _mm_add_ps(vVy, _mm_mul_ps(vAy, vDt));
+            vX = _mm_add_ps(vX, _mm_mul_ps(vVx, vDt));
+            vY = _mm_add_ps(vY, _mm_mul_ps(vVy, vDt));
+            vAge = _mm_add_ps(vAge, vMs);
+
+            _mm_store_ps(pVx + i, vVx);
+            _mm_store_ps(pVy + i, vVy);
+            _mm_store_ps(pX + i, vX);
+            _mm_store_ps(pY + i, vY);
+            _mm_store_ps(pAge + i, vAge);
+
+            vDead = _mm_cmpge_ps(vAge, vTtl);
+            if (cull) {
+                vDead = _mm_or_ps(vDead, _mm_cmplt_ps(vX, vMinX));
+                vDead = _mm_or_ps(vDead, _mm_cmplt_ps(vY, vMinY));
+                vDead = _mm_or_ps(vDead, _mm_cmpgt_ps(vX, vMaxX));
+                vDead = _mm_or_ps(vDead, _mm_cmpgt_ps(vY, vMaxY));
+            }
+            pDead[i / 32] |= (uint32_t)_mm_movemask_ps(vDead) << (i % 32);
+
+            i += 4;
+        }
+    } while (0);
+#endif
+    /* Scalar fallback (and tail, if the vector loop didn't run at all) */
+    while (i < last) {
+        int isDead;
+
+        pVx[i] += pAx[i] * dt;
+        pVy[i] += pAy[i] * dt;
+        pX[i] += pVx[i] * dt;
+        pY[i] += pVy[i] * dt;
+        pAge[i] += ms;
+
+        isDead = (pAge[i] >= ttl);
+        if (cull) {
+            isDead |= (pX[i] < minX) | (pY[i] < minY) | (pX[i] > maxX) |
+                    (pY[i] > maxY);
+        }
+        pDead[i / 32] |= (uint32_t)isDead << (i % 32);
+
+        i++;
+    }
+}
+
+/**
+ * Remove every particle flagged on pDead, keeping the live ones packed
+ *
+ * Dead particles are visited from the last to the first, so the particle
+ * moved into a hole is always a live one
+ *
+ * @param  [ in]pCtx The particle pool
+ */
+static void particles_compact(particles *pCtx) {
+    int word;
+
+    word = (pCtx->used + 31) / 32 - 1;
+    while (word >= 0) {
+        uint32_t mask;
+
+        mask = pCtx->pDead[word];
+        /* Ignore the padding past the last live particle */
+        if (word == pCtx->used / 32) {
+            mask &= ((uint32_t)1 << (pCtx->used % 32)) - 1;
+        }
+
+        while (mask != 0) {
+            int bit, i, last;
+
+            bit = 31 - __builtin_clz(mask);
+            mask &= ~((uint32_t)1 << bit);
+
+            i = word * 32 + bit;
+            last = pCtx->used - 1;
+            if (i != last) {
+                pCtx->pX[i] = pCtx->pX[last];
+                pCtx->pY[i] = pCtx->pY[last];
+                pCtx->pVx[i] = pCtx->pVx[last];
+                pCtx->pVy[i] = pCtx->pVy[last];
+                pCtx->pAx[i] = pCtx->pAx[last];
+                pCtx->pAy[i] = pCtx->pAy[last];
+                pCtx->pAge[i] = pCtx->pAge[last];
+                pCtx->pAnim[i] = pCtx->pAnim[last];
+            }
+            pCtx->used--;
+        }
+
+        word--;
+    }
+}
+
+/**
+ * Job that integrates a range of particles
+ *
+ * @param  [ in]pArg  The particle pool
+ * @param  [ in]first First particle
+ * @param  [ in]last  One past the last particle
+ */
+static gfmRV particles_integrateJob(void *pArg, int first, int last) {
+    particles *pCtx;
+
+    pCtx = (particles*)pArg;
+    particles_integrate(pCtx, first, last, pCtx->elapsed, pCtx->camX,
+            pCtx->camY);
+
+    return GFMRV_OK;
+}
+
+/**
+ * Queue the integration of every particle on the job system; After a quiet
+ * period, the pool is also halved
+ *
+ * Nothing may be spawned until particles_postUpdate is called (after
+ * jobs_wait)
+ *
+ * @param  [ in]pCtx The particle pool
+ */
+gfmRV particles_update(particles *pCtx) {
+    gfmCamera *pCam;
+    gfmRV rv;
+    int camX, camY, elapsed;
+
+    pCtx->numIntegrated = 0;
+
+    elapsed = pGame->elapsed;
+
+    if (pCtx->len > pCtx->initLen && pCtx->used <= pCtx->len / 4) {
+        pCtx->quietTime += elapsed;
+        if (pCtx->quietTime >= PARTICLES_TRIM_DELAY) {
+            rv = particles_resize(pCtx, pCtx->len / 2);
+            ASSERT(rv == GFMRV_OK, rv);
+            pCtx->quietTime = 0;
+        }
+    }
+    else {
+        pCtx->quietTime = 0;
+    }
+
+    if (pCtx->used == 0) {
+        return GFMRV_OK;
+    }
+
+    pCam = 0;
+    rv = gfm_getCamera(&pCam, pGame->pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmCamera_getPosition(&camX, &camY, pCam);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    pCtx->elapsed = (float)elapsed;
+    pCtx->camX = (float)camX;
+    pCtx->camY = (float)camY;
+    pCtx->numIntegrated = particles_padLen(pCtx->used);
+
+    rv = jobs_push(pGame->pJobs, particles_integrateJob, pCtx,
+            pCtx->numIntegrated, PARTICLES_JOB_GRAIN);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Remove every particle that died while integrating
+ *
+ * @param  [ in]pCtx The particle pool
+ */
+gfmRV particles_postUpdate(particles *pCtx) {
+    if (pCtx->numIntegrated > 0) {
+        particles_compact(pCtx);
+        pCtx->numIntegrated = 0;
+    }
+
+    return GFMRV_OK;
+}
+
+/**
+ * Push every live particle into the snapshot being recorded; Particles are
+ * too short-lived (and moved around on compaction) to be interpolated
+ *
+ * @param  [ in]pCtx The particle pool
+ */
+gfmRV particles_draw(particles *pCtx) {
+    gfmRV rv;
+    int i;
+
+    if (pCtx->used == 0) {
+        return GFMRV_OK;
+    }
+
+    i = 0;
+    while (i < pCtx->used) {
+        int *pAnim;
+        int frame, x, y;
+
+        pAnim = pCtx->pAnimData + pCtx->pAnimIndex[pCtx->pAnim[i]];
+
+        /* pAnim = len | fps | loop | frames... */
+        frame = (int)(pCtx->pAge[i] * pAnim[1] / 1000.0f);
+        if (pAnim[2]) {
+            frame %= pAnim[0];
+        }
+        else if (frame >= pAnim[0]) {
+            frame = pAnim[0] - 1;
+        }
+
+        x = (int)pCtx->pX[i] + pCtx->offX;
+        y = (int)pCtx->pY[i] + pCtx->offY;
+
+        rv = snapshot_pushTile(pGame->pSnapshot, pCtx->pSset, x, y,
+                pAnim[3 + frame], 0/*isFlipped*/, 0/*pOwner*/, 0/*part*/);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve the pool's usage
+ *
+ * @param  [out]pUsed      Number of live particles
+ * @param  [out]pHighWater Maximum number of live particles ever reached
+ * @param  [out]pLen       Number of particles currently alloc'ed
+ * @param  [out]pDropped   Number of particles dropped since the pool was full
+ * @param  [ in]pCtx       The particle pool
+ */
+void particles_getStats(int *pUsed, int *pHighWater, int *pLen, int *pDropped,
+        particles *pCtx) {
+    *pUsed = pCtx->used;
+    *pHighWater = pCtx->highWater;
+    *pLen = pCtx->len;
+    *pDropped = pCtx->numDropped;
+}
+
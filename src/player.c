@@ -11,10 +11,14 @@
 #include <GFraMe/gfmSave.h>
 #include <GFraMe/gfmSprite.h>
 
+#include <ld34/broadphase.h>
 #include <ld34/collide.h>
 #include <ld34/game.h>
+#include <ld34/mixer.h>
 #include <ld34/player.h>
+#include <ld34/snapshot.h>
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -23,11 +27,20 @@ struct stPlayer {
     gfmObject *upper_pTorso;
     gfmObject *left_pLeg;
     gfmObject *right_pLeg;
-    gfmSprite *pRenderSpr;
+    /** Covers every limb (and the legs' movement); The only object actually
+     * added to the quadtree */
+    gfmObject *pBody;
     int left_raisingTime;
-    int left_elapsedSinceStep;
+    /** When the left leg last landed (-1, if it's not a recent step) */
+    double left_stepTime;
     int right_raisingTime;
-    int right_elapsedSinceStep;
+    /** When the right leg last landed (-1, if it's not a recent step) */
+    double right_stepTime;
+    /** Legs' positions before they were last updated */
+    int left_lastX;
+    int left_lastY;
+    int right_lastX;
+    int right_lastY;
     int didJump;
 };
 
@@ -78,7 +91,7 @@ gfmRV player_init(player **ppPlayer, int x, int y) {
     ASSERT(rv == GFMRV_OK, rv);
     rv = gfmObject_getNew(&(pPlayer->left_pLeg));
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmSprite_getNew(&(pPlayer->pRenderSpr));
+    rv = gfmObject_getNew(&(pPlayer->pBody));
     ASSERT(rv == GFMRV_OK, rv);
 
     rv = gfmObject_init(pPlayer->upper_pTorso, x, y, 10, 14, pPlayer,
@@ -93,8 +106,8 @@ gfmRV player_init(player **ppPlayer, int x, int y) {
     rv = gfmObject_init(pPlayer->right_pLeg, x+1, y+30, 10, 14, pPlayer,
             PL_RIGHT_LEG);
     ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmSprite_init(pPlayer->pRenderSpr, 0, 0, 2, 2, pAssets->pSset8x8, 0,
-            0, 0, PL_UPPER);
+    /* Its bounds are set on every update */
+    rv = gfmObject_init(pPlayer->pBody, x, y, 1, 1, pPlayer, PL_BODY);
     ASSERT(rv == GFMRV_OK, rv);
 
     rv = gfmObject_setAcceleration(pPlayer->left_pLeg, 0, GRAV);
@@ -103,6 +116,8 @@ gfmRV player_init(player **ppPlayer, int x, int y) {
     ASSERT(rv == GFMRV_OK, rv);
 
     pPlayer->didJump = 1;
+    pPlayer->left_stepTime = -1.0;
+    pPlayer->right_stepTime = -1.0;
 
     *ppPlayer = pPlayer;
     rv = GFMRV_OK;
@@ -122,16 +137,42 @@ void player_clean(player **ppPlayer) {
         return;
     }
 
-    gfmSprite_free(&((*ppPlayer)->pRenderSpr));
     gfmObject_free(&((*ppPlayer)->upper_pTorso));
     gfmObject_free(&((*ppPlayer)->lower_pTorso));
     gfmObject_free(&((*ppPlayer)->left_pLeg));
     gfmObject_free(&((*ppPlayer)->right_pLeg));
+    gfmObject_free(&((*ppPlayer)->pBody));
 
     free(*ppPlayer);
     *ppPlayer = 0;
 }
 
+/**
+ * Calculate for how long a button was held during the current tick, from the
+ * time it was actually pressed (if during the tick) until it was actually
+ * released (if during the tick)
+ *
+ * @param  [ in]pBt The button
+ */
+static inline int player_getHeldTime(button *pBt) {
+    double end, start;
+
+    start = pGame->tickTime - pGame->elapsed;
+    end = pGame->tickTime;
+    if (pBt->pressTime > start) {
+        start = pBt->pressTime;
+    }
+    /* Only a release after the last press ends the hold */
+    if (pBt->releaseTime >= pBt->pressTime && pBt->releaseTime < end) {
+        end = pBt->releaseTime;
+    }
+    if (end <= start) {
+        return 0;
+    }
+
+    return (int)(end - start + 0.5);
+}
+
 static inline gfmRV player_moveLeg(gfmObject *pObj, button *pBt, int *pTime,
         int didJump, double vx) {
     gfmRV rv;
@@ -140,8 +181,8 @@ static inline gfmRV player_moveLeg(gfmObject *pObj, button *pBt, int *pTime,
         gfmCollision dir;
         int elapsed;
 
-        rv = gfm_getElapsedTime(&elapsed, pGame->pCtx);
-        ASSERT(rv == GFMRV_OK, rv);
+        /* Only count the part of the tick after the press */
+        elapsed = player_getHeldTime(pBt);
 
         rv = gfmObject_getCollision(&dir, pObj);
         ASSERT(rv == GFMRV_OK, rv);
@@ -160,8 +201,7 @@ static inline gfmRV player_moveLeg(gfmObject *pObj, button *pBt, int *pTime,
         int elapsed;
         double _vx, _vy;
 
-        rv = gfm_getElapsedTime(&elapsed, pGame->pCtx);
-        ASSERT(rv == GFMRV_OK, rv);
+        elapsed = player_getHeldTime(pBt);
 
         _vx = vx + vx * 0.1 * (PL_HOLD_T - *pTime) / (double)PL_HOLD_T;
         _vy = PL_VY  * 0.8 * (PL_HOLD_T - *pTime) / (double)PL_HOLD_T;
@@ -174,17 +214,33 @@ static inline gfmRV player_moveLeg(gfmObject *pObj, button *pBt, int *pTime,
     else if ((pBt->state & gfmInput_justReleased) == gfmInput_justReleased &&
             !didJump) {
         double vy;
+        int held;
 
-        *pTime = 0;
+        /* Still lifted for the part of the tick before the release, so move
+         * (on average) as much as that over the whole tick */
+        held = player_getHeldTime(pBt);
+        if (held > 0 && *pTime < PL_HOLD_T && pGame->elapsed > 0) {
+            double _vx, _vy, share;
 
-        rv = gfmObject_getVerticalVelocity(&vy, pObj);
-        ASSERT(rv == GFMRV_OK, rv);
+            share = held / (double)pGame->elapsed;
+            _vx = vx + vx * 0.1 * (PL_HOLD_T - *pTime) / (double)PL_HOLD_T;
+            _vy = PL_VY  * 0.8 * (PL_HOLD_T - *pTime) / (double)PL_HOLD_T;
 
-        if (vy < 0.0) {
-            vy = 0.0;
+            rv = gfmObject_setVelocity(pObj, _vx * share, _vy * share);
+            ASSERT(rv == GFMRV_OK, rv);
         }
-        rv = gfmObject_setVelocity(pObj, 0.0, 0.0);
-        ASSERT(rv == GFMRV_OK, rv);
+        else {
+            rv = gfmObject_getVerticalVelocity(&vy, pObj);
+            ASSERT(rv == GFMRV_OK, rv);
+
+            if (vy < 0.0) {
+                vy = 0.0;
+            }
+            rv = gfmObject_setVelocity(pObj, 0.0, 0.0);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+
+        *pTime = 0;
     }
     else if ((pBt->state & gfmInput_released) == gfmInput_released) {
         *pTime = 0;
@@ -195,6 +251,108 @@ __ret:
     return rv;
 }
 
+/**
+ * Retrieve a limb's bounds on this tick (i.e., over the whole path it moved,
+ * if it's a leg)
+ *
+ * @param  [out]pX0     Left
+ * @param  [out]pY0     Top
+ * @param  [out]pX1     Right
+ * @param  [out]pY1     Bottom
+ * @param  [ in]pPlayer The player
+ * @param  [ in]pLimb   The limb
+ */
+static gfmRV player_getLimbBounds(int *pX0, int *pY0, int *pX1, int *pY1,
+        player *pPlayer, gfmObject *pLimb) {
+    gfmRV rv;
+    int height, lastX, lastY, width;
+
+    rv = gfmObject_getPosition(pX0, pY0, pLimb);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getDimensions(&width, &height, pLimb);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    lastX = *pX0;
+    lastY = *pY0;
+    if (pLimb == pPlayer->left_pLeg) {
+        lastX = pPlayer->left_lastX;
+        lastY = pPlayer->left_lastY;
+    }
+    else if (pLimb == pPlayer->right_pLeg) {
+        lastX = pPlayer->right_lastX;
+        lastY = pPlayer->right_lastY;
+    }
+
+    *pX1 = *pX0 + width;
+    *pY1 = *pY0 + height;
+    if (lastX < *pX0) {
+        *pX0 = lastX;
+    }
+    else {
+        *pX1 += lastX - *pX0;
+    }
+    if (lastY < *pY0) {
+        *pY0 = lastY;
+    }
+    else {
+        *pY1 += lastY - *pY0;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Fit the body around every limb
+ *
+ * @param  [ in]pPlayer The player
+ */
+static gfmRV player_updateBody(player *pPlayer) {
+    gfmObject *ppLimbs[PL_NUM_LIMBS];
+    gfmRV rv;
+    int i, x0, y0, x1, y1;
+
+    ppLimbs[0] = pPlayer->left_pLeg;
+    ppLimbs[1] = pPlayer->right_pLeg;
+    ppLimbs[2] = pPlayer->upper_pTorso;
+    ppLimbs[3] = pPlayer->lower_pTorso;
+
+    rv = player_getLimbBounds(&x0, &y0, &x1, &y1, pPlayer, ppLimbs[0]);
+    ASSERT(rv == GFMRV_OK, rv);
+    i = 1;
+    while (i < PL_NUM_LIMBS) {
+        int lx0, ly0, lx1, ly1;
+
+        rv = player_getLimbBounds(&lx0, &ly0, &lx1, &ly1, pPlayer,
+                ppLimbs[i]);
+        ASSERT(rv == GFMRV_OK, rv);
+        if (lx0 < x0) {
+            x0 = lx0;
+        }
+        if (ly0 < y0) {
+            y0 = ly0;
+        }
+        if (lx1 > x1) {
+            x1 = lx1;
+        }
+        if (ly1 > y1) {
+            y1 = ly1;
+        }
+
+        i++;
+    }
+
+    rv = gfmObject_setPosition(pPlayer->pBody, x0, y0);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_setDimensions(pPlayer->pBody, x1 - x0, y1 - y0);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
 /**
  * Update the player's physics and handle inputs
  *
@@ -265,37 +423,22 @@ gfmRV player_preUpdate(player *pPlayer) {
     ASSERT(rv == GFMRV_OK, rv);
     rv = gfmObject_update(pPlayer->lower_pTorso, pGame->pCtx);
     ASSERT(rv == GFMRV_OK, rv);
+    /* Kept so the legs are collided over their whole movement */
+    rv = gfmObject_getPosition(&(pPlayer->left_lastX),
+            &(pPlayer->left_lastY), pPlayer->left_pLeg);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getPosition(&(pPlayer->right_lastX),
+            &(pPlayer->right_lastY), pPlayer->right_pLeg);
+    ASSERT(rv == GFMRV_OK, rv);
     rv = gfmObject_update(pPlayer->left_pLeg, pGame->pCtx);
     ASSERT(rv == GFMRV_OK, rv);
     rv = gfmObject_update(pPlayer->right_pLeg, pGame->pCtx);
     ASSERT(rv == GFMRV_OK, rv);
 
-    /* Collide left leg */
-    rv = gfmQuadtree_collideObject(pGame->pQt, pPlayer->left_pLeg);
-    ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
-    if (rv == GFMRV_QUADTREE_OVERLAPED) {
-        rv = collide_run();
-        ASSERT(rv == GFMRV_OK, rv);
-    }
-
-    /* Collide right leg */
-    rv = gfmQuadtree_collideObject(pGame->pQt, pPlayer->right_pLeg);
-    ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
-    if (rv == GFMRV_QUADTREE_OVERLAPED) {
-        rv = collide_run();
-        ASSERT(rv == GFMRV_OK, rv);
-    }
-
-    /* Collide upper torso */
-    rv = gfmQuadtree_collideObject(pGame->pQt, pPlayer->upper_pTorso);
-    ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
-    if (rv == GFMRV_QUADTREE_OVERLAPED) {
-        rv = collide_run();
-        ASSERT(rv == GFMRV_OK, rv);
-    }
-
-    /* Collide lower torso */
-    rv = gfmQuadtree_collideObject(pGame->pQt, pPlayer->lower_pTorso);
+    /* Collide every limb at once */
+    rv = player_updateBody(pPlayer);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = broadphase_collideObject(pGame->pBroadphase, pPlayer->pBody);
     ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
     if (rv == GFMRV_QUADTREE_OVERLAPED) {
         rv = collide_run();
@@ -319,10 +462,9 @@ gfmRV player_postUpdate(player *pPlayer) {
     gfmRV rv;
     gfmCamera *pCam;
     gfmCollision l_cur, l_last, r_cur, r_last;
-    int elapsed, l_x, l_y, r_x, r_y, t_x, t_y;
+    int didStep, elapsed, l_x, l_y, r_x, r_y, t_x, t_y;
 
-    rv = gfm_getElapsedTime(&elapsed, pGame->pCtx);
-    ASSERT(rv == GFMRV_OK, rv);
+    elapsed = pGame->elapsed;
 
     rv = gfmObject_getCollision(&l_cur, pPlayer->left_pLeg);
     ASSERT(rv == GFMRV_OK, rv);
@@ -333,28 +475,30 @@ gfmRV player_postUpdate(player *pPlayer) {
     rv = gfmObject_getLastCollision(&r_last, pPlayer->right_pLeg);
     ASSERT(rv == GFMRV_OK, rv);
 
+    /* Landings are only detected at the end of a tick, so assume they happened
+     * halfway through it */
+    didStep = 0;
     if (!(l_last & gfmCollision_down) && (l_cur & gfmCollision_down)) {
-        pPlayer->left_elapsedSinceStep = 0;
+        pPlayer->left_stepTime = pGame->tickTime - elapsed * 0.5;
+        didStep = 1;
 
-        rv = gfm_playAudio(0, pGame->pCtx, pAssets->sfxLeftStep, 0.3);
+        rv = mixer_play(pGame->pMixer, pAssets->sfxLeftStep, 0.3);
         ASSERT(rv == GFMRV_OK, rv);
     }
-    else {
-        pPlayer->left_elapsedSinceStep += elapsed;
-    }
 
     if (!(r_last & gfmCollision_down) && (r_cur & gfmCollision_down)) {
-        pPlayer->right_elapsedSinceStep = 0;
+        pPlayer->right_stepTime = pGame->tickTime - elapsed * 0.5;
+        didStep = 1;
 
-        rv = gfm_playAudio(0, pGame->pCtx, pAssets->sfxRightStep, 0.3);
+        rv = mixer_play(pGame->pMixer, pAssets->sfxRightStep, 0.3);
         ASSERT(rv == GFMRV_OK, rv);
     }
-    else {
-        pPlayer->right_elapsedSinceStep += elapsed;
-    }
 
-    if (pPlayer->left_elapsedSinceStep <= PL_JUMP_T &&
-            pPlayer->right_elapsedSinceStep <= PL_JUMP_T && !pPlayer->didJump) {
+    /* Jump if both legs landed within PL_JUMP_T of each other, regardless of
+     * how long a tick is */
+    if (didStep && !pPlayer->didJump && pPlayer->left_stepTime >= 0.0 &&
+            pPlayer->right_stepTime >= 0.0 && fabs(pPlayer->left_stepTime -
+            pPlayer->right_stepTime) <= PL_JUMP_T) {
         /* Jump */
         rv = gfmObject_setVelocity(pPlayer->left_pLeg, PL_JUMP_VX, PL_JUMP_VY);
         ASSERT(rv == GFMRV_OK, rv);
@@ -365,8 +509,8 @@ gfmRV player_postUpdate(player *pPlayer) {
     }
     else if ((l_cur & gfmCollision_down) && (r_cur & gfmCollision_down)) {
         pPlayer->didJump = 0;
-        pPlayer->left_elapsedSinceStep = PL_JUMP_T;
-        pPlayer->right_elapsedSinceStep = PL_JUMP_T;
+        pPlayer->left_stepTime = -1.0;
+        pPlayer->right_stepTime = -1.0;
     }
 
     /* Position the torso */
@@ -434,31 +578,14 @@ __ret:
     return rv;
 }
 
-static inline gfmRV player_draw_module(gfmSprite *pSpr, gfmSpriteset *pSset,
-        int x, int y, int ox, int oy, int w, int h, int tile) {
-    gfmRV rv;
-
-    rv = gfmSprite_setDimensions(pSpr, w, h);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmSprite_setPosition(pSpr, x, y);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmSprite_setOffset(pSpr, ox, oy);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmSprite_setSpriteset(pSpr, pSset);
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmSprite_setFrame(pSpr, tile);
-    ASSERT(rv == GFMRV_OK, rv);
-
-    rv = gfmSprite_draw(pSpr, pGame->pCtx);
-    ASSERT(rv == GFMRV_OK, rv);
-
-    rv = GFMRV_OK;
-__ret:
-    return rv;
+static inline gfmRV player_draw_module(player *pPlayer, int part,
+        gfmSpriteset *pSset, int x, int y, int ox, int oy, int tile) {
+    return snapshot_pushTile(pGame->pSnapshot, pSset, x + ox, y + oy, tile,
+            0/*isFlipped*/, pPlayer, part);
 }
 
 /**
- * Render the player
+ * Push every one of the player's parts into the snapshot being recorded
  *
  * @param  [ in]pPlayer The player
  */
@@ -477,42 +604,42 @@ gfmRV player_draw(player *pPlayer) {
 
 
     /* Left leg */
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset16x16, ll_x,
-            ll_y, -2, -2, 10, 14, 33);
+    rv = player_draw_module(pPlayer, 0/*part*/, pAssets->pSset16x16,
+            ll_x, ll_y, -2, -2, 33);
     ASSERT(rv == GFMRV_OK, rv);
     /* Left knee */
     lk_x = (lt_x + 2) * 0.75 + (ll_x + 1) * 0.25;
     lk_y = (lt_y + 13) * 0.75+ (ll_y - 4) * 0.25;
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset8x8, lk_x, lk_y,
-            0, 0, 8, 8, 66);
+    rv = player_draw_module(pPlayer, 1/*part*/, pAssets->pSset8x8,
+            lk_x, lk_y, 0, 0, 66);
     ASSERT(rv == GFMRV_OK, rv);
     /* Left hip */
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset8x8, lt_x+4,
-            lt_y+10, 0, 0, 8, 8, 67);
+    rv = player_draw_module(pPlayer, 2/*part*/, pAssets->pSset8x8,
+            lt_x+4, lt_y+10, 0, 0, 67);
     ASSERT(rv == GFMRV_OK, rv);
 
     /* Lower torso */
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset32x16, lt_x,
-            lt_y, -12, -2, 10, 14, 18);
+    rv = player_draw_module(pPlayer, 3/*part*/, pAssets->pSset32x16,
+            lt_x, lt_y, -12, -2, 18);
     ASSERT(rv == GFMRV_OK, rv);
     /* Upper torso */
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset32x16, ut_x,
-            ut_y, -12, -2, 10, 14, 17);
+    rv = player_draw_module(pPlayer, 4/*part*/, pAssets->pSset32x16,
+            ut_x, ut_y, -12, -2, 17);
     ASSERT(rv == GFMRV_OK, rv);
 
     /* Right hip */
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset8x8, lt_x,
-            lt_y+10, 0, 0, 8, 8, 65);
+    rv = player_draw_module(pPlayer, 5/*part*/, pAssets->pSset8x8,
+            lt_x, lt_y+10, 0, 0, 65);
     ASSERT(rv == GFMRV_OK, rv);
     /* Right knee */
     rk_x = (lt_x + 2) * 0.75 + (rl_x + 1) * 0.25;
     rk_y = (lt_y + 13) * 0.75 + (rl_y - 4) * 0.25;
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset8x8, rk_x, rk_y,
-            0, 0, 8, 8, 64);
+    rv = player_draw_module(pPlayer, 6/*part*/, pAssets->pSset8x8,
+            rk_x, rk_y, 0, 0, 64);
     ASSERT(rv == GFMRV_OK, rv);
     /* Right leg */
-    rv = player_draw_module(pPlayer->pRenderSpr, pAssets->pSset16x16, rl_x,
-            rl_y, -2, -2, 10, 14, 32);
+    rv = player_draw_module(pPlayer, 7/*part*/, pAssets->pSset16x16,
+            rl_x, rl_y, -2, -2, 32);
     ASSERT(rv == GFMRV_OK, rv);
 
     rv = GFMRV_OK;
@@ -561,3 +688,72 @@ __ret:
     return rv;
 }
 
+/**
+ * Retrieve where a leg was before it was last updated
+ *
+ * @param  [out]pX      Horizontal position
+ * @param  [out]pY      Vertical position
+ * @param  [ in]pPlayer The player
+ * @param  [ in]type    Which leg
+ */
+gfmRV player_getLastPosition(int *pX, int *pY, player *pPlayer, int type) {
+    switch (type) {
+        case PL_LEFT_LEG: {
+            *pX = pPlayer->left_lastX;
+            *pY = pPlayer->left_lastY;
+        } break;
+        case PL_RIGHT_LEG: {
+            *pX = pPlayer->right_lastX;
+            *pY = pPlayer->right_lastY;
+        } break;
+        default: { return GFMRV_ARGUMENTS_BAD; }
+    }
+
+    return GFMRV_OK;
+}
+
+/**
+ * Retrieve the limbs that may touch an object overlapping the player's body
+ * (the legs are tested over the whole path they moved on this tick)
+ *
+ * @param  [out]ppLimbs The limbs (at least PL_NUM_LIMBS of those)
+ * @param  [out]pNum    How many limbs were retrieved
+ * @param  [ in]pPlayer The player
+ * @param  [ in]x       Left of the overlapping object (over its movement)
+ * @param  [ in]y       Top of the overlapping object (over its movement)
+ * @param  [ in]width   Width of the overlapping object (over its movement)
+ * @param  [ in]height  Height of the overlapping object (over its movement)
+ */
+gfmRV player_getLimbs(gfmObject **ppLimbs, int *pNum, player *pPlayer, int x,
+        int y, int width, int height) {
+    gfmObject *ppAll[PL_NUM_LIMBS];
+    gfmRV rv;
+    int i;
+
+    /* Same order they used to be collided in */
+    ppAll[0] = pPlayer->left_pLeg;
+    ppAll[1] = pPlayer->right_pLeg;
+    ppAll[2] = pPlayer->upper_pTorso;
+    ppAll[3] = pPlayer->lower_pTorso;
+
+    *pNum = 0;
+    i = 0;
+    while (i < PL_NUM_LIMBS) {
+        int x0, y0, x1, y1;
+
+        rv = player_getLimbBounds(&x0, &y0, &x1, &y1, pPlayer, ppAll[i]);
+        ASSERT(rv == GFMRV_OK, rv);
+        /* Touching counts, as it does on the broadphase */
+        if (x0 <= x + width && x <= x1 && y0 <= y + height && y <= y1) {
+            ppLimbs[*pNum] = ppAll[i];
+            (*pNum)++;
+        }
+
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
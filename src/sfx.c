@@ -0,0 +1,478 @@
+/**
+ * Pre-rendered sound effects
+ *
+ * @file src/sfx.c
+ */
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmError.h>
+
+#include <ld34/bfxr.h>
+#include <ld34/sfx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !(defined(__WIN32) || defined(__WIN32__))
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+/** Version of the cache; Must be increased whenever the synthesizer changes */
+#define SFX_VERSION 1
+/** Length of the cache's header */
+#define SFX_HEADER_LEN 12
+/** Length of each entry on the cache's index */
+#define SFX_ENTRY_LEN 12
+/** Longest accepted definition */
+#define SFX_MAX_DEF_LEN 4096
+/** Longest path to any file */
+#define SFX_PATH_LEN 1100
+
+struct stSfx {
+    /** The cache, either mapped or read into memory */
+    unsigned char *pData;
+    /** Length of the cache */
+    int dataLen;
+    /** Whether pData is mapped (instead of allocated) */
+    int isMapped;
+    /** Every sound's samples, pointing into pData */
+    short **ppSamples;
+    /** Number of samples on every sound */
+    int *pNumSamples;
+    /** Hash of every sound's definition */
+    unsigned int *pHashes;
+    /** Number of sounds */
+    int num;
+};
+
+/** Hash a definition (FNV-1a, seeded with the cache's version) */
+static unsigned int sfx_hash(char *pData, int len) {
+    unsigned int hash;
+    int i;
+
+    hash = 2166136261u ^ SFX_VERSION;
+    i = 0;
+    while (i < len) {
+        hash ^= (unsigned char)pData[i];
+        hash *= 16777619u;
+        i++;
+    }
+    return hash;
+}
+
+/**
+ * Map (or read) the cache into memory
+ *
+ * @param  [ in]pCtx  The sound effects
+ * @param  [ in]pPath The cache's path
+ */
+static gfmRV sfx_mapCache(sfx *pCtx, char *pPath) {
+    gfmRV rv;
+#if defined(__WIN32) || defined(__WIN32__)
+    FILE *pFp;
+    long len;
+
+    pFp = fopen(pPath, "rb");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+    fseek(pFp, 0, SEEK_END);
+    len = ftell(pFp);
+    fseek(pFp, 0, SEEK_SET);
+    if (len <= 0) {
+        fclose(pFp);
+        ASSERT(0, GFMRV_READ_ERROR);
+    }
+    pCtx->pData = (unsigned char*)malloc(len);
+    if (!pCtx->pData || fread(pCtx->pData, 1, len, pFp) != (size_t)len) {
+        fclose(pFp);
+        free(pCtx->pData);
+        pCtx->pData = 0;
+        ASSERT(0, GFMRV_READ_ERROR);
+    }
+    fclose(pFp);
+    pCtx->dataLen = (int)len;
+    pCtx->isMapped = 0;
+#else
+    struct stat st;
+    void *pMap;
+    int fd;
+
+    fd = open(pPath, O_RDONLY);
+    ASSERT(fd >= 0, GFMRV_FUNCTION_FAILED);
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        ASSERT(0, GFMRV_READ_ERROR);
+    }
+    pMap = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* The mapping stays valid after the descriptor is closed */
+    close(fd);
+    ASSERT(pMap != MAP_FAILED, GFMRV_READ_ERROR);
+    pCtx->pData = (unsigned char*)pMap;
+    pCtx->dataLen = (int)st.st_size;
+    pCtx->isMapped = 1;
+#endif
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/** Release the cache, if mapped or read */
+static void sfx_unmapCache(sfx *pCtx) {
+    if (!pCtx->pData) {
+        return;
+    }
+#if !(defined(__WIN32) || defined(__WIN32__))
+    if (pCtx->isMapped) {
+        munmap(pCtx->pData, pCtx->dataLen);
+    }
+    else
+#endif
+    {
+        free(pCtx->pData);
+    }
+    pCtx->pData = 0;
+    pCtx->dataLen = 0;
+    pCtx->isMapped = 0;
+}
+
+/**
+ * Point every sound whose hash is on the cache to its samples
+ *
+ * @param  [ in]pCtx The sound effects
+ * @return           GFMRV_TRUE if every sound was found, GFMRV_FALSE otherwise
+ */
+static gfmRV sfx_lookup(sfx *pCtx) {
+    unsigned char *pData;
+    unsigned int pHeader[3];
+    int i, numEntries, numFound;
+
+    i = 0;
+    while (i < pCtx->num) {
+        pCtx->ppSamples[i] = 0;
+        pCtx->pNumSamples[i] = 0;
+        i++;
+    }
+
+    pData = pCtx->pData;
+    if (!pData || pCtx->dataLen < SFX_HEADER_LEN ||
+            memcmp(pData, "LDSF", 4) != 0) {
+        return GFMRV_FALSE;
+    }
+    memcpy(pHeader, pData, SFX_HEADER_LEN);
+    numEntries = (int)pHeader[2];
+    if (pHeader[1] != SFX_VERSION || numEntries < 0 ||
+            SFX_HEADER_LEN + numEntries * SFX_ENTRY_LEN > pCtx->dataLen) {
+        return GFMRV_FALSE;
+    }
+
+    numFound = 0;
+    i = 0;
+    while (i < numEntries) {
+        unsigned int pEntry[3];
+        int j;
+
+        memcpy(pEntry, pData + SFX_HEADER_LEN + i * SFX_ENTRY_LEN,
+                SFX_ENTRY_LEN);
+        /* Ignore (and later overwrite) any corrupted entry */
+        if ((pEntry[1] & 1) || pEntry[2] == 0 ||
+                (long)pEntry[1] + (long)pEntry[2] * sizeof(short) >
+                (long)pCtx->dataLen) {
+            i++;
+            continue;
+        }
+
+        j = 0;
+        while (j < pCtx->num) {
+            if (!pCtx->ppSamples[j] && pCtx->pHashes[j] == pEntry[0]) {
+                pCtx->ppSamples[j] = (short*)(pData + pEntry[1]);
+                pCtx->pNumSamples[j] = (int)pEntry[2];
+                numFound++;
+            }
+            j++;
+        }
+        i++;
+    }
+
+    if (numFound == pCtx->num) {
+        return GFMRV_TRUE;
+    }
+    return GFMRV_FALSE;
+}
+
+/**
+ * Build a new cache, reusing every sound that was already rendered, and try
+ * to save it; On success, the saved cache is mapped, otherwise the built one
+ * is kept in memory
+ *
+ * @param  [ in]pCtx    The sound effects
+ * @param  [ in]ppDefs  Every sound's definition
+ * @param  [ in]pLens   Length of every definition
+ * @param  [ in]pPath   The cache's path
+ */
+static gfmRV sfx_rebuild(sfx *pCtx, char **ppDefs, int *pLens, char *pPath) {
+    char pTmpPath[SFX_PATH_LEN + 4];
+    unsigned char *pData;
+    unsigned int pHeader[3];
+    short **ppRendered;
+    FILE *pFp;
+    gfmRV rv;
+    int i, len, offset;
+
+    pData = 0;
+    ppRendered = 0;
+
+    ppRendered = (short**)malloc(sizeof(short*) * pCtx->num);
+    ASSERT(ppRendered, GFMRV_ALLOC_FAILED);
+    memset(ppRendered, 0x0, sizeof(short*) * pCtx->num);
+
+    /* Render only the sounds that weren't found */
+    len = SFX_HEADER_LEN + pCtx->num * SFX_ENTRY_LEN;
+    i = 0;
+    while (i < pCtx->num) {
+        if (!pCtx->ppSamples[i]) {
+            bfxrParams params;
+
+            rv = bfxr_parse(&params, ppDefs[i], pLens[i]);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = bfxr_render(ppRendered + i, pCtx->pNumSamples + i, &params);
+            ASSERT(rv == GFMRV_OK, rv);
+            pCtx->ppSamples[i] = ppRendered[i];
+        }
+        len += pCtx->pNumSamples[i] * sizeof(short);
+        i++;
+    }
+
+    pData = (unsigned char*)malloc(len);
+    ASSERT(pData, GFMRV_ALLOC_FAILED);
+    memcpy(pData, "LDSF", 4);
+    pHeader[1] = SFX_VERSION;
+    pHeader[2] = (unsigned int)pCtx->num;
+    memcpy(pData + 4, pHeader + 1, SFX_HEADER_LEN - 4);
+
+    offset = SFX_HEADER_LEN + pCtx->num * SFX_ENTRY_LEN;
+    i = 0;
+    while (i < pCtx->num) {
+        unsigned int pEntry[3];
+        int size;
+
+        size = pCtx->pNumSamples[i] * sizeof(short);
+        pEntry[0] = pCtx->pHashes[i];
+        pEntry[1] = (unsigned int)offset;
+        pEntry[2] = (unsigned int)pCtx->pNumSamples[i];
+        memcpy(pData + SFX_HEADER_LEN + i * SFX_ENTRY_LEN, pEntry,
+                SFX_ENTRY_LEN);
+        memcpy(pData + offset, pCtx->ppSamples[i], size);
+        offset += size;
+        i++;
+    }
+
+    /* Every sample was copied, so the previous cache may be released */
+    sfx_unmapCache(pCtx);
+
+    /* Write to a temporary file, so a failure never corrupts the cache */
+    snprintf(pTmpPath, sizeof(pTmpPath), "%s.tmp", pPath);
+    pFp = fopen(pTmpPath, "wb");
+    if (pFp) {
+        int didWrite;
+
+        didWrite = (fwrite(pData, 1, len, pFp) == (size_t)len);
+        didWrite = (fclose(pFp) == 0) && didWrite;
+#if defined(__WIN32) || defined(__WIN32__)
+        remove(pPath);
+#endif
+        if (didWrite && rename(pTmpPath, pPath) == 0 &&
+                sfx_mapCache(pCtx, pPath) == GFMRV_OK &&
+                sfx_lookup(pCtx) == GFMRV_TRUE) {
+            free(pData);
+            pData = 0;
+        }
+        else {
+            sfx_unmapCache(pCtx);
+            remove(pTmpPath);
+        }
+    }
+
+    if (pData) {
+        /* Couldn't be saved; Keep it in memory, rendering it again later */
+        pCtx->pData = pData;
+        pCtx->dataLen = len;
+        pCtx->isMapped = 0;
+        pData = 0;
+        sfx_lookup(pCtx);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    if (ppRendered) {
+        i = 0;
+        while (i < pCtx->num) {
+            free(ppRendered[i]);
+            i++;
+        }
+        free(ppRendered);
+    }
+    free(pData);
+
+    return rv;
+}
+
+/**
+ * Read a sound's definition
+ *
+ * @param  [out]ppDef  The definition (must be freed by the caller)
+ * @param  [out]pLen   Length of the definition
+ * @param  [ in]pPath  The definition's path
+ */
+static gfmRV sfx_readDefinition(char **ppDef, int *pLen, char *pPath) {
+    FILE *pFp;
+    gfmRV rv;
+    int len;
+
+    *ppDef = 0;
+    pFp = fopen(pPath, "rb");
+    ASSERT(pFp, GFMRV_FUNCTION_FAILED);
+
+    *ppDef = (char*)malloc(SFX_MAX_DEF_LEN);
+    ASSERT(*ppDef, GFMRV_ALLOC_FAILED);
+    len = (int)fread(*ppDef, 1, SFX_MAX_DEF_LEN, pFp);
+    ASSERT(len > 0 && len < SFX_MAX_DEF_LEN, GFMRV_READ_ERROR);
+    *pLen = len;
+
+    rv = GFMRV_OK;
+__ret:
+    if (pFp) {
+        fclose(pFp);
+    }
+    if (rv != GFMRV_OK) {
+        free(*ppDef);
+        *ppDef = 0;
+    }
+
+    return rv;
+}
+
+/**
+ * Load every sound effect, rendering (and caching) any that changed
+ *
+ * @param  [out]ppCtx       The sound effects
+ * @param  [ in]pAssetsPath Path to the assets directory (with a trailing '/')
+ * @param  [ in]ppNames     Name of each sound's definition (without the
+ *                          '.bfxrsound' extension); Its index is the sound's
+ *                          id
+ * @param  [ in]numNames    Number of sounds
+ */
+gfmRV sfx_init(sfx **ppCtx, char *pAssetsPath, char **ppNames, int numNames) {
+    char pPath[SFX_PATH_LEN];
+    char **ppDefs;
+    gfmRV rv;
+    sfx *pCtx;
+    int *pLens;
+    int i;
+
+    *ppCtx = 0;
+    ppDefs = 0;
+    pLens = 0;
+    ASSERT(numNames > 0, GFMRV_ARGUMENTS_BAD);
+    ASSERT(strlen(pAssetsPath) + 64 < SFX_PATH_LEN, GFMRV_ARGUMENTS_BAD);
+
+    pCtx = (sfx*)malloc(sizeof(sfx));
+    ASSERT(pCtx, GFMRV_ALLOC_FAILED);
+    memset(pCtx, 0x0, sizeof(sfx));
+    *ppCtx = pCtx;
+
+    pCtx->num = numNames;
+    pCtx->ppSamples = (short**)malloc(sizeof(short*) * numNames);
+    ASSERT(pCtx->ppSamples, GFMRV_ALLOC_FAILED);
+    pCtx->pNumSamples = (int*)malloc(sizeof(int) * numNames);
+    ASSERT(pCtx->pNumSamples, GFMRV_ALLOC_FAILED);
+    pCtx->pHashes = (unsigned int*)malloc(sizeof(unsigned int) * numNames);
+    ASSERT(pCtx->pHashes, GFMRV_ALLOC_FAILED);
+    ppDefs = (char**)malloc(sizeof(char*) * numNames);
+    ASSERT(ppDefs, GFMRV_ALLOC_FAILED);
+    memset(ppDefs, 0x0, sizeof(char*) * numNames);
+    pLens = (int*)malloc(sizeof(int) * numNames);
+    ASSERT(pLens, GFMRV_ALLOC_FAILED);
+
+    /* Hash every definition, so outdated sounds may be detected */
+    i = 0;
+    while (i < numNames) {
+        snprintf(pPath, sizeof(pPath), "%s%s.bfxrsound", pAssetsPath,
+                ppNames[i]);
+        rv = sfx_readDefinition(ppDefs + i, pLens + i, pPath);
+        ASSERT(rv == GFMRV_OK, rv);
+        pCtx->pHashes[i] = sfx_hash(ppDefs[i], pLens[i]);
+        i++;
+    }
+
+    snprintf(pPath, sizeof(pPath), "%s%s", pAssetsPath, SFX_CACHE_FILE);
+    /* A missing cache simply gets rebuilt */
+    sfx_mapCache(pCtx, pPath);
+    if (sfx_lookup(pCtx) != GFMRV_TRUE) {
+        rv = sfx_rebuild(pCtx, ppDefs, pLens, pPath);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    if (ppDefs) {
+        i = 0;
+        while (i < numNames) {
+            free(ppDefs[i]);
+            i++;
+        }
+        free(ppDefs);
+    }
+    free(pLens);
+    if (rv != GFMRV_OK) {
+        sfx_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Release the sound effects
+ *
+ * @param  [ in]ppCtx The sound effects
+ */
+void sfx_clean(sfx **ppCtx) {
+    sfx *pCtx;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+    pCtx = *ppCtx;
+
+    sfx_unmapCache(pCtx);
+    free(pCtx->ppSamples);
+    free(pCtx->pNumSamples);
+    free(pCtx->pHashes);
+    free(pCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Retrieve a sound's samples
+ *
+ * @param  [out]ppSamples   The samples (owned by the context)
+ * @param  [out]pNumSamples Number of samples
+ * @param  [ in]pCtx        The sound effects
+ * @param  [ in]id          The sound
+ */
+gfmRV sfx_getSamples(short **ppSamples, int *pNumSamples, sfx *pCtx, int id) {
+    gfmRV rv;
+
+    ASSERT(pCtx, GFMRV_ARGUMENTS_BAD);
+    ASSERT(id >= 0 && id < pCtx->num, GFMRV_ARGUMENTS_BAD);
+
+    *ppSamples = pCtx->ppSamples[id];
+    *pNumSamples = pCtx->pNumSamples[id];
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
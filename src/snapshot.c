@@ -0,0 +1,597 @@
+/**
+ * Render snapshots, used to hand the simulation's state to the render thread
+ *
+ * The three buffers are rotated without locks: the writer and the reader each
+ * own one of them, and the third one (plus a flag marking whether it's newer
+ * than the reader's) is swapped atomically on publish/acquire. The reader
+ * keeps a private copy of the previous snapshot for interpolation
+ *
+ * @file src/snapshot.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmCamera.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmSprite.h>
+#include <GFraMe/gfmSpriteset.h>
+
+#include <ld34/clock.h>
+#include <ld34/game.h>
+#include <ld34/snapshot.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of tiles on each buffer */
+#define SNAPSHOT_INIT_TILES 256
+/** Tiles that moved further than this (e.g., respawned) aren't interpolated */
+#define SNAPSHOT_MAX_LERP 16
+/** Flag set on 'shared' when it's newer than the reader's buffer */
+#define SNAPSHOT_FRESH 0x4
+
+struct stSnapshotTile {
+    /** Spriteset where the tile is */
+    gfmSpriteset *pSset;
+    /** Entity that owns the tile */
+    void *pOwner;
+    /** Distinguishes tiles from the same owner */
+    int part;
+    /** The tile */
+    int tile;
+    /** Whether the tile is horizontally flipped */
+    int isFlipped;
+    /** Whether the tile is fixed on the screen (instead of on the world) */
+    int isHud;
+    /** Position on the world (or on the screen) */
+    int x;
+    /** Position on the world (or on the screen) */
+    int y;
+};
+typedef struct stSnapshotTile snapshotTile;
+
+struct stSnapshotBuffer {
+    /** Every recorded tile, in drawing order */
+    snapshotTile *pTiles;
+    /** Number of tiles that fit on the buffer */
+    int len;
+    /** Number of recorded tiles */
+    int used;
+    /** Camera's position */
+    int camX;
+    /** Camera's position */
+    int camY;
+    /** When the snapshot was published */
+    double time;
+    /** Sequence number, incremented on every publish */
+    int seq;
+};
+typedef struct stSnapshotBuffer snapshotBuffer;
+
+struct stSnapshot {
+    /** The triple buffer */
+    snapshotBuffer pBufs[3];
+    /** Copy of the reader's previous snapshot */
+    snapshotBuffer prev;
+    /** Index (+ 1) of each of prev's tiles, hashed by owner/part */
+    int *pPrevHash;
+    /** Number of entries on pPrevHash (always a power of 2) */
+    int hashLen;
+    /** Protects the world from being updated while it's rendered */
+    pthread_mutex_t worldLock;
+    /** Buffer shared between both threads (| SNAPSHOT_FRESH) */
+    volatile int shared;
+    /** Number of published snapshots */
+    int numPublished;
+    /** Buffer being recorded by the update thread */
+    int writeIdx;
+    /** Buffer being drawn by the render thread */
+    int readIdx;
+    /** Whether anything was already acquired */
+    int hasSnapshot;
+    /** Whether prev may be used */
+    int hasPrev;
+    /** Whether tiles should be interpolated */
+    int doLerp;
+    /** How far between prev and the current snapshot, in [0, 1] */
+    double alpha;
+    /** Interpolated camera position */
+    int camX;
+    /** Interpolated camera position */
+    int camY;
+    /** Duration of a single tick, in milliseconds */
+    double tickTime;
+};
+
+/**
+ * Make sure a buffer fits the requested number of tiles
+ *
+ * @param  [ in]pBuf The buffer
+ * @param  [ in]len  Number of tiles
+ */
+static gfmRV snapshot_reserve(snapshotBuffer *pBuf, int len) {
+    gfmRV rv;
+    snapshotTile *pTmp;
+
+    if (len <= pBuf->len) {
+        return GFMRV_OK;
+    }
+    if (len < pBuf->len * 2) {
+        len = pBuf->len * 2;
+    }
+    if (len < SNAPSHOT_INIT_TILES) {
+        len = SNAPSHOT_INIT_TILES;
+    }
+
+    pTmp = (snapshotTile*)realloc(pBuf->pTiles, sizeof(snapshotTile) * len);
+    ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+    pBuf->pTiles = pTmp;
+    pBuf->len = len;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Hash a tile's owner/part
+ *
+ * @param  [ in]pTile The tile
+ */
+static inline unsigned int snapshot_hash(snapshotTile *pTile) {
+    return (unsigned int)(((uintptr_t)pTile->pOwner >> 3) * 2654435761u) ^
+            ((unsigned int)pTile->part * 40503u);
+}
+
+/**
+ * Alloc the snapshots
+ *
+ * @param  [out]ppCtx The snapshots
+ * @param  [ in]ups   Updates per second
+ * @param  [ in]dps   Draws per second (interpolation is only done if greater
+ *                    than ups)
+ */
+gfmRV snapshot_init(snapshot **ppCtx, int ups, int dps) {
+    gfmRV rv;
+    int i;
+
+    *ppCtx = 0;
+    ASSERT(ups > 0, GFMRV_ARGUMENTS_BAD);
+
+    *ppCtx = (snapshot*)malloc(sizeof(snapshot));
+    ASSERT(*ppCtx, GFMRV_ALLOC_FAILED);
+    memset(*ppCtx, 0x0, sizeof(snapshot));
+
+    pthread_mutex_init(&((*ppCtx)->worldLock), 0);
+
+    i = 0;
+    while (i < 3) {
+        rv = snapshot_reserve((*ppCtx)->pBufs + i, SNAPSHOT_INIT_TILES);
+        ASSERT(rv == GFMRV_OK, rv);
+        i++;
+    }
+    rv = snapshot_reserve(&((*ppCtx)->prev), SNAPSHOT_INIT_TILES);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    (*ppCtx)->writeIdx = 0;
+    (*ppCtx)->shared = 1;
+    (*ppCtx)->readIdx = 2;
+    (*ppCtx)->doLerp = (dps > ups);
+    (*ppCtx)->tickTime = 1000.0 / ups;
+    (*ppCtx)->alpha = 1.0;
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK) {
+        snapshot_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Release the snapshots
+ *
+ * @param  [ in]ppCtx The snapshots
+ */
+void snapshot_clean(snapshot **ppCtx) {
+    int i;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+
+    i = 0;
+    while (i < 3) {
+        free((*ppCtx)->pBufs[i].pTiles);
+        i++;
+    }
+    free((*ppCtx)->prev.pTiles);
+    free((*ppCtx)->pPrevHash);
+    pthread_mutex_destroy(&((*ppCtx)->worldLock));
+
+    free(*ppCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Block the update thread from modifying the world (and vice-versa); Every
+ * call into GFraMe's context is made with this held (as it isn't
+ * thread-safe), so the render thread takes it around events and drawing,
+ * which also lets it read things that aren't on the snapshot (e.g., the
+ * broadphase's bounds, on debug builds)
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+void snapshot_lockWorld(snapshot *pCtx) {
+    pthread_mutex_lock(&(pCtx->worldLock));
+}
+
+/**
+ * Release the world
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+void snapshot_unlockWorld(snapshot *pCtx) {
+    pthread_mutex_unlock(&(pCtx->worldLock));
+}
+
+/**
+ * Start recording a new snapshot (on the update thread)
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+gfmRV snapshot_begin(snapshot *pCtx) {
+    pCtx->pBufs[pCtx->writeIdx].used = 0;
+
+    return GFMRV_OK;
+}
+
+/**
+ * Push a tile into the snapshot being recorded
+ *
+ * @param  [ in]pCtx      The snapshots
+ * @param  [ in]pSset     Spriteset where the tile is
+ * @param  [ in]x         Position on the world (already offset)
+ * @param  [ in]y         Position on the world (already offset)
+ * @param  [ in]tile      The tile
+ * @param  [ in]isFlipped Whether the tile is horizontally flipped
+ * @param  [ in]pOwner    Entity that owns the tile (0 disables interpolation)
+ * @param  [ in]part      Distinguishes tiles from the same owner
+ */
+gfmRV snapshot_pushTile(snapshot *pCtx, gfmSpriteset *pSset, int x, int y,
+        int tile, int isFlipped, void *pOwner, int part) {
+    gfmRV rv;
+    snapshotBuffer *pBuf;
+    snapshotTile *pTile;
+
+    pBuf = pCtx->pBufs + pCtx->writeIdx;
+    rv = snapshot_reserve(pBuf, pBuf->used + 1);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    pTile = pBuf->pTiles + pBuf->used;
+    pTile->pSset = pSset;
+    pTile->pOwner = pOwner;
+    pTile->part = part;
+    pTile->tile = tile;
+    pTile->isFlipped = isFlipped;
+    pTile->isHud = 0;
+    pTile->x = x;
+    pTile->y = y;
+    pBuf->used++;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Push a tile fixed on the screen (e.g., a HUD's) into the snapshot being
+ * recorded; It's never interpolated
+ *
+ * @param  [ in]pCtx  The snapshots
+ * @param  [ in]pSset Spriteset where the tile is
+ * @param  [ in]x     Position on the screen
+ * @param  [ in]y     Position on the screen
+ * @param  [ in]tile  The tile
+ */
+gfmRV snapshot_pushHudTile(snapshot *pCtx, gfmSpriteset *pSset, int x, int y,
+        int tile) {
+    gfmRV rv;
+    snapshotBuffer *pBuf;
+
+    rv = snapshot_pushTile(pCtx, pSset, x, y, tile, 0/*isFlipped*/,
+            0/*pOwner*/, 0/*part*/);
+    ASSERT(rv == GFMRV_OK, rv);
+    pBuf = pCtx->pBufs + pCtx->writeIdx;
+    pBuf->pTiles[pBuf->used - 1].isHud = 1;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Push a sprite's current frame into the snapshot being recorded; The sprite
+ * is used as its owner
+ *
+ * @param  [ in]pCtx The snapshots
+ * @param  [ in]pSpr The sprite
+ * @param  [ in]pSset Sprite's spriteset
+ * @param  [ in]ox    Sprite's offset
+ * @param  [ in]oy    Sprite's offset
+ */
+gfmRV snapshot_pushSprite(snapshot *pCtx, gfmSprite *pSpr, gfmSpriteset *pSset,
+        int ox, int oy) {
+    gfmRV rv;
+    int flipped, frame, x, y;
+
+    rv = gfmSprite_getPosition(&x, &y, pSpr);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmSprite_getFrame(&frame, pSpr);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmSprite_getDirection(&flipped, pSpr);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = snapshot_pushTile(pCtx, pSset, x + ox, y + oy, frame, flipped, pSpr,
+            0/*part*/);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Publish the recorded snapshot (with the current camera), replacing any
+ * other that wasn't yet consumed
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+gfmRV snapshot_publish(snapshot *pCtx) {
+    gfmCamera *pCam;
+    gfmRV rv;
+    snapshotBuffer *pBuf;
+    int old;
+
+    pBuf = pCtx->pBufs + pCtx->writeIdx;
+
+    pCam = 0;
+    rv = gfm_getCamera(&pCam, pGame->pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmCamera_getPosition(&(pBuf->camX), &(pBuf->camY), pCam);
+    ASSERT(rv == GFMRV_OK, rv);
+    pBuf->time = clock_getTime();
+    pBuf->seq = pCtx->numPublished;
+    pCtx->numPublished++;
+
+    old = __atomic_exchange_n(&(pCtx->shared), pCtx->writeIdx | SNAPSHOT_FRESH,
+            __ATOMIC_ACQ_REL);
+    pCtx->writeIdx = old & ~SNAPSHOT_FRESH;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Copy the reader's current snapshot into prev and index its tiles
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+static gfmRV snapshot_keepPrev(snapshot *pCtx) {
+    gfmRV rv;
+    snapshotBuffer *pCur;
+    int i, len;
+
+    pCur = pCtx->pBufs + pCtx->readIdx;
+
+    rv = snapshot_reserve(&(pCtx->prev), pCur->used);
+    ASSERT(rv == GFMRV_OK, rv);
+    memcpy(pCtx->prev.pTiles, pCur->pTiles, sizeof(snapshotTile) * pCur->used);
+    pCtx->prev.used = pCur->used;
+    pCtx->prev.camX = pCur->camX;
+    pCtx->prev.camY = pCur->camY;
+    pCtx->prev.time = pCur->time;
+
+    len = pCtx->hashLen;
+    if (len == 0) {
+        len = SNAPSHOT_INIT_TILES * 2;
+    }
+    while (len < pCur->used * 2) {
+        len *= 2;
+    }
+    if (len != pCtx->hashLen) {
+        int *pTmp;
+
+        pTmp = (int*)realloc(pCtx->pPrevHash, sizeof(int) * len);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pCtx->pPrevHash = pTmp;
+        pCtx->hashLen = len;
+    }
+    memset(pCtx->pPrevHash, 0x0, sizeof(int) * pCtx->hashLen);
+
+    i = 0;
+    while (i < pCtx->prev.used) {
+        snapshotTile *pTile;
+        unsigned int pos;
+
+        pTile = pCtx->prev.pTiles + i;
+        i++;
+        if (!pTile->pOwner) {
+            continue;
+        }
+
+        pos = snapshot_hash(pTile) & (pCtx->hashLen - 1);
+        while (pCtx->pPrevHash[pos] != 0) {
+            pos = (pos + 1) & (pCtx->hashLen - 1);
+        }
+        pCtx->pPrevHash[pos] = i;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Take the latest published snapshot (on the render thread) and calculate
+ * how far between the last two snapshots the current frame is
+ *
+ * @param  [out]pCamX Interpolated camera position
+ * @param  [out]pCamY Interpolated camera position
+ * @param  [ in]pCtx  The snapshots
+ * @return            GFMRV_OK, GFMRV_FALSE (nothing was published yet)
+ */
+gfmRV snapshot_acquire(int *pCamX, int *pCamY, snapshot *pCtx) {
+    gfmRV rv;
+    snapshotBuffer *pCur;
+
+    if (__atomic_load_n(&(pCtx->shared), __ATOMIC_ACQUIRE) & SNAPSHOT_FRESH) {
+        int old;
+
+        if (pCtx->hasSnapshot && pCtx->doLerp) {
+            rv = snapshot_keepPrev(pCtx);
+            ASSERT(rv == GFMRV_OK, rv);
+            pCtx->hasPrev = 1;
+        }
+
+        old = __atomic_exchange_n(&(pCtx->shared), pCtx->readIdx,
+                __ATOMIC_ACQ_REL);
+        pCtx->readIdx = old & ~SNAPSHOT_FRESH;
+        pCtx->hasSnapshot = 1;
+    }
+
+    if (!pCtx->hasSnapshot) {
+        return GFMRV_FALSE;
+    }
+
+    pCur = pCtx->pBufs + pCtx->readIdx;
+    pCtx->alpha = 1.0;
+    if (pCtx->hasPrev) {
+        pCtx->alpha = (clock_getTime() - pCur->time) / pCtx->tickTime;
+        if (pCtx->alpha < 0.0) {
+            pCtx->alpha = 0.0;
+        }
+        else if (pCtx->alpha > 1.0) {
+            pCtx->alpha = 1.0;
+        }
+    }
+
+    pCtx->camX = pCur->camX;
+    pCtx->camY = pCur->camY;
+    if (pCtx->hasPrev) {
+        pCtx->camX = (int)(pCtx->prev.camX + (pCur->camX - pCtx->prev.camX) *
+                pCtx->alpha + 0.5);
+        pCtx->camY = (int)(pCtx->prev.camY + (pCur->camY - pCtx->prev.camY) *
+                pCtx->alpha + 0.5);
+    }
+    *pCamX = pCtx->camX;
+    *pCamY = pCtx->camY;
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve the sequence number of the last published snapshot (on the update
+ * thread)
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+int snapshot_getPublished(snapshot *pCtx) {
+    return pCtx->numPublished - 1;
+}
+
+/**
+ * Retrieve the sequence number of the acquired snapshot (on the render
+ * thread)
+ *
+ * @param  [ in]pCtx The snapshots
+ * @return           The sequence number, or -1 if nothing was acquired
+ */
+int snapshot_getAcquired(snapshot *pCtx) {
+    if (!pCtx->hasSnapshot) {
+        return -1;
+    }
+    return pCtx->pBufs[pCtx->readIdx].seq;
+}
+
+/**
+ * Find a tile's position on the previous snapshot
+ *
+ * @param  [ in]pCtx  The snapshots
+ * @param  [ in]pTile The tile (from the current snapshot)
+ * @return            The tile on prev, or 0 if it wasn't found
+ */
+static snapshotTile* snapshot_findPrev(snapshot *pCtx, snapshotTile *pTile) {
+    unsigned int pos;
+
+    pos = snapshot_hash(pTile) & (pCtx->hashLen - 1);
+    while (pCtx->pPrevHash[pos] != 0) {
+        snapshotTile *pPrev;
+
+        pPrev = pCtx->prev.pTiles + pCtx->pPrevHash[pos] - 1;
+        if (pPrev->pOwner == pTile->pOwner && pPrev->part == pTile->part) {
+            return pPrev;
+        }
+        pos = (pos + 1) & (pCtx->hashLen - 1);
+    }
+
+    return 0;
+}
+
+/**
+ * Draw every tile on the acquired snapshot
+ *
+ * @param  [ in]pCtx The snapshots
+ */
+gfmRV snapshot_draw(snapshot *pCtx) {
+    gfmRV rv;
+    snapshotBuffer *pCur;
+    int i;
+
+    if (!pCtx->hasSnapshot) {
+        return GFMRV_OK;
+    }
+
+    pCur = pCtx->pBufs + pCtx->readIdx;
+
+    i = 0;
+    while (i < pCur->used) {
+        snapshotTile *pTile;
+        int x, y;
+
+        pTile = pCur->pTiles + i;
+        x = pTile->x;
+        y = pTile->y;
+
+        if (pCtx->hasPrev && pTile->pOwner) {
+            snapshotTile *pPrev;
+
+            pPrev = snapshot_findPrev(pCtx, pTile);
+            if (pPrev && abs(x - pPrev->x) <= SNAPSHOT_MAX_LERP &&
+                    abs(y - pPrev->y) <= SNAPSHOT_MAX_LERP) {
+                x = (int)(pPrev->x + (x - pPrev->x) * pCtx->alpha + 0.5);
+                y = (int)(pPrev->y + (y - pPrev->y) * pCtx->alpha + 0.5);
+            }
+        }
+
+        if (!pTile->isHud) {
+            x -= pCtx->camX;
+            y -= pCtx->camY;
+        }
+        rv = gfm_drawTile(pGame->pCtx, pTile->pSset, x, y, pTile->tile,
+                pTile->isFlipped);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
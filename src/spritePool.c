@@ -0,0 +1,1083 @@
+/**
+ * Pool of collideable sprites (e.g., bullets and props)
+ *
+ * Dead sprites are always taken from the first slab with a free node, so live
+ * sprites gather on the first slabs and the last one eventually empties
+ *
+ * Every live sprite ages at the same rate, so they are also kept on a list in
+ * the order they were spawned: once the budget is exhausted, the oldest one
+ * is simply taken from its head
+ *
+ * Sprites that stay at rest for a while (e.g., props on the floor) fall
+ * asleep: they aren't integrated and are added to the broadphase without
+ * being tested (before anything that could push them), until something
+ * wakes them. Whenever a sleeping sprite wakes (or any sprite dies while
+ * something sleeps), the spot it left is listed and the sprites sleeping on
+ * top of it are woken on the next post update, so piles collapse layer by
+ * layer once their support is gone
+ *
+ * @file src/spritePool.c
+ */
+#include <GFraMe/gframe.h>
+#include <GFraMe/gfmAssert.h>
+#include <GFraMe/gfmCamera.h>
+#include <GFraMe/gfmError.h>
+#include <GFraMe/gfmObject.h>
+#include <GFraMe/gfmSprite.h>
+#include <GFraMe/gfmSpriteset.h>
+
+#include <ld34/broadphase.h>
+#include <ld34/collide.h>
+#include <ld34/game.h>
+#include <ld34/jobs.h>
+#include <ld34/snapshot.h>
+#include <ld34/spritePool.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Maximum number of slabs; Plenty, since each doubles the pool */
+#define SPRITEPOOL_MAX_SLABS 16
+/** For how long the pool must stay mostly empty before being trimmed */
+#define SPRITEPOOL_TRIM_DELAY 2000
+/** Number of sprites updated by each job */
+#define SPRITEPOOL_JOB_GRAIN 128
+/** Sprites slower than this (in pixels per second) and standing on something
+ * are at rest */
+#define SPRITEPOOL_SLEEP_SPEED 16.0
+/** For how long a sprite must be at rest before it falls asleep */
+#define SPRITEPOOL_SLEEP_DELAY 250
+
+struct stSpritePoolNode {
+    /** The actual sprite */
+    gfmSprite *pSelf;
+    /** Pool that owns this node */
+    spritePool *pPool;
+    /** Slab where this node was alloc'ed */
+    int slab;
+    /** Index of this node within its slab */
+    int index;
+    /** For how long, in milliseconds, the sprite has been alive */
+    int age;
+    /** Whether the sprite is alive */
+    int isAlive;
+    /** For how long, in milliseconds, the sprite has been at rest */
+    int restTime;
+    /** Whether the sprite is asleep */
+    int isAsleep;
+    /** Whether the sprite was on top of another since its last update */
+    int isSupported;
+    /** Whether the sprite was added to the broadphase on this tick, before
+     * the pool was collided */
+    int isPopulated;
+    /** Whether the sprite was updated since it was spawned */
+    int didMove;
+    /** Position before the last update */
+    int lastX;
+    int lastY;
+    /** Live sprite spawned right before this one */
+    spritePoolNode *pOlder;
+    /** Live sprite spawned right after this one */
+    spritePoolNode *pNewer;
+};
+
+struct stSpritePoolSlab {
+    /** Every node on this slab */
+    spritePoolNode *pNodes;
+    /** Stack of dead nodes' indexes */
+    int *pFree;
+    /** Number of nodes */
+    int len;
+    /** Number of dead nodes (i.e., elements on pFree) */
+    int numFree;
+};
+typedef struct stSpritePoolSlab spritePoolSlab;
+
+/** Spot left (by a sprite that woke or died) where others may be sleeping on
+ * top of it */
+struct stSpritePoolSpot {
+    int x;
+    int y;
+};
+typedef struct stSpritePoolSpot spritePoolSpot;
+
+struct stSpritePool {
+    /** Every alloc'ed slab */
+    spritePoolSlab pSlabs[SPRITEPOOL_MAX_SLABS];
+    /** Animations, in the same format as a gfmGroup's */
+    int *pAnimData;
+    /** Spriteset used to render the sprites */
+    gfmSpriteset *pSset;
+    /** Number of alloc'ed slabs */
+    int numSlabs;
+    /** Number of elements in pAnimData */
+    int animDataLen;
+    /** Number of live sprites */
+    int used;
+    /** Number of alloc'ed sprites */
+    int len;
+    /** Maximum number of live sprites ever reached */
+    int highWater;
+    /** Number of sprites on the first slab */
+    int initLen;
+    /** Maximum number of sprites */
+    int maxLen;
+    /** Number of live sprites reused since the pool was full */
+    int numStolen;
+    /** Live sprite spawned the longest ago (the first to be reused) */
+    spritePoolNode *pOldest;
+    /** Live sprite spawned most recently */
+    spritePoolNode *pNewest;
+    /** Spots vacated since the last post update */
+    spritePoolSpot *pSpots;
+    /** Number of spots that fit on pSpots (twice the number of sprites, as
+     * each sprite may wake and then die) */
+    int spotsLen;
+    /** Number of vacated spots */
+    int spotsUsed;
+    /** Number of sleeping sprites; Also modified by the update jobs */
+    int numAsleep;
+    /** For how long the pool has been mostly empty */
+    int quietTime;
+    /** Elapsed time on the current frame (kept for the update jobs) */
+    int elapsed;
+    /** Type of every sprite */
+    int type;
+    /** For how long, in milliseconds, sprites live */
+    int ttl;
+    /** Sprites' hitbox */
+    int width;
+    /** Sprites' hitbox */
+    int height;
+    /** Rendering offset */
+    int offX;
+    /** Rendering offset */
+    int offY;
+};
+
+/**
+ * Release a slab and all of its sprites
+ *
+ * @param  [ in]pSlab The slab
+ */
+static void spritePool_freeSlab(spritePoolSlab *pSlab) {
+    if (pSlab->pNodes) {
+        int i;
+
+        i = 0;
+        while (i < pSlab->len) {
+            gfmSprite_free(&(pSlab->pNodes[i].pSelf));
+            i++;
+        }
+        free(pSlab->pNodes);
+    }
+    if (pSlab->pFree) {
+        free(pSlab->pFree);
+    }
+    memset(pSlab, 0x0, sizeof(spritePoolSlab));
+}
+
+/**
+ * Alloc a new slab, twice as big as the previous one (but never bigger than
+ * what's left of the budget)
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+static gfmRV spritePool_grow(spritePool *pCtx) {
+    gfmRV rv;
+    spritePoolSlab *pSlab;
+    int i, len;
+
+    ASSERT(pCtx->numSlabs < SPRITEPOOL_MAX_SLABS, GFMRV_ALLOC_FAILED);
+    ASSERT(pCtx->len < pCtx->maxLen, GFMRV_ALLOC_FAILED);
+
+    if (pCtx->numSlabs == 0) {
+        len = pCtx->initLen;
+    }
+    else {
+        len = pCtx->pSlabs[pCtx->numSlabs - 1].len * 2;
+    }
+    if (len > pCtx->maxLen - pCtx->len) {
+        len = pCtx->maxLen - pCtx->len;
+    }
+
+    pSlab = pCtx->pSlabs + pCtx->numSlabs;
+
+    pSlab->pNodes = (spritePoolNode*)malloc(sizeof(spritePoolNode) * len);
+    ASSERT(pSlab->pNodes, GFMRV_ALLOC_FAILED);
+    memset(pSlab->pNodes, 0x0, sizeof(spritePoolNode) * len);
+    pSlab->pFree = (int*)malloc(sizeof(int) * len);
+    ASSERT(pSlab->pFree, GFMRV_ALLOC_FAILED);
+    pSlab->len = len;
+
+    i = 0;
+    while (i < len) {
+        spritePoolNode *pNode;
+
+        pNode = pSlab->pNodes + i;
+
+        rv = gfmSprite_getNew(&(pNode->pSelf));
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmSprite_init(pNode->pSelf, 0/*x*/, 0/*y*/, pCtx->width,
+                pCtx->height, pCtx->pSset, pCtx->offX, pCtx->offY, pNode,
+                pCtx->type);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmSprite_addAnimations(pNode->pSelf, pCtx->pAnimData,
+                pCtx->animDataLen);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        pNode->pPool = pCtx;
+        pNode->slab = pCtx->numSlabs;
+        pNode->index = i;
+
+        /* Push in reverse, so the first node is the first to be used */
+        pSlab->pFree[len - i - 1] = i;
+
+        i++;
+    }
+    pSlab->numFree = len;
+
+    if (pCtx->spotsLen < (pCtx->len + len) * 2) {
+        spritePoolSpot *pTmp;
+
+        pTmp = (spritePoolSpot*)realloc(pCtx->pSpots,
+                sizeof(spritePoolSpot) * (pCtx->len + len) * 2);
+        ASSERT(pTmp, GFMRV_ALLOC_FAILED);
+        pCtx->pSpots = pTmp;
+        pCtx->spotsLen = (pCtx->len + len) * 2;
+    }
+
+    pCtx->numSlabs++;
+    pCtx->len += len;
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK && pCtx->numSlabs < SPRITEPOOL_MAX_SLABS) {
+        spritePool_freeSlab(pCtx->pSlabs + pCtx->numSlabs);
+    }
+
+    return rv;
+}
+
+/**
+ * Alloc and initialize a sprite pool
+ *
+ * Every sprite gets the node as its child, so it may be removed from within a
+ * collision
+ *
+ * @param  [out]ppCtx       The sprite pool
+ * @param  [ in]type        Type of every sprite
+ * @param  [ in]pSset       Spriteset used to render the sprites
+ * @param  [ in]pAnimData   Animations, in the same format as a gfmGroup's
+ * @param  [ in]animDataLen Number of elements in pAnimData
+ * @param  [ in]w           Sprites' hitbox
+ * @param  [ in]h           Sprites' hitbox
+ * @param  [ in]ox          Rendering offset
+ * @param  [ in]oy          Rendering offset
+ * @param  [ in]ttl         For how long, in milliseconds, sprites live
+ * @param  [ in]initLen     Number of sprites on the first slab
+ * @param  [ in]maxLen      Maximum number of sprites
+ */
+gfmRV spritePool_init(spritePool **ppCtx, int type, gfmSpriteset *pSset,
+        int *pAnimData, int animDataLen, int w, int h, int ox, int oy, int ttl,
+        int initLen, int maxLen) {
+    gfmRV rv;
+
+    *ppCtx = 0;
+    ASSERT(initLen > 0 && initLen <= maxLen, GFMRV_ARGUMENTS_BAD);
+
+    *ppCtx = (spritePool*)malloc(sizeof(spritePool));
+    ASSERT(*ppCtx, GFMRV_ALLOC_FAILED);
+    memset(*ppCtx, 0x0, sizeof(spritePool));
+
+    (*ppCtx)->type = type;
+    (*ppCtx)->pSset = pSset;
+    (*ppCtx)->pAnimData = pAnimData;
+    (*ppCtx)->animDataLen = animDataLen;
+    (*ppCtx)->width = w;
+    (*ppCtx)->height = h;
+    (*ppCtx)->offX = ox;
+    (*ppCtx)->offY = oy;
+    (*ppCtx)->ttl = ttl;
+    (*ppCtx)->initLen = initLen;
+    (*ppCtx)->maxLen = maxLen;
+
+    rv = spritePool_grow(*ppCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    if (rv != GFMRV_OK) {
+        spritePool_clean(ppCtx);
+    }
+
+    return rv;
+}
+
+/**
+ * Release the sprite pool and all of its sprites
+ *
+ * @param  [ in]ppCtx The sprite pool
+ */
+void spritePool_clean(spritePool **ppCtx) {
+    int i;
+
+    if (!ppCtx || !(*ppCtx)) {
+        return;
+    }
+
+    i = 0;
+    while (i < (*ppCtx)->numSlabs) {
+        spritePool_freeSlab((*ppCtx)->pSlabs + i);
+        i++;
+    }
+    free((*ppCtx)->pSpots);
+
+    free(*ppCtx);
+    *ppCtx = 0;
+}
+
+/**
+ * Append a sprite that was just spawned to the list of live sprites
+ *
+ * @param  [ in]pCtx  The sprite pool
+ * @param  [ in]pNode The sprite's node
+ */
+static void spritePool_linkNode(spritePool *pCtx, spritePoolNode *pNode) {
+    pNode->pOlder = pCtx->pNewest;
+    pNode->pNewer = 0;
+    if (pCtx->pNewest) {
+        pCtx->pNewest->pNewer = pNode;
+    }
+    else {
+        pCtx->pOldest = pNode;
+    }
+    pCtx->pNewest = pNode;
+}
+
+/**
+ * Remove a sprite (that's about to die or be reused) from the list of live
+ * sprites
+ *
+ * @param  [ in]pCtx  The sprite pool
+ * @param  [ in]pNode The sprite's node
+ */
+static void spritePool_unlinkNode(spritePool *pCtx, spritePoolNode *pNode) {
+    if (pNode->pOlder) {
+        pNode->pOlder->pNewer = pNode->pNewer;
+    }
+    else {
+        pCtx->pOldest = pNode->pNewer;
+    }
+    if (pNode->pNewer) {
+        pNode->pNewer->pOlder = pNode->pOlder;
+    }
+    else {
+        pCtx->pNewest = pNode->pOlder;
+    }
+    pNode->pOlder = 0;
+    pNode->pNewer = 0;
+}
+
+/**
+ * Put a sprite to sleep or wake it, keeping count of the pool's sleepers; May
+ * be called from the update jobs
+ *
+ * @param  [ in]pNode    The sprite's node
+ * @param  [ in]isAsleep Whether the sprite should sleep
+ */
+static void spritePool_setAsleep(spritePoolNode *pNode, int isAsleep) {
+    if (pNode->isAsleep == isAsleep) {
+        return;
+    }
+    pNode->isAsleep = isAsleep;
+    if (isAsleep) {
+        __atomic_add_fetch(&(pNode->pPool->numAsleep), 1, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_sub_fetch(&(pNode->pPool->numAsleep), 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Remember where a sprite is, as it's about to wake or die, so whatever is
+ * sleeping on top of it gets woken on the next spritePool_postUpdate; Nothing
+ * is listed while nothing sleeps (e.g., for bullets)
+ *
+ * @param  [ in]pNode The sprite's node
+ */
+static void spritePool_vacateNode(spritePoolNode *pNode) {
+    gfmObject *pObj;
+    spritePool *pCtx;
+    spritePoolSpot *pSpot;
+
+    pCtx = pNode->pPool;
+    if (pCtx->numAsleep - pNode->isAsleep <= 0 ||
+            pCtx->spotsUsed >= pCtx->spotsLen) {
+        return;
+    }
+
+    pObj = 0;
+    pSpot = pCtx->pSpots + pCtx->spotsUsed;
+    if (gfmSprite_getObject(&pObj, pNode->pSelf) != GFMRV_OK ||
+            gfmObject_getPosition(&(pSpot->x), &(pSpot->y), pObj) !=
+            GFMRV_OK) {
+        return;
+    }
+    pCtx->spotsUsed++;
+}
+
+/**
+ * Wake every sprite sleeping on top of a spot that was vacated (by a sprite
+ * that woke or died) since the last call; Sprites woken by this vacate their
+ * own spots, so they are handled on the following call
+ *
+ * Each sleeper is only visited once, and tested against the (short) list of
+ * vacated spots
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+static gfmRV spritePool_wakeSupported(spritePool *pCtx) {
+    gfmRV rv;
+    int i, num;
+
+    num = pCtx->spotsUsed;
+    if (num == 0 || pCtx->numAsleep == 0) {
+        pCtx->spotsUsed = 0;
+        return GFMRV_OK;
+    }
+
+    i = 0;
+    while (i < pCtx->numSlabs) {
+        spritePoolSlab *pSlab;
+        int j;
+
+        pSlab = pCtx->pSlabs + i;
+        j = 0;
+        while (pSlab->numFree < pSlab->len && j < pSlab->len) {
+            gfmObject *pObj;
+            spritePoolNode *pNode;
+            int bottom, k, x, y;
+
+            pNode = pSlab->pNodes + j;
+            j++;
+            if (!pNode->isAlive || !pNode->isAsleep) {
+                continue;
+            }
+
+            rv = gfmSprite_getObject(&pObj, pNode->pSelf);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = gfmObject_getPosition(&x, &y, pObj);
+            ASSERT(rv == GFMRV_OK, rv);
+
+            /* Every sprite on the pool has the same hitbox, and those at rest
+             * were separated to (about) the same line */
+            bottom = y + pCtx->height;
+            k = 0;
+            while (k < num) {
+                spritePoolSpot *pSpot;
+
+                pSpot = pCtx->pSpots + k;
+                k++;
+                if (bottom >= pSpot->y - 1 && bottom <= pSpot->y + 1 &&
+                        x < pSpot->x + pCtx->width &&
+                        x + pCtx->width > pSpot->x) {
+                    spritePool_wakeNode(pNode);
+                    break;
+                }
+            }
+        }
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    /* Keep only the spots vacated by the sprites just woken */
+    memmove(pCtx->pSpots, pCtx->pSpots + num,
+            sizeof(spritePoolSpot) * (pCtx->spotsUsed - num));
+    pCtx->spotsUsed -= num;
+    return rv;
+}
+
+/**
+ * Retrieve a dead node from the lowest slab with a free one; If every sprite
+ * is alive, the oldest one is reused
+ *
+ * The pool must already have grown, if it could
+ *
+ * @param  [out]ppNode The node
+ * @param  [ in]pCtx   The sprite pool
+ */
+static gfmRV spritePool_getNode(spritePoolNode **ppNode, spritePool *pCtx) {
+    gfmRV rv;
+    spritePoolNode *pNode;
+    int i;
+
+    pNode = 0;
+    i = 0;
+    while (i < pCtx->numSlabs) {
+        spritePoolSlab *pSlab;
+
+        pSlab = pCtx->pSlabs + i;
+        if (pSlab->numFree > 0) {
+            pSlab->numFree--;
+            pNode = pSlab->pNodes + pSlab->pFree[pSlab->numFree];
+            break;
+        }
+        i++;
+    }
+
+    if (!pNode) {
+        /* Budget exhausted: reuse the oldest sprite instead of dropping it */
+        pNode = pCtx->pOldest;
+        ASSERT(pNode, GFMRV_INTERNAL_ERROR);
+        spritePool_vacateNode(pNode);
+        spritePool_unlinkNode(pCtx, pNode);
+        pCtx->numStolen++;
+        pCtx->used--;
+    }
+    spritePool_linkNode(pCtx, pNode);
+
+    spritePool_setAsleep(pNode, 0);
+    pNode->isAlive = 1;
+    pNode->age = 0;
+    pNode->restTime = 0;
+    pNode->isSupported = 0;
+    pNode->isPopulated = 0;
+    pNode->didMove = 0;
+    pCtx->used++;
+    if (pCtx->used > pCtx->highWater) {
+        pCtx->highWater = pCtx->used;
+    }
+
+    *ppNode = pNode;
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve a dead sprite (growing the pool, if needed)
+ *
+ * If the pool already reached its maximum size, the oldest sprite is reused
+ *
+ * @param  [out]ppSpr The sprite
+ * @param  [ in]pCtx  The sprite pool
+ */
+gfmRV spritePool_recycle(gfmSprite **ppSpr, spritePool *pCtx) {
+    gfmRV rv;
+    spritePoolNode *pNode;
+
+    if (pCtx->used == pCtx->len && pCtx->len < pCtx->maxLen) {
+        rv = spritePool_grow(pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    rv = spritePool_getNode(&pNode, pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    /* Reset whatever was set by the previous owner */
+    rv = gfmSprite_setVelocity(pNode->pSelf, 0.0, 0.0);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmSprite_setAcceleration(pNode->pSelf, 0.0, 0.0);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmSprite_resetAnimation(pNode->pSelf);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    *ppSpr = pNode->pSelf;
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Spawn every described sprite in a single pass, growing the pool only once
+ *
+ * If the pool reaches its maximum size, the oldest sprites are reused
+ *
+ * @param  [ in]pCtx   The sprite pool
+ * @param  [ in]pDescs The sprites
+ * @param  [ in]num    Number of elements in pDescs
+ */
+gfmRV spritePool_spawnBatch(spritePool *pCtx, spritePoolDesc *pDescs,
+        int num) {
+    gfmRV rv;
+    int i;
+
+    ASSERT(num >= 0, GFMRV_ARGUMENTS_BAD);
+
+    while (pCtx->used + num > pCtx->len && pCtx->len < pCtx->maxLen) {
+        rv = spritePool_grow(pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+    }
+
+    i = 0;
+    while (i < num) {
+        spritePoolNode *pNode;
+        spritePoolDesc *pDesc;
+
+        pDesc = pDescs + i;
+
+        rv = spritePool_getNode(&pNode, pCtx);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        rv = gfmSprite_setPosition(pNode->pSelf, pDesc->x, pDesc->y);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmSprite_setVelocity(pNode->pSelf, pDesc->vx, pDesc->vy);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmSprite_setAcceleration(pNode->pSelf, pDesc->ax, pDesc->ay);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmSprite_resetAnimation(pNode->pSelf);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmSprite_playAnimation(pNode->pSelf, pDesc->anim);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Kill a sprite (e.g., after it collided)
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+gfmRV spritePool_removeNode(spritePoolNode *pNode) {
+    spritePoolSlab *pSlab;
+
+    if (!pNode->isAlive) {
+        return GFMRV_OK;
+    }
+    spritePool_vacateNode(pNode);
+    spritePool_unlinkNode(pNode->pPool, pNode);
+    spritePool_setAsleep(pNode, 0);
+
+    pSlab = pNode->pPool->pSlabs + pNode->slab;
+    pSlab->pFree[pSlab->numFree] = pNode->index;
+    pSlab->numFree++;
+
+    pNode->isAlive = 0;
+    pNode->pPool->used--;
+
+    return GFMRV_OK;
+}
+
+/**
+ * Job that ages a range of a slab's sprites and decides which of those are
+ * at rest and which must be moved
+ *
+ * Expired sprites are only flagged (by their age), since killing them would
+ * touch the slab's free stack. Only the range's own objects are touched
+ * (never the shared gfmCtx), so the sprites are moved by GFraMe later, on
+ * spritePool_postUpdate
+ *
+ * @param  [ in]pArg  The slab
+ * @param  [ in]first First node
+ * @param  [ in]last  One past the last node
+ */
+static gfmRV spritePool_updateJob(void *pArg, int first, int last) {
+    gfmRV rv;
+    spritePoolSlab *pSlab;
+    int i;
+
+    pSlab = (spritePoolSlab*)pArg;
+
+    i = first;
+    while (i < last) {
+        double vx, vy;
+        gfmCollision dir;
+        gfmObject *pObj;
+        spritePoolNode *pNode;
+
+        pNode = pSlab->pNodes + i;
+        i++;
+        if (!pNode->isAlive) {
+            continue;
+        }
+
+        pNode->age += pNode->pPool->elapsed;
+        if (pNode->age >= pNode->pPool->ttl) {
+            continue;
+        }
+
+        rv = gfmSprite_getObject(&pObj, pNode->pSelf);
+        ASSERT(rv == GFMRV_OK, rv);
+
+        /* At rest if it's slow and standing on something (otherwise, it
+         * could simply be at the top of its arc) */
+        rv = gfmObject_getVelocity(&vx, &vy, pObj);
+        ASSERT(rv == GFMRV_OK, rv);
+        rv = gfmObject_getCollision(&dir, pObj);
+        ASSERT(rv == GFMRV_OK, rv);
+        if (((dir & gfmCollision_down) || pNode->isSupported) &&
+                fabs(vx) < SPRITEPOOL_SLEEP_SPEED &&
+                fabs(vy) < SPRITEPOOL_SLEEP_SPEED) {
+            pNode->restTime += pNode->pPool->elapsed;
+        }
+        else {
+            pNode->restTime = 0;
+            spritePool_setAsleep(pNode, 0);
+        }
+        pNode->isSupported = 0;
+        if (pNode->restTime >= SPRITEPOOL_SLEEP_DELAY) {
+            if (!pNode->isAsleep) {
+                rv = gfmObject_setVelocity(pObj, 0.0, 0.0);
+                ASSERT(rv == GFMRV_OK, rv);
+                spritePool_setAsleep(pNode, 1);
+            }
+            pNode->didMove = 0;
+            continue;
+        }
+
+        /* Kept so the sprite is collided over its whole movement */
+        rv = gfmObject_getPosition(&(pNode->lastX), &(pNode->lastY), pObj);
+        ASSERT(rv == GFMRV_OK, rv);
+        pNode->didMove = 1;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Queue the bookkeeping of every live sprite on the job system
+ *
+ * Nothing may be spawned until spritePool_postUpdate is called (after
+ * jobs_wait)
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_update(spritePool *pCtx) {
+    gfmRV rv;
+    int i;
+
+    pCtx->elapsed = pGame->elapsed;
+
+    i = 0;
+    while (i < pCtx->numSlabs) {
+        spritePoolSlab *pSlab;
+
+        pSlab = pCtx->pSlabs + i;
+        if (pSlab->numFree < pSlab->len) {
+            rv = jobs_push(pGame->pJobs, spritePool_updateJob, pSlab,
+                    pSlab->len, SPRITEPOOL_JOB_GRAIN);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Kill the sprites that expired during the update, move (and animate) the
+ * awake ones, wake those that were sleeping on top of a sprite that's gone
+ * and, after a quiet period, release the last slab
+ *
+ * GFraMe isn't reentrant (the sprites are updated through the shared
+ * gfmCtx), so this must run on the update thread
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_postUpdate(spritePool *pCtx) {
+    gfmRV rv;
+    spritePoolSlab *pLast;
+    int i;
+
+    i = 0;
+    while (i < pCtx->numSlabs) {
+        spritePoolSlab *pSlab;
+        int j;
+
+        pSlab = pCtx->pSlabs + i;
+        j = 0;
+        while (pSlab->numFree < pSlab->len && j < pSlab->len) {
+            spritePoolNode *pNode;
+
+            pNode = pSlab->pNodes + j;
+            j++;
+            if (!pNode->isAlive) {
+                continue;
+            }
+            if (pNode->age >= pCtx->ttl) {
+                rv = spritePool_removeNode(pNode);
+                ASSERT(rv == GFMRV_OK, rv);
+            }
+            else if (pNode->didMove) {
+                rv = gfmSprite_update(pNode->pSelf, pGame->pCtx);
+                ASSERT(rv == GFMRV_OK, rv);
+            }
+        }
+        i++;
+    }
+
+    rv = spritePool_wakeSupported(pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    /* Trim the last slab once everything fits comfortably on the others */
+    pLast = pCtx->pSlabs + pCtx->numSlabs - 1;
+    if (pCtx->numSlabs > 1 && pCtx->used <= (pCtx->len - pLast->len) / 2) {
+        pCtx->quietTime += pCtx->elapsed;
+        if (pCtx->quietTime >= SPRITEPOOL_TRIM_DELAY &&
+                pLast->numFree == pLast->len) {
+            pCtx->len -= pLast->len;
+            pCtx->numSlabs--;
+            spritePool_freeSlab(pLast);
+            pCtx->quietTime = 0;
+        }
+    }
+    else {
+        pCtx->quietTime = 0;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Add every sleeping sprite that's inside the camera to the broadphase
+ * (without testing it); Must be called before anything that may push those
+ * sprites is collided
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_populate(spritePool *pCtx) {
+    gfmCamera *pCam;
+    gfmRV rv;
+    int i;
+
+    pCam = 0;
+    rv = gfm_getCamera(&pCam, pGame->pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    i = 0;
+    while (i < pCtx->numSlabs) {
+        spritePoolSlab *pSlab;
+        int j;
+
+        pSlab = pCtx->pSlabs + i;
+        j = 0;
+        while (pSlab->numFree < pSlab->len && j < pSlab->len) {
+            gfmObject *pObj;
+            spritePoolNode *pNode;
+
+            pNode = pSlab->pNodes + j;
+            j++;
+            pNode->isPopulated = 0;
+            /* Skip those that will expire on this tick */
+            if (!pNode->isAlive || !pNode->isAsleep ||
+                    pNode->age + pGame->elapsed >= pCtx->ttl ||
+                    gfmCamera_isSpriteInside(pCam, pNode->pSelf) !=
+                    GFMRV_TRUE) {
+                continue;
+            }
+
+            rv = gfmSprite_getObject(&pObj, pNode->pSelf);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = broadphase_populateObject(pGame->pBroadphase, pObj);
+            ASSERT(rv == GFMRV_OK, rv);
+            pNode->isPopulated = 1;
+        }
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Wake a sprite (e.g., after it was pushed), so it's integrated and tested
+ * again; Whatever sleeps on top of it is woken on the next post update
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+void spritePool_wakeNode(spritePoolNode *pNode) {
+    if (pNode->isAsleep) {
+        spritePool_vacateNode(pNode);
+    }
+    pNode->restTime = 0;
+    spritePool_setAsleep(pNode, 0);
+}
+
+/**
+ * Check whether a sprite is asleep
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+int spritePool_isAsleep(spritePoolNode *pNode) {
+    return pNode->isAsleep;
+}
+
+/**
+ * Mark a sprite as standing on top of another one (as if it were on the
+ * floor), so it may fall asleep
+ *
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+void spritePool_setSupported(spritePoolNode *pNode) {
+    pNode->isSupported = 1;
+}
+
+/**
+ * Retrieve where a sprite was before it was last updated (or its current
+ * position, if it wasn't updated since it was spawned)
+ *
+ * @param  [out]pX    Horizontal position
+ * @param  [out]pY    Vertical position
+ * @param  [ in]pNode The sprite's node (i.e., its child)
+ */
+gfmRV spritePool_getLastPosition(int *pX, int *pY, spritePoolNode *pNode) {
+    gfmObject *pObj;
+    gfmRV rv;
+
+    if (pNode->didMove) {
+        *pX = pNode->lastX;
+        *pY = pNode->lastY;
+        return GFMRV_OK;
+    }
+
+    rv = gfmSprite_getObject(&pObj, pNode->pSelf);
+    ASSERT(rv == GFMRV_OK, rv);
+    rv = gfmObject_getPosition(pX, pY, pObj);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Collide every live sprite that's inside the camera (over the path it moved
+ * on this tick) against the broadphase
+ *
+ * Every overlap is collected first and only resolved after the last sprite
+ * was added to the broadphase, so the narrow phase may run in parallel
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_collide(spritePool *pCtx) {
+    gfmCamera *pCam;
+    gfmRV rv;
+    int i;
+
+    pCam = 0;
+    rv = gfm_getCamera(&pCam, pGame->pCtx);
+    ASSERT(rv == GFMRV_OK, rv);
+
+    i = 0;
+    while (i < pCtx->numSlabs) {
+        spritePoolSlab *pSlab;
+        int j;
+
+        pSlab = pCtx->pSlabs + i;
+        j = 0;
+        while (pSlab->numFree < pSlab->len && j < pSlab->len) {
+            gfmObject *pObj;
+            spritePoolNode *pNode;
+            int x, y;
+
+            pNode = pSlab->pNodes + j;
+            j++;
+            if (!pNode->isAlive ||
+                    gfmCamera_isSpriteInside(pCam, pNode->pSelf) != GFMRV_TRUE) {
+                continue;
+            }
+            else if (pNode->isPopulated) {
+                /* Already on the broadphase, even if it was woken since */
+                pNode->isPopulated = 0;
+                continue;
+            }
+
+            rv = gfmSprite_getObject(&pObj, pNode->pSelf);
+            ASSERT(rv == GFMRV_OK, rv);
+            if (pNode->isAsleep) {
+                /* Fell asleep after spritePool_populate */
+                rv = broadphase_populateObject(pGame->pBroadphase, pObj);
+                ASSERT(rv == GFMRV_OK, rv);
+                continue;
+            }
+            rv = spritePool_getLastPosition(&x, &y, pNode);
+            ASSERT(rv == GFMRV_OK, rv);
+            rv = broadphase_collideSwept(pGame->pBroadphase, pObj, x, y);
+            ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE,
+                    rv);
+            if (rv == GFMRV_QUADTREE_OVERLAPED) {
+                rv = collide_collect();
+                ASSERT(rv == GFMRV_OK, rv);
+            }
+        }
+        i++;
+    }
+
+    rv = collide_resolve();
+    ASSERT(rv == GFMRV_OK, rv);
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Push every live sprite into the snapshot being recorded
+ *
+ * @param  [ in]pCtx The sprite pool
+ */
+gfmRV spritePool_draw(spritePool *pCtx) {
+    gfmRV rv;
+    int i;
+
+    i = 0;
+    while (i < pCtx->numSlabs) {
+        spritePoolSlab *pSlab;
+        int j;
+
+        pSlab = pCtx->pSlabs + i;
+        j = 0;
+        while (pSlab->numFree < pSlab->len && j < pSlab->len) {
+            spritePoolNode *pNode;
+
+            pNode = pSlab->pNodes + j;
+            j++;
+            if (!pNode->isAlive) {
+                continue;
+            }
+
+            rv = snapshot_pushSprite(pGame->pSnapshot, pNode->pSelf,
+                    pCtx->pSset, pCtx->offX, pCtx->offY);
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        i++;
+    }
+
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
+
+/**
+ * Retrieve the pool's usage
+ *
+ * @param  [out]pUsed      Number of live sprites
+ * @param  [out]pHighWater Maximum number of live sprites ever reached
+ * @param  [out]pLen       Number of sprites currently alloc'ed
+ * @param  [out]pStolen    Number of live sprites reused since the pool was
+ *                         full
+ * @param  [ in]pCtx       The sprite pool
+ */
+void spritePool_getStats(int *pUsed, int *pHighWater, int *pLen, int *pStolen,
+        spritePool *pCtx) {
+    *pUsed = pCtx->used;
+    *pHighWater = pCtx->highWater;
+    *pLen = pCtx->len;
+    *pStolen = pCtx->numStolen;
+}
+
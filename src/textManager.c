@@ -9,10 +9,12 @@
 #include <GFraMe/gfmObject.h>
 #include <GFraMe/gfmParser.h>
 #include <GFraMe/gfmString.h>
-#include <GFraMe/gfmText.h>
 
+#include <ld34/broadphase.h>
 #include <ld34/collide.h>
 #include <ld34/game.h>
+#include <ld34/mixer.h>
+#include <ld34/snapshot.h>
 #include <ld34/textManager.h>
 
 #include <stdlib.h>
@@ -38,8 +40,14 @@ struct stTextManager {
     textEvent *pCurEv;
     /** List of queued events */
     textEvent *pQueue;
-    /** Currently playing text */
-    gfmText *pText;
+    /** Currently playing text (owned by its event) */
+    char *pStr;
+    /** Length of the current text */
+    int len;
+    /** Number of characters already revealed */
+    int numShown;
+    /** Time since the last character was revealed */
+    int revealTime;
     /** Position of the window manager */
     int x;
     /** Position of the window manager */
@@ -107,12 +115,6 @@ gfmRV textManager_init(textManager **ppCtx, int x, int y, int w, int h,
     ASSERT(*ppCtx, GFMRV_ALLOC_FAILED);
     memset(*ppCtx, 0x0, sizeof(textManager));
 
-    rv = gfmText_getNew(&((*ppCtx)->pText));
-    ASSERT(rv == GFMRV_OK, rv);
-    rv = gfmText_init((*ppCtx)->pText, x+8, y+8, w-2, h-2, TEXT_DELAY, 0,
-            pAssets->pSset8x8, 0/*tile*/);
-    ASSERT(rv == GFMRV_OK, rv);
-
     (*ppCtx)->x = x;
     (*ppCtx)->y = y;
     (*ppCtx)->width = w;
@@ -132,9 +134,6 @@ __ret:
 void textManager_clean(textManager **ppCtx) {
     gfmGenArr_clean((*ppCtx)->pTexEvs, textEvent_clean);
 
-    if ((*ppCtx)->pText) {
-        gfmText_free(&((*ppCtx)->pText));
-    }
     free(*ppCtx);
     *ppCtx = 0;
 }
@@ -273,7 +272,7 @@ gfmRV textManager_preUpdate(textManager *pCtx) {
         rv = gfmObject_update(pEv->pSelf, pGame->pCtx);
         ASSERT(rv == GFMRV_OK, rv);
 
-        rv = gfmQuadtree_collideObject(pGame->pQt, pEv->pSelf);
+        rv = broadphase_collideObject(pGame->pBroadphase, pEv->pSelf);
         ASSERT(rv == GFMRV_QUADTREE_OVERLAPED || rv == GFMRV_QUADTREE_DONE, rv);
         if (rv == GFMRV_QUADTREE_OVERLAPED) {
             rv = collide_run();
@@ -294,70 +293,152 @@ __ret:
  * @param  [ in]pCtx The text manager
  */
 gfmRV textManager_postUpdate(textManager *pCtx) {
-    char c;
     gfmRV rv;
 
-    rv = gfmText_didFinish(pCtx->pText);
-    ASSERT(rv == GFMRV_TRUE || rv == GFMRV_FALSE, rv);
-    if (rv == GFMRV_TRUE) {
+    if (!pCtx->pCurEv || pCtx->numShown >= pCtx->len) {
         if (pCtx->pCurEv) {
             int elapsed;
 
-            rv = gfm_getElapsedTime(&elapsed, pGame->pCtx);
-            ASSERT(rv == GFMRV_OK, rv);
+            elapsed = pGame->elapsed;
             pCtx->elapsed += elapsed;
 
             if (pCtx->elapsed > pCtx->pCurEv->ttl) {
                 pCtx->pCurEv = 0;
                 pCtx->elapsed = 0;
+                pCtx->pStr = 0;
+                pCtx->len = 0;
             }
         }
         if (!pCtx->pCurEv && pCtx->pQueue) {
-            char *pStr;
-            int len;
-
             pCtx->pCurEv = pCtx->pQueue;
             pCtx->pQueue = pCtx->pQueue->pNext;
 
             pCtx->pCurEv->pNext = 0;
 
-            rv = gfmString_getString(&pStr, pCtx->pCurEv->pString);
+            rv = gfmString_getString(&(pCtx->pStr), pCtx->pCurEv->pString);
             ASSERT(rv == GFMRV_OK, rv);
-            rv = gfmString_getLength(&len, pCtx->pCurEv->pString);
+            rv = gfmString_getLength(&(pCtx->len), pCtx->pCurEv->pString);
             ASSERT(rv == GFMRV_OK, rv);
+            pCtx->numShown = 0;
+            pCtx->revealTime = 0;
+        }
+    }
 
-            rv = gfmText_setText(pCtx->pText, pStr, len, 0/*doCopy*/);
-            ASSERT(rv == GFMRV_OK, rv);
+    /* Reveal a character every TEXT_DELAY ms */
+    if (pCtx->pCurEv && pCtx->numShown < pCtx->len) {
+        pCtx->revealTime += pGame->elapsed;
+    }
+    while (pCtx->pCurEv && pCtx->numShown < pCtx->len &&
+            pCtx->revealTime >= TEXT_DELAY) {
+        static int textTime = 0;
+        char c;
+
+        c = pCtx->pStr[pCtx->numShown];
+        pCtx->numShown++;
+        pCtx->revealTime -= TEXT_DELAY;
+
+        if (c != ' ' && c != '\n' && c != '\0') {
+            if (textTime == 0) {
+                rv = mixer_play(pGame->pMixer, pAssets->sfxText, 0.3);
+                ASSERT(rv == GFMRV_OK, rv);
+            }
+
+            textTime = (textTime + 1) % 2;
         }
     }
 
-    rv = gfmText_update(pCtx->pText, pGame->pCtx);
-    ASSERT(rv == GFMRV_OK, rv);
+    rv = GFMRV_OK;
+__ret:
+    return rv;
+}
 
-    rv = gfmText_getJustRendered(&c, pCtx->pText);
-    if (rv == GFMRV_OK && c != ' ' && c != '\n') {
-        static int textTime = 0;
+/**
+ * Lay the revealed part of the current text out on the window (breaking lines
+ * between words) and, optionally, push its characters into the snapshot
+ *
+ * @param  [out]pNumLines Number of lines used by the revealed text
+ * @param  [ in]pCtx      The text manager
+ * @param  [ in]pSnapshot The snapshots (NULL, to only count the lines)
+ * @param  [ in]firstLine First line pushed into the snapshot
+ */
+static gfmRV textManager_layout(int *pNumLines, textManager *pCtx,
+        snapshot *pSnapshot, int firstLine) {
+    gfmRV rv;
+    int cols, i, line, x;
 
-        if (textTime == 0) {
-            rv = gfm_playAudio(0, pGame->pCtx, pAssets->sfxText, 0.3);
-            ASSERT(rv == GFMRV_OK, rv);
+    /* The window has a tile of border around the text */
+    cols = pCtx->width - 2;
+    line = 0;
+    x = 0;
+    i = 0;
+    while (i < pCtx->numShown) {
+        char c;
+
+        c = pCtx->pStr[i];
+        if (c == '\n') {
+            line++;
+            x = 0;
+            i++;
+            continue;
         }
+        else if (c == '\0') {
+            i++;
+            continue;
+        }
+
+        /* Break before a word that doesn't fit on what's left of the line
+         * (checking the whole word, so it doesn't jump while revealed) */
+        if (c != ' ' && (x == 0 || pCtx->pStr[i - 1] == ' ')) {
+            int len;
 
-        textTime = (textTime + 1) % 2;
+            len = 0;
+            while (i + len < pCtx->len && pCtx->pStr[i + len] != ' ' &&
+                    pCtx->pStr[i + len] != '\n' &&
+                    pCtx->pStr[i + len] != '\0') {
+                len++;
+            }
+            if (x > 0 && x + len > cols) {
+                line++;
+                x = 0;
+            }
+        }
+        if (x >= cols) {
+            line++;
+            x = 0;
+        }
+        if (c == ' ' && x == 0) {
+            /* Don't start a line with a space */
+            i++;
+            continue;
+        }
+
+        if (pSnapshot && c != ' ' && line >= firstLine) {
+            rv = snapshot_pushHudTile(pSnapshot, pAssets->pSset8x8,
+                    pCtx->x + 8 + x * 8, pCtx->y + 8 + (line - firstLine) * 8,
+                    c - '!');
+            ASSERT(rv == GFMRV_OK, rv);
+        }
+        x++;
+        i++;
     }
 
+    *pNumLines = line + 1;
     rv = GFMRV_OK;
 __ret:
     return rv;
 }
 
 /**
- * Render the currently display text, if any
+ * Push the currently displayed text, if any, into the snapshot being
+ * recorded (on the update thread); If it doesn't fit on the window, only its
+ * last lines are pushed
  *
- * @param  [ in]pCtx The text manager
+ * @param  [ in]pCtx      The text manager
+ * @param  [ in]pSnapshot The snapshots
  */
-gfmRV textManager_draw(textManager *pCtx) {
+gfmRV textManager_snapshot(textManager *pCtx, snapshot *pSnapshot) {
     gfmRV rv;
+    int firstLine, numLines;
 
     if (!pCtx->pCurEv) {
         return GFMRV_OK;
@@ -367,7 +448,13 @@ gfmRV textManager_draw(textManager *pCtx) {
         /* TODO Draw window */
     }
 
-    rv = gfmText_draw(pCtx->pText, pGame->pCtx);
+    rv = textManager_layout(&numLines, pCtx, 0/*pSnapshot*/, 0/*firstLine*/);
+    ASSERT(rv == GFMRV_OK, rv);
+    firstLine = 0;
+    if (numLines > pCtx->height - 2) {
+        firstLine = numLines - (pCtx->height - 2);
+    }
+    rv = textManager_layout(&numLines, pCtx, pSnapshot, firstLine);
     ASSERT(rv == GFMRV_OK, rv);
 
     rv = GFMRV_OK;
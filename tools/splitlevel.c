@@ -0,0 +1,222 @@
+/**
+ * Split a level into column sectors, so it may be streamed by the game
+ *
+ * Usage: splitlevel TILEMAP OBJECTS OUTDIR [SECTOR_WIDTH]
+ *
+ * Generates (on OUTDIR):
+ *   - level.txt: 'level <width> <height> <sectorWidth> <numSectors>' followed
+ *     by one 'sector <index> <numObjects>' line per sector;
+ *   - objects.gfm: every object that must always be loaded (i.e., everything
+ *     but enemies);
+ *   - sector_NNN_tile.gfm: the sector's columns, as a regular tilemap;
+ *   - sector_NNN_obj.gfm: enemies that start within the sector.
+ *
+ * @file tools/splitlevel.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Default width of each sector, in tiles (a whole screen) */
+#define DEF_SECTOR_WIDTH 40
+/** Longest accepted line (besides the tilemap's data) */
+#define LINE_LEN 4096
+/** Longest accepted type name */
+#define TYPE_LEN 256
+/** Maximum number of 'type' lines */
+#define MAX_TYPES 256
+/** Tiles are 8x8 */
+#define TILE_WIDTH 8
+
+static char pTypes[MAX_TYPES][TYPE_LEN * 2];
+static int numTypes;
+
+/**
+ * Check whether an object only lives while its sector is loaded
+ *
+ * @param  [ in]pName Object's in-game type
+ */
+static int splitlevel_isStreamed(char *pName) {
+    return strcmp(pName, "lil_tank") == 0 || strcmp(pName, "turret") == 0;
+}
+
+int main(int argc, char *argv[]) {
+    char pLine[LINE_LEN], pPath[LINE_LEN];
+    FILE *pIn, *pOut, *pIndex, **ppSecObjs;
+    int *pData, *pNumObjs, height, i, numSectors, sectorWidth, width;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s TILEMAP OBJECTS OUTDIR [SECTOR_WIDTH]\n",
+                argv[0]);
+        return 1;
+    }
+    sectorWidth = DEF_SECTOR_WIDTH;
+    if (argc > 4) {
+        sectorWidth = atoi(argv[4]);
+    }
+    if (sectorWidth <= 0) {
+        fprintf(stderr, "Invalid sector width\n");
+        return 1;
+    }
+
+    /* Read the tilemap */
+    pIn = fopen(argv[1], "rt");
+    if (!pIn) {
+        fprintf(stderr, "Couldn't open '%s'\n", argv[1]);
+        return 1;
+    }
+    width = 0;
+    height = 0;
+    while (fscanf(pIn, "%s", pLine) == 1) {
+        if (strcmp(pLine, "type") == 0) {
+            char pName[TYPE_LEN];
+            int tile;
+
+            if (numTypes >= MAX_TYPES ||
+                    fscanf(pIn, "%255s %i", pName, &tile) != 2) {
+                fprintf(stderr, "Invalid 'type' on '%s'\n", argv[1]);
+                return 1;
+            }
+            snprintf(pTypes[numTypes], TYPE_LEN * 2, "type %s %i", pName, tile);
+            numTypes++;
+        }
+        else if (strcmp(pLine, "map") == 0) {
+            if (fscanf(pIn, "%i %i", &width, &height) != 2 || width <= 0 ||
+                    height <= 0) {
+                fprintf(stderr, "Invalid 'map' on '%s'\n", argv[1]);
+                return 1;
+            }
+            break;
+        }
+    }
+    if (width == 0) {
+        fprintf(stderr, "No map found on '%s'\n", argv[1]);
+        return 1;
+    }
+    pData = (int*)malloc(sizeof(int) * width * height);
+    i = 0;
+    while (i < width * height) {
+        if (fscanf(pIn, "%i", pData + i) != 1) {
+            fprintf(stderr, "Truncated map on '%s'\n", argv[1]);
+            return 1;
+        }
+        i++;
+    }
+    fclose(pIn);
+
+    numSectors = (width + sectorWidth - 1) / sectorWidth;
+
+    /* Write every sector's tilemap */
+    i = 0;
+    while (i < numSectors) {
+        int first, len, x, y;
+
+        snprintf(pPath, sizeof(pPath), "%s/sector_%03i_tile.gfm", argv[3], i);
+        pOut = fopen(pPath, "wt");
+        if (!pOut) {
+            fprintf(stderr, "Couldn't create '%s'\n", pPath);
+            return 1;
+        }
+
+        first = i * sectorWidth;
+        len = width - first;
+        if (len > sectorWidth) {
+            len = sectorWidth;
+        }
+
+        x = 0;
+        while (x < numTypes) {
+            fprintf(pOut, "%s\n", pTypes[x]);
+            x++;
+        }
+        fprintf(pOut, "map %i %i\n", len, height);
+        y = 0;
+        while (y < height) {
+            x = 0;
+            while (x < len) {
+                fprintf(pOut, " %i", pData[first + x + y * width]);
+                x++;
+            }
+            fprintf(pOut, "\n");
+            y++;
+        }
+
+        fclose(pOut);
+        i++;
+    }
+
+    /* Distribute the objects */
+    pIn = fopen(argv[2], "rt");
+    if (!pIn) {
+        fprintf(stderr, "Couldn't open '%s'\n", argv[2]);
+        return 1;
+    }
+    snprintf(pPath, sizeof(pPath), "%s/objects.gfm", argv[3]);
+    pOut = fopen(pPath, "wt");
+    ppSecObjs = (FILE**)calloc(numSectors, sizeof(FILE*));
+    pNumObjs = (int*)calloc(numSectors, sizeof(int));
+    if (!pOut || !ppSecObjs || !pNumObjs) {
+        fprintf(stderr, "Couldn't create '%s'\n", pPath);
+        return 1;
+    }
+    while (fgets(pLine, sizeof(pLine), pIn)) {
+        char pKind[LINE_LEN], pName[LINE_LEN];
+        int sector, x;
+
+        if (sscanf(pLine, "%s %s %i", pKind, pName, &x) != 3) {
+            continue;
+        }
+        if (strcmp(pKind, "obj") != 0 || !splitlevel_isStreamed(pName)) {
+            fputs(pLine, pOut);
+            continue;
+        }
+
+        sector = x / (sectorWidth * TILE_WIDTH);
+        if (sector < 0) {
+            sector = 0;
+        }
+        else if (sector >= numSectors) {
+            sector = numSectors - 1;
+        }
+
+        if (!ppSecObjs[sector]) {
+            snprintf(pPath, sizeof(pPath), "%s/sector_%03i_obj.gfm", argv[3],
+                    sector);
+            ppSecObjs[sector] = fopen(pPath, "wt");
+            if (!ppSecObjs[sector]) {
+                fprintf(stderr, "Couldn't create '%s'\n", pPath);
+                return 1;
+            }
+        }
+        fputs(pLine, ppSecObjs[sector]);
+        pNumObjs[sector]++;
+    }
+    fclose(pIn);
+    fclose(pOut);
+
+    /* Write the index */
+    snprintf(pPath, sizeof(pPath), "%s/level.txt", argv[3]);
+    pIndex = fopen(pPath, "wt");
+    if (!pIndex) {
+        fprintf(stderr, "Couldn't create '%s'\n", pPath);
+        return 1;
+    }
+    fprintf(pIndex, "level %i %i %i %i\n", width, height, sectorWidth,
+            numSectors);
+    i = 0;
+    while (i < numSectors) {
+        if (ppSecObjs[i]) {
+            fclose(ppSecObjs[i]);
+        }
+        fprintf(pIndex, "sector %i %i\n", i, pNumObjs[i]);
+        i++;
+    }
+    fclose(pIndex);
+
+    free(pNumObjs);
+    free(ppSecObjs);
+    free(pData);
+
+    return 0;
+}
+